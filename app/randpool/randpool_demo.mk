@@ -24,6 +24,8 @@ randpool_demo_CSRC = \
 	app/randpool/randpool_demo.c \
 	algos/randpool.c \
 	algos/md2.c \
+	algos/sha256.c \
+	algos/drbg.c \
 	drv/timer.c \
 	os/hptime.c 
 
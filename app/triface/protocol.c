@@ -43,16 +43,6 @@
  */
 
 #include "protocol.h"
-#include "cmd_ctor.h"  // MAKE_CMD, REGISTER_CMD
-#include "verstag.h"
-#include "hw/hw_adc.h"
-#include "hw/hw_input.h"
-
-#include <drv/timer.h>
-#include <drv/ser.h>
-#include <drv/sipo.h>
-#include <drv/wdt.h>
-#include <drv/buzzer.h>
 
 #include <mware/readline.h>
 #include <mware/parser.h>
@@ -61,15 +51,15 @@
 #include <cfg/debug.h>
 
 #include <kern/kfile.h>
+#include <kern/kfile_buf.h>
 
 #include <stdlib.h>
 #include <string.h>
 
-// Define the format string for ADC
-#define ADC_FORMAT_STR "dddd"
-
 // DEBUG: set to 1 to force interactive mode
-#define FORCE_INTERACTIVE         1
+#ifndef FORCE_INTERACTIVE
+	#define FORCE_INTERACTIVE         1
+#endif
 
 /**
  * True if we are in interactive mode, false if we are in protocol mode.
@@ -80,10 +70,24 @@
  */
 static bool interactive;
 
+/**
+ * True if we are in pipelined mode, a variant of protocol mode for
+ * hosts that send commands without waiting for the replies.
+ * No prompt is sent, and each reply starts with the ID of its command
+ * followed by the status code, so the host can match them.
+ */
+static bool pipelined;
+
 /// Readline context, used for interactive mode.
 static struct RLContext rl_ctx;
 
-uint8_t reg_status_dout;
+/**
+ * Replies are collected here and written with a single call
+ * when their line is complete.
+ */
+static KFileBuf reply;
+static uint8_t reply_rx[1];
+static uint8_t reply_tx[64];
 /**
  * Send a NAK asking the host to send the current message again.
  *
@@ -101,7 +105,8 @@ INLINE void NAK(KFile *fd, const char *err)
 
 static void protocol_prompt(KFile *fd)
 {
-	kfile_print(fd, ">> ");
+	if (!pipelined)
+		kfile_print(fd, ">> ");
 }
 
 /*
@@ -137,12 +142,18 @@ static bool protocol_reply(KFile *fd, const struct CmdTemplate *t,
 static void protocol_parse(KFile *fd, const char *buf)
 {
 	const struct CmdTemplate *templ;
+	KFile *out = &reply.fd;
+	unsigned long id;
+
+	/* Tag the reply with the command ID */
+	if (pipelined && parser_get_cmd_id(buf, &id))
+		kfile_printf(out, "%lu ", id);
 
 	/* Command check.  */
 	templ = parser_get_cmd_template(buf);
 	if (!templ)
 	{
-		kfile_print(fd, "-1 Invalid command.\r\n");
+		kfile_print(out, "-1 Invalid command.\r\n");
 		protocol_prompt(fd);
 		return;
 	}
@@ -152,7 +163,7 @@ static void protocol_parse(KFile *fd, const char *buf)
 	/* Args Check.  TODO: Handle different case. see doc/PROTOCOL .  */
 	if (!parser_get_cmd_arguments(buf, templ, args))
 	{
-		kfile_print(fd, "-2 Invalid arguments.\r\n");
+		kfile_print(out, "-2 Invalid arguments.\r\n");
 		protocol_prompt(fd);
 		return;
 	}
@@ -160,17 +171,87 @@ static void protocol_parse(KFile *fd, const char *buf)
 	/* Execute. */
 	if(!parser_execute_cmd(templ, args))
 	{
-		NAK(fd, "Error in executing command.");
+		if (pipelined)
+		{
+			kfile_print(out, "-3 Command failed.\r\n");
+			return;
+		}
+		NAK(out, "Error in executing command.");
 	}
-	if (!protocol_reply(fd, templ, args))
+	else if (pipelined)
+		kfile_putc('0', out);
+
+	if (!protocol_reply(out, templ, args))
 	{
-		NAK(fd, "Invalid return format.");
+		NAK(out, "Invalid return format.");
 	}
 
 	protocol_prompt(fd);
 	return;
 }
 
+/*
+ * Handle the lines changing mode in protocol and pipelined mode.
+ * Return true if the line has been handled.
+ */
+static bool protocol_mode(KFile *fd, const char *buf)
+{
+	if (buf[0] == 0x1B && buf[1] == 0x1B)  // ESC
+	{
+		interactive = true;
+		pipelined = false;
+		kfile_printf(fd, "Entering interactive mode\r\n");
+	}
+	else if (!strcmp(buf, "pipeline"))
+	{
+		pipelined = true;
+		kfile_printf(fd, "Entering pipelined mode\r\n");
+	}
+	else if (pipelined && !strcmp(buf, "exit"))
+	{
+		pipelined = false;
+		interactive = FORCE_INTERACTIVE;
+		kfile_printf(fd, "Leaving pipelined mode...\r\n");
+	}
+	else
+		return false;
+
+	return true;
+}
+
+/*
+ * Read the rest of a binary frame, whose SYNC byte has already
+ * been read, in buf (size bytes long) and execute it.
+ * The reply is sent with a single write; frames longer than buf
+ * are dropped, replying with an error.
+ */
+static void protocol_frame(KFile *fd, uint8_t *buf, size_t size)
+{
+	uint8_t reply[PARSER_REPLY_HDR + 4 * PARSER_MAX_ARGS];
+	size_t len;
+
+	buf[0] = PARSER_FRAME_SYNC;
+	if (kfile_read(fd, buf + 1, 2) != 2)
+		return;
+
+	len = buf[1] + PARSER_FRAME_HDR;
+	if (len > size)
+	{
+		for (len -= 3; len; --len)
+			if (kfile_getc(fd) == EOF)
+				return;
+		len = parser_frame_status(buf[2], PFS_INVALID_ARGS, reply);
+	}
+	else
+	{
+		if (kfile_read(fd, buf + 3, len - 3) != len - 3)
+			return;
+		len = parser_process_frame(buf, len, reply, sizeof(reply));
+	}
+
+	kfile_write(fd, reply, len);
+}
+
 void protocol_run(KFile *fd)
 {
 	/**
@@ -181,7 +262,22 @@ void protocol_run(KFile *fd)
 
 	if (!interactive)
 	{
-		kfile_gets(fd, linebuf, sizeof(linebuf));
+		int c = kfile_getc(fd);
+
+		/* Binary frames from machine clients */
+		if (c == PARSER_FRAME_SYNC)
+		{
+			protocol_frame(fd, (uint8_t *)linebuf, sizeof(linebuf));
+			kfile_clearerr(fd);
+			return;
+		}
+
+		linebuf[0] = '\0';
+		if (c != EOF && c != '\r' && c != '\n')
+		{
+			linebuf[0] = c;
+			kfile_gets(fd, linebuf + 1, sizeof(linebuf) - 1);
+		}
 
 		// reset serial port error anyway
 		kfile_clearerr(fd);
@@ -191,18 +287,8 @@ void protocol_run(KFile *fd)
 		{
 			/* If we enter lines beginning with sharp(#)
 			they are stripped out from commands */
-			if(linebuf[0] != '#')
-			{
-				if (linebuf[0] == 0x1B && linebuf[1] == 0x1B)  // ESC
-				{
-					interactive = true;
-					kfile_printf(fd, "Entering interactive mode\r\n");
-				}
-				else
-				{
-					protocol_parse(fd, linebuf);
-				}
-			}
+			if(linebuf[0] != '#' && !protocol_mode(fd, linebuf))
+				protocol_parse(fd, linebuf);
 		}
 	}
 	else
@@ -232,6 +318,12 @@ void protocol_run(KFile *fd)
 					kfile_printf(fd, "Leaving interactive mode...\r\n");
 					interactive = FORCE_INTERACTIVE;
 				}
+				else if (!strcmp(buf, "pipeline"))
+				{
+					rl_clear_history(&rl_ctx);
+					interactive = false;
+					protocol_mode(fd, buf);
+				}
 				else
 				{
 					//TODO: remove sequence numbers
@@ -247,123 +339,26 @@ void protocol_run(KFile *fd)
 	}
 }
 
-/*
- * Commands.
- * TODO: Command declarations and definitions should be in another file(s).
- * Maybe we should use CMD_HUNK_TEMPLATE.
- *
- */
-
-MAKE_CMD(ver, "", "ddd",
-({
-	args[1].l = VERS_MAJOR;
-	args[2].l = VERS_MINOR;
-	args[3].l = VERS_REV;
-	0;
-}), 0);
-
-/* Sleep. Example of declaring function body directly in macro call.  */
-MAKE_CMD(sleep, "d", "",
-({
-	timer_delay((mtime_t)args[1].l);
-	0;
-}), 0)
-
-/* Ping.  */
-MAKE_CMD(ping, "", "",
-({
-	//Silence "args not used" warning.
-	(void)args;
-	0;
-}), 0)
-
-/* Dout  */
-MAKE_CMD(dout, "d", "",
-({
-	sipo_putchar((uint8_t)args[1].l);
-
-	//Store status of dout ports.
-	reg_status_dout = (uint8_t)args[1].l;
-	0;
-}), 0)
-
-/* rdout  read the status of out ports.*/
-MAKE_CMD(rdout, "", "d",
-({
-	args[1].l = reg_status_dout;
-	0;
-}), 0)
-
-
-/* Reset */
-MAKE_CMD(reset, "", "",
-({
-	//Silence "args not used" warning.
-	(void)args;
-	wdt_init(7);
-	wdt_start();
-
-	/*We want to have an infinite loop that lock access on watchdog timer.
-	This piece of code it's equivalent to a while(true), but we have done this because
-	gcc generate a warning message that suggest to use "noreturn" parameter in function reset.*/
-	ASSERT(args);
-	while(args);
-	0;
-
-}), 0)
-
-/* Din */
-MAKE_CMD(din, "", "d",
-({
-	args[1].l = INPUT_GET();
-	0;
-}), 0)
-
-
-
-/* Ain */
-MAKE_CMD(ain, "", ADC_FORMAT_STR,
-({
-	STATIC_ASSERT((sizeof(ADC_FORMAT_STR) - 1) == ADC_CHANNEL_NUM);
-	for(int i = 0; i < ADC_CHANNEL_NUM; i++)
-		args[i+1].l = adc_read_ai_channel(i);
-
-	0;
-}), 0)
-
-/* Beep  */
-MAKE_CMD(beep, "d", "",
-({
-	buz_beep(args[1].l);
-	0;
-}), 0)
-
-/* Register commands.  */
-static void protocol_registerCmds(void)
+/* Readline output, sent with one write per key.  */
+static void protocol_rlWrite(const char *buf, size_t len, void *fd)
 {
-	REGISTER_CMD(ver);
-	REGISTER_CMD(sleep);
-	REGISTER_CMD(ping);
-	REGISTER_CMD(dout);
-	//Set off all dout ports.
-	reg_status_dout = 0;
-	REGISTER_CMD(rdout);
-	REGISTER_CMD(reset);
-	REGISTER_CMD(din);
-	REGISTER_CMD(ain);
-	REGISTER_CMD(beep);
+	kfile_write((KFile *)fd, buf, len);
 }
 
 /* Initialization: readline context, parser and register commands.  */
 void protocol_init(KFile *fd)
 {
 	interactive = FORCE_INTERACTIVE;
+	pipelined = false;
+
+	kfilebuf_init(&reply, fd, reply_rx, sizeof(reply_rx),
+		reply_tx, sizeof(reply_tx), KFB_LINE);
 
 	rl_init_ctx(&rl_ctx);
 	//rl_setprompt(&rl_ctx, ">> ");
 	rl_sethook_get(&rl_ctx, (getc_hook)kfile_getc, fd);
-	rl_sethook_put(&rl_ctx, (putc_hook)kfile_putc, fd);
-	rl_sethook_match(&rl_ctx, parser_rl_match, NULL);
+	rl_sethook_write(&rl_ctx, protocol_rlWrite, fd);
+	rl_sethook_complete(&rl_ctx, parser_rl_complete, NULL);
 	rl_sethook_clear(&rl_ctx, (clear_hook)kfile_clearerr,fd);
 
 	parser_init();
@@ -47,4 +47,7 @@
 void protocol_init(KFile *fd);
 void protocol_run(KFile *fd);
 
+/* Register the commands of the board, see commands.c */
+void protocol_registerCmds(void);
+
 #endif // PROTOOCOL_H
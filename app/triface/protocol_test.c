@@ -0,0 +1,445 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Triface protocol test.
+ *
+ * The protocol runs in a child process on the slave side of a pty,
+ * set in raw mode like a serial port, while the test plays the host
+ * on the master side. Replies of protocol and pipelined mode, errors
+ * and binary frames are checked.
+ *
+ * The benchmark sends the same commands waiting for every reply
+ * (protocol mode) and keeping a window of commands in flight
+ * (pipelined mode), as text lines and as binary frames.
+ * Results are printed on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<lockstep|pipelined> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#define _GNU_SOURCE /* posix_openpt(), cfmakeraw() */
+
+/* Start in protocol mode */
+#define FORCE_INTERACTIVE 0
+
+/* Board configuration, for kfile_gets() */
+#include "cfg/cfg_kfile.h"
+
+#include "protocol.h"
+#include "cmd_ctor.h"
+
+#include <mware/parser.h>
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <kern/kfile.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if UNIT_TEST
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <signal.h>
+	#include <termios.h>
+	#include <unistd.h>
+	#include <sys/wait.h>
+
+#define BENCH_COMMANDS  5000
+#define BENCH_WINDOW    32
+
+MAKE_CMD(add, "dd", "d",
+({
+	args[3].l = args[1].l + args[2].l;
+	0;
+}), 0)
+
+MAKE_CMD(fail, "", "",
+({
+	(void)args;
+	RC_ERROR;
+}), 0)
+
+void protocol_registerCmds(void)
+{
+	REGISTER_CMD(add);
+	REGISTER_CMD(fail);
+}
+
+/*
+ * Board side: KFile on the slave side of the pty.
+ */
+static struct
+{
+	KFile fd;
+	int tty;
+} board;
+
+static size_t board_read(UNUSED_ARG(struct KFile *, fd), void *buf, size_t size)
+{
+	size_t done = 0;
+
+	while (done < size)
+	{
+		ssize_t len = read(board.tty, (char *)buf + done, size - done);
+
+		/* The host has gone */
+		if (len <= 0)
+			_exit(0);
+		done += len;
+	}
+	return done;
+}
+
+static size_t board_write(UNUSED_ARG(struct KFile *, fd), const void *buf, size_t size)
+{
+	size_t done = 0;
+
+	while (done < size)
+	{
+		ssize_t len = write(board.tty, (const char *)buf + done, size - done);
+
+		if (len <= 0)
+			_exit(0);
+		done += len;
+	}
+	return done;
+}
+
+static void board_clearerr(UNUSED_ARG(struct KFile *, fd))
+{
+}
+
+static void board_run(int tty)
+{
+	memset(&board, 0, sizeof(board));
+	board.tty = tty;
+	board.fd.read = board_read;
+	board.fd.write = board_write;
+	board.fd.clearerr = board_clearerr;
+	board.fd.close = kfile_genericClose;
+
+	protocol_init(&board.fd);
+	for (;;)
+		protocol_run(&board.fd);
+}
+
+/*
+ * Host side, on the master side of the pty.
+ */
+/* Max time to wait for the board answers */
+#define HOST_TIMEOUT_MS  5000
+
+static int host;
+static pid_t board_pid;
+static char host_buf[4096];
+static size_t host_pos, host_len;
+
+static void host_send(const void *buf, size_t len)
+{
+	ssize_t done = write(host, buf, len);
+
+	ASSERT(done == (ssize_t)len);
+}
+
+static void host_print(const char *str)
+{
+	host_send(str, strlen(str));
+}
+
+static int host_getc(void)
+{
+	if (host_pos == host_len)
+	{
+		struct pollfd pfd = { .fd = host, .events = POLLIN };
+		ssize_t len;
+
+		/* Do not hang the whole test run if the board stops answering */
+		if (poll(&pfd, 1, HOST_TIMEOUT_MS) != 1)
+		{
+			kprintf("no answer from the board\n");
+			kill(board_pid, SIGTERM);
+			exit(2);
+		}
+		len = read(host, host_buf, sizeof(host_buf));
+		ASSERT(len > 0);
+		host_pos = 0;
+		host_len = len;
+	}
+	return (unsigned char)host_buf[host_pos++];
+}
+
+/* Read \a len bytes, or a line if len is 0 */
+static char *host_recv(size_t len)
+{
+	static char line[128];
+	size_t i = 0;
+
+	while (i < sizeof(line) - 1)
+	{
+		line[i++] = host_getc();
+		if (len ? i == len : line[i - 1] == '\n')
+			break;
+	}
+	line[i] = '\0';
+	return line;
+}
+
+#define EXPECT(str) \
+	do { \
+		const char *got = host_recv(0); \
+		if (strcmp(got, (str))) \
+		{ \
+			kprintf("expected [%s] got [%s]\n", (str), got); \
+			ASSERT(0); \
+		} \
+	} while (0)
+
+/* The prompt has no line end */
+#define EXPECT_PROMPT() \
+	do { \
+		const char *got = host_recv(3); \
+		ASSERT(!strcmp(got, ">> ")); \
+	} while (0)
+
+/* Build a binary frame running add(a, b) */
+static size_t makeAdd(uint8_t *frame, uint8_t seq, int32_t a, int32_t b)
+{
+	cmd_hash_t hash = parser_cmd_hash("add", 3);
+
+	frame[0] = PARSER_FRAME_SYNC;
+	frame[1] = 8;
+	frame[2] = seq;
+	frame[3] = (uint8_t)hash;
+	frame[4] = (uint8_t)(hash >> 8);
+	for (int i = 0; i < 4; i++)
+	{
+		frame[5 + i] = (uint8_t)((uint32_t)a >> (8 * i));
+		frame[9 + i] = (uint8_t)((uint32_t)b >> (8 * i));
+	}
+	return PARSER_FRAME_HDR + 8;
+}
+
+/* Check the reply to a frame built by makeAdd() */
+static void checkAdd(uint8_t seq, int32_t sum)
+{
+	const uint8_t *r = (const uint8_t *)host_recv(PARSER_REPLY_HDR + 4);
+
+	ASSERT(r[0] == PARSER_FRAME_SYNC && r[1] == 4 && r[2] == seq && r[3] == PFS_OK);
+	ASSERT((int32_t)(r[4] | (r[5] << 8) | (r[6] << 16) | ((uint32_t)r[7] << 24)) == sum);
+}
+
+static void modes(void)
+{
+	uint8_t frame[32];
+
+	/* Protocol mode */
+	EXPECT_PROMPT();
+	host_print("1 add 2 3\r\n");
+	EXPECT(" 5\r\n");
+	EXPECT_PROMPT();
+	host_print("2 sub 2 3\r\n");
+	EXPECT("-1 Invalid command.\r\n");
+	EXPECT_PROMPT();
+
+	/* Pipelined mode: a batch of commands, replies in order */
+	host_print("pipeline\r\n");
+	EXPECT("Entering pipelined mode\r\n");
+	host_print("7 add 1 2\r\n"
+		"# comment\r\n"
+		"8 sub 1 2\r\n"
+		"9 add 1\r\n"
+		"10 fail\r\n"
+		"11 add -5 2\r\n");
+	host_send(frame, makeAdd(frame, 12, 100000, -1));
+	host_print("13 add 40 2\r\n");
+	EXPECT("7 0 3\r\n");
+	EXPECT("8 -1 Invalid command.\r\n");
+	EXPECT("9 -2 Invalid arguments.\r\n");
+	EXPECT("10 -3 Command failed.\r\n");
+	EXPECT("11 0 -3\r\n");
+	checkAdd(12, 99999);
+	EXPECT("13 0 42\r\n");
+
+	host_print("exit\r\n");
+	EXPECT("Leaving pipelined mode...\r\n");
+	host_print("14 add 1 1\r\n");
+	EXPECT(" 2\r\n");
+	EXPECT_PROMPT();
+}
+
+static void benchReport(const char *scenario, const char *path, unsigned long t)
+{
+	printf("BENCH scenario=%s path=%s commands=%d window=%d time_us=%lu cmds_per_s=%lu\n",
+		scenario, path, BENCH_COMMANDS, strcmp(path, "lockstep") ? BENCH_WINDOW : 1,
+		t / 1000, (unsigned long)((unsigned long long)BENCH_COMMANDS * 1000000000ULL / t));
+}
+
+static void sendText(int i)
+{
+	char line[32];
+
+	snprintf(line, sizeof(line), "%d add %d 1\r\n", i, i);
+	host_print(line);
+}
+
+static void recvText(int i, bool tagged)
+{
+	char expect[32];
+
+	if (tagged)
+		snprintf(expect, sizeof(expect), "%d 0 %d\r\n", i, i + 1);
+	else
+		snprintf(expect, sizeof(expect), " %d\r\n", i + 1);
+	EXPECT(expect);
+}
+
+static void sendFrame(int i)
+{
+	uint8_t frame[32];
+
+	host_send(frame, makeAdd(frame, (uint8_t)i, i, 1));
+}
+
+static void bench(void)
+{
+	unsigned long start;
+	int sent, i;
+
+	/* Protocol mode: one command at a time */
+	start = bench_nsec();
+	for (i = 0; i < BENCH_COMMANDS; i++)
+	{
+		sendText(i);
+		recvText(i, false);
+		EXPECT_PROMPT();
+	}
+	benchReport("text", "lockstep", bench_nsec() - start);
+
+	start = bench_nsec();
+	for (i = 0; i < BENCH_COMMANDS; i++)
+	{
+		sendFrame(i);
+		checkAdd((uint8_t)i, i + 1);
+	}
+	benchReport("frame", "lockstep", bench_nsec() - start);
+
+	/* Pipelined mode: up to BENCH_WINDOW commands in flight */
+	host_print("pipeline\r\n");
+	EXPECT("Entering pipelined mode\r\n");
+
+	start = bench_nsec();
+	for (i = sent = 0; i < BENCH_COMMANDS; i++)
+	{
+		while (sent < BENCH_COMMANDS && sent < i + BENCH_WINDOW)
+			sendText(sent++);
+		recvText(i, true);
+	}
+	benchReport("text", "pipelined", bench_nsec() - start);
+
+	start = bench_nsec();
+	for (i = sent = 0; i < BENCH_COMMANDS; i++)
+	{
+		while (sent < BENCH_COMMANDS && sent < i + BENCH_WINDOW)
+			sendFrame(sent++);
+		checkAdd((uint8_t)i, i + 1);
+	}
+	benchReport("frame", "pipelined", bench_nsec() - start);
+}
+
+int protocol_testSetup(void)
+{
+	struct termios tio;
+	int tty, granted, unlocked;
+
+	kdbg_init();
+
+	host = posix_openpt(O_RDWR | O_NOCTTY);
+	ASSERT(host >= 0);
+	granted = grantpt(host);
+	unlocked = unlockpt(host);
+	ASSERT(granted == 0 && unlocked == 0);
+	tty = open(ptsname(host), O_RDWR | O_NOCTTY);
+	ASSERT(tty >= 0);
+
+	/* Like a serial line: no echo, no line editing, no translations */
+	tcgetattr(tty, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(tty, TCSANOW, &tio);
+
+	fflush(stdout);
+	board_pid = fork();
+	ASSERT(board_pid >= 0);
+	if (!board_pid)
+	{
+		close(host);
+		board_run(tty);
+	}
+	close(tty);
+	return 0;
+}
+
+int protocol_testRun(void)
+{
+	modes();
+	bench();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int protocol_testTearDown(void)
+{
+	int status;
+
+	close(host);
+	kill(board_pid, SIGTERM);
+	waitpid(board_pid, &status, 0);
+	return 0;
+}
+
+TEST_MAIN(protocol);
+
+#include "protocol.c"
+#include <mware/parser.c>
+#include <mware/readline.c>
+#include <kern/kfile.c>
+#include <kern/kfile_buf.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif // UNIT_TEST
@@ -22,6 +22,7 @@ triface_lock = 0x2f
 triface_CSRC = \
 	app/triface/triface.c \
 	app/triface/protocol.c \
+	app/triface/commands.c \
 	app/triface/hw/hw_adc.c \
 	bertos/drv/timer.c \
 	bertos/drv/ser.c \
@@ -30,11 +31,11 @@ triface_CSRC = \
 	bertos/cpu/avr/drv/sipo.c \
 	bertos/mware/formatwr.c \
 	bertos/mware/hex.c \
-	bertos/struct/hashtable.c \
 	bertos/mware/readline.c \
 	bertos/mware/parser.c \
 	bertos/mware/event.c \
 	bertos/kern/kfile.c \
+	bertos/kern/kfile_buf.c \
 	bertos/net/keytag.c \
 	#
 
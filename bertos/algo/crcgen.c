@@ -0,0 +1,318 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Generic table driven CRC, with slicing kernels.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "crcgen.h"
+
+#include "cfg/cfg_crcgen.h"
+#include <cfg/debug.h>
+
+#include <cpu/detect.h>
+
+#include <string.h> /* memcpy() */
+
+#if CONFIG_CRCGEN_HW && CPU_X86 && defined(__GNUC__)
+	#define CRCGEN_HW_32C 1
+
+	/// CRC-32C polynomial, bit reversed.
+	#define CRC32C_POLY  0x82F63B78UL
+
+	/*
+	 * CRC-32C with the SSE 4.2 CRC32 instruction: it works on the
+	 * reflected register, like the table kernels.
+	 */
+	static __attribute__((target("sse4.2")))
+	uint32_t crcgen_hw32c(uint32_t crc, const uint8_t *buf, size_t len)
+	{
+		#if CPU_X86_64
+			uint64_t crc64 = crc;
+
+			for (; len >= 8; buf += 8, len -= 8)
+			{
+				uint64_t v;
+
+				memcpy(&v, buf, sizeof(v));
+				crc64 = __builtin_ia32_crc32di(crc64, v);
+			}
+			crc = (uint32_t)crc64;
+		#endif
+
+		for (; len >= 4; buf += 4, len -= 4)
+		{
+			uint32_t v;
+
+			memcpy(&v, buf, sizeof(v));
+			crc = __builtin_ia32_crc32si(crc, v);
+		}
+
+		while (len--)
+			crc = __builtin_ia32_crc32qi(crc, *buf++);
+
+		return crc;
+	}
+#else
+	#define CRCGEN_HW_32C 0
+#endif
+
+/// Mask of the valid bits of the CRC register of \a gen.
+#define CRC_MASK(gen)  ((gen)->width == 32 ? 0xFFFFFFFFUL : (1UL << (gen)->width) - 1)
+
+/// Load 4 bytes in little endian order.
+#define LOAD_LE32(p) \
+	((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+
+/**
+ * Build the lookup tables of \a gen.
+ *
+ * Table 0 holds the CRC of each byte value; table k the CRC of a byte value
+ * followed by k zero bytes, so that a slicing kernel can add up the
+ * contribution of k bytes with k independent lookups.
+ */
+void crcgen_init(CrcGen *gen)
+{
+	uint32_t (*t)[256] = gen->table;
+	uint32_t mask = CRC_MASK(gen);
+	unsigned shift = gen->width - 8;
+
+	ASSERT(gen->width == 16 || gen->width == 32);
+	ASSERT(gen->slices == 1 || gen->slices == 4 || gen->slices == 8);
+
+	for (unsigned b = 0; b < 256; b++)
+	{
+		uint32_t c;
+
+		if (gen->reflected)
+		{
+			c = b;
+			for (int i = 0; i < 8; i++)
+				c = (c & 1) ? (c >> 1) ^ gen->poly : c >> 1;
+		}
+		else
+		{
+			c = (uint32_t)b << shift;
+			for (int i = 0; i < 8; i++)
+				c = ((c >> (gen->width - 1)) & 1) ? ((c << 1) ^ gen->poly) & mask : (c << 1) & mask;
+		}
+		t[0][b] = c;
+	}
+
+	for (unsigned k = 1; k < gen->slices; k++)
+		for (unsigned b = 0; b < 256; b++)
+		{
+			uint32_t c = t[k - 1][b];
+
+			t[k][b] = gen->reflected ?
+				(c >> 8) ^ t[0][c & 0xFF] :
+				((c << 8) & mask) ^ t[0][c >> shift];
+		}
+
+	gen->hw = false;
+	#if CRCGEN_HW_32C
+		__builtin_cpu_init();
+		gen->hw = gen->reflected && gen->width == 32 && gen->poly == CRC32C_POLY
+			&& __builtin_cpu_supports("sse4.2");
+	#endif
+
+	gen->ready = true;
+}
+
+/*
+ * Slice-by-4 and slice-by-8 kernels for reflected 32 bit CRCs,
+ * the common case: CRC-32 and CRC-32C.
+ */
+static uint32_t crcgen_slice4(uint32_t (*t)[256], uint32_t crc, const uint8_t *buf, size_t blocks)
+{
+	while (blocks--)
+	{
+		crc ^= LOAD_LE32(buf);
+		crc = t[3][crc & 0xFF] ^ t[2][(crc >> 8) & 0xFF]
+			^ t[1][(crc >> 16) & 0xFF] ^ t[0][crc >> 24];
+		buf += 4;
+	}
+	return crc;
+}
+
+static uint32_t crcgen_slice8(uint32_t (*t)[256], uint32_t crc, const uint8_t *buf, size_t blocks)
+{
+	while (blocks--)
+	{
+		crc ^= LOAD_LE32(buf);
+		crc = t[7][crc & 0xFF] ^ t[6][(crc >> 8) & 0xFF]
+			^ t[5][(crc >> 16) & 0xFF] ^ t[4][crc >> 24]
+			^ t[3][buf[4]] ^ t[2][buf[5]] ^ t[1][buf[6]] ^ t[0][buf[7]];
+		buf += 8;
+	}
+	return crc;
+}
+
+/*
+ * Slice-by-4 and slice-by-8 kernels for MSB first 16 bit CRCs,
+ * like CRC-16/CCITT and XMODEM.
+ */
+static uint32_t crcgen_slice4_16(uint32_t (*t)[256], uint32_t crc, const uint8_t *buf, size_t blocks)
+{
+	while (blocks--)
+	{
+		crc = t[3][buf[0] ^ (crc >> 8)] ^ t[2][buf[1] ^ (crc & 0xFF)]
+			^ t[1][buf[2]] ^ t[0][buf[3]];
+		buf += 4;
+	}
+	return crc;
+}
+
+static uint32_t crcgen_slice8_16(uint32_t (*t)[256], uint32_t crc, const uint8_t *buf, size_t blocks)
+{
+	while (blocks--)
+	{
+		crc = t[7][buf[0] ^ (crc >> 8)] ^ t[6][buf[1] ^ (crc & 0xFF)]
+			^ t[5][buf[2]] ^ t[4][buf[3]]
+			^ t[3][buf[4]] ^ t[2][buf[5]] ^ t[1][buf[6]] ^ t[0][buf[7]];
+		buf += 8;
+	}
+	return crc;
+}
+
+/*
+ * Slicing kernel for any width and bit order: the bytes of the CRC
+ * register are xored with the first bytes of each block, then every byte
+ * of the block is looked up in the table of its distance from the end.
+ */
+static uint32_t crcgen_sliceGeneric(const CrcGen *gen, uint32_t crc, const uint8_t *buf, size_t blocks)
+{
+	unsigned n = gen->slices;
+	unsigned crc_bytes = gen->width / 8;
+
+	while (blocks--)
+	{
+		uint32_t res = 0;
+
+		for (unsigned i = 0; i < n; i++)
+		{
+			uint8_t b = buf[i];
+
+			if (i < crc_bytes)
+				b ^= gen->reflected ? crc >> (8 * i) : crc >> (gen->width - 8 * (i + 1));
+			res ^= gen->table[n - 1 - i][b];
+		}
+		crc = res;
+		buf += n;
+	}
+	return crc;
+}
+
+/**
+ * Start a CRC computation with \a gen, building its tables if needed.
+ */
+void crcgen_begin(CrcGenCtx *ctx, CrcGen *gen)
+{
+	if (!gen->ready)
+		crcgen_init(gen);
+
+	ctx->gen = gen;
+	ctx->crc = gen->init;
+}
+
+/**
+ * Add \a len bytes of \a buf to the CRC computed in \a ctx.
+ */
+void crcgen_update(CrcGenCtx *ctx, const void *_buf, size_t len)
+{
+	const CrcGen *gen = ctx->gen;
+	const uint8_t *buf = (const uint8_t *)_buf;
+	uint32_t crc = ctx->crc;
+
+	#if CRCGEN_HW_32C
+		if (gen->hw)
+		{
+			ctx->crc = crcgen_hw32c(crc, buf, len);
+			return;
+		}
+	#endif
+
+	if (gen->slices > 1 && len >= gen->slices)
+	{
+		size_t blocks = len / gen->slices;
+
+		if (gen->reflected && gen->width == 32)
+			crc = gen->slices == 4 ?
+				crcgen_slice4(gen->table, crc, buf, blocks) :
+				crcgen_slice8(gen->table, crc, buf, blocks);
+		else if (!gen->reflected && gen->width == 16)
+			crc = gen->slices == 4 ?
+				crcgen_slice4_16(gen->table, crc, buf, blocks) :
+				crcgen_slice8_16(gen->table, crc, buf, blocks);
+		else
+			crc = crcgen_sliceGeneric(gen, crc, buf, blocks);
+
+		buf += blocks * gen->slices;
+		len -= blocks * gen->slices;
+	}
+
+	/* Remaining bytes, one at a time */
+	if (gen->reflected)
+		while (len--)
+			crc = gen->table[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+	else
+	{
+		uint32_t mask = CRC_MASK(gen);
+		unsigned shift = gen->width - 8;
+
+		while (len--)
+			crc = gen->table[0][((crc >> shift) ^ *buf++) & 0xFF] ^ ((crc << 8) & mask);
+	}
+
+	ctx->crc = crc;
+}
+
+/**
+ * \return the CRC of all the data added to \a ctx.
+ */
+uint32_t crcgen_end(CrcGenCtx *ctx)
+{
+	return (ctx->crc ^ ctx->gen->xorout) & CRC_MASK(ctx->gen);
+}
+
+/**
+ * \return the CRC of \a len bytes of \a buf, computed with \a gen.
+ */
+uint32_t crcgen_compute(CrcGen *gen, const void *buf, size_t len)
+{
+	CrcGenCtx ctx;
+
+	crcgen_begin(&ctx, gen);
+	crcgen_update(&ctx, buf, len);
+	return crcgen_end(&ctx);
+}
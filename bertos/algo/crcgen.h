@@ -0,0 +1,127 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Generic table driven CRC, with slicing kernels.
+ *
+ * A CrcGen describes a CRC algorithm: width (16 or 32 bits), polynomial,
+ * initial value, final xor and bit order. Parameters of the most used
+ * CRCs are predefined, other ones can be given at runtime.
+ *
+ * Each CrcGen owns its lookup tables, built in RAM on first use: with
+ * 1 slice the CRC is computed one byte at a time with a 256 entries table,
+ * with 4 or 8 slices 4 or 8 bytes are processed at once using one table
+ * per byte (slice-by-4/8), which is much faster on 32 bit CPUs at the cost
+ * of 1KB of RAM per slice.
+ * On x86 CPUs with SSE 4.2, CRC-32C is computed with the CRC32 instruction.
+ *
+ * \code
+ * CRCGEN_DECLARE(static, fs_crc, CRCGEN_32C, 4);
+ * CrcGenCtx ctx;
+ *
+ * crcgen_begin(&ctx, &fs_crc);
+ * crcgen_update(&ctx, hdr, sizeof(hdr));
+ * crcgen_update(&ctx, data, len);
+ * hdr.crc = crcgen_end(&ctx);
+ *
+ * // Or, in a single call
+ * crc = crcgen_compute(&fs_crc, data, len);
+ * \endcode
+ *
+ * \note Algo/crc.h is still the best choice on 8 bit CPUs: its
+ *       CRC16 table is in flash and does not need any RAM.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef ALGO_CRCGEN_H
+#define ALGO_CRCGEN_H
+
+#include <cfg/compiler.h>
+
+/**
+ * \name Parameters of common CRCs.
+ * Width, polynomial, initial value, final xor, reflected bit order,
+ * in parentheses; custom CRCs use the same form.
+ * Polynomials of reflected CRCs are bit reversed.
+ * \{
+ */
+#define CRCGEN_CCITT   (16, 0x1021, 0xFFFF, 0, false)                        ///< CRC-16/CCITT-FALSE
+#define CRCGEN_XMODEM  (16, 0x1021, 0, 0, false)                             ///< CRC-16/XMODEM, like crc16()
+#define CRCGEN_32      (32, 0xEDB88320UL, 0xFFFFFFFFUL, 0xFFFFFFFFUL, true)  ///< CRC-32 (Ethernet, zip)
+#define CRCGEN_32C     (32, 0x82F63B78UL, 0xFFFFFFFFUL, 0xFFFFFFFFUL, true)  ///< CRC-32C (Castagnoli)
+/* \} */
+
+/**
+ * CRC algorithm, with its lookup tables.
+ */
+typedef struct CrcGen
+{
+	uint8_t width;          ///< Width of the CRC: 16 or 32.
+	uint32_t poly;          ///< Polynomial, bit reversed if reflected.
+	uint32_t init;          ///< Initial value.
+	uint32_t xorout;        ///< Value xored with the final CRC.
+	bool reflected;         ///< True if bits are processed LSB first.
+
+	uint8_t slices;         ///< Bytes processed at once: 1, 4 or 8.
+	uint32_t (*table)[256]; ///< \a slices lookup tables.
+	bool ready;             ///< True when the tables are built.
+	bool hw;                ///< True if the CRC is computed in hardware.
+} CrcGen;
+
+/**
+ * Streaming CRC computation context.
+ */
+typedef struct CrcGenCtx
+{
+	CrcGen *gen;            ///< Algorithm in use.
+	uint32_t crc;           ///< Current CRC register.
+} CrcGenCtx;
+
+/// Static initializer for a CrcGen.
+#define CRCGEN_INIT(table, slices, params)  { CRCGEN_PARAMS_ params, slices, table, false, false }
+#define CRCGEN_PARAMS_(width, poly, init, xorout, refl)  width, poly, init, xorout, refl
+
+/**
+ * Declare CrcGen \a name, with \a params (one of the CRCGEN_* parameter
+ * sets) and \a slices lookup tables; \a storage is the storage class.
+ */
+#define CRCGEN_DECLARE(storage, name, params, slices) \
+	storage uint32_t name##_table[slices][256]; \
+	storage CrcGen name = CRCGEN_INIT(name##_table, slices, params)
+
+void crcgen_init(CrcGen *gen);
+void crcgen_begin(CrcGenCtx *ctx, CrcGen *gen);
+void crcgen_update(CrcGenCtx *ctx, const void *buf, size_t len);
+uint32_t crcgen_end(CrcGenCtx *ctx);
+uint32_t crcgen_compute(CrcGen *gen, const void *buf, size_t len);
+
+#endif /* ALGO_CRCGEN_H */
@@ -0,0 +1,274 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Generic CRC test.
+ *
+ * Every predefined CRC is checked against its standard check value
+ * (the CRC of "123456789"), CRC-16/XMODEM against crc16(), and all
+ * kernels (bytewise, slice-by-4, slice-by-8 and hardware) against each
+ * other, on unaligned buffers and with random sized streaming updates.
+ *
+ * The benchmark measures the throughput of each CRC with each kernel,
+ * printing on stdout:
+ * \code
+ * BENCH scenario=<crc> path=<slice1|slice4|slice8|hw|crc16> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "crcgen.h"
+#include "crc.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+#include <cfg/test.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define BUF_SIZE      4096
+#define BENCH_BYTES   (64UL * 1024 * 1024)
+
+static uint8_t buf[BUF_SIZE + 8];
+
+CRCGEN_DECLARE(static, ccitt1, CRCGEN_CCITT, 1);
+CRCGEN_DECLARE(static, ccitt4, CRCGEN_CCITT, 4);
+CRCGEN_DECLARE(static, ccitt8, CRCGEN_CCITT, 8);
+CRCGEN_DECLARE(static, xmodem1, CRCGEN_XMODEM, 1);
+CRCGEN_DECLARE(static, xmodem4, CRCGEN_XMODEM, 4);
+CRCGEN_DECLARE(static, xmodem8, CRCGEN_XMODEM, 8);
+CRCGEN_DECLARE(static, crc32_1, CRCGEN_32, 1);
+CRCGEN_DECLARE(static, crc32_4, CRCGEN_32, 4);
+CRCGEN_DECLARE(static, crc32_8, CRCGEN_32, 8);
+CRCGEN_DECLARE(static, crc32c_1, CRCGEN_32C, 1);
+CRCGEN_DECLARE(static, crc32c_4, CRCGEN_32C, 4);
+CRCGEN_DECLARE(static, crc32c_8, CRCGEN_32C, 8);
+
+/* A reflected 16 bit CRC (CRC-16/X-25), to exercise the generic slicing kernel */
+CRCGEN_DECLARE(static, x25_1, (16, 0x8408, 0xFFFF, 0xFFFF, true), 1);
+CRCGEN_DECLARE(static, x25_8, (16, 0x8408, 0xFFFF, 0xFFFF, true), 8);
+
+static const struct
+{
+	const char *name;
+	CrcGen *gen[3];
+	uint32_t check;
+} crcs[] =
+{
+	{ "ccitt",  { &ccitt1, &ccitt4, &ccitt8 },       0x29B1 },
+	{ "xmodem", { &xmodem1, &xmodem4, &xmodem8 },    0x31C3 },
+	{ "crc32",  { &crc32_1, &crc32_4, &crc32_8 },    0xCBF43926UL },
+	{ "crc32c", { &crc32c_1, &crc32c_4, &crc32c_8 }, 0xE3069283UL },
+	{ "x25",    { &x25_1, &x25_8, &x25_8 },          0x906E },
+};
+
+static uint32_t seed = 1;
+
+static uint32_t test_rand(void)
+{
+	seed = seed * 1103515245UL + 12345;
+	return seed >> 8;
+}
+
+static uint32_t computeStreaming(CrcGen *gen, const uint8_t *data, size_t len)
+{
+	CrcGenCtx ctx;
+
+	crcgen_begin(&ctx, gen);
+	while (len)
+	{
+		size_t n = MIN(len, (size_t)(test_rand() % 23));
+
+		crcgen_update(&ctx, data, n);
+		data += n;
+		len -= n;
+	}
+	return crcgen_end(&ctx);
+}
+
+static int checkValues(void)
+{
+	for (size_t i = 0; i < countof(crcs); i++)
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t crc = crcgen_compute(crcs[i].gen[k], "123456789", 9);
+
+			if (crc != crcs[i].check)
+			{
+				kprintf("%s, %d slices: check %08lx, expected %08lx\n", crcs[i].name,
+					crcs[i].gen[k]->slices, (unsigned long)crc, (unsigned long)crcs[i].check);
+				return -1;
+			}
+		}
+	return 0;
+}
+
+static int crossCheck(void)
+{
+	for (int round = 0; round < 200; round++)
+	{
+		size_t off = test_rand() % 8;
+		size_t len = test_rand() % (BUF_SIZE / 4);
+		const uint8_t *data = buf + off;
+
+		for (size_t i = 0; i < countof(crcs); i++)
+		{
+			uint32_t ref = crcgen_compute(crcs[i].gen[0], data, len);
+
+			for (int k = 1; k < 3; k++)
+			{
+				if (crcgen_compute(crcs[i].gen[k], data, len) != ref
+				 || computeStreaming(crcs[i].gen[k], data, len) != ref)
+				{
+					kprintf("%s, %d slices: mismatch on %lu bytes at offset %lu\n", crcs[i].name,
+						crcs[i].gen[k]->slices, (unsigned long)len, (unsigned long)off);
+					return -1;
+				}
+			}
+		}
+
+		if (crcgen_compute(&xmodem8, data, len) != crc16(0, data, len))
+		{
+			kprintf("xmodem differs from crc16() on %lu bytes\n", (unsigned long)len);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Compare the hardware CRC-32C with the tables, if the CPU has it */
+static int checkHw(void)
+{
+	CrcGen sw = crc32c_8;
+
+	sw.hw = false;
+	for (int round = 0; round < 200; round++)
+	{
+		size_t off = test_rand() % 8;
+		size_t len = test_rand() % BUF_SIZE;
+
+		if (crcgen_compute(&crc32c_8, buf + off, len) != crcgen_compute(&sw, buf + off, len)
+		 || computeStreaming(&crc32c_8, buf + off, len) != crcgen_compute(&sw, buf + off, len))
+		{
+			kprintf("crc32c: hw mismatch on %lu bytes at offset %lu\n", (unsigned long)len, (unsigned long)off);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void benchReport(const char *name, const char *path, unsigned long t, uint32_t sum)
+{
+	printf("BENCH scenario=%s path=%s bytes=%lu time_us=%lu mb_per_s=%lu sum=%08lx\n",
+		name, path, BENCH_BYTES, t / 1000, BENCH_BYTES * 1000 / t, (unsigned long)sum);
+}
+
+/*
+ * CRC of BENCH_BYTES bytes with \a gen, chained through all the
+ * buffers so that no call can be hoisted out of the loop.
+ */
+static uint32_t benchGen(CrcGen *gen)
+{
+	CrcGenCtx ctx;
+
+	crcgen_begin(&ctx, gen);
+	for (unsigned long n = 0; n < BENCH_BYTES; n += BUF_SIZE)
+		crcgen_update(&ctx, buf, BUF_SIZE);
+	return crcgen_end(&ctx);
+}
+
+static void bench(void)
+{
+	static const char * const paths[] = { "slice1", "slice4", "slice8" };
+	unsigned long start, n;
+	uint32_t sum;
+	uint16_t crc;
+
+	for (size_t i = 0; i < countof(crcs) - 1; i++)
+		for (int k = 0; k < 3; k++)
+		{
+			CrcGen gen = *crcs[i].gen[k];
+
+			/* Tables only: the hardware kernel is measured below */
+			gen.hw = false;
+			start = bench_nsec();
+			sum = benchGen(&gen);
+			benchReport(crcs[i].name, paths[k], bench_nsec() - start, sum);
+		}
+
+	if (crc32c_8.hw)
+	{
+		start = bench_nsec();
+		sum = benchGen(&crc32c_8);
+		benchReport("crc32c", "hw", bench_nsec() - start, sum);
+	}
+
+	crc = 0;
+	start = bench_nsec();
+	for (n = 0; n < BENCH_BYTES; n += BUF_SIZE)
+		crc = crc16(crc, buf, BUF_SIZE);
+	benchReport("xmodem", "crc16", bench_nsec() - start, crc);
+}
+
+int crcgen_testSetup(void)
+{
+	kdbg_init();
+	for (size_t i = 0; i < sizeof(buf); i++)
+		buf[i] = (uint8_t)test_rand();
+	return 0;
+}
+
+int crcgen_testRun(void)
+{
+	if (checkValues() || crossCheck() || checkHw())
+		return -1;
+
+	kprintf("crc32c: hardware kernel %s\n", crc32c_8.hw ? "in use" : "not available");
+	bench();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int crcgen_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(crcgen);
+
+#include "crcgen.c"
+#include "crc.c"
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
@@ -0,0 +1,111 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief HMAC-DRBG deterministic random bit generator.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "drbg.h"
+
+#include <cfg/macros.h> /* MIN() */
+
+#include <string.h>     /* memcpy(), memset() */
+
+/*
+ * HMAC_DRBG_Update(): mix \a data, if any, in K and V.
+ */
+static void drbg_update(Drbg *drbg, const void *data, size_t len)
+{
+	uint8_t key[SHA256_DIGEST_LEN];
+
+	for (uint8_t sep = 0; sep < (len ? 2 : 1); sep++)
+	{
+		/* K = HMAC(K, V || sep || data) */
+		sha256_hmacUpdate(&drbg->hmac, drbg->v, sizeof(drbg->v));
+		sha256_hmacUpdate(&drbg->hmac, &sep, 1);
+		if (len)
+			sha256_hmacUpdate(&drbg->hmac, data, len);
+		memcpy(key, sha256_hmacEnd(&drbg->hmac), sizeof(key));
+		sha256_hmacInit(&drbg->hmac, key, sizeof(key));
+
+		/* V = HMAC(K, V) */
+		sha256_hmacUpdate(&drbg->hmac, drbg->v, sizeof(drbg->v));
+		memcpy(drbg->v, sha256_hmacEnd(&drbg->hmac), sizeof(drbg->v));
+	}
+}
+
+/**
+ * Instantiate \a drbg from \a len bytes of \a seed.
+ */
+void drbg_init(Drbg *drbg, const void *seed, size_t len)
+{
+	uint8_t key[SHA256_DIGEST_LEN];
+
+	memset(key, 0, sizeof(key));
+	sha256_hmacInit(&drbg->hmac, key, sizeof(key));
+	memset(drbg->v, 0x01, sizeof(drbg->v));
+
+	drbg_update(drbg, seed, len);
+	drbg->reseed_counter = 1;
+}
+
+/**
+ * Mix \a len bytes of fresh \a data in the state of \a drbg.
+ */
+void drbg_reseed(Drbg *drbg, const void *data, size_t len)
+{
+	drbg_update(drbg, data, len);
+	drbg->reseed_counter = 1;
+}
+
+/**
+ * Fill \a out with \a len pseudo random bytes.
+ */
+void drbg_generate(Drbg *drbg, void *_out, size_t len)
+{
+	uint8_t *out = (uint8_t *)_out;
+
+	while (len)
+	{
+		size_t n = MIN(len, sizeof(drbg->v));
+
+		sha256_hmacUpdate(&drbg->hmac, drbg->v, sizeof(drbg->v));
+		memcpy(drbg->v, sha256_hmacEnd(&drbg->hmac), sizeof(drbg->v));
+		memcpy(out, drbg->v, n);
+		out += n;
+		len -= n;
+	}
+
+	drbg_update(drbg, NULL, 0);
+	drbg->reseed_counter++;
+}
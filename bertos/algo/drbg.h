@@ -0,0 +1,73 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief HMAC-DRBG deterministic random bit generator.
+ *
+ * HMAC_DRBG with SHA-256, as specified in NIST SP 800-90A, without
+ * prediction resistance and personalization strings. The generator is
+ * seeded with data holding enough entropy (at least 32 bytes worth) and
+ * produces an unpredictable byte stream; after every request the
+ * internal state is updated, so past outputs can not be recovered
+ * from the current state.
+ *
+ * \code
+ * Drbg drbg;
+ *
+ * drbg_init(&drbg, seed, sizeof(seed));
+ * drbg_generate(&drbg, session_key, sizeof(session_key));
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef ALGO_DRBG_H
+#define ALGO_DRBG_H
+
+#include "sha256.h"
+
+#include <cfg/compiler.h>
+
+/**
+ * HMAC-DRBG context.
+ */
+typedef struct Drbg
+{
+	Sha256Hmac hmac;              ///< HMAC keyed with the current K.
+	uint8_t v[SHA256_DIGEST_LEN]; ///< Current V.
+	uint32_t reseed_counter;      ///< Requests since the last reseed.
+} Drbg;
+
+void drbg_init(Drbg *drbg, const void *seed, size_t len);
+void drbg_reseed(Drbg *drbg, const void *data, size_t len);
+void drbg_generate(Drbg *drbg, void *out, size_t len);
+
+#endif /* ALGO_DRBG_H */
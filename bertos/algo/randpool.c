@@ -37,15 +37,18 @@
  */
 
 #include "randpool.h"
-#include "md2.h"
 
 #include <cfg/compiler.h>
 #include <cfg/debug.h>       //ASSERT()
 #include <cfg/macros.h>      //MIN(), ROUND_UP();
 
-#include <stdio.h>           //sprintf();
 #include <string.h>          //memset(), memcpy();
 
+#if !CONFIG_RANDPOOL_DRBG
+	#include "md2.h"
+	#include <stdio.h>           //sprintf();
+#endif
+
 #if CONFIG_RANDPOOL_TIMER
 	#include <drv/timer.h>       //timer_clock();
 #endif
@@ -77,6 +80,33 @@ static void randpool_push(EntropyPool *pool, void *_byte, size_t n_byte)
 }
 
 
+#if CONFIG_RANDPOOL_DRBG
+
+/*
+ * Stir the entropy pool: the whole pool, with the counter, reseeds the
+ * DRBG and is then replaced by the DRBG output.
+ * Every byte of the pool is hashed a fixed number of times, so the
+ * cost is linear in the pool size.
+ */
+static void randpool_stir(EntropyPool *pool)
+{
+	size_t entropy = pool->entropy; //Save current value of entropy.
+
+	randpool_add(pool, NULL, 0);
+	randpool_push(pool, &pool->counter, sizeof(pool->counter));
+
+	drbg_reseed(&pool->drbg, pool->pool_entropy, CONFIG_SIZE_ENTROPY_POOL);
+	drbg_generate(&pool->drbg, pool->pool_entropy, CONFIG_SIZE_ENTROPY_POOL);
+	pool->counter = pool->counter + 1;
+
+	/*Insert in pool the difference between a two call of this function (see above).*/
+	randpool_add(pool, NULL, 0);
+
+	pool->entropy = entropy; //Restore old value of entropy. We haven't add entropy.
+}
+
+#else /* !CONFIG_RANDPOOL_DRBG */
+
 /*
  * This function stir entropy pool with MD2 function hash.
  *
@@ -115,6 +145,8 @@ static void randpool_stir(EntropyPool *pool)
 	pool->entropy = entropy; //Restore old value of entropy. We haven't add entropy.
 }
 
+#endif /* !CONFIG_RANDPOOL_DRBG */
+
 /**
  * Add \param entropy bits from \param data buffer to the entropy \param pool
  */
@@ -166,7 +198,9 @@ void randpool_init(EntropyPool *pool, void *_data, size_t len)
 	data = (uint8_t *)_data;
 
 	memset(pool, 0, sizeof(EntropyPool));
+#if !CONFIG_RANDPOOL_DRBG
 	pool->pos_get = MD2_DIGEST_LEN;
+#endif
 
 #if CONFIG_RANDPOOL_TIMER
 	pool->last_counter = timer_clock();
@@ -184,6 +218,9 @@ void randpool_init(EntropyPool *pool, void *_data, size_t len)
 		pool->entropy = len;
 	}
 
+#if CONFIG_RANDPOOL_DRBG
+	drbg_init(&pool->drbg, pool->pool_entropy, CONFIG_SIZE_ENTROPY_POOL);
+#endif
 }
 
 /**
@@ -203,6 +240,20 @@ size_t randpool_size(EntropyPool *pool)
  * \param pool is the pool entropy context.
  * \param _data is the pointer to write the random data to.
  */
+#if CONFIG_RANDPOOL_DRBG
+
+void randpool_get(EntropyPool *pool, void *data, size_t n_byte)
+{
+	/* Reseed with everything added to the pool since the last call */
+	randpool_stir(pool);
+
+	drbg_generate(&pool->drbg, data, n_byte);
+
+	pool->entropy -= n_byte; //Update a entropy.
+}
+
+#else /* !CONFIG_RANDPOOL_DRBG */
+
 void randpool_get(EntropyPool *pool, void *_data, size_t n_byte)
 {
 	Md2Context context;
@@ -215,7 +266,7 @@ void randpool_get(EntropyPool *pool, void *_data, size_t n_byte)
 	data = (uint8_t *)_data;
 
 	/* Test if i + CONFIG_MD2_BLOCK_LEN  is inside of entropy pool.*/
-	ASSERT((MD2_DIGEST_LEN + i) < CONFIG_SIZE_ENTROPY_POOL);
+	ASSERT((MD2_DIGEST_LEN + i) <= CONFIG_SIZE_ENTROPY_POOL);
 
 	md2_init(&context);
 
@@ -248,6 +299,8 @@ void randpool_get(EntropyPool *pool, void *_data, size_t n_byte)
 
 }
 
+#endif /* !CONFIG_RANDPOOL_DRBG */
+
 /**
  * Return a pointer to entropy pool.
  */
@@ -43,6 +43,10 @@
 #include "cfg/cfg_randpool.h"
 #include <cfg/compiler.h>
 
+#if CONFIG_RANDPOOL_DRBG
+	#include "drbg.h"
+#endif
+
 
 /**
  * Sturct data of entropy pool.
@@ -60,6 +64,10 @@ typedef struct EntropyPool
 
 	uint8_t pool_entropy[CONFIG_SIZE_ENTROPY_POOL];  ///< Entropy pool.
 
+#if CONFIG_RANDPOOL_DRBG
+	Drbg drbg;                                       ///< Generator seeded from the pool.
+#endif
+
 } EntropyPool;
 
 
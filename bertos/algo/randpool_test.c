@@ -0,0 +1,169 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Entropy pool test.
+ *
+ * Two pools fed with the same data must give the same bytes, a single
+ * different input byte must change them, and the output must not
+ * repeat. The benchmark measures the generation of session keys,
+ * printing on stdout:
+ * \code
+ * BENCH scenario=session_key path=<drbg|md2> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "randpool.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+#include <cfg/test.h>
+
+#include <drv/timer.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define KEY_LEN       16
+#define BENCH_KEYS    1000
+
+#if CONFIG_RANDPOOL_TIMER
+	/* Timer tick counter, frozen: the test must be repeatable */
+	volatile ticks_t _clock;
+#endif
+
+static EntropyPool pool1, pool2;
+
+static void feed(EntropyPool *pool, uint8_t last)
+{
+	uint8_t data[32];
+
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = i * 13;
+	data[sizeof(data) - 1] = last;
+
+	randpool_init(pool, NULL, 0);
+	randpool_add(pool, data, sizeof(data) * 8);
+}
+
+static int repeatable(void)
+{
+	uint8_t key1[100], key2[100];
+
+	feed(&pool1, 0);
+	feed(&pool2, 0);
+	for (int i = 0; i < 10; i++)
+	{
+		randpool_get(&pool1, key1, sizeof(key1));
+		randpool_get(&pool2, key2, sizeof(key2));
+		if (memcmp(key1, key2, sizeof(key1)))
+		{
+			kprintf("same pools, different output\n");
+			return -1;
+		}
+	}
+
+	feed(&pool2, 1);
+	randpool_get(&pool2, key2, sizeof(key2));
+	randpool_get(&pool1, key1, sizeof(key1));
+	if (!memcmp(key1, key2, sizeof(key1)))
+	{
+		kprintf("different pools, same output\n");
+		return -1;
+	}
+
+	/* Consecutive keys must differ */
+	randpool_get(&pool1, key2, sizeof(key2));
+	if (!memcmp(key1, key2, sizeof(key1)))
+	{
+		kprintf("repeated output\n");
+		return -1;
+	}
+	return 0;
+}
+
+static void bench(void)
+{
+	uint8_t key[KEY_LEN];
+	unsigned long start, t;
+	uint8_t sum = 0;
+
+	feed(&pool1, 0);
+	start = bench_nsec();
+	for (int i = 0; i < BENCH_KEYS; i++)
+	{
+		randpool_add(&pool1, &i, sizeof(i) * 8);
+		randpool_get(&pool1, key, sizeof(key));
+		sum += key[0];
+	}
+	t = bench_nsec() - start;
+
+	printf("BENCH scenario=session_key path=%s pool_size=%d key_len=%d keys=%d time_us=%lu ns_per_key=%lu sum=%02x\n",
+		CONFIG_RANDPOOL_DRBG ? "drbg" : "md2", CONFIG_SIZE_ENTROPY_POOL, KEY_LEN, BENCH_KEYS,
+		t / 1000, t / BENCH_KEYS, sum);
+}
+
+int randpool_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int randpool_testRun(void)
+{
+	if (repeatable())
+		return -1;
+
+	bench();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int randpool_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(randpool);
+
+#include "randpool.c"
+#if CONFIG_RANDPOOL_DRBG
+	#include "drbg.c"
+	#include "sha256.c"
+#else
+	#include "md2.c"
+#endif
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
@@ -0,0 +1,237 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SHA-256 Secure Hash Algorithm and HMAC-SHA-256.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "sha256.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN(), ROTR() */
+
+#include <string.h>     /* memcpy(), memset() */
+
+static const uint32_t sha256_k[64] =
+{
+	0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+	0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+	0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+	0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+	0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+	0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+	0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+	0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL,
+};
+
+#define CH(x, y, z)   (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)  (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define SIGMA0(x)     (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define SIGMA1(x)     (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define GAMMA0(x)     (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define GAMMA1(x)     (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+/*
+ * Hash one block. The message schedule is kept in a 16 words ring,
+ * to save stack on small CPUs.
+ */
+static void sha256_transform(uint32_t *state, const uint8_t *block)
+{
+	uint32_t w[16];
+	uint32_t a, b, c, d, e, f, g, h, t1, t2;
+
+	for (int i = 0; i < 16; i++, block += 4)
+		w[i] = ((uint32_t)block[0] << 24) | ((uint32_t)block[1] << 16)
+			| ((uint32_t)block[2] << 8) | block[3];
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+	for (int i = 0; i < 64; i++)
+	{
+		if (i >= 16)
+			w[i & 15] += GAMMA1(w[(i - 2) & 15]) + w[(i - 7) & 15] + GAMMA0(w[(i - 15) & 15]);
+
+		t1 = h + SIGMA1(e) + CH(e, f, g) + sha256_k[i] + w[i & 15];
+		t2 = SIGMA0(a) + MAJ(a, b, c);
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+/**
+ * Start a new SHA-256 computation in \a ctx.
+ */
+void sha256_init(Sha256Context *ctx)
+{
+	ctx->state[0] = 0x6a09e667UL;
+	ctx->state[1] = 0xbb67ae85UL;
+	ctx->state[2] = 0x3c6ef372UL;
+	ctx->state[3] = 0xa54ff53aUL;
+	ctx->state[4] = 0x510e527fUL;
+	ctx->state[5] = 0x9b05688cUL;
+	ctx->state[6] = 0x1f83d9abUL;
+	ctx->state[7] = 0x5be0cd19UL;
+	ctx->count = 0;
+}
+
+/**
+ * Hash \a len bytes of \a data.
+ */
+void sha256_update(Sha256Context *ctx, const void *_data, size_t len)
+{
+	const uint8_t *data = (const uint8_t *)_data;
+	size_t used = ctx->count % SHA256_BLOCK_LEN;
+
+	ctx->count += len;
+
+	/* Complete a partial block first */
+	if (used)
+	{
+		size_t n = MIN(len, (size_t)(SHA256_BLOCK_LEN - used));
+
+		memcpy(ctx->buffer + used, data, n);
+		data += n;
+		len -= n;
+		if (used + n < SHA256_BLOCK_LEN)
+			return;
+		sha256_transform(ctx->state, ctx->buffer);
+	}
+
+	/* Whole blocks are hashed in place */
+	for (; len >= SHA256_BLOCK_LEN; data += SHA256_BLOCK_LEN, len -= SHA256_BLOCK_LEN)
+		sha256_transform(ctx->state, data);
+
+	memcpy(ctx->buffer, data, len);
+}
+
+/**
+ * End the computation in \a ctx.
+ * \return a pointer to the message digest, SHA256_DIGEST_LEN bytes
+ *         long, valid until \a ctx is used again.
+ */
+uint8_t *sha256_end(Sha256Context *ctx)
+{
+	size_t used = ctx->count % SHA256_BLOCK_LEN;
+	uint64_t bits = ctx->count * 8;
+
+	/* Pad with 0x80, zeros and the message length in bits, big endian */
+	ctx->buffer[used++] = 0x80;
+	if (used > SHA256_BLOCK_LEN - 8)
+	{
+		memset(ctx->buffer + used, 0, SHA256_BLOCK_LEN - used);
+		sha256_transform(ctx->state, ctx->buffer);
+		used = 0;
+	}
+	memset(ctx->buffer + used, 0, SHA256_BLOCK_LEN - 8 - used);
+	for (int i = 0; i < 8; i++)
+		ctx->buffer[SHA256_BLOCK_LEN - 1 - i] = (uint8_t)(bits >> (8 * i));
+	sha256_transform(ctx->state, ctx->buffer);
+
+	for (int i = 0; i < 8; i++)
+	{
+		ctx->buffer[4 * i]     = (uint8_t)(ctx->state[i] >> 24);
+		ctx->buffer[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+		ctx->buffer[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+		ctx->buffer[4 * i + 3] = (uint8_t)ctx->state[i];
+	}
+	return ctx->buffer;
+}
+
+/**
+ * Start an HMAC computation with \a key, \a key_len bytes long.
+ * After sha256_hmacEnd() \a hmac is ready for a new message with
+ * the same key.
+ */
+void sha256_hmacInit(Sha256Hmac *hmac, const void *key, size_t key_len)
+{
+	uint8_t pad[SHA256_BLOCK_LEN];
+
+	memset(pad, 0, sizeof(pad));
+	if (key_len > SHA256_BLOCK_LEN)
+	{
+		sha256_init(&hmac->ctx);
+		sha256_update(&hmac->ctx, key, key_len);
+		memcpy(pad, sha256_end(&hmac->ctx), SHA256_DIGEST_LEN);
+	}
+	else
+		memcpy(pad, key, key_len);
+
+	for (size_t i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36;
+	sha256_init(&hmac->inner);
+	sha256_update(&hmac->inner, pad, sizeof(pad));
+
+	/* 0x5c ^ 0x36: from inner to outer pad */
+	for (size_t i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x6a;
+	sha256_init(&hmac->outer);
+	sha256_update(&hmac->outer, pad, sizeof(pad));
+
+	hmac->ctx = hmac->inner;
+}
+
+/**
+ * Authenticate \a len bytes of \a data.
+ */
+void sha256_hmacUpdate(Sha256Hmac *hmac, const void *data, size_t len)
+{
+	sha256_update(&hmac->ctx, data, len);
+}
+
+/**
+ * End the HMAC computation in \a hmac.
+ * \return a pointer to the MAC, SHA256_DIGEST_LEN bytes long, valid
+ *         until \a hmac is used again.
+ */
+uint8_t *sha256_hmacEnd(Sha256Hmac *hmac)
+{
+	Sha256Context *ctx = &hmac->ctx;
+	uint8_t digest[SHA256_DIGEST_LEN];
+
+	memcpy(digest, sha256_end(ctx), sizeof(digest));
+	*ctx = hmac->outer;
+	sha256_update(ctx, digest, sizeof(digest));
+	sha256_end(ctx);
+
+	/*
+	 * Ready for the next message: the key block fills the buffer
+	 * exactly, so the MAC can stay there.
+	 */
+	memcpy(ctx->state, hmac->inner.state, sizeof(ctx->state));
+	ctx->count = hmac->inner.count;
+	return ctx->buffer;
+}
@@ -0,0 +1,90 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SHA-256 Secure Hash Algorithm and HMAC-SHA-256.
+ *
+ * SHA-256 (FIPS 180-2) takes as input a message of arbitrary length and
+ * produces a 256 bit message digest. It works on 32 bit words, 64 bytes
+ * at a time, and is much faster than MD2 on every CPU.
+ *
+ * HMAC (RFC 2104) keeps the hash state after the key blocks, so the
+ * same key can authenticate many messages at the cost of 2 hash blocks
+ * less per message.
+ *
+ * \code
+ * Sha256Context ctx;
+ *
+ * sha256_init(&ctx);
+ * sha256_update(&ctx, data, len);
+ * memcpy(digest, sha256_end(&ctx), SHA256_DIGEST_LEN);
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef ALGO_SHA256_H
+#define ALGO_SHA256_H
+
+#include <cfg/compiler.h>
+
+#define SHA256_BLOCK_LEN   64   ///< Length of the blocks hashed at once.
+#define SHA256_DIGEST_LEN  32   ///< Length of the message digest.
+
+/**
+ * Context for SHA-256 computation.
+ */
+typedef struct Sha256Context
+{
+	uint32_t state[8];                ///< Current hash value.
+	uint64_t count;                   ///< Number of bytes hashed.
+	uint8_t buffer[SHA256_BLOCK_LEN]; ///< Input buffer, digest at the end.
+} Sha256Context;
+
+/**
+ * Context for HMAC-SHA-256 computation.
+ */
+typedef struct Sha256Hmac
+{
+	Sha256Context ctx;   ///< Hash of the current message.
+	Sha256Context inner; ///< Hash state after the inner key block.
+	Sha256Context outer; ///< Hash state after the outer key block.
+} Sha256Hmac;
+
+void sha256_init(Sha256Context *ctx);
+void sha256_update(Sha256Context *ctx, const void *data, size_t len);
+uint8_t *sha256_end(Sha256Context *ctx);
+
+void sha256_hmacInit(Sha256Hmac *hmac, const void *key, size_t key_len);
+void sha256_hmacUpdate(Sha256Hmac *hmac, const void *data, size_t len);
+uint8_t *sha256_hmacEnd(Sha256Hmac *hmac);
+
+#endif /* ALGO_SHA256_H */
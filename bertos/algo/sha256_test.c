@@ -0,0 +1,229 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief SHA-256, HMAC-SHA-256 and HMAC-DRBG test.
+ *
+ * Digests are checked against the FIPS 180-2 examples, MACs against
+ * RFC 4231 and the DRBG against a reference implementation of
+ * SP 800-90A HMAC_DRBG. The benchmark compares SHA-256 with MD2,
+ * printing on stdout:
+ * \code
+ * BENCH scenario=hash path=<md2|sha256> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "sha256.h"
+#include "drbg.h"
+#include "md2.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+#include <cfg/test.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_BYTES  (1024UL * 1024)
+
+static int checkDigest(const char *name, const uint8_t *digest, const char *expected)
+{
+	if (memcmp(digest, expected, SHA256_DIGEST_LEN))
+	{
+		kprintf("%s: wrong digest\n", name);
+		kdump(digest, SHA256_DIGEST_LEN);
+		return -1;
+	}
+	return 0;
+}
+
+static int sha256Vectors(void)
+{
+	static const struct
+	{
+		const char *msg;
+		const char *digest;
+	} vectors[] =
+	{
+		{ "",
+		  "\xe3\xb0\xc4\x42\x98\xfc\x1c\x14\x9a\xfb\xf4\xc8\x99\x6f\xb9\x24"
+		  "\x27\xae\x41\xe4\x64\x9b\x93\x4c\xa4\x95\x99\x1b\x78\x52\xb8\x55" },
+		{ "abc",
+		  "\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae\x22\x23"
+		  "\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2\x00\x15\xad" },
+		{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+		  "\x24\x8d\x6a\x61\xd2\x06\x38\xb8\xe5\xc0\x26\x93\x0c\x3e\x60\x39"
+		  "\xa3\x3c\xe4\x59\x64\xff\x21\x67\xf6\xec\xed\xd4\x19\xdb\x06\xc1" },
+	};
+	Sha256Context ctx;
+
+	for (size_t i = 0; i < countof(vectors); i++)
+	{
+		sha256_init(&ctx);
+		sha256_update(&ctx, vectors[i].msg, strlen(vectors[i].msg));
+		if (checkDigest(vectors[i].msg, sha256_end(&ctx), vectors[i].digest))
+			return -1;
+	}
+
+	/* One million 'a', in chunks not multiple of the block size */
+	uint8_t a[1000];
+
+	memset(a, 'a', sizeof(a));
+	sha256_init(&ctx);
+	for (int i = 0; i < 1000; i++)
+		sha256_update(&ctx, a, sizeof(a));
+	return checkDigest("a * 10^6", sha256_end(&ctx),
+		"\xcd\xc7\x6e\x5c\x99\x14\xfb\x92\x81\xa1\xc7\xe2\x84\xd7\x3e\x67"
+		"\xf1\x80\x9a\x48\xa4\x97\x20\x0e\x04\x6d\x39\xcc\xc7\x11\x2c\xd0");
+}
+
+static int hmacVectors(void)
+{
+	Sha256Hmac hmac;
+	uint8_t key[131];
+
+	/* RFC 4231, test case 2, twice with the same key */
+	sha256_hmacInit(&hmac, "Jefe", 4);
+	for (int i = 0; i < 2; i++)
+	{
+		sha256_hmacUpdate(&hmac, "what do ya want ", 16);
+		sha256_hmacUpdate(&hmac, "for nothing?", 12);
+		if (checkDigest("hmac 2", sha256_hmacEnd(&hmac),
+			"\x5b\xdc\xc1\x46\xbf\x60\x75\x4e\x6a\x04\x24\x26\x08\x95\x75\xc7"
+			"\x5a\x00\x3f\x08\x9d\x27\x39\x83\x9d\xec\x58\xb9\x64\xec\x38\x43"))
+			return -1;
+	}
+
+	/* RFC 4231, test case 6: key longer than a block */
+	memset(key, 0xaa, sizeof(key));
+	sha256_hmacInit(&hmac, key, sizeof(key));
+	sha256_hmacUpdate(&hmac, "Test Using Larger Than Block-Size Key - Hash Key First", 54);
+	return checkDigest("hmac 6", sha256_hmacEnd(&hmac),
+		"\x60\xe4\x31\x59\x1e\xe0\xb6\x7f\x0d\x8a\x26\xaa\xcb\xf5\xb7\x7f"
+		"\x8e\x0b\xc6\x21\x37\x28\xc5\x14\x05\x46\x04\x0f\x0e\xe3\x7f\x54");
+}
+
+static int drbgVectors(void)
+{
+	Drbg drbg;
+	uint8_t seed[48], out[64];
+
+	for (size_t i = 0; i < sizeof(seed); i++)
+		seed[i] = i;
+
+	drbg_init(&drbg, seed, sizeof(seed));
+	drbg_generate(&drbg, out, sizeof(out));
+	drbg_generate(&drbg, out, sizeof(out));
+	if (memcmp(out,
+		"\xca\xc8\x49\x0b\xa9\xb2\x3f\xfc\x16\xf1\x4f\x9b\x05\xd4\x2a\xdb"
+		"\xab\xc2\xf9\xb9\x6b\x2a\xbe\x25\x61\x24\x04\x50\xcd\xd3\x8b\x52"
+		"\xb9\x9c\x23\x20\x18\x19\x6a\x00\x05\x91\x15\x67\x9e\xeb\xe7\xa0"
+		"\x08\xd1\xb1\x77\x82\xe9\x1a\xf7\x35\x7c\xfe\xda\x72\x41\x5f\xe4", 64))
+	{
+		kprintf("drbg: wrong output\n");
+		return -1;
+	}
+
+	drbg_reseed(&drbg, "reseed", 6);
+	drbg_generate(&drbg, out, 40);
+	if (memcmp(out,
+		"\xb8\x6c\x2b\x6e\x85\x51\x64\x95\x8c\x60\x3b\x43\xbe\x4c\xcc\xfa"
+		"\x1d\x51\x7e\x49\x61\x15\x36\x08\x49\x1d\xa7\x68\x90\xae\xa4\x08"
+		"\xe8\xd7\x76\xb2\x56\x6e\x97\x90", 40))
+	{
+		kprintf("drbg: wrong output after reseed\n");
+		return -1;
+	}
+	return 0;
+}
+
+static void bench(void)
+{
+	static uint8_t buf[1024];
+	unsigned long start, t;
+	Md2Context md2;
+	Sha256Context sha;
+	uint8_t sum;
+
+	for (size_t i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7;
+
+	start = bench_nsec();
+	md2_init(&md2);
+	for (unsigned long n = 0; n < BENCH_BYTES; n += sizeof(buf))
+		md2_update(&md2, buf, sizeof(buf));
+	sum = md2_end(&md2)[0];
+	t = bench_nsec() - start;
+	printf("BENCH scenario=hash path=md2 bytes=%lu time_us=%lu kb_per_s=%lu sum=%02x\n",
+		BENCH_BYTES, t / 1000, BENCH_BYTES * 1000000 / t, sum);
+
+	start = bench_nsec();
+	sha256_init(&sha);
+	for (unsigned long n = 0; n < BENCH_BYTES; n += sizeof(buf))
+		sha256_update(&sha, buf, sizeof(buf));
+	sum = sha256_end(&sha)[0];
+	t = bench_nsec() - start;
+	printf("BENCH scenario=hash path=sha256 bytes=%lu time_us=%lu kb_per_s=%lu sum=%02x\n",
+		BENCH_BYTES, t / 1000, BENCH_BYTES * 1000000 / t, sum);
+}
+
+int sha256_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int sha256_testRun(void)
+{
+	if (sha256Vectors() || hmacVectors() || drbgVectors())
+		return -1;
+
+	bench();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int sha256_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(sha256);
+
+#include "sha256.c"
+#include "drbg.c"
+#include "md2.c"
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
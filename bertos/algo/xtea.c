@@ -0,0 +1,435 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief XTEA and XXTEA block ciphers, with CTR and CBC modes.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "xtea.h"
+
+#include "cfg/cfg_xtea.h"
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN() */
+
+#define LANES     CONFIG_XTEA_LANES
+#define BULK_LEN  (LANES * XTEA_BLOCK_LEN)
+
+#define LOAD_BE32(p) \
+	(((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (p)[3])
+
+#define STORE_BE32(p, v) do { \
+		uint32_t v_ = (v); \
+		(p)[0] = (uint8_t)(v_ >> 24); \
+		(p)[1] = (uint8_t)(v_ >> 16); \
+		(p)[2] = (uint8_t)(v_ >> 8); \
+		(p)[3] = (uint8_t)v_; \
+	} while (0)
+
+/// XTEA mixing function.
+#define XTEA_F(x)  ((((x) << 4) ^ ((x) >> 5)) + (x))
+
+/**
+ * Compute the key schedule of the 16 bytes key \a k in \a key.
+ */
+void xtea_setKey(XteaKey *key, const void *_k)
+{
+	const uint8_t *k = (const uint8_t *)_k;
+	uint32_t sum = 0;
+
+	for (int i = 0; i < 4; i++)
+		key->k[i] = LOAD_BE32(k + 4 * i);
+
+	for (int i = 0; i < XTEA_ROUNDS; i++)
+	{
+		key->ks[2 * i] = sum + key->k[sum & 3];
+		sum += XTEA_DELTA;
+		key->ks[2 * i + 1] = sum + key->k[(sum >> 11) & 3];
+	}
+}
+
+static void xtea_encrypt(const uint32_t *ks, uint32_t *v0, uint32_t *v1)
+{
+	uint32_t y = *v0, z = *v1;
+
+	for (int i = 0; i < 2 * XTEA_ROUNDS; i += 2)
+	{
+		y += XTEA_F(z) ^ ks[i];
+		z += XTEA_F(y) ^ ks[i + 1];
+	}
+	*v0 = y;
+	*v1 = z;
+}
+
+static void xtea_decrypt(const uint32_t *ks, uint32_t *v0, uint32_t *v1)
+{
+	uint32_t y = *v0, z = *v1;
+
+	for (int i = 2 * XTEA_ROUNDS - 2; i >= 0; i -= 2)
+	{
+		z -= XTEA_F(y) ^ ks[i + 1];
+		y -= XTEA_F(z) ^ ks[i];
+	}
+	*v0 = y;
+	*v1 = z;
+}
+
+#if LANES > 1
+/*
+ * Encrypt and decrypt LANES blocks at once: the inner loops have no
+ * dependencies between lanes, so they map on SIMD instructions.
+ */
+static void xtea_encryptLanes(const uint32_t *ks, uint32_t *y, uint32_t *z)
+{
+	for (int i = 0; i < 2 * XTEA_ROUNDS; i += 2)
+	{
+		uint32_t k0 = ks[i], k1 = ks[i + 1];
+
+		for (int l = 0; l < LANES; l++)
+			y[l] += XTEA_F(z[l]) ^ k0;
+		for (int l = 0; l < LANES; l++)
+			z[l] += XTEA_F(y[l]) ^ k1;
+	}
+}
+
+static void xtea_decryptLanes(const uint32_t *ks, uint32_t *y, uint32_t *z)
+{
+	for (int i = 2 * XTEA_ROUNDS - 2; i >= 0; i -= 2)
+	{
+		uint32_t k0 = ks[i], k1 = ks[i + 1];
+
+		for (int l = 0; l < LANES; l++)
+			z[l] -= XTEA_F(y[l]) ^ k1;
+		for (int l = 0; l < LANES; l++)
+			y[l] -= XTEA_F(z[l]) ^ k0;
+	}
+}
+#endif /* LANES > 1 */
+
+/**
+ * Encrypt the 8 bytes block \a src with \a key in \a dst.
+ * \a dst and \a src can be the same buffer.
+ */
+void xtea_encBlock(const XteaKey *key, void *_dst, const void *_src)
+{
+	const uint8_t *src = (const uint8_t *)_src;
+	uint8_t *dst = (uint8_t *)_dst;
+	uint32_t y = LOAD_BE32(src), z = LOAD_BE32(src + 4);
+
+	xtea_encrypt(key->ks, &y, &z);
+	STORE_BE32(dst, y);
+	STORE_BE32(dst + 4, z);
+}
+
+/**
+ * Decrypt the 8 bytes block \a src with \a key in \a dst.
+ * \a dst and \a src can be the same buffer.
+ */
+void xtea_decBlock(const XteaKey *key, void *_dst, const void *_src)
+{
+	const uint8_t *src = (const uint8_t *)_src;
+	uint8_t *dst = (uint8_t *)_dst;
+	uint32_t y = LOAD_BE32(src), z = LOAD_BE32(src + 4);
+
+	xtea_decrypt(key->ks, &y, &z);
+	STORE_BE32(dst, y);
+	STORE_BE32(dst + 4, z);
+}
+
+/*
+ * Add \a n to the 64 bit counter \a ctr.
+ */
+INLINE void xtea_ctrAdd(uint32_t *ctr, uint32_t n)
+{
+	ctr[1] += n;
+	if (ctr[1] < n)
+		ctr[0]++;
+}
+
+/*
+ * Compute the keystream of the next counter block.
+ */
+static void xtea_ctrNext(XteaCtr *ctx)
+{
+	uint32_t y = ctx->ctr[0], z = ctx->ctr[1];
+
+	xtea_encrypt(ctx->key->ks, &y, &z);
+	STORE_BE32(ctx->stream, y);
+	STORE_BE32(ctx->stream + 4, z);
+	xtea_ctrAdd(ctx->ctr, 1);
+	ctx->used = 0;
+}
+
+/**
+ * Start a CTR mode stream with \a key at byte \a pos.
+ * The 8 bytes \a iv are the counter block of byte 0.
+ */
+void xtea_ctrInit(XteaCtr *ctx, const XteaKey *key, const void *_iv, uint32_t pos)
+{
+	const uint8_t *iv = (const uint8_t *)_iv;
+
+	ctx->key = key;
+	ctx->iv[0] = LOAD_BE32(iv);
+	ctx->iv[1] = LOAD_BE32(iv + 4);
+	xtea_ctrSeek(ctx, pos);
+}
+
+/**
+ * Move the CTR mode stream \a ctx to byte \a pos.
+ */
+void xtea_ctrSeek(XteaCtr *ctx, uint32_t pos)
+{
+	ctx->ctr[0] = ctx->iv[0];
+	ctx->ctr[1] = ctx->iv[1];
+	xtea_ctrAdd(ctx->ctr, pos / XTEA_BLOCK_LEN);
+	ctx->used = XTEA_BLOCK_LEN;
+
+	if (pos % XTEA_BLOCK_LEN)
+	{
+		xtea_ctrNext(ctx);
+		ctx->used = pos % XTEA_BLOCK_LEN;
+	}
+}
+
+/**
+ * Encrypt or decrypt \a len bytes of \a src in \a dst, in CTR mode.
+ * \a dst and \a src can be the same buffer.
+ */
+void xtea_ctrCrypt(XteaCtr *ctx, void *_dst, const void *_src, size_t len)
+{
+	const uint8_t *src = (const uint8_t *)_src;
+	uint8_t *dst = (uint8_t *)_dst;
+
+	/* Rest of the current keystream block */
+	for (; len && ctx->used < XTEA_BLOCK_LEN; len--)
+		*dst++ = *src++ ^ ctx->stream[ctx->used++];
+
+	#if LANES > 1
+		for (; len >= BULK_LEN; len -= BULK_LEN)
+		{
+			uint32_t y[LANES], z[LANES];
+
+			for (int l = 0; l < LANES; l++)
+			{
+				y[l] = ctx->ctr[0];
+				z[l] = ctx->ctr[1];
+				xtea_ctrAdd(ctx->ctr, 1);
+			}
+
+			xtea_encryptLanes(ctx->key->ks, y, z);
+
+			for (int l = 0; l < LANES; l++)
+			{
+				STORE_BE32(dst, LOAD_BE32(src) ^ y[l]);
+				STORE_BE32(dst + 4, LOAD_BE32(src + 4) ^ z[l]);
+				src += XTEA_BLOCK_LEN;
+				dst += XTEA_BLOCK_LEN;
+			}
+		}
+	#endif
+
+	while (len)
+	{
+		size_t n = MIN(len, (size_t)XTEA_BLOCK_LEN);
+
+		xtea_ctrNext(ctx);
+		for (size_t i = 0; i < n; i++)
+			dst[i] = src[i] ^ ctx->stream[i];
+		ctx->used = n;
+		src += n;
+		dst += n;
+		len -= n;
+	}
+}
+
+/**
+ * Start a CBC mode stream with \a key and the 8 bytes \a iv.
+ */
+void xtea_cbcInit(XteaCbc *ctx, const XteaKey *key, const void *_iv)
+{
+	const uint8_t *iv = (const uint8_t *)_iv;
+
+	ctx->key = key;
+	ctx->iv[0] = LOAD_BE32(iv);
+	ctx->iv[1] = LOAD_BE32(iv + 4);
+}
+
+/**
+ * Encrypt \a len bytes of \a src in \a dst, in CBC mode.
+ * \a len must be a multiple of the block size; \a dst and \a src can
+ * be the same buffer.
+ */
+void xtea_cbcEncrypt(XteaCbc *ctx, void *_dst, const void *_src, size_t len)
+{
+	const uint8_t *src = (const uint8_t *)_src;
+	uint8_t *dst = (uint8_t *)_dst;
+	uint32_t y = ctx->iv[0], z = ctx->iv[1];
+
+	ASSERT(len % XTEA_BLOCK_LEN == 0);
+
+	for (; len >= XTEA_BLOCK_LEN; len -= XTEA_BLOCK_LEN)
+	{
+		y ^= LOAD_BE32(src);
+		z ^= LOAD_BE32(src + 4);
+		xtea_encrypt(ctx->key->ks, &y, &z);
+		STORE_BE32(dst, y);
+		STORE_BE32(dst + 4, z);
+		src += XTEA_BLOCK_LEN;
+		dst += XTEA_BLOCK_LEN;
+	}
+
+	ctx->iv[0] = y;
+	ctx->iv[1] = z;
+}
+
+/**
+ * Decrypt \a len bytes of \a src in \a dst, in CBC mode.
+ * \a len must be a multiple of the block size; \a dst and \a src can
+ * be the same buffer.
+ */
+void xtea_cbcDecrypt(XteaCbc *ctx, void *_dst, const void *_src, size_t len)
+{
+	const uint8_t *src = (const uint8_t *)_src;
+	uint8_t *dst = (uint8_t *)_dst;
+
+	ASSERT(len % XTEA_BLOCK_LEN == 0);
+
+	/* Unlike encryption, blocks can be decrypted in parallel */
+	#if LANES > 1
+		for (; len >= BULK_LEN; len -= BULK_LEN)
+		{
+			uint32_t y[LANES], z[LANES], c0[LANES], c1[LANES];
+
+			for (int l = 0; l < LANES; l++)
+			{
+				y[l] = c0[l] = LOAD_BE32(src);
+				z[l] = c1[l] = LOAD_BE32(src + 4);
+				src += XTEA_BLOCK_LEN;
+			}
+
+			xtea_decryptLanes(ctx->key->ks, y, z);
+
+			for (int l = 0; l < LANES; l++)
+			{
+				STORE_BE32(dst, y[l] ^ ctx->iv[0]);
+				STORE_BE32(dst + 4, z[l] ^ ctx->iv[1]);
+				ctx->iv[0] = c0[l];
+				ctx->iv[1] = c1[l];
+				dst += XTEA_BLOCK_LEN;
+			}
+		}
+	#endif
+
+	for (; len >= XTEA_BLOCK_LEN; len -= XTEA_BLOCK_LEN)
+	{
+		uint32_t c0 = LOAD_BE32(src), c1 = LOAD_BE32(src + 4);
+		uint32_t y = c0, z = c1;
+
+		xtea_decrypt(ctx->key->ks, &y, &z);
+		STORE_BE32(dst, y ^ ctx->iv[0]);
+		STORE_BE32(dst + 4, z ^ ctx->iv[1]);
+		ctx->iv[0] = c0;
+		ctx->iv[1] = c1;
+		src += XTEA_BLOCK_LEN;
+		dst += XTEA_BLOCK_LEN;
+	}
+}
+
+/// XXTEA mixing function.
+#define XXTEA_MX  ((((z >> 5) ^ (y << 2)) + ((y >> 3) ^ (z << 4))) ^ ((sum ^ y) + (k[(p & 3) ^ e] ^ z)))
+
+/// Word \a i of buffer \a buf.
+#define WORD(i)   (buf + 4 * (i))
+
+/**
+ * Encrypt \a buf, \a len bytes long, with XXTEA.
+ * \a len must be a multiple of 4, and at least 8.
+ */
+void xxtea_enc(const XteaKey *key, void *_buf, size_t len)
+{
+	uint8_t *buf = (uint8_t *)_buf;
+	const uint32_t *k = key->k;
+	size_t n = len / 4, p;
+	unsigned rounds = 6 + 52 / n;
+	uint32_t y, z, sum = 0, e;
+
+	ASSERT(len % 4 == 0 && n >= 2);
+
+	z = LOAD_BE32(WORD(n - 1));
+	do
+	{
+		sum += XTEA_DELTA;
+		e = (sum >> 2) & 3;
+		for (p = 0; p < n - 1; p++)
+		{
+			y = LOAD_BE32(WORD(p + 1));
+			z = LOAD_BE32(WORD(p)) + XXTEA_MX;
+			STORE_BE32(WORD(p), z);
+		}
+		y = LOAD_BE32(WORD(0));
+		z = LOAD_BE32(WORD(n - 1)) + XXTEA_MX;
+		STORE_BE32(WORD(n - 1), z);
+	}
+	while (--rounds);
+}
+
+/**
+ * Decrypt \a buf, \a len bytes long, with XXTEA.
+ * \a len must be a multiple of 4, and at least 8.
+ */
+void xxtea_dec(const XteaKey *key, void *_buf, size_t len)
+{
+	uint8_t *buf = (uint8_t *)_buf;
+	const uint32_t *k = key->k;
+	size_t n = len / 4, p;
+	unsigned rounds = 6 + 52 / n;
+	uint32_t y, z, sum = rounds * XTEA_DELTA, e;
+
+	ASSERT(len % 4 == 0 && n >= 2);
+
+	y = LOAD_BE32(WORD(0));
+	do
+	{
+		e = (sum >> 2) & 3;
+		for (p = n - 1; p > 0; p--)
+		{
+			z = LOAD_BE32(WORD(p - 1));
+			y = LOAD_BE32(WORD(p)) - XXTEA_MX;
+			STORE_BE32(WORD(p), y);
+		}
+		z = LOAD_BE32(WORD(n - 1));
+		y = LOAD_BE32(WORD(0)) - XXTEA_MX;
+		STORE_BE32(WORD(0), y);
+		sum -= XTEA_DELTA;
+	}
+	while (--rounds);
+}
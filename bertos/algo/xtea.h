@@ -0,0 +1,119 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief XTEA and XXTEA block ciphers, with CTR and CBC modes.
+ *
+ * XTEA is the extended version of TEA by Wheeler and Needham, with a
+ * fixed key schedule: the round keys are computed once in an XteaKey
+ * and reused for every block. Keys and blocks are read as big endian
+ * words, like in the published test vectors.
+ *
+ * Buffers of any length are encrypted in CTR mode, which turns XTEA in
+ * a stream cipher and allows random access; CBC mode works on multiples
+ * of the block size. Both keep their state between calls, so data can
+ * be processed in chunks of any size.
+ *
+ * XXTEA (Corrected Block TEA) encrypts a whole buffer as a single
+ * block, of at least 8 bytes and a multiple of 4, read as big endian
+ * words: a change in any byte changes all the ciphertext.
+ *
+ * \code
+ * XteaKey key;
+ * XteaCtr ctr;
+ *
+ * xtea_setKey(&key, key_bytes);
+ * xtea_ctrInit(&ctr, &key, nonce, 0);
+ * xtea_ctrCrypt(&ctr, buf, buf, len);
+ * \endcode
+ *
+ * \note A (key, IV) pair must never be used for two different
+ *       messages in CTR mode.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef ALGO_XTEA_H
+#define ALGO_XTEA_H
+
+#include <cfg/compiler.h>
+
+#define XTEA_KEY_LEN     16          ///< Key size.
+#define XTEA_BLOCK_LEN   8           ///< Block size.
+#define XTEA_ROUNDS      32          ///< Number of cycles (two Feistel rounds each).
+#define XTEA_DELTA       0x9E3779B9UL ///< Key schedule constant.
+
+/**
+ * Precomputed key schedule.
+ */
+typedef struct XteaKey
+{
+	uint32_t ks[2 * XTEA_ROUNDS];    ///< XTEA round keys.
+	uint32_t k[4];                   ///< Key words, for XXTEA.
+} XteaKey;
+
+/**
+ * CTR mode context.
+ */
+typedef struct XteaCtr
+{
+	const XteaKey *key;              ///< Key in use.
+	uint32_t iv[2];                  ///< Counter block of the first byte.
+	uint32_t ctr[2];                 ///< Next counter block.
+	uint8_t stream[XTEA_BLOCK_LEN];  ///< Keystream of the current block.
+	uint8_t used;                    ///< Keystream bytes already used.
+} XteaCtr;
+
+/**
+ * CBC mode context.
+ */
+typedef struct XteaCbc
+{
+	const XteaKey *key;              ///< Key in use.
+	uint32_t iv[2];                  ///< Last ciphertext block.
+} XteaCbc;
+
+void xtea_setKey(XteaKey *key, const void *k);
+void xtea_encBlock(const XteaKey *key, void *dst, const void *src);
+void xtea_decBlock(const XteaKey *key, void *dst, const void *src);
+
+void xtea_ctrInit(XteaCtr *ctx, const XteaKey *key, const void *iv, uint32_t pos);
+void xtea_ctrSeek(XteaCtr *ctx, uint32_t pos);
+void xtea_ctrCrypt(XteaCtr *ctx, void *dst, const void *src, size_t len);
+
+void xtea_cbcInit(XteaCbc *ctx, const XteaKey *key, const void *iv);
+void xtea_cbcEncrypt(XteaCbc *ctx, void *dst, const void *src, size_t len);
+void xtea_cbcDecrypt(XteaCbc *ctx, void *dst, const void *src, size_t len);
+
+void xxtea_enc(const XteaKey *key, void *buf, size_t len);
+void xxtea_dec(const XteaKey *key, void *buf, size_t len);
+
+#endif /* ALGO_XTEA_H */
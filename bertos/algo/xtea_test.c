@@ -0,0 +1,462 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief XTEA, XXTEA, cipher modes and KFile filter test.
+ *
+ * The ciphers are checked against test vectors (the published XTEA
+ * one, and the reference algorithms for the modes and XXTEA); the modes
+ * against single block encryption, with buffers split in random chunks
+ * so that the interleaved and the byte at a time paths are mixed;
+ * the KFile filter against CTR mode, on a RAM file and on a stream.
+ *
+ * The benchmark prints the throughput on stdout, in bytes per CPU cycle
+ * on x86 (from the time stamp counter) and in bytes per microsecond
+ * elsewhere:
+ * \code
+ * BENCH scenario=cipher path=<tea|xtea_block|ctr|cbc_enc|cbc_dec|xxtea|kfile> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "xtea.h"
+#include "tea.h"
+
+#include "cfg/cfg_xtea.h"
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+#include <cfg/test.h>
+
+#include <cpu/detect.h>
+
+#include <kern/kfile_xtea.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define BUF_SIZE     4096
+#define BENCH_ROUNDS 64
+
+static const uint8_t key_bytes[XTEA_KEY_LEN] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+
+/* Counter low word near the wrap, to test the carry */
+static const uint8_t iv[XTEA_BLOCK_LEN] = { 0xf0, 0xf1, 0xf2, 0xf3, 0xff, 0xff, 0xff, 0xfe };
+static const uint8_t rx_iv[XTEA_BLOCK_LEN] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+static XteaKey key;
+static uint8_t plain[BUF_SIZE], buf[BUF_SIZE], ref[BUF_SIZE];
+static uint32_t seed = 1;
+
+static uint32_t test_rand(void)
+{
+	seed = seed * 1103515245UL + 12345;
+	return seed >> 8;
+}
+
+static int check(const char *name, const void *data, const void *expected, size_t len)
+{
+	if (memcmp(data, expected, len))
+	{
+		kprintf("%s: wrong result\n", name);
+		kdump(data, len);
+		return -1;
+	}
+	return 0;
+}
+
+static int vectors(void)
+{
+	uint8_t msg[40], out[40];
+	XteaCtr ctr;
+	XteaCbc cbc;
+
+	for (size_t i = 0; i < sizeof(msg); i++)
+		msg[i] = i * 7 + 3;
+
+	xtea_encBlock(&key, out, "ABCDEFGH");
+	if (check("block", out, "\x49\x7d\xf3\xd0\x72\x61\x2c\xb5", 8))
+		return -1;
+	xtea_decBlock(&key, out, out);
+	if (check("block dec", out, "ABCDEFGH", 8))
+		return -1;
+
+	xtea_ctrInit(&ctr, &key, iv, 0);
+	xtea_ctrCrypt(&ctr, out, msg, sizeof(msg));
+	if (check("ctr", out,
+		"\xf5\xf6\x5f\xe3\x34\x41\x54\xa2\x8d\x4e\x23\x6f\x0b\x1a\x82\x6a"
+		"\xfc\x47\x70\x13\xb2\x6d\x75\x64\x89\xa9\x5a\x86\xf3\x9f\x3b\x63"
+		"\x91\xd2\xcf\x49\x6c\x40\x8b\xc8", 40))
+		return -1;
+
+	xtea_cbcInit(&cbc, &key, iv);
+	xtea_cbcEncrypt(&cbc, out, msg, 24);
+	if (check("cbc", out,
+		"\x23\xae\x58\x22\x6d\xb8\x1d\x43\x44\xb5\xa6\x79\xd3\xdf\x23\x7a"
+		"\x48\x69\xf6\xed\x8b\xbe\x67\xb6", 24))
+		return -1;
+
+	memcpy(out, msg, sizeof(msg));
+	xxtea_enc(&key, out, 40);
+	if (check("xxtea", out,
+		"\x8f\x2b\xa6\x7c\x23\xfd\xaf\xb9\x20\xd6\x55\x61\x42\xcf\x6a\xc4"
+		"\x42\xc3\xfc\xaa\x33\x24\x78\x30\x52\x12\x85\xe6\xdd\xb4\x3f\x1d"
+		"\xaa\x49\xbe\x98\xd0\x6c\xb6\x12", 40))
+		return -1;
+	xxtea_dec(&key, out, 40);
+	if (check("xxtea dec", out, msg, 40))
+		return -1;
+
+	memcpy(out, msg, 8);
+	xxtea_enc(&key, out, 8);
+	if (check("xxtea 8", out, "\x8c\xe5\xf5\xae\xbb\x9b\x81\x0c", 8))
+		return -1;
+	xxtea_dec(&key, out, 8);
+	return check("xxtea 8 dec", out, msg, 8);
+}
+
+/*
+ * Reference CTR and CBC, one block at a time.
+ */
+static void refCtr(uint8_t *dst, const uint8_t *src, size_t len, uint32_t pos)
+{
+	for (size_t i = 0; i < len; i++, pos++)
+	{
+		uint8_t ctr[XTEA_BLOCK_LEN], stream[XTEA_BLOCK_LEN];
+		uint32_t block = pos / XTEA_BLOCK_LEN;
+		int carry = 0;
+
+		memcpy(ctr, iv, sizeof(ctr));
+		for (int j = XTEA_BLOCK_LEN - 1; j >= 0; j--)
+		{
+			int sum = ctr[j] + (j >= 4 ? (block >> (8 * (7 - j))) & 0xff : 0) + carry;
+
+			ctr[j] = sum;
+			carry = sum >> 8;
+		}
+		xtea_encBlock(&key, stream, ctr);
+		dst[i] = src[i] ^ stream[pos % XTEA_BLOCK_LEN];
+	}
+}
+
+static void refCbc(uint8_t *dst, const uint8_t *src, size_t len)
+{
+	uint8_t prev[XTEA_BLOCK_LEN];
+
+	memcpy(prev, iv, sizeof(prev));
+	for (size_t i = 0; i < len; i += XTEA_BLOCK_LEN)
+	{
+		for (int j = 0; j < XTEA_BLOCK_LEN; j++)
+			prev[j] ^= src[i + j];
+		xtea_encBlock(&key, prev, prev);
+		memcpy(dst + i, prev, XTEA_BLOCK_LEN);
+	}
+}
+
+static int modes(void)
+{
+	size_t len = 1000;
+
+	/* CTR, in chunks of random size, in place */
+	refCtr(ref, plain, len, 0);
+	for (int round = 0; round < 20; round++)
+	{
+		XteaCtr ctr;
+		size_t done = 0;
+
+		memcpy(buf, plain, len);
+		xtea_ctrInit(&ctr, &key, iv, 0);
+		while (done < len)
+		{
+			size_t n = MIN(len - done, (size_t)(test_rand() % 150));
+
+			xtea_ctrCrypt(&ctr, buf + done, buf + done, n);
+			done += n;
+		}
+		if (check("ctr chunks", buf, ref, len))
+			return -1;
+	}
+
+	/* CTR random access */
+	for (int round = 0; round < 50; round++)
+	{
+		XteaCtr ctr;
+		uint32_t pos = test_rand() % 900;
+		size_t n = test_rand() % 100;
+
+		xtea_ctrInit(&ctr, &key, iv, pos);
+		xtea_ctrCrypt(&ctr, buf, plain + pos, n);
+		if (check("ctr seek", buf, ref + pos, n))
+			return -1;
+	}
+
+	/* CBC, in chunks of random number of blocks */
+	len = 1024;
+	refCbc(ref, plain, len);
+	for (int round = 0; round < 20; round++)
+	{
+		XteaCbc enc, dec;
+		size_t done = 0;
+
+		xtea_cbcInit(&enc, &key, iv);
+		xtea_cbcInit(&dec, &key, iv);
+		while (done < len)
+		{
+			size_t n = MIN(len - done, (size_t)(test_rand() % 20) * XTEA_BLOCK_LEN);
+
+			xtea_cbcEncrypt(&enc, buf + done, plain + done, n);
+			if (check("cbc chunks", buf + done, ref + done, n))
+				return -1;
+			xtea_cbcDecrypt(&dec, buf + done, buf + done, n);
+			if (check("cbc dec chunks", buf + done, plain + done, n))
+				return -1;
+			done += n;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Simulated RAM file and stream.
+ */
+static struct
+{
+	KFile fd;
+	uint8_t mem[BUF_SIZE];
+	size_t in_pos;
+} ram;
+
+static size_t ram_write(struct KFile *fd, const void *data, size_t size)
+{
+	size = MIN(size, (size_t)(BUF_SIZE - fd->seek_pos));
+	memcpy(ram.mem + fd->seek_pos, data, size);
+	fd->seek_pos += size;
+	fd->size = MAX(fd->size, fd->seek_pos);
+	return size;
+}
+
+static size_t ram_read(struct KFile *fd, void *data, size_t size)
+{
+	size = MIN(size, (size_t)(fd->size - fd->seek_pos));
+	memcpy(data, ram.mem + fd->seek_pos, size);
+	fd->seek_pos += size;
+	return size;
+}
+
+/* Streams write from the beginning and read what is in ref */
+static size_t stream_read(UNUSED_ARG(struct KFile *, fd), void *data, size_t size)
+{
+	memcpy(data, ref + ram.in_pos, size);
+	ram.in_pos += size;
+	return size;
+}
+
+static void ram_init(bool seekable)
+{
+	memset(&ram, 0, sizeof(ram));
+	ram.fd.write = ram_write;
+	ram.fd.read = seekable ? ram_read : stream_read;
+	ram.fd.seek = seekable ? kfile_genericSeek : NULL;
+	ram.fd.close = kfile_genericClose;
+}
+
+static int filter(void)
+{
+	KFileXtea kx;
+	size_t len = 2000;
+
+	/* Seekable file: ciphertext is the CTR stream at the file position */
+	ram_init(true);
+	kfilextea_init(&kx, &ram.fd, &key, iv, NULL);
+	for (size_t done = 0; done < len; )
+	{
+		size_t n = MIN(len - done, (size_t)(test_rand() % 200));
+
+		if (kfile_write(&kx.fd, plain + done, n) != n)
+			return -1;
+		done += n;
+	}
+	refCtr(ref, plain, len, 0);
+	if (check("kfile write", ram.mem, ref, len))
+		return -1;
+
+	for (int round = 0; round < 50; round++)
+	{
+		kfile_off_t pos = test_rand() % len;
+		size_t n = MIN(len - pos, (size_t)(test_rand() % 100));
+
+		if (kfile_seek(&kx.fd, pos, KSM_SEEK_SET) != pos
+		 || kfile_read(&kx.fd, buf, n) != n
+		 || check("kfile read", buf, plain + pos, n))
+			return -1;
+
+		/* Rewrite in place, a read must give back the new data */
+		if (round % 10 == 0)
+		{
+			kfile_seek(&kx.fd, pos, KSM_SEEK_SET);
+			kfile_write(&kx.fd, "rewritten", MIN(n, (size_t)9));
+			kfile_seek(&kx.fd, pos, KSM_SEEK_SET);
+			kfile_read(&kx.fd, buf, MIN(n, (size_t)9));
+			if (check("kfile rewrite", buf, "rewritten", MIN(n, (size_t)9)))
+				return -1;
+			kfile_seek(&kx.fd, pos, KSM_SEEK_SET);
+			kfile_write(&kx.fd, plain + pos, MIN(n, (size_t)9));
+		}
+	}
+
+	/* Stream: independent keystreams for the two directions */
+	ram_init(false);
+	kfilextea_init(&kx, &ram.fd, &key, iv, rx_iv);
+	{
+		XteaCtr peer;
+
+		xtea_ctrInit(&peer, &key, rx_iv, 0);
+		xtea_ctrCrypt(&peer, ref, plain, len);
+	}
+	kfile_write(&kx.fd, plain, 100);
+	kfile_read(&kx.fd, buf, 300);
+	kfile_write(&kx.fd, plain + 100, 100);
+	kfile_read(&kx.fd, buf + 300, 300);
+	if (check("stream read", buf, plain, 600))
+		return -1;
+	refCtr(ref, plain, 200, 0);
+	return check("stream write", ram.mem, ref, 200);
+}
+
+#if CPU_X86
+	#define BENCH_UNIT "cycles"
+	#define bench_clock() __builtin_ia32_rdtsc()
+#else
+	#define BENCH_UNIT "ns"
+	#define bench_clock() bench_nsec()
+#endif
+
+static void benchReport(const char *path, unsigned long long t)
+{
+	unsigned long bytes = BUF_SIZE * BENCH_ROUNDS;
+
+	printf("BENCH scenario=cipher path=%s lanes=%d bytes=%lu %s=%llu bytes_per_k%s=%llu sum=%02x\n",
+		path, CONFIG_XTEA_LANES, bytes, BENCH_UNIT, t, BENCH_UNIT,
+		bytes * 1000ULL / t, buf[0]);
+}
+
+static void bench(void)
+{
+	unsigned long long start;
+	XteaCtr ctr;
+	XteaCbc cbc;
+	KFileXtea kx;
+	uint32_t tea_key[4] = { 1, 2, 3, 4 };
+
+	start = bench_clock();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+		for (size_t j = 0; j < BUF_SIZE; j += TEA_BLOCK_LEN)
+			tea_enc(buf + j, tea_key);
+	benchReport("tea", bench_clock() - start);
+
+	start = bench_clock();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+		for (size_t j = 0; j < BUF_SIZE; j += XTEA_BLOCK_LEN)
+			xtea_encBlock(&key, buf + j, buf + j);
+	benchReport("xtea_block", bench_clock() - start);
+
+	xtea_ctrInit(&ctr, &key, iv, 0);
+	start = bench_clock();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+		xtea_ctrCrypt(&ctr, buf, buf, BUF_SIZE);
+	benchReport("ctr", bench_clock() - start);
+
+	xtea_cbcInit(&cbc, &key, iv);
+	start = bench_clock();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+		xtea_cbcEncrypt(&cbc, buf, buf, BUF_SIZE);
+	benchReport("cbc_enc", bench_clock() - start);
+
+	xtea_cbcInit(&cbc, &key, iv);
+	start = bench_clock();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+		xtea_cbcDecrypt(&cbc, buf, buf, BUF_SIZE);
+	benchReport("cbc_dec", bench_clock() - start);
+
+	start = bench_clock();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+		xxtea_enc(&key, buf, BUF_SIZE);
+	benchReport("xxtea", bench_clock() - start);
+
+	ram_init(true);
+	kfilextea_init(&kx, &ram.fd, &key, iv, NULL);
+	start = bench_clock();
+	for (int i = 0; i < BENCH_ROUNDS; i++)
+	{
+		kfile_seek(&kx.fd, 0, KSM_SEEK_SET);
+		kfile_write(&kx.fd, plain, BUF_SIZE);
+	}
+	benchReport("kfile", bench_clock() - start);
+}
+
+int xtea_testSetup(void)
+{
+	kdbg_init();
+	xtea_setKey(&key, key_bytes);
+	for (size_t i = 0; i < sizeof(plain); i++)
+		plain[i] = (uint8_t)test_rand();
+	return 0;
+}
+
+int xtea_testRun(void)
+{
+	if (vectors() || modes() || filter())
+		return -1;
+
+	bench();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int xtea_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(xtea);
+
+#include "xtea.c"
+#include "tea.c"
+#include <kern/kfile_xtea.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
@@ -45,4 +45,12 @@
 /// Module logging format.
 #define DATAFLASH_LOG_FORMAT     LOG_FMT_TERSE
 
+/**
+ * Keep continuous array reads open between sequential reads.
+ * CS stays asserted, and the chip in active mode, until the next
+ * command or kfile_flush(): enable only if the dataflash is the
+ * only device on the SPI bus.
+ */
+#define CONFIG_DATAFLASH_READ_STREAM  0
+
 #endif /* CFG_DATAFLASH_H */
@@ -43,5 +43,11 @@
 /// Eeprom memory type.
 #define CONFIG_FLASH25 FLASH25_AT25F2048
 
+/**
+ * Read with the FAST_READ opcode, allowing higher SPI clocks.
+ * Enable only if the memory supports it (AT25F2048 does not).
+ */
+#define CONFIG_FLASH25_FAST_READ 0
+
 #endif /* CFG_FALSH25_H */
 
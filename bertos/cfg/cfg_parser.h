@@ -43,6 +43,12 @@
 /// TODO
 #define CONFIG_INTERNAL_COMMANDS 0
 
+/**
+ * Size of the command table, must be a power of 2.
+ * At most CONFIG_PARSER_MAX_COMMANDS - 1 commands can be registered.
+ */
+#define CONFIG_PARSER_MAX_COMMANDS 64
+
 #endif /* CFG_PARSER_H */
 
 
@@ -47,6 +47,13 @@
 /// Turn on or off timer support in Randpool.
 #define CONFIG_RANDPOOL_TIMER       1
 
+/**
+ * Stir and extract the pool with a SHA-256 HMAC-DRBG (1) instead
+ * of MD2 (0). The DRBG is much faster and its cost grows linearly
+ * with the pool size, MD2 stirring grows quadratically.
+ */
+#define CONFIG_RANDPOOL_DRBG        1
+
 #endif /* CFG_RANDPOOL_H */
 
 
@@ -83,6 +83,11 @@
  * LOG_LEVEL and LOG_VERBOSE macros must be defined before to include log module,
  * otherwise the log module use a default settings.
  *
+ * Messages are formatted and written with kprintf() at once. Modules
+ * that log from time critical code can define LOG_DEFERRED to 1 before
+ * including cfg/log.h: their messages are queued in the deferred log
+ * dlog_default and formatted later by dlog_drain() (see mware/dlog.h).
+ *
  * \version $Id: log.h 1885 2008-10-08 14:15:11Z batt $
  * \author Daniele Basile <asterix@develer.com>
  *
@@ -132,10 +137,22 @@
 #define LOG_FMT_TERSE     0
 /* \} */
 
+// Use a default setting if nobody asked for deferred logging
+#ifndef LOG_DEFERRED
+#define LOG_DEFERRED    0
+#endif
+
+#if LOG_DEFERRED
+	#include <mware/dlog.h>
+	#define LOG_OUT(str, ...)    DLOG(&dlog_default, str, ## __VA_ARGS__)
+#else
+	#define LOG_OUT              kprintf
+#endif
+
 #if LOG_FORMAT == LOG_FMT_VERBOSE
-	#define LOG_PRINT(str_level, str,...)    kprintf("%s():%d:%s: " str, __func__, __LINE__, str_level, ## __VA_ARGS__)
+	#define LOG_PRINT(str_level, str,...)    LOG_OUT("%s():%d:%s: " str, __func__, __LINE__, str_level, ## __VA_ARGS__)
 #elif LOG_FORMAT == LOG_FMT_TERSE
-	#define LOG_PRINT(str_level, str,...)    kprintf("%s: " str, str_level, ## __VA_ARGS__)
+	#define LOG_PRINT(str_level, str,...)    LOG_OUT("%s: " str, str_level, ## __VA_ARGS__)
 #else
 	#error No LOG_FORMAT defined
 #endif
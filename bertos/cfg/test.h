@@ -110,4 +110,22 @@ int main(void) \
  */
 #define SILENT_ASSERT(str) kputs("SILENT_ASSERT:$"str"$\n")
 
+#if UNIT_TEST
+	#include <cfg/compiler.h>
+
+	#include <time.h> /* clock_gettime() */
+
+	/**
+	 * Monotonic time in nanoseconds, to time benchmarks in tests.
+	 * Benchmark results are printed on lines starting with "BENCH ".
+	 */
+	INLINE unsigned long bench_nsec(void)
+	{
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	}
+#endif /* UNIT_TEST */
+
 #endif /* CFG_TEST_H */
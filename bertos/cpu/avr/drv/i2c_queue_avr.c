@@ -0,0 +1,172 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2003, 2004, 2005 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ * \brief Interrupt driven I2C transaction queue backend for the AVR ATMega TWI.
+ *
+ * The TWI interrupt handler moves the transfers of drv/i2c_queue.h on
+ * the bus one byte at a time, the CPU is free in the meantime.
+ *
+ * \note A slave replying NACK to its address fails the transfer with EOF:
+ *       unlike i2c_start_w(), busy devices are not polled again.
+ *       The byte functions of drv/i2c.h must not be used while the
+ *       queue is active.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> // BV()
+#include <cfg/module.h>
+
+#include <cpu/irq.h>
+#include <drv/i2c.h>
+#include <drv/i2c_queue.h>
+
+#include <compat/twi.h>
+
+/* TWI control register values */
+#define TWCR_NEXT   (BV(TWINT) | BV(TWEN) | BV(TWIE))
+#define TWCR_START  (TWCR_NEXT | BV(TWSTA))
+#define TWCR_STOP   (BV(TWINT) | BV(TWEN) | BV(TWSTO))
+
+/** The bus driven by the TWI */
+static I2cBus *twi_bus;
+
+/**
+ * Start the current transfer of the TWI bus.
+ */
+static void twi_start(UNUSED_ARG(I2cBus *, bus))
+{
+	/* A STOP condition could be still pending from the previous transfer */
+	while (TWCR & BV(TWSTO)) {}
+	TWCR = TWCR_START;
+}
+
+/**
+ * End the current transfer with \a status.
+ */
+static void twi_end(int status)
+{
+	TWCR = TWCR_STOP;
+	i2cq_done(twi_bus, status);
+}
+
+/**
+ * Go on with the next segment of \a xfer.
+ */
+static void twi_nextSeg(I2cXfer *xfer)
+{
+	I2cSeg *seg;
+
+	do
+	{
+		xfer->cur_pos = 0;
+		if (++xfer->cur_seg == xfer->seg_cnt)
+		{
+			twi_end(0);
+			return;
+		}
+		seg = &xfer->seg[xfer->cur_seg];
+
+		if (!(seg->flags & I2C_SEG_NOSTART))
+		{
+			TWCR = TWCR_START;
+			return;
+		}
+	}
+	while (!seg->len);
+
+	/* Go on writing without a repeated START */
+	TWDR = seg->buf[xfer->cur_pos++];
+	TWCR = TWCR_NEXT;
+}
+
+/**
+ * TWI state machine.
+ */
+SIGNAL(TWI_vect)
+{
+	I2cXfer *xfer = twi_bus->curr;
+	I2cSeg *seg = &xfer->seg[xfer->cur_seg];
+
+	switch (TW_STATUS)
+	{
+	case TW_START:
+	case TW_REP_START:
+		TWDR = (seg->flags & I2C_SEG_READ) ? (xfer->id | I2C_READBIT) : (xfer->id & ~I2C_READBIT);
+		TWCR = TWCR_NEXT;
+		break;
+
+	case TW_MT_SLA_ACK:
+	case TW_MT_DATA_ACK:
+		if (xfer->cur_pos < seg->len)
+		{
+			TWDR = seg->buf[xfer->cur_pos++];
+			TWCR = TWCR_NEXT;
+		}
+		else
+			twi_nextSeg(xfer);
+		break;
+
+	case TW_MR_SLA_ACK:
+		/* The last byte read gets a NACK */
+		TWCR = TWCR_NEXT | (seg->len > 1 ? BV(TWEA) : 0);
+		break;
+
+	case TW_MR_DATA_ACK:
+		seg->buf[xfer->cur_pos++] = TWDR;
+		TWCR = TWCR_NEXT | (xfer->cur_pos + 1 < seg->len ? BV(TWEA) : 0);
+		break;
+
+	case TW_MR_DATA_NACK:
+		seg->buf[xfer->cur_pos++] = TWDR;
+		twi_nextSeg(xfer);
+		break;
+
+	default:
+		/* Slave NACK, arbitration lost or bus error */
+		twi_end(EOF);
+		break;
+	}
+}
+
+/**
+ * Init \a bus to be driven by the TWI interrupt.
+ * The TWI must be already initialized by i2c_init().
+ */
+void i2cq_initTwi(I2cBus *bus)
+{
+	MOD_CHECK(i2c);
+
+	twi_bus = bus;
+	i2cq_init(bus, twi_start);
+}
@@ -98,12 +98,23 @@ static const DataflashInfo mem_info[] =
 
 STATIC_ASSERT(countof(mem_info) == DFT_CNT);
 
+/**
+ * Commands on SRAM buffers, indexed by buffer number.
+ * \{
+ */
+static const DataFlashOpcode buff_write[] = { DFO_WRITE_BUFF1, DFO_WRITE_BUFF2 };
+static const DataFlashOpcode buff_load[] = { DFO_MOV_MEM_TO_BUFF1, DFO_MOV_MEM_TO_BUFF2 };
+static const DataFlashOpcode buff_program[] = { DFO_WRITE_BUFF1_TO_MEM_E, DFO_WRITE_BUFF2_TO_MEM_E };
+/* \} */
+
 /**
  * Macro that toggle CS of dataflash.
  * \note This is equivalent to fd->setCS(false) immediately followed by fd->setCS(true).
+ * An open continuous array read is terminated.
  */
 INLINE void CS_TOGGLE(DataFlash *fd)
 {
+	fd->reading = false;
 	fd->setCS(false);
 	fd->setCS(true);
 }
@@ -137,21 +148,14 @@ static void send_cmd(DataFlash *fd, dataflash_page_t page_addr, dataflash_offset
 	 *
 	 */
 
-	/*
-	 * Send opcode.
-	 */
-	kfile_putc(opcode, fd->channel);
+	uint8_t frame[4];
 
-	/*
-	 *  Send page address.
-	 */
-	kfile_putc((uint8_t)(page_addr >> (16 - mem_info[fd->dev].page_bits)), fd->channel);
-	kfile_putc((uint8_t)((page_addr << (mem_info[fd->dev].page_bits - 8)) + (byte_addr >> 8)), fd->channel);
+	frame[0] = opcode;
+	frame[1] = (uint8_t)(page_addr >> (16 - mem_info[fd->dev].page_bits));
+	frame[2] = (uint8_t)((page_addr << (mem_info[fd->dev].page_bits - 8)) + (byte_addr >> 8));
+	frame[3] = (uint8_t)byte_addr;
 
-	/*
-	 * Send byte page address.
-	 */
-	kfile_putc((uint8_t)byte_addr, fd->channel);
+	kfile_write(fd->channel, frame, sizeof(frame));
 }
 
 /**
@@ -192,17 +196,12 @@ static uint8_t dataflash_stat(DataFlash *fd)
 
 
 /**
- * Send one command to data flash memory, and
- * return status register value.
- *
+ * Wait the end of the internal operation started by dataflash_startCmd(), if any.
  */
-static uint8_t dataflash_cmd(DataFlash *fd, dataflash_page_t page_addr, dataflash_offset_t byte_addr, DataFlashOpcode opcode)
+static void dataflash_waitReady(DataFlash *fd)
 {
-	uint8_t stat;
-
-	send_cmd(fd, page_addr, byte_addr, opcode);
-
-	CS_TOGGLE(fd);
+	if (!fd->busy)
+		return;
 
 	/*
 	 * We chech data flash memory state, and wait until busy-flag
@@ -211,38 +210,61 @@ static uint8_t dataflash_cmd(DataFlash *fd, dataflash_page_t page_addr, dataflas
 	while (!(dataflash_stat(fd) & BUSY_BIT))
 		cpu_relax();
 
-	stat = dataflash_stat(fd);
+	fd->setCS(false);
+	fd->busy = false;
+}
 
+/**
+ * Start the internal operation \a opcode, without waiting for its end.
+ *
+ * While the memory is busy the CPU can do other work, like
+ * filling the other SRAM buffer.
+ */
+static void dataflash_startCmd(DataFlash *fd, dataflash_page_t page_addr, dataflash_offset_t byte_addr, DataFlashOpcode opcode)
+{
+	dataflash_waitReady(fd);
+
+	send_cmd(fd, page_addr, byte_addr, opcode);
 	kfile_flush(fd->channel); // Flush channel
+
 	/*
-	 * Data flash has completed a bus cycle, so disable CS.
+	 * Operation starts when CS is disabled.
 	 */
 	fd->setCS(false);
-
-	return stat;
+	fd->busy = true;
 }
 
 /**
- * Read \a len bytes from main data flash memory or buffer data
- * flash memory, and put it in \a *block.
+ * Send one command to data flash memory, wait for its
+ * end and return status register value.
+ *
  */
-static void dataflash_readBlock(DataFlash *fd, dataflash_page_t page_addr, dataflash_offset_t byte_addr, DataFlashOpcode opcode, uint8_t *block, dataflash_size_t len)
+static uint8_t dataflash_cmd(DataFlash *fd, dataflash_page_t page_addr, dataflash_offset_t byte_addr, DataFlashOpcode opcode)
 {
-	send_cmd(fd, page_addr, byte_addr, opcode);
+	uint8_t stat;
 
-	if (opcode == DFO_READ_FLASH_MEM_BYTE_B)
-	{
-		/*
-		 * Send 24 don't care bits.
-		 */
-		uint8_t dummy[] = { 0, 0, 0 };
-		kfile_write(fd->channel, dummy, sizeof(dummy));
-	}
+	dataflash_startCmd(fd, page_addr, byte_addr, opcode);
+	dataflash_waitReady(fd);
 
-	kfile_putc(0, fd->channel); //Send 8 don't care bit.
-	kfile_read(fd->channel, block, len); //Read len bytes ad put in block buffer.
-	kfile_flush(fd->channel); // Flush channel
+	stat = dataflash_stat(fd);
 	fd->setCS(false);
+
+	return stat;
+}
+
+/**
+ * Start a read of main memory, or of buffer memory, at \a page_addr and \a byte_addr.
+ * CS is left enabled: data can be read from the channel until CS is disabled.
+ */
+static void dataflash_startRead(DataFlash *fd, dataflash_page_t page_addr, dataflash_offset_t byte_addr, DataFlashOpcode opcode)
+{
+	/*
+	 * Send 8 don't care bits, 32 for B type memories.
+	 */
+	static const uint8_t dummy[] = { 0, 0, 0, 0 };
+
+	send_cmd(fd, page_addr, byte_addr, opcode);
+	kfile_write(fd->channel, dummy, opcode == DFO_READ_FLASH_MEM_BYTE_B ? 4 : 1);
 }
 
 
@@ -267,27 +289,47 @@ static void dataflash_writeBlock(DataFlash *fd, dataflash_offset_t offset, DataF
 
 
 /**
- * Load selct page from dataflash memory to buffer.
+ * Load selct page from dataflash memory to buffer \a buff.
  */
-static void dataflash_loadPage(DataFlash *fd, dataflash_page_t page_addr)
+static void dataflash_loadPage(DataFlash *fd, dataflash_page_t page_addr, uint8_t buff)
 {
-	dataflash_cmd(fd, page_addr, 0x00, DFO_MOV_MEM_TO_BUFF1);
+	dataflash_cmd(fd, page_addr, 0x00, buff_load[buff]);
 }
 
 /**
- * Flush select page (stored in buffer) in data flash main memory page.
+ * Start programming current page (stored in buffer) in data
+ * flash main memory page, if dirty.
  */
-static int dataflash_flush(KFile *_fd)
+static void dataflash_flushPage(DataFlash *fd)
 {
-	DataFlash *fd = DATAFLASH_CAST(_fd);
 	if (fd->page_dirty)
 	{
-		dataflash_cmd(fd, fd->current_page, 0x00, DFO_WRITE_BUFF1_TO_MEM_E);
+		dataflash_startCmd(fd, fd->current_page, 0x00, buff_program[fd->buff]);
 
 		fd->page_dirty = false;
 
 		LOG_INFO("Flushing page {%ld}\n", fd->current_page);
 	}
+}
+
+/**
+ * Flush select page (stored in buffer) in data flash main memory page,
+ * waiting for the end of the programming.
+ * An open continuous array read is closed, releasing the bus.
+ */
+static int dataflash_flush(KFile *_fd)
+{
+	DataFlash *fd = DATAFLASH_CAST(_fd);
+
+	if (fd->reading)
+	{
+		kfile_flush(fd->channel);
+		fd->setCS(false);
+		fd->reading = false;
+	}
+
+	dataflash_flushPage(fd);
+	dataflash_waitReady(fd);
 	return 0;
 }
 
@@ -315,7 +357,7 @@ static KFile *dataflash_reopen(KFile *_fd)
 	fd->fd.seek_pos = 0;
 
 	/* Load selected page from dataflash memory */
-	dataflash_loadPage(fd, fd->current_page);
+	dataflash_loadPage(fd, fd->current_page, fd->buff);
 
 	LOG_INFO("Reopen.\n");
 	return &fd->fd;
@@ -331,6 +373,10 @@ static KFile *dataflash_reopen(KFile *_fd)
  * flush current page in main memory and
  * then read from memory, else we read byte
  * directly from data flash main memory.
+ * Reads use the continuous array read command, that crosses
+ * page boundaries: if CONFIG_DATAFLASH_READ_STREAM is set the
+ * command is left open and a read starting where the previous
+ * one ended goes on without sending a new command.
  *
  * \return the number of bytes read.
  */
@@ -360,14 +406,28 @@ static size_t dataflash_read(struct KFile *_fd, void *buf, size_t size)
 	 * Flush current page in main memory if
 	 * we had been written a byte in memory
 	 */
-	dataflash_flush(&fd->fd);
+	dataflash_flushPage(fd);
 
 	/*
 	 * Read byte in main page data flash memory.
 	 */
-	dataflash_readBlock(fd, page_addr, byte_addr, mem_info[fd->dev].read_cmd, data, size);
+	if (!fd->reading || fd->read_pos != fd->fd.seek_pos)
+	{
+		dataflash_waitReady(fd);
+		dataflash_startRead(fd, page_addr, byte_addr, mem_info[fd->dev].read_cmd);
+	}
+	kfile_read(fd->channel, data, size); //Read len bytes ad put in block buffer.
 
 	fd->fd.seek_pos += size;
+
+	#if CONFIG_DATAFLASH_READ_STREAM
+		fd->reading = true;
+		fd->read_pos = fd->fd.seek_pos;
+	#else
+		kfile_flush(fd->channel); // Flush channel
+		fd->setCS(false);
+	#endif
+
 	LOG_INFO("Read %ld bytes\n", size);
 
 	return size;
@@ -379,8 +439,10 @@ static size_t dataflash_read(struct KFile *_fd, void *buf, size_t size)
  * \note For writing \a _buf in dataflash memory, we must
  * first write in buffer data flash memory. At the end of write,
  * we can put page in dataflash main memory.
- * If we write in two contiguous pages, we put in main memory current
- * page and then reload the page which we want to write.
+ * If we write in two contiguous pages, we load the page which we want to
+ * write in the other SRAM buffer and then put in main memory current page:
+ * the new page is filled while the old one is programmed.
+ * The load is skipped when the whole page is overwritten.
  *
  * \return the number of bytes write.
  */
@@ -414,19 +476,32 @@ static size_t dataflash_write(struct KFile *_fd, const void *_buf, size_t size)
 
 		if (new_page != fd->current_page)
 		{
-			/* Flush current page in main memory*/
-			dataflash_flush(&fd->fd);
-			/* Load select page memory from data flash memory*/
-			dataflash_loadPage(fd, new_page);
+			uint8_t next = !fd->buff;
+
+			/* Load select page memory from data flash memory in the free buffer */
+			if (wr_len < mem_info[fd->dev].page_size)
+			{
+				dataflash_loadPage(fd, new_page, next);
+				LOG_INFO(" >> Load page: {%ld}\n", new_page);
+			}
 
+			/* Start programming current page in main memory */
+			dataflash_flushPage(fd);
+
+			fd->buff = next;
 			fd->current_page = new_page;
-			LOG_INFO(" >> Load page: {%ld}\n", new_page);
 		}
+		else if (!fd->page_dirty)
+		{
+			/* Current buffer could still be programming */
+			dataflash_waitReady(fd);
+		}
+
 		/*
 		* Write byte in current page, and set true
 		* page_dirty flag.
 		*/
-		dataflash_writeBlock(fd, offset, DFO_WRITE_BUFF1, data, wr_len);
+		dataflash_writeBlock(fd, offset, buff_write[fd->buff], data, wr_len);
 		fd->page_dirty = true;
 
 		data += wr_len;
@@ -492,7 +567,7 @@ bool dataflash_init(DataFlash *fd, KFile *ch, DataflashType dev, dataflash_setCS
 	fd->fd.size = mem_info[fd->dev].page_size * mem_info[fd->dev].page_cnt;
 
 	/* Load selected page from dataflash memory */
-	dataflash_loadPage(fd, fd->current_page);
+	dataflash_loadPage(fd, fd->current_page, fd->buff);
 	MOD_INIT(dataflash);
 	return true;
 }
@@ -88,6 +88,10 @@ typedef struct DataFlash
 	DataflashType dev;              ///< Memory device type;
 	dataflash_page_t current_page;  ///< Current loaded dataflash page.
 	bool page_dirty;                ///< True if current_page is dirty (needs to be flushed).
+	uint8_t buff;                   ///< SRAM buffer (0 or 1) holding current_page.
+	bool busy;                      ///< True if an internal operation could be in progress.
+	bool reading;                   ///< True if a continuous array read is still open.
+	kfile_off_t read_pos;           ///< Next address of the open continuous array read.
 	dataflash_setReset_t *setReset; ///< Callback used to set reset pin of dataflash.
 	dataflash_setCS_t *setCS;       ///< Callback used to set CS pin of dataflash.
 } DataFlash;
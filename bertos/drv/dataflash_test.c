@@ -0,0 +1,470 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief DataFlash driver test and benchmark on a simulated AT45DB161D.
+ *
+ * The simulator decodes the commands framed by CS and models main
+ * memory, the two SRAM buffers and the timings of the bus, of the
+ * buffer loads and of the page programs. Commands that need the
+ * main memory array while the memory is busy, and writes to the
+ * buffer being programmed, are accounted as protocol errors.
+ *
+ * The benchmarks append log records, preparing each one with some CPU
+ * work; the "sync" path waits for the end of every internal operation,
+ * as the driver did before ping-pong buffering. Results are printed on
+ * stdout as:
+ * \code
+ * BENCH scenario=<name> path=<name> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "dataflash.h"
+
+#include "cfg/cfg_dataflash.h"
+#include <cfg/debug.h>
+#include <cfg/test.h>
+#include <cfg/module.h>
+
+#include <drv/timer.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+
+#define SPI_CALL_US      2      ///< Cost of a SPI driver call.
+#define SPI_BYTE_NS      1000   ///< Time to shift one byte at 8 MHz.
+#define XFER_US          200    ///< Main memory page to buffer transfer.
+#define PROGRAM_US       14000  ///< Buffer to main memory page program with erase.
+
+#define PAGE_SIZE        528
+#define PAGE_BITS        10
+#define PAGE_CNT         4096
+#define DENSITY_ID       0x0B
+
+#define TEST_PAGES       64
+
+/**
+ * Simulated AT45DB161D.
+ */
+static struct
+{
+	KFile fd;                          ///< SPI channel.
+	uint8_t mem[PAGE_CNT * PAGE_SIZE]; ///< Main memory.
+	uint8_t buff[2][PAGE_SIZE];        ///< SRAM buffers.
+
+	unsigned long now;                 ///< Simulated time [us].
+	unsigned long busy_until;          ///< End of the current operation [us].
+	int busy_buff;                     ///< Buffer used by the current operation.
+
+	bool cs;                           ///< Chip select state.
+	uint8_t cmd;                       ///< Opcode of the current frame.
+	size_t in;                         ///< Bytes exchanged in the current frame.
+	uint32_t addr;                     ///< Address of the current frame.
+
+	unsigned long calls;               ///< SPI driver calls.
+	unsigned long reads;               ///< Continuous array read commands.
+	unsigned long loads;               ///< Page to buffer transfers.
+	unsigned long programs;            ///< Page programs.
+	unsigned long overlap;             ///< Bytes written in a buffer during a program.
+	unsigned long errors;              ///< Protocol violations.
+} sim;
+
+static bool sim_busy(void)
+{
+	return sim.now < sim.busy_until;
+}
+
+static int sim_buffOf(uint8_t cmd)
+{
+	switch (cmd)
+	{
+	case DFO_WRITE_BUFF1:
+	case DFO_MOV_MEM_TO_BUFF1:
+	case DFO_WRITE_BUFF1_TO_MEM_E:
+		return 0;
+	case DFO_WRITE_BUFF2:
+	case DFO_MOV_MEM_TO_BUFF2:
+	case DFO_WRITE_BUFF2_TO_MEM_E:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+static void sim_start(unsigned long time, int buff)
+{
+	sim.busy_until = sim.now + time;
+	sim.busy_buff = buff;
+}
+
+static void sim_setCS(bool enable)
+{
+	if (enable)
+	{
+		ASSERT(!sim.cs);
+		sim.cs = true;
+		sim.in = 0;
+		return;
+	}
+
+	if (!sim.cs)
+		return;
+	sim.cs = false;
+	if (sim.in < 4)
+		return;
+
+	dataflash_page_t page = sim.addr >> PAGE_BITS;
+	int b = sim_buffOf(sim.cmd);
+
+	if (sim.cmd == DFO_MOV_MEM_TO_BUFF1 || sim.cmd == DFO_MOV_MEM_TO_BUFF2)
+	{
+		memcpy(sim.buff[b], sim.mem + page * PAGE_SIZE, PAGE_SIZE);
+		sim_start(XFER_US, b);
+		sim.loads++;
+	}
+	else if (sim.cmd == DFO_WRITE_BUFF1_TO_MEM_E || sim.cmd == DFO_WRITE_BUFF2_TO_MEM_E)
+	{
+		memcpy(sim.mem + page * PAGE_SIZE, sim.buff[b], PAGE_SIZE);
+		sim_start(PROGRAM_US, b);
+		sim.programs++;
+	}
+}
+
+static void sim_tick(size_t bytes)
+{
+	sim.calls++;
+	sim.now += SPI_CALL_US + bytes * SPI_BYTE_NS / 1000;
+}
+
+/**
+ * Decode a byte sent to the memory.
+ */
+static void sim_byteIn(uint8_t c)
+{
+	size_t n = sim.in++;
+	int b = sim_buffOf(sim.cmd);
+
+	ASSERT(sim.cs);
+	if (n == 0)
+	{
+		sim.cmd = c;
+		sim.addr = 0;
+		b = sim_buffOf(c);
+
+		/* Only status and the free buffer are accessible while busy */
+		if (sim_busy() && c != DFO_READ_STATUS
+		 && !((c == DFO_WRITE_BUFF1 || c == DFO_WRITE_BUFF2) && b != sim.busy_buff))
+			sim.errors++;
+		if (c == DFO_READ_FLASH_MEM_BYTE_D)
+			sim.reads++;
+		return;
+	}
+
+	if (n < 4)
+	{
+		sim.addr = (sim.addr << 8) | c;
+		return;
+	}
+
+	if (sim.cmd == DFO_WRITE_BUFF1 || sim.cmd == DFO_WRITE_BUFF2)
+	{
+		uint32_t off = (sim.addr & ((1 << PAGE_BITS) - 1)) + n - 4;
+
+		if (sim_busy())
+			sim.overlap++;
+		sim.buff[b][off % PAGE_SIZE] = c;
+	}
+}
+
+/**
+ * \return the byte sent by the memory.
+ */
+static uint8_t sim_byteOut(void)
+{
+	size_t n = sim.in++;
+
+	ASSERT(sim.cs);
+	switch (sim.cmd)
+	{
+	case DFO_READ_STATUS:
+		return (sim_busy() ? 0 : BUSY_BIT) | (DENSITY_ID << 2);
+	case DFO_READ_FLASH_MEM_BYTE_D:
+	{
+		/* One don't care byte after the address */
+		uint32_t pos = (sim.addr >> PAGE_BITS) * PAGE_SIZE + (sim.addr & ((1 << PAGE_BITS) - 1));
+
+		ASSERT(n >= 5);
+		return sim.mem[(pos + n - 5) % sizeof(sim.mem)];
+	}
+	default:
+		sim.errors++;
+		return 0xFF;
+	}
+}
+
+static size_t sim_write(UNUSED_ARG(struct KFile *, fd), const void *_buf, size_t size)
+{
+	const uint8_t *buf = (const uint8_t *)_buf;
+
+	sim_tick(size);
+	for (size_t i = 0; i < size; i++)
+		sim_byteIn(buf[i]);
+	return size;
+}
+
+static size_t sim_read(UNUSED_ARG(struct KFile *, fd), void *_buf, size_t size)
+{
+	uint8_t *buf = (uint8_t *)_buf;
+
+	sim_tick(size);
+	for (size_t i = 0; i < size; i++)
+		buf[i] = sim_byteOut();
+	return size;
+}
+
+static int sim_flush(UNUSED_ARG(struct KFile *, fd))
+{
+	return 0;
+}
+
+static void sim_init(void)
+{
+	memset(&sim, 0, sizeof(sim));
+	memset(sim.mem, 0xFF, sizeof(sim.mem));
+	sim.busy_buff = -1;
+	sim.fd.write = sim_write;
+	sim.fd.read = sim_read;
+	sim.fd.flush = sim_flush;
+}
+
+/**
+ * Wait for the end of the internal operation of the memory.
+ */
+static void sim_sync(void)
+{
+	sim.now = MAX(sim.now, sim.busy_until);
+}
+
+/*
+ * Stubs for the drivers not used on the simulator.
+ */
+MOD_DEFINE(hw_dataflash);
+
+void timer_delayHp(UNUSED_ARG(hptime_t, delay))
+{
+}
+
+void proc_yield(void)
+{
+}
+
+static DataFlash flash;
+static uint8_t ref[TEST_PAGES * PAGE_SIZE];
+static uint8_t buf[TEST_PAGES * PAGE_SIZE];
+
+static void fill(uint8_t *data, size_t len, unsigned seed)
+{
+	for (size_t i = 0; i < len; i++)
+		data[i] = (uint8_t)(i * 7 + seed + (i >> 8));
+}
+
+static void checkMem(void)
+{
+	ASSERT(kfile_flush(&flash.fd) == 0);
+	ASSERT(!sim_busy());
+	ASSERT(memcmp(sim.mem, ref, sizeof(ref)) == 0);
+	ASSERT(sim.errors == 0);
+}
+
+static void readWrite(void)
+{
+	memset(ref, 0xFF, sizeof(ref));
+
+	/* Partial pages are loaded before writing */
+	fill(ref + 300, 2000, 1);
+	ASSERT(kfile_seek(&flash.fd, 300, KSM_SEEK_SET) == 300);
+	ASSERT(kfile_write(&flash.fd, ref + 300, 2000) == 2000);
+	ASSERT(kfile_seek(&flash.fd, 0, KSM_SEEK_SET) == 0);
+	ASSERT(kfile_read(&flash.fd, buf, 3000) == 3000);
+	ASSERT(memcmp(buf, ref, 3000) == 0);
+	checkMem();
+
+	/* Small updates in the middle of a page */
+	for (int i = 0; i < 10; i++)
+	{
+		kfile_off_t pos = PAGE_SIZE * i + 200;
+
+		fill(ref + pos, 10, i + 50);
+		ASSERT(kfile_seek(&flash.fd, pos, KSM_SEEK_SET) == pos);
+		ASSERT(kfile_write(&flash.fd, ref + pos, 10) == 10);
+	}
+	checkMem();
+}
+
+static void fullPages(void)
+{
+	unsigned long loads = sim.loads;
+
+	/* Whole pages are not loaded, and are filled while the previous one is programmed */
+	sim.overlap = 0;
+	fill(ref + 10 * PAGE_SIZE, 20 * PAGE_SIZE, 9);
+	ASSERT(kfile_seek(&flash.fd, 10 * PAGE_SIZE, KSM_SEEK_SET) == 10 * PAGE_SIZE);
+	ASSERT(kfile_write(&flash.fd, ref + 10 * PAGE_SIZE, 20 * PAGE_SIZE) == 20 * PAGE_SIZE);
+	ASSERT(sim.loads == loads);
+	ASSERT(sim.overlap >= 19 * PAGE_SIZE);
+	checkMem();
+}
+
+static void streamRead(void)
+{
+	unsigned long reads = sim.reads;
+
+	/* Sequential reads go on with the same command, across page boundaries */
+	ASSERT(kfile_seek(&flash.fd, 100, KSM_SEEK_SET) == 100);
+	for (int i = 0; i < 20; i++)
+		ASSERT(kfile_read(&flash.fd, buf + 100 + i * 100, 100) == 100);
+	ASSERT(memcmp(buf + 100, ref + 100, 2000) == 0);
+	ASSERT(sim.reads == reads + (CONFIG_DATAFLASH_READ_STREAM ? 1 : 20));
+
+	/* A seek starts a new command */
+	ASSERT(kfile_seek(&flash.fd, 5000, KSM_SEEK_SET) == 5000);
+	ASSERT(kfile_read(&flash.fd, buf, 100) == 100);
+	ASSERT(memcmp(buf, ref + 5000, 100) == 0);
+
+	/* Writes stop the read */
+	fill(ref + 5100, 10, 3);
+	ASSERT(kfile_write(&flash.fd, ref + 5100, 10) == 10);
+	ASSERT(kfile_read(&flash.fd, buf, 100) == 100);
+	ASSERT(memcmp(buf, ref + 5110, 100) == 0);
+
+	/* Flush releases the bus */
+	ASSERT(kfile_flush(&flash.fd) == 0);
+	ASSERT(!sim.cs);
+	checkMem();
+}
+
+#define LOG_PAGES    32
+#define PREPARE_US   3000  ///< CPU time spent preparing a log record.
+
+static void benchLog(size_t record, unsigned long prepare_us, bool sync)
+{
+	size_t len = LOG_PAGES * PAGE_SIZE;
+	unsigned long start;
+
+	fill(ref, len, record + sync);
+	kfile_flush(&flash.fd);
+	kfile_seek(&flash.fd, 0, KSM_SEEK_SET);
+	sim.calls = sim.loads = sim.programs = 0;
+	start = sim.now;
+
+	for (size_t done = 0; done < len; done += record)
+	{
+		/* Prepare the record */
+		sim.now += prepare_us;
+
+		ASSERT(kfile_write(&flash.fd, ref + done, record) == record);
+		if (sync)
+			sim_sync();
+	}
+	kfile_flush(&flash.fd);
+
+	unsigned long time_us = sim.now - start;
+	printf("BENCH scenario=log path=%s record=%lu prepare_us=%lu bytes=%lu calls=%lu loads=%lu programs=%lu time_us=%lu bytes_per_s=%lu\n",
+		sync ? "sync" : "pingpong", (unsigned long)record, prepare_us,
+		(unsigned long)len, sim.calls, sim.loads, sim.programs, time_us,
+		(unsigned long)((uint64_t)len * 1000000 / time_us));
+
+	ASSERT(memcmp(sim.mem, ref, len) == 0);
+	ASSERT(sim.errors == 0);
+}
+
+static void benchRead(size_t chunk)
+{
+	size_t len = LOG_PAGES * PAGE_SIZE;
+	unsigned long start;
+
+	kfile_seek(&flash.fd, 0, KSM_SEEK_SET);
+	sim.calls = sim.reads = 0;
+	start = sim.now;
+
+	for (size_t done = 0; done < len; done += chunk)
+		ASSERT(kfile_read(&flash.fd, buf + done, chunk) == chunk);
+
+	unsigned long time_us = sim.now - start;
+	printf("BENCH scenario=read path=%s chunk=%lu bytes=%lu calls=%lu commands=%lu time_us=%lu bytes_per_s=%lu\n",
+		CONFIG_DATAFLASH_READ_STREAM ? "stream" : "command", (unsigned long)chunk,
+		(unsigned long)len, sim.calls, sim.reads, time_us,
+		(unsigned long)((uint64_t)len * 1000000 / time_us));
+
+	ASSERT(memcmp(buf, sim.mem, len) == 0);
+}
+
+int dataflash_testSetup(void)
+{
+	kdbg_init();
+	sim_init();
+	MOD_INIT(hw_dataflash);
+	return dataflash_init(&flash, &sim.fd, DFT_AT45DB161D, sim_setCS, NULL) ? 0 : 1;
+}
+
+int dataflash_testRun(void)
+{
+	readWrite();
+	fullPages();
+	streamRead();
+	benchLog(128, PREPARE_US, true);
+	benchLog(128, PREPARE_US, false);
+	benchLog(PAGE_SIZE, 0, true);
+	benchLog(PAGE_SIZE, 0, false);
+	benchRead(48);
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int dataflash_testTearDown(void)
+{
+	return kfile_close(&flash.fd);
+}
+
+TEST_MAIN(dataflash);
+
+#include <drv/dataflash.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif /* UNIT_TEST */
@@ -54,6 +54,8 @@
 
 #include <cpu/byteorder.h> // cpu_to_be16()
 
+#include <algo/crc.h>
+
 #include <string.h>  // memset()
 
 /**
@@ -97,36 +99,269 @@ STATIC_ASSERT(countof(mem_info) == EEPROM_CNT);
 
 
 /**
- * Copy \a size bytes from buffer \a buf to
- * eeprom.
+ * Max number of write attempts of a block, when writes are verified.
  */
-static size_t eeprom_writeRaw(struct KFile *_fd, const void *buf, size_t size)
+#define VERIFY_RETRIES  5
+
+/**
+ * Fill \a addr_buf with the address bytes needed to access
+ * \a addr, storing in \a addr_len their number.
+ * \return the device address to select.
+ */
+static e2dev_addr_t eeprom_addr(Eeprom *fd, e2addr_t addr, uint8_t *addr_buf, uint8_t *addr_len)
+{
+	if (mem_info[fd->type].has_dev_addr)
+	{
+		addr_buf[0] = (addr >> 8) & 0xFF;
+		addr_buf[1] = (addr & 0xFF);
+		*addr_len = 2;
+		return fd->addr;
+	}
+	else
+	{
+		addr_buf[0] = (addr & 0xFF);
+		*addr_len = 1;
+		return (e2dev_addr_t)((addr >> 8) & 0x07);
+	}
+}
+
+/**
+ * Start a sequential read at \a addr.
+ * \return true if ok, false on errors (the bus is released).
+ */
+static bool eeprom_startRead(Eeprom *fd, e2addr_t addr)
 {
-	Eeprom *fd = EEPROM_CAST(_fd);
-	e2dev_addr_t dev_addr;
 	uint8_t addr_buf[2];
 	uint8_t addr_len;
-	size_t wr_len = 0;
+	e2dev_addr_t dev_addr = eeprom_addr(fd, addr, addr_buf, &addr_len);
 
-	e2blk_size_t blk_size = mem_info[fd->type].blk_size;
+	if (!(i2c_start_w(EEPROM_ADDR(dev_addr))
+	   && i2c_send(addr_buf, addr_len)
+	   && i2c_start_r(EEPROM_ADDR(dev_addr))))
+	{
+		i2c_stop();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Read \a size bytes at \a addr in \a buf.
+ * \return the number of bytes read.
+ */
+static size_t eeprom_readRaw(Eeprom *fd, e2addr_t addr, uint8_t *buf, size_t size)
+{
+	size_t rd_len = 0;
+
+	if (!eeprom_startRead(fd, addr))
+		return 0;
+
+	while (size--)
+	{
+		/*
+		 * The last byte read does not have an ACK
+		 * to stop communication.
+		 */
+		int c = i2c_get(size);
+
+		if (c == EOF)
+			break;
+
+		*buf++ = c;
+		rd_len++;
+	}
+	i2c_stop();
+
+	return rd_len;
+}
+
+/**
+ * Write \a count bytes of \a buf at \a addr, inside a single block,
+ * and wait for the end of the internal write cycle.
+ *
+ * \return true if ok, false on errors.
+ */
+static bool eeprom_writeBlock(Eeprom *fd, e2addr_t addr, const void *buf, size_t count)
+{
+	uint8_t addr_buf[2];
+	uint8_t addr_len;
+	e2dev_addr_t dev_addr = eeprom_addr(fd, addr, addr_buf, &addr_len);
+	bool ok;
 
 	STATIC_ASSERT(countof(addr_buf) <= sizeof(e2addr_t));
 
-	/* clamp size to memory limit (otherwise may roll back) */
-	ASSERT(_fd->seek_pos + size <= (kfile_off_t)_fd->size);
-	size = MIN((kfile_off_t)size, _fd->size - _fd->seek_pos);
+	ok = i2c_start_w(EEPROM_ADDR(dev_addr))
+		&& i2c_send(addr_buf, addr_len)
+		&& i2c_send(buf, count);
+	i2c_stop();
 
-	if (mem_info[fd->type].has_dev_addr)
+	/*
+	 * ACK polling: the device does not acknowledge its address until
+	 * the write cycle is over, and i2c_start_w() retries on NACK.
+	 */
+	if (ok)
 	{
-		dev_addr = fd->addr;
-		addr_len = 2;
+		ok = i2c_start_w(EEPROM_ADDR(dev_addr));
+		i2c_stop();
 	}
-	else
+	return ok;
+}
+
+/**
+ * Check that the \a count bytes at \a addr match \a buf,
+ * comparing the CRC of the data read back with the CRC of \a buf.
+ *
+ * \return true on success.
+ */
+static bool eeprom_checkBlock(Eeprom *fd, e2addr_t addr, const void *buf, size_t count)
+{
+	uint16_t crc = 0;
+	size_t len = count;
+
+	if (!eeprom_startRead(fd, addr))
+		return false;
+
+	while (len--)
+	{
+		int c = i2c_get(len);
+
+		if (c == EOF)
+		{
+			i2c_stop();
+			return false;
+		}
+		crc = UPDCRC16(c, crc);
+	}
+	i2c_stop();
+
+	if (crc != crc16(0, buf, count))
+	{
+		TRACEMSG("Data mismatch!");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Write \a count bytes of \a buf at \a addr, inside a single block.
+ * If writes are verified the block is checked and written again
+ * if not matching, up to VERIFY_RETRIES times.
+ *
+ * \return true if ok, false on errors.
+ */
+static bool eeprom_program(Eeprom *fd, e2addr_t addr, const void *buf, size_t count)
+{
+	int retries = fd->verify ? VERIFY_RETRIES : 1;
+
+	while (retries--)
+	{
+		if (eeprom_writeBlock(fd, addr, buf, count)
+		 && (!fd->verify || eeprom_checkBlock(fd, addr, buf, count)))
+			return true;
+	}
+	return false;
+}
+
+#if CONFIG_EEPROM_CACHE_SIZE
+
+/**
+ * Size of the blocks cached, never crossing page boundaries.
+ */
+#define CACHE_BLK_SIZE(fd) MIN(mem_info[(fd)->type].blk_size, (e2blk_size_t)CONFIG_EEPROM_CACHE_SIZE)
+
+STATIC_ASSERT(!(CONFIG_EEPROM_CACHE_SIZE & (CONFIG_EEPROM_CACHE_SIZE - 1)));
+
+/**
+ * Write the dirty range of the cache to the memory.
+ * \return true if ok, false on errors (the data stays in cache).
+ */
+static bool eeprom_cacheFlush(Eeprom *fd)
+{
+	if (fd->dirty_hi == fd->dirty_lo)
+		return true;
+
+	if (!eeprom_program(fd, fd->cache_addr + fd->dirty_lo,
+		fd->cache + fd->dirty_lo, fd->dirty_hi - fd->dirty_lo))
+		return false;
+
+	fd->dirty_lo = fd->dirty_hi = 0;
+	return true;
+}
+
+/**
+ * Put \a count bytes of \a buf, to be written at \a addr, in cache.
+ * \a count bytes at \a addr must not cross a cache block.
+ *
+ * Only the dirty range of the cache holds valid data: if the new data
+ * is not contiguous to it the gap is read from the memory.
+ *
+ * \return true if ok, false on errors.
+ */
+static bool eeprom_cachePut(Eeprom *fd, e2addr_t addr, const uint8_t *buf, size_t count)
+{
+	e2addr_t base = addr & ~(CACHE_BLK_SIZE(fd) - 1);
+	e2blk_size_t off = addr - base;
+
+	if (fd->dirty_hi != fd->dirty_lo && base != fd->cache_addr
+	 && !eeprom_cacheFlush(fd))
+		return false;
+
+	if (fd->dirty_hi == fd->dirty_lo)
 	{
-		dev_addr = (e2dev_addr_t)((fd->fd.seek_pos >> 8) & 0x07);
-		addr_len = 1;
+		fd->cache_addr = base;
+		fd->dirty_lo = fd->dirty_hi = off;
 	}
 
+	if (off > fd->dirty_hi)
+	{
+		size_t len = off - fd->dirty_hi;
+		if (eeprom_readRaw(fd, base + fd->dirty_hi, fd->cache + fd->dirty_hi, len) != len)
+			return false;
+	}
+	if (off + count < fd->dirty_lo)
+	{
+		size_t len = fd->dirty_lo - off - count;
+		if (eeprom_readRaw(fd, base + off + count, fd->cache + off + count, len) != len)
+			return false;
+	}
+
+	memcpy(fd->cache + off, buf, count);
+	fd->dirty_lo = MIN(fd->dirty_lo, off);
+	fd->dirty_hi = MAX(fd->dirty_hi, (e2blk_size_t)(off + count));
+	return true;
+}
+
+#else /* !CONFIG_EEPROM_CACHE_SIZE */
+
+#define CACHE_BLK_SIZE(fd)    mem_info[(fd)->type].blk_size
+#define eeprom_cacheFlush(fd) ((void)(fd), true)
+
+#endif /* !CONFIG_EEPROM_CACHE_SIZE */
+
+/**
+ * Copy \a size bytes from buffer \a _buf to
+ * eeprom.
+ *
+ * Writes are split in blocks that don't cross page boundaries;
+ * if the write-behind cache is enabled small writes inside the
+ * same block are collected and written with a single page write
+ * when another block is written, on reads and on kfile_flush().
+ *
+ * \note If writes are verified a block not matching
+ *       is written again, 5 times max.
+ */
+static size_t eeprom_write(struct KFile *_fd, const void *_buf, size_t size)
+{
+	Eeprom *fd = EEPROM_CAST(_fd);
+	const uint8_t *buf = (const uint8_t *)_buf;
+	size_t wr_len = 0;
+
+	e2blk_size_t blk_size = CACHE_BLK_SIZE(fd);
+
+	/* clamp size to memory limit (otherwise may roll back) */
+	ASSERT(_fd->seek_pos + size <= (kfile_off_t)_fd->size);
+	size = MIN((kfile_off_t)size, _fd->size - _fd->seek_pos);
+
 	while (size)
 	{
 		/*
@@ -135,32 +370,18 @@ static size_t eeprom_writeRaw(struct KFile *_fd, const void *buf, size_t size)
 		 */
 		size_t count = MIN(size, (size_t)(blk_size - (fd->fd.seek_pos & (blk_size - 1))));
 
-		if (mem_info[fd->type].has_dev_addr)
-		{
-			addr_buf[0] = (fd->fd.seek_pos >> 8) & 0xFF;
-			addr_buf[1] = (fd->fd.seek_pos & 0xFF);
-		}
-		else
-		{
-			dev_addr = (e2dev_addr_t)((fd->fd.seek_pos >> 8) & 0x07);
-			addr_buf[0] = (fd->fd.seek_pos & 0xFF);
-		}
-
-
-		if (!(i2c_start_w(EEPROM_ADDR(dev_addr))
-			&& i2c_send(addr_buf, addr_len)
-			&& i2c_send(buf, count)))
-		{
-			i2c_stop();
-			return wr_len;
-		}
-
-		i2c_stop();
+		#if CONFIG_EEPROM_CACHE_SIZE
+			if (!eeprom_cachePut(fd, fd->fd.seek_pos, buf, count))
+				break;
+		#else
+			if (!eeprom_program(fd, fd->fd.seek_pos, buf, count))
+				break;
+		#endif
 
 		/* Update count and addr for next operation */
 		size -= count;
 		fd->fd.seek_pos += count;
-		buf = ((const char *)buf) + count;
+		buf += count;
 		wr_len += count;
 	}
 
@@ -168,33 +389,23 @@ static size_t eeprom_writeRaw(struct KFile *_fd, const void *buf, size_t size)
 }
 
 /**
- * Copy \a size bytes from buffer \a _buf to
- * eeprom.
- * \note Writes are verified and if buffer content
- *       is not matching we retry 5 times max.
+ * Write pending data of the write-behind cache.
+ * \return 0 if ok, EOF on errors.
  */
-static size_t eeprom_writeVerify(struct KFile *_fd, const void *_buf, size_t size)
+static int eeprom_flush(struct KFile *_fd)
 {
 	Eeprom *fd = EEPROM_CAST(_fd);
-	int retries = 5;
-	size_t wr_len;
 
-	while (retries--)
-	{
-		wr_len = eeprom_writeRaw(_fd, _buf, size);
-		/* rewind to verify what we have just written */
-		kfile_seek(_fd, -(kfile_off_t)wr_len, KSM_SEEK_CUR);
-		if (wr_len == size
-		 && eeprom_verify(fd, _buf, wr_len))
-		{
-			/* Forward to go after what we have written*/
-			kfile_seek(_fd, wr_len, KSM_SEEK_CUR);
-			return wr_len;
-		}
-	}
-	return wr_len;
+	return eeprom_cacheFlush(fd) ? 0 : EOF;
 }
 
+/**
+ * Close \a _fd, writing pending data.
+ */
+static int eeprom_close(struct KFile *_fd)
+{
+	return eeprom_flush(_fd);
+}
 
 /**
  * Copy \a size bytes
@@ -205,56 +416,17 @@ static size_t eeprom_writeVerify(struct KFile *_fd, const void *_buf, size_t siz
 static size_t eeprom_read(struct KFile *_fd, void *_buf, size_t size)
 {
 	Eeprom *fd = EEPROM_CAST(_fd);
-	uint8_t addr_buf[2];
-	uint8_t addr_len;
-	size_t rd_len = 0;
-	uint8_t *buf = (uint8_t *)_buf;
-
-	STATIC_ASSERT(countof(addr_buf) <= sizeof(e2addr_t));
+	size_t rd_len;
 
 	/* clamp size to memory limit (otherwise may roll back) */
 	ASSERT(_fd->seek_pos + size <= (kfile_off_t)_fd->size);
 	size = MIN((kfile_off_t)size, _fd->size - _fd->seek_pos);
 
-	e2dev_addr_t dev_addr;
-	if (mem_info[fd->type].has_dev_addr)
-	{
-		dev_addr = fd->addr;
-		addr_len = 2;
-		addr_buf[0] = (fd->fd.seek_pos >> 8) & 0xFF;
-		addr_buf[1] = (fd->fd.seek_pos & 0xFF);
-	}
-	else
-	{
-		dev_addr = (e2dev_addr_t)((fd->fd.seek_pos >> 8) & 0x07);
-		addr_len = 1;
-		addr_buf[0] = (fd->fd.seek_pos & 0xFF);
-	}
-
-
-	if (!(i2c_start_w(EEPROM_ADDR(dev_addr))
-	   && i2c_send(addr_buf, addr_len)
-	   && i2c_start_r(EEPROM_ADDR(dev_addr))))
-	{
-		i2c_stop();
+	if (!eeprom_cacheFlush(fd))
 		return 0;
-	}
-
-	while (size--)
-	{
-		/*
-		 * The last byte read does not have an ACK
-		 * to stop communication.
-		 */
-		int c = i2c_get(size);
 
-		if (c == EOF)
-			break;
-
-		*buf++ = c;
-		fd->fd.seek_pos++;
-		rd_len++;
-	}
+	rd_len = eeprom_readRaw(fd, fd->fd.seek_pos, (uint8_t *)_buf, size);
+	fd->fd.seek_pos += rd_len;
 
 	return rd_len;
 }
@@ -274,6 +446,9 @@ bool eeprom_verify(Eeprom *fd, const void *buf, size_t count)
 	/* Save seek position */
 	kfile_off_t prev_seek = fd->fd.seek_pos;
 
+	if (!eeprom_cacheFlush(fd))
+		return false;
+
 	while (count && result)
 	{
 		/* Split read in smaller pieces */
@@ -355,7 +530,7 @@ bool eeprom_erase(Eeprom *fd, e2addr_t addr, e2_size_t count)
 		count -= size;
 	}
 	fd->fd.seek_pos = prev_off;
-	return res;
+	return res && eeprom_cacheFlush(fd);
 }
 
 
@@ -365,6 +540,10 @@ bool eeprom_erase(Eeprom *fd, e2addr_t addr, e2_size_t count)
  * \a type is the eeprom device we want to initialize (\see EepromType)
  * \a addr is the i2c devide address (usually pins A0, A1, A2).
  * \a verify is true if you want that every write operation will be verified.
+ *
+ * \note With the write-behind cache enabled (CONFIG_EEPROM_CACHE_SIZE)
+ *       data could be kept in RAM until kfile_flush() or kfile_close(),
+ *       and it is verified only when it is written back.
  */
 void eeprom_init(Eeprom *fd, EepromType type, e2dev_addr_t addr, bool verify)
 {
@@ -376,15 +555,14 @@ void eeprom_init(Eeprom *fd, EepromType type, e2dev_addr_t addr, bool verify)
 
 	fd->type = type;
 	fd->addr = addr;
+	fd->verify = verify;
 	fd->fd.size = mem_info[fd->type].e2_size;
 
 	// Setup eeprom programming functions.
 	fd->fd.read = eeprom_read;
-	if (verify)
-		fd->fd.write = eeprom_writeVerify;
-	else
-		fd->fd.write = eeprom_writeRaw;
-	fd->fd.close = kfile_genericClose;
+	fd->fd.write = eeprom_write;
+	fd->fd.flush = eeprom_flush;
+	fd->fd.close = eeprom_close;
 
 	fd->fd.seek = kfile_genericSeek;
 }
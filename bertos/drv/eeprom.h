@@ -42,6 +42,7 @@
 #ifndef DRV_EEPROM_H
 #define DRV_EEPROM_H
 
+#include "cfg/cfg_eeprom.h"
 #include <cfg/compiler.h>
 #include <kern/kfile.h>
 
@@ -64,6 +65,14 @@ typedef enum EepromType
  */
 typedef uint8_t e2dev_addr_t;
 
+/// Type for EEPROM addresses
+typedef uint16_t e2addr_t;
+
+/**
+ * Type for EEPROM block size.
+ */
+typedef uint16_t e2blk_size_t;
+
 /**
  * Describe an EEPROM context, used by the driver to
  * access the single device.
@@ -73,6 +82,13 @@ typedef struct Eeprom
 	KFile fd;          ///< File descriptor.
 	EepromType type;   ///< EEPROM type
 	e2dev_addr_t addr; ///< Device address.
+	bool verify;       ///< True if written blocks are read back and checked.
+#if CONFIG_EEPROM_CACHE_SIZE
+	uint8_t cache[CONFIG_EEPROM_CACHE_SIZE]; ///< Write-behind cache.
+	e2addr_t cache_addr;   ///< Address of the cached block.
+	e2blk_size_t dirty_lo; ///< Start of the dirty range in cache.
+	e2blk_size_t dirty_hi; ///< End of the dirty range in cache, equal to dirty_lo if clean.
+#endif
 } Eeprom;
 
 /**
@@ -89,9 +105,6 @@ INLINE Eeprom * EEPROM_CAST(KFile *fd)
 	return (Eeprom *)fd;
 }
 
-/// Type for EEPROM addresses
-typedef uint16_t e2addr_t;
-
 /**
  * Macro for E2Layout offset calculation
  *
@@ -103,11 +116,6 @@ typedef uint16_t e2addr_t;
  */
 #define e2addr(type, field) ((e2addr_t)&(((type *)0)->field))
 
-/**
- * Type for EEPROM block size.
- */
-typedef uint16_t e2blk_size_t;
-
 /**
  * Type for accessing EEPROM whole size.
  */
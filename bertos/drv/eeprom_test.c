@@ -0,0 +1,380 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief EEPROM driver test and benchmark on a simulated 24XX256.
+ *
+ * The I2C bus functions are replaced by a simulated EEPROM, that models
+ * the page write buffer with its address roll over, the internal write
+ * cycle (during which the device does not acknowledge its address) and
+ * the bus timings at 100 kHz. Some page writes can be corrupted on
+ * purpose to exercise write verification.
+ *
+ * The benchmark saves a configuration layout made of many small fields,
+ * each one written with its own kfile_write(). Results are printed on
+ * stdout as:
+ * \code
+ * BENCH scenario=<name> path=<name> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "eeprom.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+#include <cfg/module.h>
+
+#include <drv/i2c.h>
+
+#include <stddef.h> /* offsetof() */
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+
+#define START_US     10    ///< Start or stop condition.
+#define BYTE_US      90    ///< Byte plus ACK at 100 kHz.
+#define WRITE_US     5000  ///< Internal write cycle.
+
+#define E2_SIZE      0x8000
+#define E2_PAGE      0x40
+#define E2_DEV_ID    0xA0
+
+/**
+ * Simulated 24XX256 on the I2C bus.
+ */
+static struct
+{
+	uint8_t mem[E2_SIZE];       ///< Memory array.
+	uint8_t latch[E2_PAGE];     ///< Page write buffer.
+	bool latched[E2_PAGE];      ///< True for bytes written in the page buffer.
+
+	unsigned long now;          ///< Simulated time [us].
+	unsigned long busy_until;   ///< End of the write cycle [us].
+
+	bool selected;              ///< True if the device has acknowledged its address.
+	bool reading;               ///< True in master receiver mode.
+	int addr_bytes;             ///< Address bytes received.
+	e2addr_t ptr;               ///< Address pointer.
+	size_t data;                ///< Data bytes received.
+
+	int corrupt;                ///< Number of next page writes to corrupt.
+	unsigned long writes;       ///< Page writes.
+	unsigned long polls;        ///< Address NACKs during write cycles.
+	unsigned long transfers;    ///< Bus transactions.
+} sim;
+
+static bool sim_busy(void)
+{
+	return sim.now < sim.busy_until;
+}
+
+static void sim_init(void)
+{
+	memset(&sim, 0, sizeof(sim));
+	for (size_t i = 0; i < sizeof(sim.mem); i++)
+		sim.mem[i] = (uint8_t)(i * 13 + 1);
+}
+
+MOD_DEFINE(i2c);
+
+void i2c_init(void)
+{
+	MOD_INIT(i2c);
+}
+
+static bool sim_select(uint8_t id)
+{
+	sim.now += START_US + BYTE_US;
+	sim.addr_bytes = 0;
+	sim.data = 0;
+	sim.reading = id & I2C_READBIT;
+	sim.selected = (id & ~I2C_READBIT) == E2_DEV_ID && !sim_busy();
+	if (sim.selected && !sim.reading)
+		sim.transfers++;
+	return sim.selected;
+}
+
+/*
+ * Retry on NACK, as the real drivers do.
+ */
+bool i2c_start_w(uint8_t id)
+{
+	while (!sim_select(id & ~I2C_READBIT))
+	{
+		if (!sim_busy())
+			return false;
+		sim.polls++;
+	}
+	memset(sim.latched, 0, sizeof(sim.latched));
+	return true;
+}
+
+bool i2c_start_r(uint8_t id)
+{
+	return sim_select(id | I2C_READBIT);
+}
+
+void i2c_stop(void)
+{
+	sim.now += START_US;
+	if (sim.selected && !sim.reading && sim.data)
+	{
+		e2addr_t page = sim.ptr & ~(E2_PAGE - 1);
+
+		for (int i = 0; i < E2_PAGE; i++)
+			if (sim.latched[i])
+				sim.mem[page + i] = sim.latch[i];
+		if (sim.corrupt)
+		{
+			sim.corrupt--;
+			sim.mem[sim.ptr] ^= 0x10;
+		}
+		sim.writes++;
+		sim.busy_until = sim.now + WRITE_US;
+	}
+	sim.selected = false;
+}
+
+bool i2c_put(uint8_t data)
+{
+	sim.now += BYTE_US;
+	if (!sim.selected || sim.reading)
+		return false;
+
+	if (sim.addr_bytes < 2)
+	{
+		sim.ptr = (sim.addr_bytes ? (sim.ptr & 0xFF00) | data : data << 8) & (E2_SIZE - 1);
+		sim.addr_bytes++;
+		return true;
+	}
+
+	/* Address rolls over inside the page */
+	int col = (sim.ptr + sim.data) & (E2_PAGE - 1);
+	sim.latch[col] = data;
+	sim.latched[col] = true;
+	sim.data++;
+	return true;
+}
+
+int i2c_get(UNUSED_ARG(bool, ack))
+{
+	sim.now += BYTE_US;
+	if (!sim.selected || !sim.reading)
+		return EOF;
+
+	uint8_t c = sim.mem[sim.ptr];
+	sim.ptr = (sim.ptr + 1) & (E2_SIZE - 1);
+	return c;
+}
+
+static Eeprom e2;
+static uint8_t ref[E2_SIZE];
+static uint8_t buf[1024];
+
+static void checkMem(void)
+{
+	ASSERT(kfile_flush(&e2.fd) == 0);
+	ASSERT(memcmp(sim.mem, ref, sizeof(ref)) == 0);
+}
+
+static void put(e2addr_t addr, const void *data, size_t len)
+{
+	memcpy(ref + addr, data, len);
+	ASSERT(kfile_seek(&e2.fd, addr, KSM_SEEK_SET) == addr);
+	ASSERT(kfile_write(&e2.fd, data, len) == len);
+}
+
+static void readWrite(void)
+{
+	unsigned long writes;
+
+	for (int i = 0; i < 300; i++)
+		buf[i] = i;
+	put(50, buf, 300);
+	checkMem();
+
+	/* Write cycle is waited polling the device */
+	ASSERT(!sim_busy());
+	ASSERT(sim.polls);
+
+	/* Small writes in a block are written together, gaps are preserved */
+	writes = sim.writes;
+	put(0x400 + 3, "ab", 2);
+	put(0x400 + 20, "cd", 2);
+	put(0x400 + 9, "ef", 2);
+	put(0x400 + 1, "gh", 2);
+	ASSERT(sim.writes == writes + (CONFIG_EEPROM_CACHE_SIZE ? 0 : 4));
+	checkMem();
+	ASSERT(sim.writes == writes + (CONFIG_EEPROM_CACHE_SIZE ? 1 : 4));
+
+	/* Reads see pending writes */
+	put(0x500, "xyz", 3);
+	ASSERT(kfile_seek(&e2.fd, 0x4FF, KSM_SEEK_SET) == 0x4FF);
+	ASSERT(kfile_read(&e2.fd, buf, 5) == 5);
+	ASSERT(memcmp(buf, ref + 0x4FF, 5) == 0);
+	checkMem();
+
+	/* Erase */
+	ASSERT(eeprom_erase(&e2, 0x600 + 5, 200));
+	memset(ref + 0x600 + 5, 0xFF, 200);
+	checkMem();
+}
+
+static void verify(void)
+{
+	Eeprom e2v;
+	unsigned long writes;
+
+	eeprom_init(&e2v, EEPROM_24XX256, 0, true);
+
+	/* Corrupted blocks are written again */
+	writes = sim.writes;
+	sim.corrupt = 2;
+	memset(buf, 0x5A, E2_PAGE);
+	memcpy(ref + 0x800, buf, E2_PAGE);
+	ASSERT(kfile_seek(&e2v.fd, 0x800, KSM_SEEK_SET) == 0x800);
+	ASSERT(kfile_write(&e2v.fd, buf, E2_PAGE) == E2_PAGE);
+	ASSERT(kfile_flush(&e2v.fd) == 0);
+	ASSERT(sim.writes == writes + 3);
+	ASSERT(memcmp(sim.mem, ref, sizeof(ref)) == 0);
+	ASSERT(kfile_seek(&e2v.fd, 0x800, KSM_SEEK_SET) == 0x800);
+	ASSERT(eeprom_verify(&e2v, ref + 0x800, E2_PAGE));
+
+	/* Errors are reported when retries are exhausted */
+	sim.corrupt = 100;
+	ASSERT(kfile_seek(&e2v.fd, 0x900, KSM_SEEK_SET) == 0x900);
+	#if CONFIG_EEPROM_CACHE_SIZE
+		ASSERT(kfile_write(&e2v.fd, buf, E2_PAGE) == E2_PAGE);
+		ASSERT(kfile_close(&e2v.fd) == EOF);
+	#else
+		ASSERT(kfile_write(&e2v.fd, buf, E2_PAGE) == 0);
+	#endif
+	sim.corrupt = 0;
+	memcpy(ref + 0x900, sim.mem + 0x900, E2_PAGE);
+}
+
+/**
+ * A configuration layout made of small fields.
+ */
+typedef struct Config
+{
+	uint8_t version;
+	uint16_t serial;
+	struct
+	{
+		int16_t offset;
+		uint16_t gain;
+		uint8_t flags;
+	} channel[16];
+	uint32_t crc;
+} Config;
+
+#define FIELD(field) offsetof(Config, field), sizeof(((Config *)0)->field)
+
+static void saveField(e2addr_t addr, size_t len, const uint8_t *cfg, bool sync)
+{
+	put(0x1000 + addr, cfg + addr, len);
+	if (sync)
+		ASSERT(kfile_flush(&e2.fd) == 0);
+}
+
+static void benchConfig(bool sync, bool check)
+{
+	uint8_t cfg[sizeof(Config)];
+	unsigned long start;
+
+	for (size_t i = 0; i < sizeof(cfg); i++)
+		cfg[i] = (uint8_t)(i * 31 + sync + check);
+	e2.verify = check;
+	sim.writes = sim.polls = sim.transfers = 0;
+	start = sim.now;
+
+	saveField(FIELD(version), cfg, sync);
+	saveField(FIELD(serial), cfg, sync);
+	for (int i = 0; i < 16; i++)
+	{
+		saveField(FIELD(channel[i].offset), cfg, sync);
+		saveField(FIELD(channel[i].gain), cfg, sync);
+		saveField(FIELD(channel[i].flags), cfg, sync);
+	}
+	saveField(FIELD(crc), cfg, sync);
+	ASSERT(kfile_flush(&e2.fd) == 0);
+
+	printf("BENCH scenario=config path=%s verify=%d bytes=%lu fields=%d page_writes=%lu transactions=%lu polls=%lu time_us=%lu\n",
+		sync ? "field" : "cached", check, (unsigned long)sizeof(Config), 3 + 16 * 3,
+		sim.writes, sim.transfers, sim.polls, sim.now - start);
+
+	checkMem();
+	e2.verify = false;
+}
+
+int eeprom_testSetup(void)
+{
+	kdbg_init();
+	sim_init();
+	memcpy(ref, sim.mem, sizeof(ref));
+	i2c_init();
+	eeprom_init(&e2, EEPROM_24XX256, 0, false);
+	return 0;
+}
+
+int eeprom_testRun(void)
+{
+	readWrite();
+	verify();
+	benchConfig(true, false);
+	benchConfig(false, false);
+	benchConfig(true, true);
+	benchConfig(false, true);
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int eeprom_testTearDown(void)
+{
+	return kfile_close(&e2.fd);
+}
+
+TEST_MAIN(eeprom);
+
+#include <drv/eeprom.c>
+#include <drv/i2c.c>
+#include <algo/crc.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif /* UNIT_TEST */
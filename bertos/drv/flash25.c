@@ -49,22 +49,35 @@
 #include <cfg/macros.h>
 #include <cfg/debug.h>
 
-#include <drv/timer.h>
 #include <drv/flash25.h>
 
 #include <kern/kfile.h>
 
 #include <cpu/power.h> /* cpu_relax() */
 
-#warning FIXME:This file was change, but is untest!
+#include <string.h> /* memset() */
+
+#if CONFIG_FLASH25_FAST_READ
+	#define FLASH25_READ_CMD  FLASH25_FAST_READ
+#else
+	#define FLASH25_READ_CMD  FLASH25_READ
+#endif
 
 /**
  * Wait until flash memory is ready.
+ *
+ * Program and erase cycles are started without waiting for their end:
+ * the status register is polled only here, at the beginning of the next
+ * operation, so that the CPU can do something else (like preparing the
+ * next page to write) while the memory is busy.
  */
 static void flash25_waitReady(Flash25 *fd)
 {
 	uint8_t stat;
 
+	if (!fd->busy)
+		return;
+
 	while (1)
 	{
 		CS_ENABLE();
@@ -79,6 +92,8 @@ static void flash25_waitReady(Flash25 *fd)
 
 		cpu_relax();
 	}
+
+	fd->busy = false;
 }
 
 /**
@@ -93,6 +108,28 @@ static void flash25_sendCmd(Flash25 *fd, Flash25Opcode cmd)
 	CS_DISABLE();
 }
 
+/**
+ * Enable CS and send command \a cmd followed by memory address \a addr.
+ *
+ * Opcode, address and the dummy byte needed by FAST_READ are sent
+ * with a single write on the channel.
+ * CS is left enabled: the caller transfers data and then disables it.
+ */
+static void flash25_sendAddr(Flash25 *fd, Flash25Opcode cmd, flash25Addr_t addr)
+{
+	uint8_t frame[5];
+
+	frame[0] = cmd;
+	frame[1] = (addr >> 16) & 0xFF;
+	frame[2] = (addr >> 8) & 0xFF;
+	frame[3] = addr & 0xFF;
+	frame[4] = 0;
+
+	CS_ENABLE();
+
+	kfile_write(fd->channel, frame, cmd == FLASH25_FAST_READ ? 5 : 4);
+}
+
 /**
  * flash25 init function.
  * This function init a comunication channel and
@@ -144,14 +181,28 @@ static KFile * flash25_reopen(struct KFile *_fd)
 	return &fd->fd;
 }
 
+/**
+ * Wait the end of the last program or erase cycle.
+ *
+ * \return always 0.
+ */
+static int flash25_flush(struct KFile *_fd)
+{
+	Flash25 *fd = FLASH25_CAST(_fd);
+
+	flash25_waitReady(fd);
+	return 0;
+}
+
 /**
  * Close a serial memory interface.
  *
- * For serial memory this funtion do nothing,
- * and return always 0.
+ * For serial memory this funtion only waits the
+ * end of the last write, and return always 0.
  */
-static int flash25_close(UNUSED_ARG(struct KFile *,fd))
+static int flash25_close(struct KFile *fd)
 {
+	flash25_flush(fd);
 	kprintf("flash25 file closed\n");
 	return 0;
 }
@@ -162,34 +213,23 @@ static int flash25_close(UNUSED_ARG(struct KFile *,fd))
  * For read in serial flash memory we
  * enble cs pin and send one byte of read opcode,
  * and then 3 byte of address of memory cell we
- * want to read. After the last byte of address we
- * can read data from so pin.
+ * want to read (plus a dummy byte if FAST_READ is used).
+ * After the last byte of address we can read data from so pin.
  *
  * \return the number of bytes read.
  */
 static size_t flash25_read(struct KFile *_fd, void *buf, size_t size)
 {
-	uint8_t *data = (uint8_t *)buf;
-
 	Flash25 *fd = FLASH25_CAST(_fd);
 
 	ASSERT(fd->fd.seek_pos + (kfile_off_t)size <= fd->fd.size);
 	size = MIN((kfile_off_t)size, fd->fd.size - fd->fd.seek_pos);
 
-	//kprintf("Reading at addr[%lu], size[%d]\n", fd->seek_pos, size);
-	CS_ENABLE();
-
-	kfile_putc(FLASH25_READ, fd->channel);
-
-
-	/*
-	 * Address that we want to read.
-	 */
-	kfile_putc((fd->fd.seek_pos >> 16) & 0xFF, fd->channel);
-	kfile_putc((fd->fd.seek_pos >> 8) & 0xFF, fd->channel);
-	kfile_putc(fd->fd.seek_pos & 0xFF, fd->channel);
+	/* Memory array can't be read during a write cycle */
+	flash25_waitReady(fd);
 
-	kfile_read(fd->channel, data, size);
+	flash25_sendAddr(fd, FLASH25_READ_CMD, fd->fd.seek_pos);
+	kfile_read(fd->channel, buf, size);
 
 	CS_DISABLE();
 
@@ -210,6 +250,9 @@ static size_t flash25_read(struct KFile *_fd, void *buf, size_t size)
  * When we finish to send all data, we disable cs
  * and flash write received data bytes on its memory.
  *
+ * The end of the write cycle of the last page is not waited:
+ * this is done by the next operation on the memory or by kfile_flush().
+ *
  * \note: WARNING: you could write only on erased memory section!
  * Each write time you could write max a memory page size,
  * because if you write more than memory page size the
@@ -235,11 +278,8 @@ static size_t flash25_write(struct KFile *_fd, const void *_buf, size_t size)
 		offset = fd->fd.seek_pos % (flash25Size_t)FLASH25_PAGE_SIZE;
 		wr_len = MIN((flash25Size_t)size, FLASH25_PAGE_SIZE - (flash25Size_t)offset);
 
-		kprintf("[seek_pos-<%lu>, offset-<%d>]\n", fd->fd.seek_pos, offset);
-
 		/*
-		 * We check serial flash memory state, and wait until ready-flag
-		 * is high.
+		 * Wait the end of the previous write cycle, if any.
 		 */
 		flash25_waitReady(fd);
 
@@ -257,19 +297,11 @@ static size_t flash25_write(struct KFile *_fd, const void *_buf, size_t size)
 		 */
 		flash25_sendCmd(fd, FLASH25_WREN);
 
-		CS_ENABLE();
-		kfile_putc(FLASH25_PROGRAM, fd->channel);
-
-		/*
-		 * Address that we want to write.
-		 */
-		kfile_putc((fd->fd.seek_pos >> 16) & 0xFF, fd->channel);
-		kfile_putc((fd->fd.seek_pos >> 8) & 0xFF, fd->channel);
-		kfile_putc(fd->fd.seek_pos & 0xFF, fd->channel);
-
+		flash25_sendAddr(fd, FLASH25_PROGRAM, fd->fd.seek_pos);
 		kfile_write(fd->channel, data, wr_len);
 
 		CS_DISABLE();
+		fd->busy = true;
 
 		data += wr_len;
 		fd->fd.seek_pos += wr_len;
@@ -277,7 +309,6 @@ static size_t flash25_write(struct KFile *_fd, const void *_buf, size_t size)
 		total_write += wr_len;
 	}
 
-	kprintf("written %lu bytes\n", total_write);
 	return total_write;
 }
 
@@ -287,19 +318,12 @@ static size_t flash25_write(struct KFile *_fd, const void *_buf, size_t size)
  * Erase a select \p sector of serial flash memory.
  *
  * \note A sector size is FLASH25_SECTOR_SIZE.
- * This operation could take a while.
+ * This operation could take a while: the erase cycle is
+ * waited by the next operation on the memory.
  */
 void flash25_sectorErase(Flash25 *fd, Flash25Sector sector)
 {
-
-	/*
-	 * Erase a sector could take a while,
-	 * for debug we measure that time
-	 * see datasheet to compare this time.
-	 */
-	DB(ticks_t start_time = timer_clock());
-
-	CS_ENABLE();
+	flash25_waitReady(fd);
 
 	/*
 	 * To erase a sector of serial flash memory we must first
@@ -308,24 +332,12 @@ void flash25_sectorErase(Flash25 *fd, Flash25Sector sector)
 	 * determinate if any address within the sector
 	 * is selected.
 	 */
-	kfile_putc(FLASH25_WREN, fd->channel);
-	kfile_putc(FLASH25_SECTORE_ERASE,fd-> channel);
-
-	/*
-	 * Address inside the sector that we want to
-	 * erase.
-	 */
-	kfile_putc(sector, fd->channel);
+	flash25_sendCmd(fd, FLASH25_WREN);
 
+	flash25_sendAddr(fd, FLASH25_SECTORE_ERASE, sector);
 	CS_DISABLE();
 
-	/*
-	 * We check serial flash memory state, and wait until ready-flag
-	 * is hight.
-	 */
-	flash25_waitReady(fd);
-
-	DB(kprintf("Erased sector [%ld] in %ld ms\n", (unsigned long)sector, (unsigned long)ticks_to_ms(timer_clock() - start_time)));
+	fd->busy = true;
 }
 
 /**
@@ -333,16 +345,12 @@ void flash25_sectorErase(Flash25 *fd, Flash25Sector sector)
  *
  * Erase all sector of serial flash memory.
  *
- * \note This operation could take a while.
+ * \note This operation could take a while: the erase cycle is
+ * waited by the next operation on the memory.
  */
 void flash25_chipErase(Flash25 *fd)
 {
-	/*
-	 * Erase all chip could take a while,
-	 * for debug we measure that time
-	 * see datasheet to compare this time.
-	 */
-	DB(ticks_t start_time = timer_clock());
+	flash25_waitReady(fd);
 
 	/*
 	 * To erase serial flash memory we must first
@@ -352,14 +360,7 @@ void flash25_chipErase(Flash25 *fd)
 	flash25_sendCmd(fd, FLASH25_WREN);
 	flash25_sendCmd(fd, FLASH25_CHIP_ERASE);
 
-	/*
-	 * We check serial flash memory state, and wait until ready-flag
-	 * is high.
-	 */
-	flash25_waitReady(fd);
-
-	DB(kprintf("Erased all memory in %ld ms\n", ticks_to_ms(timer_clock() - start_time)));
-
+	fd->busy = true;
 }
 
 /**
@@ -371,6 +372,8 @@ void flash25_init(Flash25 *fd, KFile *ch)
 	ASSERT(fd);
 	ASSERT(ch);
 
+	memset(fd, 0, sizeof(*fd));
+
 	 //Set kfile struct type as a generic kfile structure.
 	DB(fd->fd._type = KFT_FLASH25);
 
@@ -380,6 +383,7 @@ void flash25_init(Flash25 *fd, KFile *ch)
 	fd->fd.read = flash25_read;
 	fd->fd.write = flash25_write;
 	fd->fd.seek = kfile_genericSeek;
+	fd->fd.flush = flash25_flush;
 
 	/*
 	 * Init a local channel structure and flash kfile interface.
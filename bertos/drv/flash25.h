@@ -60,6 +60,7 @@ typedef struct Flash25
 {
 	KFile fd;                       ///< File descriptor.
 	KFile *channel;                 ///< Dataflash comm channel (usually SPI).
+	bool busy;                      ///< True if a program or erase cycle could be in progress.
 } Flash25;
 
 /**
@@ -93,8 +94,8 @@ INLINE Flash25 * FLASH25_CAST(KFile *fd)
 	#define FLASH25_PAGE_SIZE          256   // Page size in byte
 	#define FLASH25_NUM_SECTOR         4     // Number of section in serial memory
 	#define FLASH25_SECTOR_SIZE        65536UL // Section size in byte
-	#define FLASH25_MEM_SIZE           FLASH25_NUM_SECTOR * FLASH25_SECTOR_SIZE
-	#define FLASH25_NUM_PAGE           FLASH25_MEM_SIZE / FLASH25_PAGE_SIZE
+	#define FLASH25_MEM_SIZE           (FLASH25_NUM_SECTOR * FLASH25_SECTOR_SIZE)
+	#define FLASH25_NUM_PAGE           (FLASH25_MEM_SIZE / FLASH25_PAGE_SIZE)
 #elif
 	#error Nothing memory defined in CONFIG_FLASH25 are support.
 #endif
@@ -111,6 +112,7 @@ typedef enum {
 	FLASH25_RDSR            = 0x5,  ///< Read status register
 	FLASH25_WRSR            = 0x1,  ///< Write status register
 	FLASH25_READ            = 0x3,  ///< Read data from memory array
+	FLASH25_FAST_READ       = 0xB,  ///< Read data from memory array, after a dummy byte (higher clock)
 	FLASH25_PROGRAM         = 0x2,  ///< Program data into memory array
 	FLASH25_SECTORE_ERASE   = 0x52, ///< Erase one sector in memory array
 	FLASH25_CHIP_ERASE      = 0x62, ///< Erase all sector in memory array
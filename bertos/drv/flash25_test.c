@@ -0,0 +1,427 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Serial flash driver test and benchmark.
+ *
+ * The driver runs on top of a simulated SPI flash: the simulator decodes
+ * the commands framed by chip select, models the memory array (programming
+ * can only clear bits, erasing sets them) and the timings of the bus, of the
+ * program and of the erase cycles. Every command sent to the memory while
+ * it is busy, and every program or erase without the write enable latch,
+ * is accounted as a protocol error.
+ *
+ * The benchmarks write pages preparing each one with some CPU work, with
+ * and without waiting for the end of the program cycle after each write,
+ * and read the memory back. Results are printed on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<name> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "flash25.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+
+#define SPI_CALL_US      2       ///< Cost of a SPI driver call.
+#define SPI_BYTE_NS      1000    ///< Time to shift one byte at 8 MHz.
+#define PROGRAM_US       2000    ///< Page program cycle.
+#define SECTOR_ERASE_US  400000  ///< Sector erase cycle.
+#define CHIP_ERASE_US    1600000 ///< Chip erase cycle.
+
+#define WEL_BIT  0x02
+
+/*
+ * Replace the example hw_spi.h with the chip select of the simulator.
+ */
+#define HW_SPI_H
+#define CS_ENABLE()    sim_cs(true)
+#define CS_DISABLE()   sim_cs(false)
+#define SPI_HW_INIT()  do { } while (0)
+
+/**
+ * Simulated SPI flash.
+ */
+static struct
+{
+	KFile fd;                        ///< SPI channel.
+	uint8_t mem[FLASH25_MEM_SIZE];   ///< Memory array.
+
+	unsigned long now;               ///< Simulated time [us].
+	unsigned long busy_until;        ///< End of the current cycle [us].
+	bool wel;                        ///< Write enable latch.
+
+	bool cs;                         ///< Chip select state.
+	uint8_t cmd;                     ///< Opcode of the current frame.
+	size_t in;                       ///< Bytes received in the current frame.
+	flash25Addr_t addr;              ///< Address of the current frame.
+	unsigned long cycle;             ///< Cycle to start on CS release.
+
+	unsigned long calls;             ///< SPI driver calls.
+	unsigned long frames;            ///< CS frames.
+	unsigned long polls;             ///< Status register reads.
+	unsigned long errors;            ///< Protocol violations.
+} sim;
+
+static bool sim_busy(void)
+{
+	return sim.now < sim.busy_until;
+}
+
+static void sim_cs(bool enable)
+{
+	ASSERT(sim.cs != enable);
+	sim.cs = enable;
+
+	if (enable)
+	{
+		sim.in = 0;
+		sim.frames++;
+		return;
+	}
+
+	if (sim.in == 0)
+		return;
+	if (sim.cmd == FLASH25_WREN)
+		sim.wel = true;
+	else if (sim.cmd == FLASH25_CHIP_ERASE)
+	{
+		if (!sim.wel)
+			sim.errors++;
+		else
+		{
+			memset(sim.mem, 0xFF, sizeof(sim.mem));
+			sim.cycle = CHIP_ERASE_US;
+		}
+	}
+
+	if (sim.cycle)
+	{
+		sim.busy_until = sim.now + sim.cycle;
+		sim.cycle = 0;
+		sim.wel = false;
+	}
+}
+
+static void sim_tick(size_t bytes)
+{
+	sim.calls++;
+	sim.now += SPI_CALL_US + bytes * SPI_BYTE_NS / 1000;
+}
+
+/**
+ * Decode a byte sent to the memory.
+ */
+static void sim_byteIn(uint8_t c)
+{
+	size_t n = sim.in++;
+
+	ASSERT(sim.cs);
+	if (n == 0)
+	{
+		sim.cmd = c;
+		sim.addr = 0;
+		if (c == FLASH25_RDSR)
+			sim.polls++;
+		else if (sim_busy())
+			sim.errors++;
+		return;
+	}
+
+	if (n < 4)
+	{
+		sim.addr = (sim.addr << 8) | c;
+		if (n == 3 && sim.cmd == FLASH25_SECTORE_ERASE)
+		{
+			if (!sim.wel)
+				sim.errors++;
+			else
+			{
+				flash25Addr_t sect = (sim.addr % FLASH25_MEM_SIZE) / FLASH25_SECTOR_SIZE;
+				memset(sim.mem + sect * FLASH25_SECTOR_SIZE, 0xFF, FLASH25_SECTOR_SIZE);
+				sim.cycle = SECTOR_ERASE_US;
+			}
+		}
+		return;
+	}
+
+	if (sim.cmd == FLASH25_PROGRAM)
+	{
+		/* Address rolls over inside the page */
+		flash25Addr_t page = sim.addr - sim.addr % FLASH25_PAGE_SIZE;
+		flash25Addr_t off = (sim.addr + n - 4) % FLASH25_PAGE_SIZE;
+
+		if (!sim.wel)
+			sim.errors++;
+		else
+		{
+			sim.mem[page + off] &= c;
+			sim.cycle = PROGRAM_US;
+		}
+	}
+}
+
+/**
+ * \return the byte sent by the memory.
+ */
+static uint8_t sim_byteOut(void)
+{
+	size_t n = sim.in++;
+
+	ASSERT(sim.cs);
+	switch (sim.cmd)
+	{
+	case FLASH25_RDSR:
+		return (sim_busy() ? RDY_BIT : 0) | (sim.wel ? WEL_BIT : 0);
+	case FLASH25_RDID:
+		return n == 1 ? FLASH25_MANUFACTURER_ID : FLASH25_DEVICE_ID;
+	case FLASH25_READ:
+		ASSERT(n >= 4);
+		return sim.mem[(sim.addr + n - 4) % FLASH25_MEM_SIZE];
+	case FLASH25_FAST_READ:
+		ASSERT(n >= 5);
+		return sim.mem[(sim.addr + n - 5) % FLASH25_MEM_SIZE];
+	default:
+		sim.errors++;
+		return 0xFF;
+	}
+}
+
+static size_t sim_write(UNUSED_ARG(struct KFile *, fd), const void *_buf, size_t size)
+{
+	const uint8_t *buf = (const uint8_t *)_buf;
+
+	sim_tick(size);
+	for (size_t i = 0; i < size; i++)
+		sim_byteIn(buf[i]);
+	return size;
+}
+
+static size_t sim_read(UNUSED_ARG(struct KFile *, fd), void *_buf, size_t size)
+{
+	uint8_t *buf = (uint8_t *)_buf;
+
+	sim_tick(size);
+	for (size_t i = 0; i < size; i++)
+		buf[i] = sim_byteOut();
+	return size;
+}
+
+static void sim_init(void)
+{
+	memset(&sim, 0, sizeof(sim));
+	memset(sim.mem, 0xFF, sizeof(sim.mem));
+	sim.fd.write = sim_write;
+	sim.fd.read = sim_read;
+}
+
+static void sim_resetStats(void)
+{
+	sim.calls = sim.frames = sim.polls = 0;
+}
+
+/**
+ * cpu_relax() of the busy-wait: nothing else to do here.
+ */
+void proc_yield(void)
+{
+}
+
+static Flash25 flash;
+static uint8_t ref[FLASH25_SECTOR_SIZE];
+static uint8_t buf[FLASH25_SECTOR_SIZE];
+
+static void fill(uint8_t *data, size_t len, unsigned seed)
+{
+	for (size_t i = 0; i < len; i++)
+		data[i] = (uint8_t)(i * 7 + seed + (i >> 8));
+}
+
+static void readWrite(void)
+{
+	unsigned long polls;
+
+	fill(ref, 1000, 3);
+	ASSERT(kfile_seek(&flash.fd, 100, KSM_SEEK_SET) == 100);
+	ASSERT(kfile_write(&flash.fd, ref, 1000) == 1000);
+
+	/* Write returns while the last page is being programmed */
+	ASSERT(sim_busy());
+
+	/* Reads wait for the end of the cycle */
+	ASSERT(kfile_seek(&flash.fd, 100, KSM_SEEK_SET) == 100);
+	ASSERT(kfile_read(&flash.fd, buf, 1000) == 1000);
+	ASSERT(memcmp(buf, ref, 1000) == 0);
+	ASSERT(memcmp(sim.mem + 100, ref, 1000) == 0);
+	ASSERT(sim.mem[99] == 0xFF && sim.mem[1100] == 0xFF);
+
+	/* No status polling when the memory is idle */
+	polls = sim.polls;
+	ASSERT(kfile_seek(&flash.fd, 0, KSM_SEEK_SET) == 0);
+	ASSERT(kfile_read(&flash.fd, buf, 10) == 10);
+	ASSERT(sim.polls == polls);
+
+	/* Writes crossing a page boundary are split */
+	fill(ref, 10, 77);
+	ASSERT(kfile_seek(&flash.fd, 8 * FLASH25_PAGE_SIZE - 5, KSM_SEEK_SET) == 8 * FLASH25_PAGE_SIZE - 5);
+	ASSERT(kfile_write(&flash.fd, ref, 10) == 10);
+	ASSERT(kfile_flush(&flash.fd) == 0);
+	ASSERT(!sim_busy());
+	ASSERT(memcmp(sim.mem + 8 * FLASH25_PAGE_SIZE - 5, ref, 10) == 0);
+	ASSERT(sim.errors == 0);
+}
+
+static void erase(void)
+{
+	fill(ref, FLASH25_PAGE_SIZE, 5);
+	ASSERT(kfile_seek(&flash.fd, FLASH25_SECT2, KSM_SEEK_SET) == FLASH25_SECT2);
+	ASSERT(kfile_write(&flash.fd, ref, FLASH25_PAGE_SIZE) == FLASH25_PAGE_SIZE);
+
+	flash25_sectorErase(&flash, FLASH25_SECT2);
+	ASSERT(sim_busy());
+
+	ASSERT(kfile_seek(&flash.fd, FLASH25_SECT2, KSM_SEEK_SET) == FLASH25_SECT2);
+	ASSERT(kfile_read(&flash.fd, buf, FLASH25_PAGE_SIZE) == FLASH25_PAGE_SIZE);
+	for (int i = 0; i < FLASH25_PAGE_SIZE; i++)
+		ASSERT(buf[i] == 0xFF);
+
+	/* Other sectors are untouched */
+	ASSERT(sim.mem[100] != 0xFF);
+
+	flash25_chipErase(&flash);
+	ASSERT(kfile_close(&flash.fd) == 0);
+	ASSERT(!sim_busy());
+	ASSERT(sim.mem[100] == 0xFF);
+	ASSERT(sim.errors == 0);
+	kfile_reopen(&flash.fd);
+}
+
+#define BENCH_PAGES  64
+#define PREPARE_US   1500  ///< CPU time spent preparing a page.
+
+static void benchWrite(bool sync)
+{
+	unsigned long start;
+	size_t len = BENCH_PAGES * FLASH25_PAGE_SIZE;
+
+	flash25_chipErase(&flash);
+	kfile_flush(&flash.fd);
+	fill(ref, len, sync);
+	sim_resetStats();
+	start = sim.now;
+
+	kfile_seek(&flash.fd, 0, KSM_SEEK_SET);
+	for (int i = 0; i < BENCH_PAGES; i++)
+	{
+		/* Prepare the page */
+		sim.now += PREPARE_US;
+
+		ASSERT(kfile_write(&flash.fd, ref + i * FLASH25_PAGE_SIZE, FLASH25_PAGE_SIZE) == FLASH25_PAGE_SIZE);
+		if (sync)
+			kfile_flush(&flash.fd);
+	}
+	kfile_flush(&flash.fd);
+
+	unsigned long time_us = sim.now - start;
+	printf("BENCH scenario=write path=%s pages=%d bytes=%lu prepare_us=%d calls=%lu frames=%lu polls=%lu time_us=%lu bytes_per_s=%lu\n",
+		sync ? "sync" : "deferred", BENCH_PAGES, (unsigned long)len, PREPARE_US,
+		sim.calls, sim.frames, sim.polls, time_us,
+		(unsigned long)((uint64_t)len * 1000000 / time_us));
+
+	ASSERT(memcmp(sim.mem, ref, len) == 0);
+	ASSERT(sim.errors == 0);
+}
+
+static void benchRead(size_t chunk)
+{
+	unsigned long start;
+
+	sim_resetStats();
+	start = sim.now;
+
+	kfile_seek(&flash.fd, 0, KSM_SEEK_SET);
+	for (size_t done = 0; done < sizeof(buf); done += chunk)
+		ASSERT(kfile_read(&flash.fd, buf + done, chunk) == chunk);
+
+	unsigned long time_us = sim.now - start;
+	printf("BENCH scenario=read path=%s chunk=%lu bytes=%lu calls=%lu frames=%lu time_us=%lu bytes_per_s=%lu\n",
+		CONFIG_FLASH25_FAST_READ ? "fast_read" : "read", (unsigned long)chunk,
+		(unsigned long)sizeof(buf), sim.calls, sim.frames, time_us,
+		(unsigned long)((uint64_t)sizeof(buf) * 1000000 / time_us));
+
+	/* Command and address go in a single call */
+	ASSERT(sim.calls == 2 * sizeof(buf) / chunk);
+	ASSERT(memcmp(buf, sim.mem, sizeof(buf)) == 0);
+}
+
+int flash25_testSetup(void)
+{
+	kdbg_init();
+	sim_init();
+	flash25_init(&flash, &sim.fd);
+	return 0;
+}
+
+int flash25_testRun(void)
+{
+	readWrite();
+	erase();
+	benchWrite(true);
+	benchWrite(false);
+	benchRead(16);
+	benchRead(FLASH25_PAGE_SIZE);
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int flash25_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(flash25);
+
+#include <drv/flash25.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif /* UNIT_TEST */
@@ -0,0 +1,190 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief I2C transaction queue.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "i2c_queue.h"
+
+#include <cfg/debug.h>
+
+#include <cpu/irq.h>
+#include <cpu/power.h> /* cpu_relax() */
+
+#include <drv/i2c.h>
+
+/**
+ * Queue \a xfer on \a bus.
+ * The transfer is started at once if the bus is idle.
+ * \a xfer, its segments and their buffers belong to the bus until
+ * the transfer has been completed.
+ */
+void i2cq_submit(I2cBus *bus, I2cXfer *xfer)
+{
+	cpu_flags_t flags;
+	bool start;
+
+	ASSERT(xfer->seg_cnt);
+	ASSERT(!(xfer->seg[0].flags & I2C_SEG_NOSTART));
+
+	xfer->status = I2CQ_PENDING;
+	xfer->cur_seg = 0;
+	xfer->cur_pos = 0;
+
+	IRQ_SAVE_DISABLE(flags);
+	ADDTAIL(&bus->queue, &xfer->link);
+	start = !bus->curr;
+	if (start)
+		bus->curr = (I2cXfer *)list_remHead(&bus->queue);
+	IRQ_RESTORE(flags);
+
+	/* The backend does not touch the bus until started */
+	if (start)
+		bus->start(bus);
+}
+
+/**
+ * Complete the current transfer of \a bus with \a status and start
+ * the next queued one.
+ * Called by backends, usually from interrupt context.
+ */
+void i2cq_done(I2cBus *bus, int status)
+{
+	I2cXfer *xfer = bus->curr;
+
+	ASSERT(xfer);
+	xfer->status = status;
+
+	bus->curr = (I2cXfer *)list_remHead(&bus->queue);
+	if (bus->curr)
+		bus->start(bus);
+
+	event_do(&xfer->done);
+}
+
+/**
+ * Wait for the completion of \a xfer, yielding the CPU.
+ * Useful when the done event of the transfer does not signal the caller.
+ * \return 0 if ok, EOF on errors.
+ */
+int i2cq_wait(I2cXfer *xfer)
+{
+	while (!i2cq_completed(xfer))
+		cpu_relax();
+	return xfer->status;
+}
+
+/**
+ * Queue \a xfer on \a bus and wait for its completion.
+ * \return 0 if ok, EOF on errors.
+ */
+int i2cq_transfer(I2cBus *bus, I2cXfer *xfer)
+{
+	i2cq_submit(bus, xfer);
+	return i2cq_wait(xfer);
+}
+
+/**
+ * Init \a bus, driven by the backend \a start function.
+ */
+void i2cq_init(I2cBus *bus, I2cStartFunc_t start)
+{
+	LIST_INIT(&bus->queue);
+	bus->curr = NULL;
+	bus->start = start;
+}
+
+/**
+ * Execute \a xfer with the byte functions of drv/i2c.h.
+ * \return 0 if ok, EOF on errors.
+ */
+static int i2cq_pollXfer(I2cXfer *xfer)
+{
+	int status = 0;
+
+	for (uint8_t i = 0; i < xfer->seg_cnt; i++)
+	{
+		I2cSeg *seg = &xfer->seg[i];
+
+		if (seg->flags & I2C_SEG_READ)
+		{
+			ASSERT(seg->len);
+			if (!i2c_start_r(xfer->id) || !i2c_recv(seg->buf, seg->len))
+			{
+				status = EOF;
+				break;
+			}
+		}
+		else if ((!(seg->flags & I2C_SEG_NOSTART) && !i2c_start_w(xfer->id))
+			|| !i2c_send(seg->buf, seg->len))
+		{
+			status = EOF;
+			break;
+		}
+	}
+	i2c_stop();
+	return status;
+}
+
+/**
+ * The byte functions drive a single bus: true while executing transfers.
+ */
+static bool poll_running;
+
+/**
+ * Polled backend: execute the current transfer and all the ones
+ * queued in the meantime.
+ */
+static void i2cq_pollStart(I2cBus *bus)
+{
+	/* Transfers submitted by done events are executed by the outer loop */
+	if (poll_running)
+		return;
+
+	poll_running = true;
+	while (bus->curr)
+		i2cq_done(bus, i2cq_pollXfer(bus->curr));
+	poll_running = false;
+}
+
+/**
+ * Init \a bus to execute transfers with the byte functions of drv/i2c.h
+ * (bitbang or hardware polled driver), which must be already initialized.
+ * Transfers are executed by the submitting process, which is busy
+ * until the queue is empty.
+ */
+void i2cq_initPolled(I2cBus *bus)
+{
+	i2cq_init(bus, i2cq_pollStart);
+}
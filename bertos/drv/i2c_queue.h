@@ -0,0 +1,165 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief I2C transaction queue.
+ *
+ * A transfer (I2cXfer) is a list of segments addressed to the same
+ * slave: each segment reads or writes a buffer, and starts with a
+ * (repeated) START condition and the slave address, unless it goes on
+ * with the previous write segment (I2C_SEG_NOSTART). A STOP condition
+ * ends the transfer.
+ *
+ * Transfers are queued on an I2cBus and executed in FIFO order by a
+ * backend: with an interrupt driven backend the bus is driven by the
+ * ISR, the submitting process can go on or sleep and is notified by
+ * the done Event of the transfer, so other processes run while data
+ * is moved on the bus.
+ * The polled backend, built on the byte functions of drv/i2c.h,
+ * executes each transfer as soon as the bus is free.
+ *
+ * Random read of a register, waiting with a signal:
+ * \code
+ * uint8_t reg = TEMP_REG;
+ * uint8_t temp[2];
+ * I2cSeg seg[] =
+ * {
+ *     { 0, &reg, sizeof(reg) },
+ *     { I2C_SEG_READ, temp, sizeof(temp) },
+ * };
+ * I2cXfer xfer;
+ *
+ * i2cq_xfer(&xfer, SENSOR_ID, seg, countof(seg), event_createSignal(proc_current(), SIG_USER1));
+ * i2cq_submit(&bus, &xfer);
+ * sig_wait(SIG_USER1);
+ * if (xfer.status == 0)
+ *     ...
+ * \endcode
+ *
+ * \note The done event is triggered from the context of the backend,
+ *       which is usually an interrupt.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef DRV_I2C_QUEUE_H
+#define DRV_I2C_QUEUE_H
+
+#include <cfg/compiler.h>
+#include <cfg/macros.h> /* BV() */
+#include <mware/event.h>
+#include <struct/list.h>
+
+/**
+ * Segment flags.
+ * \{
+ */
+#define I2C_SEG_READ     BV(0) ///< Read segment (write if not set).
+#define I2C_SEG_NOSTART  BV(1) ///< Go on with the previous write segment, without a repeated START.
+/* \} */
+
+/**
+ * Status of a transfer not yet completed.
+ */
+#define I2CQ_PENDING  1
+
+/**
+ * A segment of a transfer.
+ */
+typedef struct I2cSeg
+{
+	uint8_t flags;   ///< Segment flags (I2C_SEG_*).
+	uint8_t *buf;    ///< Data to write, or room for data read.
+	size_t len;      ///< Bytes to transfer, at least 1 for read segments.
+} I2cSeg;
+
+/**
+ * An I2C transfer.
+ */
+typedef struct I2cXfer
+{
+	Node link;             ///< Link in the queue of the bus.
+	uint8_t id;            ///< Slave device id, address left shifted by 1.
+	I2cSeg *seg;           ///< Segments.
+	uint8_t seg_cnt;       ///< Number of segments.
+	Event done;            ///< Triggered on completion.
+	volatile int status;   ///< I2CQ_PENDING, then 0 if ok or EOF on errors.
+
+	uint8_t cur_seg;       ///< Segment being transferred (used by backends).
+	size_t cur_pos;        ///< Next byte of the segment (used by backends).
+} I2cXfer;
+
+struct I2cBus;
+
+/**
+ * Backend function starting the current transfer of \a bus.
+ */
+typedef void (*I2cStartFunc_t)(struct I2cBus *bus);
+
+/**
+ * A queue of transfers on an I2C bus.
+ */
+typedef struct I2cBus
+{
+	List queue;              ///< Transfers waiting for the bus.
+	I2cXfer * volatile curr; ///< Transfer on the bus, NULL if idle.
+	I2cStartFunc_t start;    ///< Backend start function.
+} I2cBus;
+
+/**
+ * Prepare \a xfer to transfer the \a seg_cnt segments in \a seg with
+ * slave \a id, triggering \a done on completion.
+ */
+INLINE void i2cq_xfer(I2cXfer *xfer, uint8_t id, I2cSeg *seg, uint8_t seg_cnt, Event done)
+{
+	xfer->id = id;
+	xfer->seg = seg;
+	xfer->seg_cnt = seg_cnt;
+	xfer->done = done;
+}
+
+/**
+ * \return true if \a xfer has been completed.
+ */
+INLINE bool i2cq_completed(I2cXfer *xfer)
+{
+	return xfer->status != I2CQ_PENDING;
+}
+
+void i2cq_init(I2cBus *bus, I2cStartFunc_t start);
+void i2cq_initPolled(I2cBus *bus);
+void i2cq_initTwi(I2cBus *bus); /* AVR TWI interrupt backend, see cpu/avr/drv/i2c_queue_avr.c */
+void i2cq_submit(I2cBus *bus, I2cXfer *xfer);
+void i2cq_done(I2cBus *bus, int status);
+int i2cq_wait(I2cXfer *xfer);
+int i2cq_transfer(I2cBus *bus, I2cXfer *xfer);
+
+#endif /* DRV_I2C_QUEUE_H */
@@ -0,0 +1,623 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief I2C transaction queue test and benchmark on a mock bus.
+ *
+ * The mock bus models some temperature sensors and an EEPROM, with the
+ * bus timings at 100 kHz and protocol checks (a master receiver must
+ * NACK the last byte before a STOP or a repeated START).
+ * Transfers are executed by two backends:
+ * \li the polled backend of drv/i2c_queue.c, on top of byte functions
+ *     implemented by the mock bus;
+ * \li a mock interrupt driven controller, which works like the TWI of
+ *     the AVR: each bus operation runs in background and raises an
+ *     interrupt when done. The time spent waiting for interrupts is
+ *     free for other processes, proc_yield() jumps to the next one.
+ *
+ * Results are printed on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<name> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "i2c_queue.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+#include <cfg/module.h>
+#include <cfg/macros.h> /* countof() */
+
+#include <cpu/power.h> /* cpu_relax() */
+
+#include <drv/i2c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+
+#define START_US     10    ///< Start or stop condition.
+#define BYTE_US      90    ///< Byte plus ACK at 100 kHz.
+#define ISR_US       4     ///< Interrupt handler.
+
+#define SENSOR_ID    0x90
+#define SENSORS      4
+#define SENSOR_REGS  8
+#define E2_ID        0xA0
+#define E2_SIZE      1024
+#define MISSING_ID   0x70
+
+/**
+ * Device on the mock bus.
+ */
+typedef struct MockDev
+{
+	uint8_t id;          ///< Device id.
+	int addr_bytes;      ///< Register address bytes.
+	size_t size;         ///< Memory size.
+	uint8_t *mem;        ///< Memory (registers).
+} MockDev;
+
+static uint8_t sensor_mem[SENSORS][SENSOR_REGS];
+static uint8_t e2_mem[E2_SIZE];
+
+static MockDev devs[] =
+{
+	{ SENSOR_ID + 0, 1, SENSOR_REGS, sensor_mem[0] },
+	{ SENSOR_ID + 2, 1, SENSOR_REGS, sensor_mem[1] },
+	{ SENSOR_ID + 4, 1, SENSOR_REGS, sensor_mem[2] },
+	{ SENSOR_ID + 6, 1, SENSOR_REGS, sensor_mem[3] },
+	{ E2_ID, 2, E2_SIZE, e2_mem },
+};
+
+/**
+ * Mock bus.
+ */
+static struct
+{
+	unsigned long now;          ///< Simulated time [us].
+	unsigned long i2c_cpu;      ///< CPU time spent on the bus [us].
+	unsigned long free;         ///< CPU time left to other processes [us].
+
+	MockDev *sel;               ///< Selected device.
+	bool reading;               ///< True in master receiver mode.
+	bool ack;                   ///< ACK given by the master to the last byte read.
+	int addr_bytes;             ///< Address bytes received.
+	size_t ptr;                 ///< Address pointer.
+
+	unsigned long errors;       ///< Protocol errors.
+	unsigned long transfers;    ///< Bus transactions.
+} sim;
+
+static void sim_init(void)
+{
+	memset(&sim, 0, sizeof(sim));
+	for (int i = 0; i < SENSORS; i++)
+		for (int j = 0; j < SENSOR_REGS; j++)
+			sensor_mem[i][j] = (uint8_t)(i * 16 + j);
+	memset(e2_mem, 0xFF, sizeof(e2_mem));
+}
+
+static bool bus_start(uint8_t id)
+{
+	/* The master must NACK the last byte read */
+	if (sim.sel && sim.reading && sim.ack)
+		sim.errors++;
+
+	sim.now += START_US + BYTE_US;
+	sim.sel = NULL;
+	sim.reading = id & I2C_READBIT;
+	if (!sim.reading)
+		sim.addr_bytes = 0;
+
+	for (size_t i = 0; i < countof(devs); i++)
+		if (devs[i].id == (id & ~I2C_READBIT))
+			sim.sel = &devs[i];
+	return sim.sel != NULL;
+}
+
+static bool bus_put(uint8_t c)
+{
+	sim.now += BYTE_US;
+	if (!sim.sel || sim.reading)
+	{
+		sim.errors++;
+		return false;
+	}
+
+	if (sim.addr_bytes < sim.sel->addr_bytes)
+	{
+		sim.ptr = (sim.addr_bytes++ ? sim.ptr << 8 : 0) | c;
+		sim.ptr %= sim.sel->size;
+	}
+	else
+	{
+		sim.sel->mem[sim.ptr] = c;
+		sim.ptr = (sim.ptr + 1) % sim.sel->size;
+	}
+	return true;
+}
+
+static int bus_get(bool ack)
+{
+	int c;
+
+	sim.now += BYTE_US;
+	if (!sim.sel || !sim.reading)
+	{
+		sim.errors++;
+		return EOF;
+	}
+
+	c = sim.sel->mem[sim.ptr];
+	sim.ptr = (sim.ptr + 1) % sim.sel->size;
+	sim.ack = ack;
+	return c;
+}
+
+static void bus_stop(void)
+{
+	if (sim.sel && sim.reading && sim.ack)
+		sim.errors++;
+
+	sim.now += START_US;
+	sim.sel = NULL;
+	sim.transfers++;
+}
+
+/*
+ * Byte functions of drv/i2c.h, used by the polled backend.
+ * The CPU is busy for the whole bus time.
+ */
+MOD_DEFINE(i2c);
+
+void i2c_init(void)
+{
+	MOD_INIT(i2c);
+}
+
+#define POLL(expr) \
+	({ \
+		unsigned long __start = sim.now; \
+		typeof(expr) __res = (expr); \
+		sim.i2c_cpu += sim.now - __start; \
+		__res; \
+	})
+
+bool i2c_start_w(uint8_t id)
+{
+	return POLL(bus_start(id & ~I2C_READBIT));
+}
+
+bool i2c_start_r(uint8_t id)
+{
+	return POLL(bus_start(id | I2C_READBIT));
+}
+
+void i2c_stop(void)
+{
+	unsigned long start = sim.now;
+
+	bus_stop();
+	sim.i2c_cpu += sim.now - start;
+}
+
+bool i2c_put(uint8_t data)
+{
+	return POLL(bus_put(data));
+}
+
+int i2c_get(bool ack)
+{
+	return POLL(bus_get(ack));
+}
+
+/*
+ * Mock interrupt driven controller.
+ * Bus operations are executed on the mock bus at once, but their
+ * result is delivered by the interrupt at the end of the bus time.
+ */
+enum
+{
+	TWI_MT_ACK,     ///< Address or data byte acknowledged, transmitter.
+	TWI_MR_SLA_ACK, ///< Address acknowledged, receiver.
+	TWI_MR_DATA,    ///< Data byte received.
+	TWI_NACK,       ///< Address or data byte not acknowledged.
+};
+
+static struct
+{
+	I2cBus *bus;                ///< Bus driven by the controller.
+	bool irq;                   ///< Interrupt pending.
+	unsigned long due;          ///< Time of the pending interrupt [us].
+	unsigned long bus_free;     ///< End of the last bus operation [us].
+	int status;                 ///< Controller status.
+	int data;                   ///< Last byte received.
+} twi;
+
+/**
+ * Run bus operation \a expr in background and raise the interrupt at its end.
+ */
+#define TWI_OP(expr) \
+	({ \
+		unsigned long __now = sim.now; \
+		sim.now = MAX(sim.now, twi.bus_free); \
+		typeof(expr) __res = (expr); \
+		twi.bus_free = twi.due = sim.now; \
+		twi.irq = true; \
+		sim.now = __now; \
+		__res; \
+	})
+
+static void twi_sendAddr(I2cXfer *xfer)
+{
+	bool read = xfer->seg[xfer->cur_seg].flags & I2C_SEG_READ;
+
+	if (!TWI_OP(bus_start(read ? (xfer->id | I2C_READBIT) : (xfer->id & ~I2C_READBIT))))
+		twi.status = TWI_NACK;
+	else
+		twi.status = read ? TWI_MR_SLA_ACK : TWI_MT_ACK;
+}
+
+static void twi_put(uint8_t c)
+{
+	twi.status = TWI_OP(bus_put(c)) ? TWI_MT_ACK : TWI_NACK;
+}
+
+static void twi_get(I2cXfer *xfer)
+{
+	twi.data = TWI_OP(bus_get(xfer->cur_pos + 1 < xfer->seg[xfer->cur_seg].len));
+	twi.status = TWI_MR_DATA;
+}
+
+static void twi_end(int status)
+{
+	unsigned long now = sim.now;
+
+	/* The STOP condition does not raise interrupts */
+	sim.now = MAX(sim.now, twi.bus_free);
+	bus_stop();
+	twi.bus_free = sim.now;
+	sim.now = now;
+
+	i2cq_done(twi.bus, status);
+}
+
+static void twi_nextSeg(I2cXfer *xfer)
+{
+	I2cSeg *seg;
+
+	do
+	{
+		xfer->cur_pos = 0;
+		if (++xfer->cur_seg == xfer->seg_cnt)
+		{
+			twi_end(0);
+			return;
+		}
+		seg = &xfer->seg[xfer->cur_seg];
+
+		if (!(seg->flags & I2C_SEG_NOSTART))
+		{
+			twi_sendAddr(xfer);
+			return;
+		}
+	}
+	while (!seg->len);
+
+	twi_put(seg->buf[xfer->cur_pos++]);
+}
+
+static void twi_isr(void)
+{
+	I2cXfer *xfer = twi.bus->curr;
+	I2cSeg *seg = &xfer->seg[xfer->cur_seg];
+
+	switch (twi.status)
+	{
+	case TWI_MT_ACK:
+		if (xfer->cur_pos < seg->len)
+			twi_put(seg->buf[xfer->cur_pos++]);
+		else
+			twi_nextSeg(xfer);
+		break;
+
+	case TWI_MR_SLA_ACK:
+		twi_get(xfer);
+		break;
+
+	case TWI_MR_DATA:
+		seg->buf[xfer->cur_pos++] = (uint8_t)twi.data;
+		if (xfer->cur_pos < seg->len)
+			twi_get(xfer);
+		else
+			twi_nextSeg(xfer);
+		break;
+
+	default:
+		twi_end(EOF);
+		break;
+	}
+}
+
+static void twi_start(I2cBus *bus)
+{
+	twi_sendAddr(bus->curr);
+}
+
+static void twi_init(I2cBus *bus)
+{
+	memset(&twi, 0, sizeof(twi));
+	twi.bus = bus;
+	i2cq_init(bus, twi_start);
+}
+
+/**
+ * Other processes run until the next interrupt.
+ */
+void proc_yield(void)
+{
+	if (!twi.irq)
+		return;
+
+	if (sim.now < twi.due)
+	{
+		sim.free += twi.due - sim.now;
+		sim.now = twi.due;
+	}
+	twi.irq = false;
+	sim.now += ISR_US;
+	sim.i2c_cpu += ISR_US;
+	twi_isr();
+}
+
+/* Done events only use soft interrupts here */
+void sig_signal(UNUSED_ARG(struct Process *, proc), UNUSED_ARG(sigmask_t, sig))
+{
+	ASSERT(0);
+}
+
+/**
+ * Prepare a random read of \a len bytes at register \a reg of sensor \a n.
+ */
+static void sensorRead(I2cXfer *xfer, I2cSeg *seg, int n, uint8_t *reg, uint8_t *buf, size_t len, Event done)
+{
+	seg[0].flags = 0;
+	seg[0].buf = reg;
+	seg[0].len = 1;
+	seg[1].flags = I2C_SEG_READ;
+	seg[1].buf = buf;
+	seg[1].len = len;
+	i2cq_xfer(xfer, SENSOR_ID + 2 * n, seg, 2, done);
+}
+
+/**
+ * Prepare an EEPROM write of \a len bytes at \a addr.
+ * Address and data are sent as separate segments, without repeated START.
+ */
+static void e2Write(I2cXfer *xfer, I2cSeg *seg, uint8_t *addr, uint16_t a, const uint8_t *buf, size_t len)
+{
+	addr[0] = a >> 8;
+	addr[1] = a & 0xFF;
+	seg[0].flags = 0;
+	seg[0].buf = addr;
+	seg[0].len = 2;
+	seg[1].flags = I2C_SEG_NOSTART;
+	seg[1].buf = (uint8_t *)buf;
+	seg[1].len = len;
+	i2cq_xfer(xfer, E2_ID, seg, 2, event_createNone());
+}
+
+static int ids[] = { 0, 1, 2, 3, 4 };
+static int order[SENSORS + 1];
+static int completed;
+
+static void recordDone(void *n)
+{
+	order[completed++] = *(int *)n;
+}
+
+/**
+ * Functional checks, on any backend.
+ */
+static void exercise(I2cBus *bus, const char *name)
+{
+	I2cXfer xfer[SENSORS + 1];
+	I2cSeg seg[SENSORS + 1][2];
+	uint8_t reg[SENSORS];
+	uint8_t temp[SENSORS][2];
+	uint8_t addr[2], data[16], back[16];
+
+	kprintf("%s: write and read back\n", name);
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = (uint8_t)(i * 7 + 3);
+	e2Write(&xfer[0], seg[0], addr, 0x123, data, sizeof(data));
+	ASSERT(i2cq_transfer(bus, &xfer[0]) == 0);
+	ASSERT(memcmp(e2_mem + 0x123, data, sizeof(data)) == 0);
+
+	seg[0][1].flags = I2C_SEG_READ;
+	seg[0][1].buf = back;
+	ASSERT(i2cq_transfer(bus, &xfer[0]) == 0);
+	ASSERT(memcmp(back, data, sizeof(back)) == 0);
+
+	kprintf("%s: missing device\n", name);
+	reg[0] = 0;
+	sensorRead(&xfer[0], seg[0], 0, reg, temp[0], 2, event_createNone());
+	xfer[0].id = MISSING_ID;
+	ASSERT(i2cq_transfer(bus, &xfer[0]) == EOF);
+
+	kprintf("%s: queued transfers\n", name);
+	completed = 0;
+	for (int i = 0; i < SENSORS; i++)
+	{
+		reg[i] = (uint8_t)(i + 1);
+		sensorRead(&xfer[i], seg[i], i, &reg[i], temp[i], 2, event_createSoftint(recordDone, &ids[i]));
+		i2cq_submit(bus, &xfer[i]);
+	}
+	e2Write(&xfer[SENSORS], seg[SENSORS], addr, 0x200, data, sizeof(data));
+	xfer[SENSORS].done = event_createSoftint(recordDone, &ids[SENSORS]);
+	i2cq_submit(bus, &xfer[SENSORS]);
+	ASSERT(i2cq_wait(&xfer[SENSORS]) == 0);
+
+	ASSERT(completed == SENSORS + 1);
+	for (int i = 0; i < SENSORS; i++)
+	{
+		ASSERT(order[i] == i);
+		ASSERT(xfer[i].status == 0);
+		ASSERT(temp[i][0] == sensor_mem[i][i + 1]);
+		ASSERT(temp[i][1] == sensor_mem[i][i + 2]);
+	}
+	ASSERT(memcmp(e2_mem + 0x200, data, sizeof(data)) == 0);
+	ASSERT(!bus->curr);
+	ASSERT(sim.errors == 0);
+}
+
+/*
+ * Transfers submitted by done events, like a periodic acquisition.
+ */
+static struct
+{
+	I2cBus *bus;
+	I2cXfer xfer;
+	I2cSeg seg[2];
+	uint8_t reg;
+	uint8_t temp[2];
+	int left;
+	int depth;
+	int max_depth;
+} chain;
+
+static void chainNext(UNUSED_ARG(void *, unused))
+{
+	if (++chain.depth > chain.max_depth)
+		chain.max_depth = chain.depth;
+	ASSERT(chain.xfer.status == 0);
+
+	if (--chain.left)
+		i2cq_submit(chain.bus, &chain.xfer);
+	chain.depth--;
+}
+
+static void chained(I2cBus *bus, const char *name)
+{
+	kprintf("%s: chained transfers\n", name);
+	chain.bus = bus;
+	chain.left = 100;
+	chain.depth = chain.max_depth = 0;
+	chain.reg = 0;
+	sensorRead(&chain.xfer, chain.seg, 2, &chain.reg, chain.temp, 2, event_createSoftint(chainNext, NULL));
+
+	i2cq_submit(bus, &chain.xfer);
+	while (chain.left)
+		cpu_relax();
+
+	/* Done events never nest */
+	ASSERT(chain.max_depth == 1);
+	ASSERT(sim.errors == 0);
+}
+
+/**
+ * Acquisition round: read all the sensors and log the readings in the EEPROM.
+ */
+static void benchRounds(I2cBus *bus, const char *path)
+{
+	enum { ROUNDS = 100 };
+	I2cXfer xfer[SENSORS + 1];
+	I2cSeg seg[SENSORS + 1][2];
+	uint8_t reg[SENSORS];
+	uint8_t temp[SENSORS][2];
+	uint8_t addr[2];
+	unsigned long start = sim.now;
+
+	sim.i2c_cpu = sim.free = sim.transfers = 0;
+	for (int r = 0; r < ROUNDS; r++)
+	{
+		for (int i = 0; i < SENSORS; i++)
+		{
+			reg[i] = 0;
+			sensorRead(&xfer[i], seg[i], i, &reg[i], temp[i], 2, event_createNone());
+			i2cq_submit(bus, &xfer[i]);
+		}
+		e2Write(&xfer[SENSORS], seg[SENSORS], addr, (uint16_t)(r * sizeof(temp)), (uint8_t *)temp, sizeof(temp));
+		i2cq_submit(bus, &xfer[SENSORS]);
+		ASSERT(i2cq_wait(&xfer[SENSORS]) == 0);
+	}
+
+	unsigned long elapsed = sim.now - start;
+	printf("BENCH scenario=acquisition path=%s rounds=%d transactions=%lu time_us=%lu i2c_cpu_us=%lu cpu_free_pct=%lu\n",
+		path, ROUNDS, sim.transfers, elapsed, sim.i2c_cpu, (elapsed - sim.i2c_cpu) * 100 / elapsed);
+	ASSERT(sim.errors == 0);
+}
+
+int i2c_queue_testSetup(void)
+{
+	kdbg_init();
+	sim_init();
+	i2c_init();
+	return 0;
+}
+
+int i2c_queue_testRun(void)
+{
+	I2cBus bus;
+
+	i2cq_initPolled(&bus);
+	exercise(&bus, "polled");
+	chained(&bus, "polled");
+	benchRounds(&bus, "polled");
+
+	twi_init(&bus);
+	exercise(&bus, "irq");
+	chained(&bus, "irq");
+	benchRounds(&bus, "irq");
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int i2c_queue_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(i2c_queue);
+
+#include <drv/i2c_queue.c>
+#include <drv/i2c.c>
+#include <mware/event.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif /* UNIT_TEST */
@@ -58,6 +58,7 @@
 #include "cfg/cfg_ser.h"
 #include "cfg/cfg_kern.h"
 #include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN() */
 
 #include <mware/formatwr.h>
 
@@ -238,6 +239,37 @@ static size_t ser_write(struct KFile *fd, const void *_buf, size_t size)
 }
 
 
+/**
+ * Lend the free space of the tx FIFO, so that data can be
+ * produced directly there.
+ * \return the buffer, NULL if the FIFO is full.
+ */
+static void *ser_borrow(struct KFile *fd, size_t *len)
+{
+	Serial *fds = SERIAL_CAST(fd);
+
+	*len = fifo_contigFree_locked(&fds->txfifo);
+	return *len ? fds->txfifo.tail : NULL;
+}
+
+/**
+ * Send \a len bytes written in the buffer lent by ser_borrow().
+ */
+static size_t ser_commit(struct KFile *fd, size_t len)
+{
+	Serial *fds = SERIAL_CAST(fd);
+
+	if (len)
+	{
+		fifo_pushInPlace_locked(&fds->txfifo, len);
+
+		/* (re)trigger tx interrupt */
+		fds->hw->table->txStart(fds->hw);
+	}
+	return len;
+}
+
+
 #if CONFIG_SER_RXTIMEOUT != -1 || CONFIG_SER_TXTIMEOUT != -1
 void ser_settimeouts(struct Serial *fd, mtime_t rxtimeout, mtime_t txtimeout)
 {
@@ -441,6 +473,8 @@ void ser_init(struct Serial *fds, unsigned int unit)
 	fds->fd.flush = ser_flush;
 	fds->fd.error = ser_error;
 	fds->fd.clearerr = ser_clearerr;
+	fds->fd.borrow = ser_borrow;
+	fds->fd.commit = ser_commit;
 	ser_open(fds, unit);
 }
 
@@ -461,19 +495,27 @@ static size_t spimaster_read(struct KFile *fd, void *_buf, size_t size)
 	uint8_t *buf = (uint8_t *)_buf;
 	int c;
 
-	while (size--)
+	while (size)
 	{
 		/*
-		 * Send and receive chars 1 by 1, otherwise the rxfifo
+		 * Send fake chars in blocks, so that the bus never waits for
+		 * us, but no more than the rxfifo can hold, otherwise it
 		 * will overrun.
 		 */
-		ser_putchar(0, fd_spi);
+		size_t len = MIN(size, fifo_len(&fd_spi->rxfifo));
 
-		if ((c = ser_getchar(fd_spi)) == EOF)
-			break;
+		for (size_t i = 0; i < len; i++)
+			ser_putchar(0, fd_spi);
 
-		*buf++ = c;
-		total_rd++;
+		for (size_t i = 0; i < len; i++)
+		{
+			if ((c = ser_getchar(fd_spi)) == EOF)
+				return total_rd;
+
+			*buf++ = c;
+			total_rd++;
+		}
+		size -= len;
 	}
 	return total_rd;
 }
@@ -507,6 +549,9 @@ void spimaster_init(Serial *fds, unsigned int unit)
 	ser_init(fds, unit);
 	fds->fd.read = spimaster_read;
 	fds->fd.write = spimaster_write;
+	/* Writes must go through spimaster_write() */
+	fds->fd.borrow = NULL;
+	fds->fd.commit = NULL;
 }
 
 
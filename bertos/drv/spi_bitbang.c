@@ -44,10 +44,45 @@
 #include "hw/hw_spi.h"
 
 #include "cfg/cfg_spi_bitbang.h"
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* BV() */
 #include <cfg/module.h>
 
+#include <cpu/attr.h> /* CPU_BYTE_ORDER */
 #include <cpu/irq.h>
 
+#include <string.h> /* memset() */
+
+/*
+ * Mask of the i-th bit sent on the wire.
+ */
+#if CONFIG_SPI_DATAORDER == SPI_LSB_FIRST
+	#define SPI_BITMASK(i)  BV(i)
+#elif CONFIG_SPI_DATAORDER == SPI_MSB_FIRST
+	#define SPI_BITMASK(i)  BV(7 - (i))
+#endif
+
+/*
+ * True if the bytes of a word go on the wire in reverse memory order.
+ */
+#define SPI_WORD_SWAP \
+	((CONFIG_SPI_DATAORDER == SPI_MSB_FIRST) != (CPU_BYTE_ORDER == CPU_BIG_ENDIAN))
+
+/**
+ * Shift bit \a i of \a out on MOSI, and bit \a i of \a in from MISO.
+ */
+#define SPI_BIT(out, in, i) \
+	do { \
+		if ((out) & SPI_BITMASK(i)) \
+			MOSI_HIGH(); \
+		else \
+			MOSI_LOW(); \
+		SCK_ACTIVE(); \
+		if (IS_MISO_HIGH()) \
+			(in) |= SPI_BITMASK(i); \
+		SCK_INACTIVE(); \
+	} while (0)
+
 void spi_assertSS(void)
 {
 	ATOMIC(SS_ACTIVE());
@@ -58,33 +93,101 @@ void spi_deassertSS(void)
 	ATOMIC(SS_INACTIVE());
 }
 
+/**
+ * Send byte \a c and receive one, with the loop on the bits unrolled.
+ * Interrupts are disabled for one byte at a time only.
+ */
+INLINE uint8_t spi_byte(uint8_t c)
+{
+	uint8_t data = 0;
+
+	ATOMIC(
+		SPI_BIT(c, data, 0);
+		SPI_BIT(c, data, 1);
+		SPI_BIT(c, data, 2);
+		SPI_BIT(c, data, 3);
+		SPI_BIT(c, data, 4);
+		SPI_BIT(c, data, 5);
+		SPI_BIT(c, data, 6);
+		SPI_BIT(c, data, 7);
+	);
+	return data;
+}
+
 /**
  * Send byte \c c over MOSI line, CONFIG_SPI_DATAORDER first.
  * SS pin state is left unchanged.
  */
 uint8_t spi_sendRecv(uint8_t c)
 {
-	uint8_t data = 0;
-	uint8_t shift = SPI_DATAORDER_START;
-
+	return spi_byte(c);
+}
 
-	ATOMIC(
-		for (int i = 0; i < 8; i++)
+/**
+ * Full duplex transfer of \a count words, \a word_size bytes long (1, 2 or 4).
+ * Words to send are taken from \a tx, or zeros are sent if \a tx is NULL;
+ * words received are stored in \a rx, or discarded if \a rx is NULL.
+ * SS pin state is left unchanged.
+ */
+void spi_xfer(const void *_tx, void *_rx, size_t count, size_t word_size)
+{
+	const uint8_t *tx = (const uint8_t *)_tx;
+	uint8_t *rx = (uint8_t *)_rx;
+
+	ASSERT(word_size == 1 || word_size == 2 || word_size == 4);
+
+	if (word_size == 1 || !SPI_WORD_SWAP)
+	{
+		/* Memory and wire order match: a plain byte stream */
+		count *= word_size;
+		if (!rx)
+			while (count--)
+				spi_byte(*tx++);
+		else if (!tx)
+			while (count--)
+				*rx++ = spi_byte(0);
+		else
+			while (count--)
+				*rx++ = spi_byte(*tx++);
+		return;
+	}
+
+	while (count--)
+	{
+		for (size_t i = word_size; i--; )
 		{
-			/* Shift the i-th bit to MOSI */
-			if (c & shift)
-				MOSI_HIGH();
-			else
-				MOSI_LOW();
-			/* Assert clock */
-			SCK_ACTIVE();
-			data |= IS_MISO_HIGH() ? shift : 0;
-			/* De-assert clock */
-			SCK_INACTIVE();
-			SPI_DATAORDER_SHIFT(shift);
+			uint8_t c = spi_byte(tx ? tx[i] : 0);
+
+			if (rx)
+				rx[i] = c;
 		}
-	);
-	return data;
+		if (tx)
+			tx += word_size;
+		if (rx)
+			rx += word_size;
+	}
+}
+
+/**
+ * Send 16 bit word \a w and return the one received.
+ */
+uint16_t spi_sendRecv16(uint16_t w)
+{
+	uint16_t r;
+
+	spi_xfer(&w, &r, 1, sizeof(w));
+	return r;
+}
+
+/**
+ * Send 32 bit word \a w and return the one received.
+ */
+uint32_t spi_sendRecv32(uint32_t w)
+{
+	uint32_t r;
+
+	spi_xfer(&w, &r, 1, sizeof(w));
+	return r;
 }
 
 MOD_DEFINE(spi);
@@ -99,12 +202,7 @@ void spi_init(void)
  */
 void spi_read(void *_buff, size_t len)
 {
-	uint8_t *buff = (uint8_t *)_buff;
-
-	while (len--)
-		/* Read byte from spi and put it in buffer. */
-		*buff++ = spi_sendRecv(0);
-
+	spi_xfer(NULL, _buff, len, 1);
 }
 
 /**
@@ -112,10 +210,32 @@ void spi_read(void *_buff, size_t len)
  */
 void spi_write(const void *_buff, size_t len)
 {
-	const uint8_t *buff = (const uint8_t *)_buff;
+	spi_xfer(_buff, NULL, len, 1);
+}
+
+static size_t spi_fileRead(UNUSED_ARG(struct KFile *, fd), void *buf, size_t size)
+{
+	spi_read(buf, size);
+	return size;
+}
 
-	while (len--)
-		/* Write byte pointed at by *buff to spi */
-		spi_sendRecv(*buff++);
+static size_t spi_fileWrite(UNUSED_ARG(struct KFile *, fd), const void *buf, size_t size)
+{
+	spi_write(buf, size);
+	return size;
+}
+
+/**
+ * Init \a fd as a KFile channel on the SPI bus.
+ * Reads send zeros and writes discard the data received, like
+ * the Serial SPI master.
+ */
+void spi_initFile(KFile *fd)
+{
+	MOD_CHECK(spi);
 
+	memset(fd, 0, sizeof(*fd));
+	fd->read = spi_fileRead;
+	fd->write = spi_fileWrite;
+	fd->close = kfile_genericClose;
 }
@@ -33,6 +33,20 @@
  *
  * \brief Emulated SPI Master for DSP firmware download (interface)
  *
+ * Data is transferred full duplex, in blocks of 8, 16 or 32 bit words:
+ * words are taken from and stored in memory with the CPU byte order and
+ * go on the wire in CONFIG_SPI_DATAORDER, so a 16 bit word is sent most
+ * significant byte first when MSB first order is selected.
+ * The bus can also be used as a KFile channel, e.g. for the Flash25 and
+ * DataFlash drivers:
+ * \code
+ * KFile spi;
+ *
+ * spi_init();
+ * spi_initFile(&spi);
+ * flash25_init(&flash, &spi);
+ * \endcode
+ *
  * \version $Id: spi.h 15321 2007-03-21 14:45:12Z asterix $
  *
  * \author Francesco Sacchi <batt@develer.com>
@@ -47,6 +61,8 @@
 
 #include <cfg/compiler.h>
 
+#include <kern/kfile.h>
+
 /**
  * Define send and receive order bit.
  * \{
@@ -63,10 +79,14 @@
 	#define  SPI_DATAORDER_SHIFT(i) ((i) >>= 1)
 #endif
 
+void spi_xfer(const void *tx, void *rx, size_t count, size_t word_size);
 void spi_write(const void *buf, size_t len);
 void spi_read(void *buf, size_t len);
 uint8_t spi_sendRecv(uint8_t c);
+uint16_t spi_sendRecv16(uint16_t w);
+uint32_t spi_sendRecv32(uint32_t w);
 void spi_init(void);
+void spi_initFile(KFile *fd);
 void spi_assertSS(void);
 void spi_deassertSS(void);
 
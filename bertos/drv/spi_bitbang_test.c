@@ -0,0 +1,268 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Emulated SPI master test on a simulated slave.
+ *
+ * The SPI pins are replaced by a slave that samples MOSI on the
+ * active clock edge, drives MISO from a reply buffer and records
+ * every byte received, checking the bit order of CONFIG_SPI_DATAORDER.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "spi_bitbang.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+#include <cfg/macros.h> /* BV() */
+
+#include <string.h>
+
+#if UNIT_TEST
+
+#if CONFIG_SPI_DATAORDER == SPI_LSB_FIRST
+	#define SIM_BITMASK(i)  BV(i)
+#else
+	#define SIM_BITMASK(i)  BV(7 - (i))
+#endif
+
+#define SIM_SIZE  256
+
+/**
+ * Simulated SPI slave.
+ */
+static struct
+{
+	bool ss;                    ///< Slave selected.
+	bool mosi;                  ///< MOSI level.
+	bool sck;                   ///< Clock active.
+	int bit;                    ///< Bit being transferred.
+	uint8_t shift;              ///< Byte being received.
+
+	uint8_t reply[SIM_SIZE];    ///< Bytes sent by the slave.
+	uint8_t recv[SIM_SIZE];     ///< Bytes received by the slave.
+	size_t count;               ///< Bytes transferred.
+	unsigned long errors;       ///< Protocol errors.
+} sim;
+
+static void sim_reset(void)
+{
+	sim.count = 0;
+	sim.bit = 0;
+	sim.shift = 0;
+	memset(sim.recv, 0, sizeof(sim.recv));
+	for (size_t i = 0; i < SIM_SIZE; i++)
+		sim.reply[i] = (uint8_t)(i * 37 + 11);
+}
+
+static void sim_sckActive(void)
+{
+	if (!sim.ss || sim.sck)
+		sim.errors++;
+	sim.sck = true;
+	if (sim.mosi)
+		sim.shift |= SIM_BITMASK(sim.bit);
+}
+
+static void sim_sckInactive(void)
+{
+	if (!sim.sck)
+		sim.errors++;
+	sim.sck = false;
+	if (++sim.bit == 8)
+	{
+		sim.recv[sim.count % SIM_SIZE] = sim.shift;
+		sim.count++;
+		sim.bit = 0;
+		sim.shift = 0;
+	}
+}
+
+static bool sim_miso(void)
+{
+	if (!sim.sck)
+		sim.errors++;
+	return sim.reply[sim.count % SIM_SIZE] & SIM_BITMASK(sim.bit);
+}
+
+/* Pins of hw/hw_spi.h */
+#define HW_SPI_H
+#define SPI_HW_INIT()    do { sim.sck = false; sim.ss = false; } while (0)
+#define SS_ACTIVE()      do { sim.ss = true; } while (0)
+#define SS_INACTIVE()    do { sim.ss = false; } while (0)
+#define MOSI_HIGH()      do { sim.mosi = true; } while (0)
+#define MOSI_LOW()       do { sim.mosi = false; } while (0)
+#define SCK_ACTIVE()     sim_sckActive()
+#define SCK_INACTIVE()   sim_sckInactive()
+#define IS_MISO_HIGH()   sim_miso()
+
+/*
+ * Byte \a i of word \a w on the wire.
+ */
+#if CONFIG_SPI_DATAORDER == SPI_LSB_FIRST
+	#define WIRE_BYTE(w, i, size)  ((uint8_t)((w) >> (8 * (i))))
+#else
+	#define WIRE_BYTE(w, i, size)  ((uint8_t)((w) >> (8 * ((size) - 1 - (i)))))
+#endif
+
+static void bytes(void)
+{
+	uint8_t tx[100], rx[100];
+
+	kprintf("Byte transfers\n");
+	for (size_t i = 0; i < sizeof(tx); i++)
+		tx[i] = (uint8_t)(i * 5 + 1);
+
+	sim_reset();
+	spi_write(tx, sizeof(tx));
+	ASSERT(sim.count == sizeof(tx));
+	ASSERT(memcmp(sim.recv, tx, sizeof(tx)) == 0);
+
+	sim_reset();
+	spi_read(rx, sizeof(rx));
+	ASSERT(memcmp(rx, sim.reply, sizeof(rx)) == 0);
+	for (size_t i = 0; i < sizeof(rx); i++)
+		ASSERT(sim.recv[i] == 0);
+
+	sim_reset();
+	spi_xfer(tx, rx, sizeof(tx), 1);
+	ASSERT(memcmp(sim.recv, tx, sizeof(tx)) == 0);
+	ASSERT(memcmp(rx, sim.reply, sizeof(rx)) == 0);
+
+	sim_reset();
+	ASSERT(spi_sendRecv(0xA5) == sim.reply[0]);
+	ASSERT(sim.recv[0] == 0xA5);
+}
+
+static void words(void)
+{
+	uint16_t tx16[10], rx16[10];
+	uint32_t tx32[10], rx32[10];
+
+	kprintf("Word transfers\n");
+	sim_reset();
+	uint16_t r16 = spi_sendRecv16(0x1234);
+	ASSERT(sim.count == 2);
+	ASSERT(sim.recv[0] == WIRE_BYTE(0x1234, 0, 2));
+	ASSERT(sim.recv[1] == WIRE_BYTE(0x1234, 1, 2));
+	ASSERT(WIRE_BYTE(r16, 0, 2) == sim.reply[0]);
+	ASSERT(WIRE_BYTE(r16, 1, 2) == sim.reply[1]);
+
+	sim_reset();
+	uint32_t r32 = spi_sendRecv32(0x89ABCDEF);
+	ASSERT(sim.count == 4);
+	for (int i = 0; i < 4; i++)
+	{
+		ASSERT(sim.recv[i] == WIRE_BYTE(0x89ABCDEFUL, i, 4));
+		ASSERT(WIRE_BYTE(r32, i, 4) == sim.reply[i]);
+	}
+
+	for (int i = 0; i < 10; i++)
+	{
+		tx16[i] = (uint16_t)(i * 0x1111 + 0x0102);
+		tx32[i] = (uint32_t)i * 0x01010101UL + 0x10203040UL;
+	}
+
+	sim_reset();
+	spi_xfer(tx16, rx16, countof(tx16), sizeof(tx16[0]));
+	ASSERT(sim.count == sizeof(tx16));
+	for (int i = 0; i < 10; i++)
+		for (int j = 0; j < 2; j++)
+		{
+			ASSERT(sim.recv[i * 2 + j] == WIRE_BYTE(tx16[i], j, 2));
+			ASSERT(WIRE_BYTE(rx16[i], j, 2) == sim.reply[i * 2 + j]);
+		}
+
+	sim_reset();
+	spi_xfer(NULL, rx32, countof(rx32), sizeof(rx32[0]));
+	for (int i = 0; i < 10; i++)
+		for (int j = 0; j < 4; j++)
+			ASSERT(WIRE_BYTE(rx32[i], j, 4) == sim.reply[i * 4 + j]);
+
+	sim_reset();
+	spi_xfer(tx32, NULL, countof(tx32), sizeof(tx32[0]));
+	for (int i = 0; i < 10; i++)
+		for (int j = 0; j < 4; j++)
+			ASSERT(sim.recv[i * 4 + j] == WIRE_BYTE(tx32[i], j, 4));
+}
+
+static void channel(void)
+{
+	KFile spi;
+	uint8_t buf[32];
+
+	kprintf("KFile channel\n");
+	spi_initFile(&spi);
+
+	sim_reset();
+	ASSERT(kfile_putc(0x9F, &spi) == 0x9F);
+	ASSERT(kfile_read(&spi, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(sim.recv[0] == 0x9F);
+	ASSERT(memcmp(buf, sim.reply + 1, sizeof(buf)) == 0);
+	ASSERT(kfile_close(&spi) == 0);
+}
+
+int spi_bitbang_testSetup(void)
+{
+	kdbg_init();
+	spi_init();
+	return 0;
+}
+
+int spi_bitbang_testRun(void)
+{
+	spi_assertSS();
+	bytes();
+	words();
+	channel();
+	spi_deassertSS();
+
+	ASSERT(!sim.ss);
+	ASSERT(sim.errors == 0);
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int spi_bitbang_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(spi_bitbang);
+
+#include <drv/spi_bitbang.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif /* UNIT_TEST */
@@ -127,6 +127,12 @@ static fcs_t computeFcs(struct BattFsPageHeader *hdr)
 	return cks;
 }
 
+/**
+ * Mask applied to the FCS of pages written inside a transaction.
+ * Until the transaction is committed these pages look invalid.
+ */
+#define PENDING_FCS_MARK 0x5AA5
+
 /**
  * Read from disk.
  * If available, the cache will be used.
@@ -142,6 +148,42 @@ static size_t diskRead(struct BattFsSuper *disk, pgcnt_t page, pgaddr_t addr, vo
 		return disk->read(disk, page, addr, buf, size);
 }
 
+/**
+ * Read from disk using the read-ahead buffer, if available.
+ * When the requested data is not in the read-ahead buffer,
+ * the buffer is refilled starting from \a addr.
+ * \note \a size must not cross page data boundary.
+ * \return the number of bytes read.
+ */
+static size_t diskReadAhead(struct BattFsSuper *disk, pgcnt_t page, pgaddr_t addr, void *buf, size_t size)
+{
+	ASSERT(addr + size <= disk->data_size);
+
+	if (page == disk->curr_page
+	 || !disk->readahead_buf
+	 || size >= disk->readahead_size)
+		return diskRead(disk, page, addr, buf, size);
+
+	if (page != disk->readahead_page
+	 || addr < disk->readahead_addr
+	 || addr + size > disk->readahead_addr + disk->readahead_len)
+	{
+		pgaddr_t len = MIN(disk->readahead_size, (pgaddr_t)(disk->data_size - addr));
+
+		if (disk->read(disk, page, addr, disk->readahead_buf, len) != len)
+		{
+			disk->readahead_len = 0;
+			return 0;
+		}
+		disk->readahead_page = page;
+		disk->readahead_addr = addr;
+		disk->readahead_len = len;
+	}
+
+	memcpy(buf, &disk->readahead_buf[addr - disk->readahead_addr], size);
+	return size;
+}
+
 
 /**
  * Read header of \a page in \a hdr.
@@ -178,6 +220,9 @@ static bool setBufferHdr(struct BattFsSuper *disk, struct BattFsPageHeader *hdr)
 
 	#warning FIXME:refactor computeFcs to save time and stack
 	hdr->fcs = computeFcs(hdr);
+	/* Pages written inside a transaction are pending until commit */
+	if (disk->in_trans)
+		hdr->fcs ^= PENDING_FCS_MARK;
 	/* Fill buffer */
 	battfs_to_disk(hdr, buf);
 
@@ -211,6 +256,133 @@ static bool getBufferHdr(struct BattFsSuper *disk, struct BattFsPageHeader *hdr)
 	return true;
 }
 
+/**
+ * Size of the commit record header (the number of entries).
+ */
+#define TRANS_HDR_LEN 2
+
+/**
+ * Size of a commit record entry (page and header FCS).
+ */
+#define TRANS_ENTRY_LEN 4
+
+/**
+ * Read entry \a i of the last commit record.
+ * \return true if ok, false on disk errors.
+ */
+static bool transEntry(struct BattFsSuper *disk, pgcnt_t i, pgcnt_t *page, fcs_t *fcs)
+{
+	uint8_t buf[TRANS_ENTRY_LEN];
+
+	if (diskRead(disk, disk->trans_page, TRANS_HDR_LEN + i * TRANS_ENTRY_LEN, buf, TRANS_ENTRY_LEN)
+	    != TRANS_ENTRY_LEN)
+		return false;
+
+	*page = buf[1] << 8 | buf[0];
+	*fcs = buf[3] << 8 | buf[2];
+	return true;
+}
+
+/**
+ * \return the number of entries in the last commit record.
+ */
+static pgcnt_t transCount(struct BattFsSuper *disk)
+{
+	uint8_t buf[TRANS_HDR_LEN];
+
+	if (disk->trans_page == PAGE_UNSET_SENTINEL
+	 || diskRead(disk, disk->trans_page, 0, buf, TRANS_HDR_LEN) != TRANS_HDR_LEN)
+		return 0;
+
+	return MIN((pgcnt_t)(buf[1] << 8 | buf[0]),
+		(pgcnt_t)((disk->data_size - TRANS_HDR_LEN) / TRANS_ENTRY_LEN));
+}
+
+/**
+ * Check the last commit record of \a disk: entries must refer to pages
+ * of the disk and be sorted by page, without duplicates.
+ * A corrupted record is ignored, as if no transaction was committed.
+ * \return true if ok, false on disk errors.
+ */
+static bool transCheck(struct BattFsSuper *disk)
+{
+	pgcnt_t count = transCount(disk);
+	pgcnt_t page, prev = 0;
+	fcs_t fcs;
+
+	for (pgcnt_t i = 0; i < count; i++)
+	{
+		if (!transEntry(disk, i, &page, &fcs))
+			return false;
+
+		if (page >= disk->page_count || (i && page <= prev))
+		{
+			LOG_ERR("Corrupted commit record, entry %d page %d\n", i, page);
+			disk->trans_page = PAGE_UNSET_SENTINEL;
+			return true;
+		}
+		prev = page;
+	}
+	return true;
+}
+
+/**
+ * Search \a page in the last commit record, using a binary search
+ * (entries are sorted by page).
+ * \return true if \a page is committed with header FCS \a fcs, false otherwise.
+ */
+static bool transCommitted(struct BattFsSuper *disk, pgcnt_t page, fcs_t fcs)
+{
+	pgcnt_t first = 0, last = transCount(disk);
+	pgcnt_t p;
+	fcs_t f;
+
+	while (first < last)
+	{
+		pgcnt_t i = (first + last) / 2;
+
+		if (!transEntry(disk, i, &p, &f))
+			return false;
+
+		if (p == page)
+			return f == fcs;
+		else if (p < page)
+			first = i + 1;
+		else
+			last = i;
+	}
+	return false;
+}
+
+/**
+ * \return true if \a page has been saved by the current transaction.
+ */
+static bool transPending(struct BattFsSuper *disk, pgcnt_t page)
+{
+	for (pgcnt_t i = 0; i < disk->trans_count; i++)
+		if (disk->trans_pages[i].page == page)
+			return true;
+	return false;
+}
+
+/**
+ * Check if \a hdr, read from \a page, belongs to a valid page.
+ * A page is valid if the header FCS is correct or if it has been
+ * written inside a transaction which is in progress or has been committed.
+ */
+static bool pageValid(struct BattFsSuper *disk, pgcnt_t page, struct BattFsPageHeader *hdr)
+{
+	fcs_t fcs = computeFcs(hdr);
+
+	if (hdr->fcs == fcs)
+		return true;
+
+	return (hdr->fcs == (fcs ^ PENDING_FCS_MARK))
+		&& ((disk->in_trans && page == disk->curr_page)
+			|| transPending(disk, page)
+			|| transCommitted(disk, page, hdr->fcs));
+}
+
 /**
  * Count the number of pages from
  * inode 0 to \a inode in \a filelen_table.
@@ -255,7 +427,9 @@ static void movePages(struct BattFsSuper *disk, pgcnt_t src, int offset)
 static bool countDiskFilePages(struct BattFsSuper *disk, pgoff_t *filelen_table)
 {
 	BattFsPageHeader hdr;
+	seq_t trans_seq = 0;
 	disk->free_page_start = 0;
+	disk->trans_page = PAGE_UNSET_SENTINEL;
 
 	/* Count the number of disk page per file */
 	for (pgcnt_t page = 0; page < disk->page_count; page++)
@@ -277,6 +451,35 @@ static bool countDiskFilePages(struct BattFsSuper *disk, pgoff_t *filelen_table)
 			/* Keep trace of free space */
 			disk->free_bytes -= hdr.fill;
 			disk->free_page_start++;
+
+			/* Keep trace of the newest commit record, a single page */
+			if (hdr.inode == BATTFS_TRANS_INODE && hdr.pgoff == 0
+			 && (disk->trans_page == PAGE_UNSET_SENTINEL || hdr.seq > trans_seq))
+			{
+				disk->trans_page = page;
+				trans_seq = hdr.seq;
+			}
+		}
+	}
+
+	if (!transCheck(disk))
+		return false;
+
+	/* Count pages written by committed transactions */
+	pgcnt_t trans_count = transCount(disk);
+	for (pgcnt_t i = 0; i < trans_count; i++)
+	{
+		pgcnt_t page;
+		fcs_t fcs;
+
+		if (!transEntry(disk, i, &page, &fcs) || !readHdr(disk, page, &hdr))
+			return false;
+
+		if (hdr.fcs == fcs && hdr.fcs == (computeFcs(&hdr) ^ PENDING_FCS_MARK))
+		{
+			filelen_table[hdr.inode]++;
+			disk->free_bytes -= hdr.fill;
+			disk->free_page_start++;
 		}
 	}
 	LOG_INFO("free_bytes:%d, free_page_start:%d\n", disk->free_bytes, disk->free_page_start);
@@ -309,7 +512,7 @@ static bool fillPageArray(struct BattFsSuper *disk, pgoff_t *filelen_table)
 			return false;
 
 		/* Check header FCS */
-		if (hdr.fcs == computeFcs(&hdr))
+		if (pageValid(disk, page, &hdr))
 		{
 			/* Compute array position */
 			pgcnt_t array_pos = countPages(filelen_table, hdr.inode);
@@ -327,7 +530,7 @@ static bool fillPageArray(struct BattFsSuper *disk, pgoff_t *filelen_table)
 					return false;
 
 				/* Check header FCS */
-				ASSERT(hdr_prv.fcs == computeFcs(&hdr_prv));
+				ASSERT(pageValid(disk, disk->page_array[array_pos], &hdr_prv));
 
 				/* Only the very same page with a different seq number can be here */
 				ASSERT(hdr.inode == hdr_prv.inode);
@@ -390,6 +593,36 @@ static bool fillPageArray(struct BattFsSuper *disk, pgoff_t *filelen_table)
 }
 
 
+/**
+ * Add the page in \a disk buffer to the pages saved
+ * by the current transaction.
+ * \return true if ok, false if too many pages have been saved.
+ */
+static bool transAddPage(struct BattFsSuper *disk)
+{
+	BattFsPageHeader hdr;
+	pgcnt_t i;
+
+	if (!getBufferHdr(disk, &hdr))
+		return false;
+
+	for (i = 0; i < disk->trans_count; i++)
+		if (disk->trans_pages[i].page == disk->curr_page)
+			break;
+
+	if (i >= countof(disk->trans_pages))
+	{
+		LOG_ERR("Too many pages in transaction\n");
+		return false;
+	}
+
+	disk->trans_pages[i].page = disk->curr_page;
+	disk->trans_pages[i].fcs = hdr.fcs;
+	if (i == disk->trans_count)
+		disk->trans_count++;
+	return true;
+}
+
 /**
  * Flush the current \a disk buffer.
  * \return true if ok, false on errors.
@@ -400,6 +633,13 @@ static bool flushBuffer(struct BattFsSuper *disk)
 	{
 		LOG_INFO("Flushing to disk page %d\n", disk->curr_page);
 
+		/* Read-ahead buffer content is going to be stale */
+		if (disk->readahead_page == disk->curr_page)
+			disk->readahead_len = 0;
+
+		if (disk->in_trans && !transAddPage(disk))
+			return false;
+
 		if (!(disk->erase(disk, disk->curr_page)
 			&& disk->save(disk, disk->curr_page)))
 			return false;
@@ -440,7 +680,8 @@ static bool loadPage(struct BattFsSuper *disk, pgcnt_t new_page, BattFsPageHeade
  */
 bool battfs_mount(struct BattFsSuper *disk)
 {
-	pgoff_t filelen_table[BATTFS_MAX_FILES];
+	pgoff_t local_filelen_table[BATTFS_MAX_FILES];
+	pgoff_t *filelen_table = disk->filelen_table ? disk->filelen_table : local_filelen_table;
 
 	/* Sanity check */
 	ASSERT(disk->open);
@@ -472,7 +713,12 @@ bool battfs_mount(struct BattFsSuper *disk)
 	disk->free_bytes = 0;
 	disk->disk_size = (disk_size_t)disk->data_size * disk->page_count;
 
+	disk->in_trans = false;
+	disk->trans_count = 0;
+	disk->trans_freed = 0;
+
 	/* Initialize page buffer cache */
+	disk->readahead_len = 0;
 	disk->cache_dirty = false;
 	disk->curr_page = 0;
 	disk->load(disk, disk->curr_page);
@@ -534,7 +780,7 @@ bool battfs_fsck(struct BattFsSuper *disk)
 
 		if (page < disk->free_page_start)
 		{
-			FSCHECK(computeFcs(&hdr) == hdr.fcs);
+			FSCHECK(pageValid(disk, disk->page_array[page], &hdr));
 			page_used++;
 			free_bytes -= hdr.fill;
 			if (hdr.inode != prev_hdr.inode || start)
@@ -598,9 +844,19 @@ static int battfs_fileclose(struct KFile *fd)
 }
 
 
+/**
+ * True if there are no free pages on \a disk that can be used.
+ * Pages freed during a transaction can not be reused until its
+ * commit record is written, since they hold the old copy of data.
+ * trans_freed is 0 outside transactions.
+ */
+#define TRANS_SPACE_OVER(disk) \
+	(SPACE_OVER(disk) \
+		|| (pgcnt_t)((disk)->page_count - (disk)->free_page_start) <= (disk)->trans_freed)
+
 static bool getNewPage(struct BattFsSuper *disk, pgcnt_t new_pos, inode_t inode, pgoff_t pgoff, BattFsPageHeader *new_hdr)
 {
-	if (SPACE_OVER(disk))
+	if (TRANS_SPACE_OVER(disk))
 	{
 		LOG_ERR("No disk space available!\n");
 		return false;
@@ -625,6 +881,9 @@ static bool getNewPage(struct BattFsSuper *disk, pgcnt_t new_pos, inode_t inode,
 	disk->page_array[new_pos] = disk->curr_page;
 	disk->cache_dirty = true;
 
+	if (disk->filelen_table)
+		disk->filelen_table[inode]++;
+
 	new_hdr->inode = inode;
 	new_hdr->pgoff = pgoff;
 	new_hdr->fill = 0;
@@ -632,6 +891,90 @@ static bool getNewPage(struct BattFsSuper *disk, pgcnt_t new_pos, inode_t inode,
 	return setBufferHdr(disk, new_hdr);
 }
 
+/**
+ * Move the page loaded in \a disk buffer to a free page.
+ * \a slot is the page array element of the loaded page: it is
+ * updated with the new page while the old one is freed.
+ * \a hdr is the header of the loaded page, its seq is increased.
+ * \return true if ok, false on errors.
+ */
+static bool relocatePage(struct BattFsSuper *disk, pgcnt_t *slot, BattFsPageHeader *hdr)
+{
+	/* Get a free page */
+	disk->curr_page = disk->page_array[disk->free_page_start];
+	movePages(disk, disk->free_page_start + 1, -1);
+
+	/* Insert previous page in free blocks list */
+	LOG_INFO("Setting page %d as free\n", *slot);
+	disk->page_array[disk->page_count - 1] = *slot;
+	if (disk->in_trans)
+		disk->trans_freed++;
+	/* Assign new page */
+	*slot = disk->curr_page;
+	hdr->seq++;
+	/* The new page is not on disk yet */
+	disk->cache_dirty = true;
+
+	return setBufferHdr(disk, hdr);
+}
+
+/**
+ * Prepare page \a pg_offset of file \a fdb to be modified.
+ * The page is loaded in the disk buffer and moved to a free page, with
+ * an increased seq number. This way the old copy of the page stays
+ * valid on disk until the new one has been completely written, and
+ * a power loss during the flush does not destroy data already on disk.
+ * The header of the loaded page is put in \a hdr.
+ * \return true if ok, false on errors (error is set in file errors).
+ */
+static bool rewritePage(BattFs *fdb, pgoff_t pg_offset, BattFsPageHeader *hdr)
+{
+	BattFsSuper *disk = fdb->disk;
+
+	if (TRANS_SPACE_OVER(disk))
+	{
+		LOG_ERR("No disk space available!\n");
+		fdb->errors |= BATTFS_DISK_SPACEOVER_ERR;
+		return false;
+	}
+	LOG_INFO("Re-writing page %d to %d\n", fdb->start[pg_offset], disk->page_array[disk->free_page_start]);
+	if (!loadPage(disk, fdb->start[pg_offset], hdr))
+	{
+		fdb->errors |= BATTFS_DISK_LOADPAGE_ERR;
+		return false;
+	}
+
+	return relocatePage(disk, &fdb->start[pg_offset], hdr);
+}
+
+/**
+ * Size of the zero block used to clear the disk page buffer.
+ */
+#define ZERO_BLOCK_LEN 32
+
+/**
+ * Fill \a len bytes of current \a disk page buffer with 0s, starting at \a addr.
+ * Zeros are written in blocks of ZERO_BLOCK_LEN bytes, so the
+ * number of calls to the disk driver is kept low.
+ * \return true if ok, false on errors.
+ */
+static bool zeroBuffer(struct BattFsSuper *disk, pgaddr_t addr, pgaddr_t len)
+{
+	static const uint8_t zero[ZERO_BLOCK_LEN];
+
+	while (len)
+	{
+		pgaddr_t wr_len = MIN(len, (pgaddr_t)sizeof(zero));
+
+		if (disk->bufferWrite(disk, addr, zero, wr_len) != wr_len)
+			return false;
+
+		addr += wr_len;
+		len -= wr_len;
+	}
+	return true;
+}
+
 /**
  * Write to file \a fd \a size bytes from \a buf.
  * \return The number of bytes written.
@@ -664,18 +1007,20 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 		}
 
 		/* Fill unused space of first page with 0s */
-		uint8_t dummy = 0;
 		pgaddr_t zero_bytes = MIN(fd->seek_pos - fd->size, disk->data_size - curr_hdr.fill);
-		while (zero_bytes--)
+		if (zero_bytes)
 		{
-			if (disk->bufferWrite(disk, curr_hdr.fill, &dummy, 1) != 1)
+			if (!disk->cache_dirty && !rewritePage(fdb, fdb->max_off, &curr_hdr))
+				return total_write;
+
+			if (!zeroBuffer(disk, curr_hdr.fill, zero_bytes))
 			{
 				fdb->errors |= BATTFS_DISK_BUFFERWR_ERR;
 				return total_write;
 			}
-			curr_hdr.fill++;
-			fd->size++;
-			disk->free_bytes--;
+			curr_hdr.fill += zero_bytes;
+			fd->size += zero_bytes;
+			disk->free_bytes -= zero_bytes;
 			disk->cache_dirty = true;
 		}
 		setBufferHdr(disk, &curr_hdr);
@@ -688,14 +1033,15 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 			LOG_INFO("missing pages: %d\n", missing_pages);
 			flushBuffer(disk);
 
-			/* Fill page buffer with 0 to avoid filling unused pages with garbage */
-			for (pgaddr_t off = 0; off < disk->data_size; off++)
+			/*
+			 * Fill page buffer with 0 to avoid filling unused pages with garbage.
+			 * getNewPage() only rewrites the header, so the buffer
+			 * stays zeroed for all the missing pages.
+			 */
+			if (!zeroBuffer(disk, 0, disk->data_size))
 			{
-				if (disk->bufferWrite(disk, off, &dummy, 1) != 1)
-				{
-					fdb->errors |= BATTFS_DISK_BUFFERWR_ERR;
-					return total_write;
-				}
+				fdb->errors |= BATTFS_DISK_BUFFERWR_ERR;
+				return total_write;
 			}
 
 			while (missing_pages--)
@@ -744,31 +1090,10 @@ static size_t battfs_write(struct KFile *fd, const void *_buf, size_t size)
 			fdb->max_off = pg_offset;
 		}
 		/* Handle cache load of a new page*/
-		else if (fdb->start[pg_offset] != disk->curr_page)
+		else if (fdb->start[pg_offset] != disk->curr_page || !disk->cache_dirty)
 		{
-			if (SPACE_OVER(disk))
-			{
-				LOG_ERR("No disk space available!\n");
-				fdb->errors |= BATTFS_DISK_SPACEOVER_ERR;
+			if (!rewritePage(fdb, pg_offset, &curr_hdr))
 				return total_write;
-			}
-			LOG_INFO("Re-writing page %d to %d\n", fdb->start[pg_offset], disk->page_array[disk->free_page_start]);
-			if (!loadPage(disk, fdb->start[pg_offset], &curr_hdr))
-			{
-				fdb->errors |= BATTFS_DISK_LOADPAGE_ERR;
-				return total_write;
-			}
-
-			/* Get a free page */
-			disk->curr_page = disk->page_array[disk->free_page_start];
-			movePages(disk, disk->free_page_start + 1, -1);
-
-			/* Insert previous page in free blocks list */
-			LOG_INFO("Setting page %d as free\n", fdb->start[pg_offset]);
-			disk->page_array[disk->page_count - 1] = fdb->start[pg_offset];
-			/* Assign new page */
-			fdb->start[pg_offset] = disk->curr_page;
-			curr_hdr.seq++;
 		}
 
 		//LOG_INFO("writing to buffer for page %d, offset %d, size %d\n", disk->curr_page, addr_offset, wr_len);
@@ -813,7 +1138,8 @@ static size_t battfs_read(struct KFile *fd, void *_buf, size_t size)
 	size_t total_read = 0;
 	pgoff_t pg_offset;
 	pgaddr_t addr_offset;
-	pgaddr_t read_len;
+	pgcnt_t page;
+	size_t read_len;
 
 	if (fd->seek_pos < 0)
 	{
@@ -828,21 +1154,43 @@ static size_t battfs_read(struct KFile *fd, void *_buf, size_t size)
 		pg_offset = fd->seek_pos / disk->data_size;
 		addr_offset = fd->seek_pos % disk->data_size;
 		read_len = MIN(size, (size_t)(disk->data_size - addr_offset));
+		page = fdb->start[pg_offset];
+
+		#if _DEBUG
+			/* Check page owner only when a new page is started */
+			if (addr_offset == 0 || total_read == 0)
+			{
+				BattFsPageHeader hdr;
+				readHdr(disk, page, &hdr);
+				ASSERT(hdr.inode == fdb->inode);
+			}
+		#endif
 
-		//LOG_INFO("reading from page %d, offset %d, size %d\n", fdb->start[pg_offset], addr_offset, read_len);
+		/*
+		 * Coalesce physically consecutive pages, stopping
+		 * at the one currently loaded in the page buffer.
+		 */
+		pgoff_t run = 1;
+		if (disk->readMulti && page != disk->curr_page)
+		{
+			while (read_len < size
+				&& fdb->start[pg_offset + run] == page + run
+				&& page + run != disk->curr_page)
+			{
+				read_len += MIN(size - read_len, (size_t)disk->data_size);
+				run++;
+			}
+		}
+
+		//LOG_INFO("reading %d pages from page %d, offset %d, size %d\n", run, page, addr_offset, read_len);
 		/* Read from disk */
-		if (diskRead(disk, fdb->start[pg_offset], addr_offset, buf, read_len) != read_len)
+		if ((run > 1 ? disk->readMulti(disk, page, addr_offset, buf, read_len)
+			: diskReadAhead(disk, page, addr_offset, buf, read_len)) != read_len)
 		{
 			fdb->errors |= BATTFS_DISK_READ_ERR;
 			return total_read;
 		}
 
-		#if _DEBUG
-			BattFsPageHeader hdr;
-			readHdr(disk, fdb->start[pg_offset], &hdr);
-			ASSERT(hdr.inode == fdb->inode);
-		#endif
-
 		size -= read_len;
 		fd->seek_pos += read_len;
 		total_read += read_len;
@@ -853,7 +1201,8 @@ static size_t battfs_read(struct KFile *fd, void *_buf, size_t size)
 
 
 /**
- * Search file \a inode in \a disk using a binary search.
+ * Search file \a inode in \a disk using the file length table, if
+ * available, or a binary search on page headers.
  * \a last is filled with array offset of file start
  * in disk->page_array if file is found, otherwise
  * \a last is filled with the correct insert position
@@ -865,7 +1214,14 @@ static bool findFile(BattFsSuper *disk, inode_t inode, pgcnt_t *last)
 	BattFsPageHeader hdr;
 	pgcnt_t first = 0, page;
 	*last = disk->free_page_start;
-	fcs_t fcs;
+	bool valid;
+
+	/* File positions are known, no need to read the disk */
+	if (disk->filelen_table)
+	{
+		*last = countPages(disk->filelen_table, inode);
+		return disk->filelen_table[inode] != 0;
+	}
 
 	while (first < *last)
 	{
@@ -874,17 +1230,17 @@ static bool findFile(BattFsSuper *disk, inode_t inode, pgcnt_t *last)
 		if (!readHdr(disk, disk->page_array[page], &hdr))
 			return false;
 		LOG_INFO("inode read: %d\n", hdr.inode);
-		fcs = computeFcs(&hdr);
-		if (hdr.fcs == fcs && hdr.inode == inode)
+		valid = pageValid(disk, disk->page_array[page], &hdr);
+		if (valid && hdr.inode == inode)
 		{
 			*last = page - hdr.pgoff;
 			LOG_INFO("Found: %d\n", *last);
 			return true;
 		}
-		else if (hdr.fcs == fcs && hdr.inode < inode)
+		else if (valid && hdr.inode < inode)
 			first = page + 1;
 		else
-			*last = page - 1;
+			*last = page;
 	}
 	LOG_INFO("Not found: last %d\n", *last);
 	return false;
@@ -911,9 +1267,9 @@ static file_size_t countFileSize(BattFsSuper *disk, pgcnt_t *start, inode_t inod
 
 	while (start < &disk->page_array[disk->free_page_start])
 	{
-		if (!readHdr(disk, *start++, &hdr))
+		if (!readHdr(disk, *start, &hdr))
 			return EOF;
-		if (hdr.fcs == computeFcs(&hdr) && hdr.inode == inode)
+		if (pageValid(disk, *start++, &hdr) && hdr.inode == inode)
 			size += hdr.fill;
 		else
 			break;
@@ -945,6 +1301,13 @@ bool battfs_fileopen(BattFsSuper *disk, BattFs *fd, inode_t inode, filemode_t mo
 
 	memset(fd, 0, sizeof(*fd));
 
+	if (inode >= BATTFS_TRANS_INODE && !(mode & BATTFS_SYSTEM))
+	{
+		LOG_ERR("inode %d is reserved\n", inode);
+		fd->errors |= BATTFS_RESERVED_INODE_ERR;
+		return false;
+	}
+
 	/* Search file start point in disk page array */
 	pgcnt_t start_pos;
 	if (!findFile(disk, inode, &start_pos))
@@ -1007,6 +1370,260 @@ bool battfs_fileopen(BattFsSuper *disk, BattFs *fd, inode_t inode, filemode_t mo
 }
 
 
+/**
+ * Start a transaction on \a disk.
+ *
+ * All pages written until battfs_transCommit() are saved as pending:
+ * they are ignored at mount time until the commit record listing them
+ * has been written. This way changes to one or more files become
+ * visible all together, or not at all if power is lost before commit.
+ * There is no explicit abort: umount and mount the disk again without
+ * committing and the old content of the files is back.
+ *
+ * During a transaction pages freed by rewrites are not reused, so
+ * up to CONFIG_BATTFS_TRANS_PAGES pages can be written and the disk
+ * must have enough free space to hold both copies.
+ *
+ * \return true if ok, false on errors.
+ */
+bool battfs_transBegin(struct BattFsSuper *disk)
+{
+	ASSERT(!disk->in_trans);
+
+	if (!flushBuffer(disk))
+		return false;
+
+	disk->in_trans = true;
+	disk->trans_count = 0;
+	disk->trans_freed = 0;
+	return true;
+}
+
+/**
+ * \return true if \a page is used by a file on \a disk.
+ */
+static bool pageInUse(struct BattFsSuper *disk, pgcnt_t page)
+{
+	for (pgcnt_t pos = 0; pos < disk->free_page_start; pos++)
+		if (disk->page_array[pos] == page)
+			return true;
+	return false;
+}
+
+/**
+ * \return true if the commit record entry \a page, \a fcs still refers
+ *         to a page in use on \a disk, false otherwise.
+ */
+static bool transEntryLive(struct BattFsSuper *disk, pgcnt_t page, fcs_t fcs)
+{
+	BattFsPageHeader hdr;
+
+	return pageInUse(disk, page)
+		&& readHdr(disk, page, &hdr)
+		&& hdr.fcs == fcs;
+}
+
+/**
+ * Make \a page of \a disk valid by itself, saving it again with
+ * a normal header FCS.
+ * The old copy is freed, so \a page can be removed from commit record.
+ * \return true if ok, false on errors.
+ */
+static bool sealPage(struct BattFsSuper *disk, pgcnt_t page)
+{
+	BattFsPageHeader hdr;
+	pgcnt_t pos;
+
+	for (pos = 0; pos < disk->free_page_start; pos++)
+		if (disk->page_array[pos] == page)
+			break;
+	ASSERT(pos < disk->free_page_start);
+
+	/* Pages freed by the transaction being committed are still needed */
+	if (TRANS_SPACE_OVER(disk))
+	{
+		LOG_ERR("No disk space available!\n");
+		return false;
+	}
+
+	return loadPage(disk, page, &hdr)
+		&& relocatePage(disk, &disk->page_array[pos], &hdr)
+		&& flushBuffer(disk);
+}
+
+/**
+ * Sort pages saved by current transaction on \a disk, by page number.
+ */
+static void transSort(struct BattFsSuper *disk)
+{
+	for (pgcnt_t i = 1; i < disk->trans_count; i++)
+	{
+		for (pgcnt_t j = i; j > 0 && disk->trans_pages[j - 1].page > disk->trans_pages[j].page; j--)
+			SWAP(disk->trans_pages[j - 1], disk->trans_pages[j]);
+	}
+}
+
+/**
+ * Write a commit record entry on file \a fd.
+ * \return true if ok, false on errors.
+ */
+static bool transWriteEntry(BattFs *fd, pgcnt_t page, fcs_t fcs)
+{
+	uint8_t buf[TRANS_ENTRY_LEN];
+
+	buf[0] = page;
+	buf[1] = page >> 8;
+	buf[2] = fcs;
+	buf[3] = fcs >> 8;
+
+	return kfile_write(&fd->fd, buf, TRANS_ENTRY_LEN) == TRANS_ENTRY_LEN;
+}
+
+/**
+ * Write the commit record for the pages saved by current transaction.
+ * \return true if ok, false on errors.
+ */
+static bool transWriteRecord(struct BattFsSuper *disk)
+{
+	BattFs fd;
+	pgcnt_t old_count, new_count = 0, i = 0, j = 0;
+	pgcnt_t max_entries = (disk->data_size - TRANS_HDR_LEN) / TRANS_ENTRY_LEN;
+	pgcnt_t old_page = PAGE_UNSET_SENTINEL, new_page;
+	fcs_t old_fcs = 0;
+	uint8_t buf[TRANS_HDR_LEN];
+	bool ok;
+
+	/* Drop entries of pages freed by rewrites in this transaction */
+	for (pgcnt_t k = 0; k < disk->trans_count; k++)
+		if (pageInUse(disk, disk->trans_pages[k].page))
+			disk->trans_pages[new_count++] = disk->trans_pages[k];
+	disk->trans_count = new_count;
+	transSort(disk);
+
+	/* Count entries of previous transactions still in use */
+	old_count = transCount(disk);
+	new_count = disk->trans_count;
+	for (pgcnt_t k = 0; k < old_count; k++)
+	{
+		if (!transEntry(disk, k, &old_page, &old_fcs))
+			return false;
+		if (transEntryLive(disk, old_page, old_fcs))
+			new_count++;
+	}
+
+	/* Too many entries, make old pages valid by themselves */
+	if (new_count > max_entries)
+	{
+		LOG_INFO("Commit record full, sealing pages\n");
+		for (pgcnt_t k = 0; k < old_count; k++)
+		{
+			if (!transEntry(disk, k, &old_page, &old_fcs))
+				return false;
+			if (transEntryLive(disk, old_page, old_fcs) && !sealPage(disk, old_page))
+				return false;
+		}
+		old_count = 0;
+	}
+
+	if (disk->trans_count > max_entries)
+	{
+		LOG_ERR("Too many pages in transaction\n");
+		return false;
+	}
+
+	if (!battfs_fileopen(disk, &fd, BATTFS_TRANS_INODE, BATTFS_CREATE | BATTFS_SYSTEM))
+		return false;
+
+	/*
+	 * Merge old entries with the new ones, keeping them sorted.
+	 * Old entries are read from the previous copy of the record,
+	 * which stays untouched on disk until the new copy is flushed.
+	 */
+	kfile_seek(&fd.fd, TRANS_HDR_LEN, KSM_SEEK_SET);
+	new_count = 0;
+	old_page = PAGE_UNSET_SENTINEL;
+	ok = true;
+	while (ok && (i < old_count || j < disk->trans_count))
+	{
+		if (old_page == PAGE_UNSET_SENTINEL && i < old_count)
+		{
+			if (!transEntry(disk, i++, &old_page, &old_fcs))
+			{
+				ok = false;
+				break;
+			}
+			if (!transEntryLive(disk, old_page, old_fcs))
+			{
+				old_page = PAGE_UNSET_SENTINEL;
+				continue;
+			}
+		}
+
+		if (j < disk->trans_count && disk->trans_pages[j].page <= old_page)
+		{
+			/* Page reused by this transaction, old entry is stale */
+			if (disk->trans_pages[j].page == old_page)
+				old_page = PAGE_UNSET_SENTINEL;
+			new_page = disk->trans_pages[j].page;
+			ok = transWriteEntry(&fd, new_page, disk->trans_pages[j++].fcs);
+		}
+		else if (old_page != PAGE_UNSET_SENTINEL)
+		{
+			ok = transWriteEntry(&fd, old_page, old_fcs);
+			old_page = PAGE_UNSET_SENTINEL;
+		}
+		else
+			continue;
+		new_count++;
+	}
+
+	/* Write the number of entries */
+	buf[0] = new_count;
+	buf[1] = new_count >> 8;
+	kfile_seek(&fd.fd, 0, KSM_SEEK_SET);
+	ok = ok && kfile_write(&fd.fd, buf, TRANS_HDR_LEN) == TRANS_HDR_LEN;
+
+	/* Commit record is saved here */
+	if (kfile_close(&fd.fd) || !ok)
+		return false;
+
+	disk->trans_page = fd.start[0];
+	LOG_INFO("Transaction committed, %d pages\n", new_count);
+	return true;
+}
+
+/**
+ * Commit current transaction on \a disk.
+ *
+ * The commit record is a single page file: it lists the pending pages
+ * of this transaction together with the ones of previous transactions
+ * still in use. Rewriting it is atomic, since the new copy of the page
+ * takes over the old one only when completely saved.
+ * If the record is too small to hold all the entries, pages of previous
+ * transactions are sealed (saved again with a normal FCS) and dropped.
+ *
+ * \return true if ok, false on errors. In this case the transaction
+ *         is not committed.
+ */
+bool battfs_transCommit(struct BattFsSuper *disk)
+{
+	ASSERT(disk->in_trans);
+
+	if (!flushBuffer(disk))
+		return false;
+	/* Commit record is written outside the transaction */
+	disk->in_trans = false;
+	if (!transWriteRecord(disk))
+	{
+		/* Transaction is still open, commit can be retried */
+		disk->in_trans = true;
+		return false;
+	}
+	disk->trans_count = 0;
+	disk->trans_freed = 0;
+	return true;
+}
+
 /**
  * Umount \a disk.
  */
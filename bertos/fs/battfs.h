@@ -41,6 +41,8 @@
 #ifndef FS_BATTFS_H
 #define FS_BATTFS_H
 
+#include "cfg/cfg_battfs.h"
+
 #include <cfg/compiler.h> // uintXX_t; STATIC_ASSERT
 #include <cpu/types.h> // CPU_BITS_PER_CHAR
 #include <algo/rotating_hash.h>
@@ -102,6 +104,21 @@ typedef struct BattFsPageHeader
  */
 #define BATTFS_MAX_FILES (1 << (CPU_BITS_PER_CHAR * sizeof(inode_t)))
 
+/**
+ * Inode reserved to the transaction commit record.
+ * \see battfs_transBegin
+ */
+#define BATTFS_TRANS_INODE (BATTFS_MAX_FILES - 2)
+
+/*
+ * Inodes from BATTFS_TRANS_INODE up are reserved to the filesystem
+ * and can not be opened as ordinary files.
+ * Disk images written by older versions with files on these inodes
+ * are not compatible: the first page of inode BATTFS_TRANS_INODE is
+ * taken as a commit record (and ignored by mount if it does not look
+ * like one), and the files can not be opened any more.
+ */
+
 /* Fwd decl */
 struct BattFsSuper;
 
@@ -124,6 +141,18 @@ typedef bool (*disk_open_t) (struct BattFsSuper *d);
  */
 typedef size_t (*disk_page_read_t) (struct BattFsSuper *d, pgcnt_t page, pgaddr_t addr, void *buf, size_t);
 
+/**
+ * Type interface for disk multi page read function.
+ * Read \a size bytes starting at address \a addr inside \a page,
+ * continuing on the physically following pages when the end of
+ * page data is reached.
+ * Page headers must be skipped: only data_size bytes of each page
+ * are copied in \a buf.
+ * This allows memories with a continuous read command to
+ * read several pages issuing only one command.
+ * \return the number of bytes read.
+ */
+typedef size_t (*disk_multi_read_t) (struct BattFsSuper *d, pgcnt_t page, pgaddr_t addr, void *buf, size_t);
 
 /**
  * Type interface for disk page load function.
@@ -185,6 +214,7 @@ typedef struct BattFsSuper
 {
 	disk_open_t open;        ///< Disk init.
 	disk_page_read_t  read;  ///< Page read.
+	disk_multi_read_t readMulti; ///< Consecutive pages read, optional (NULL if not supported).
 	disk_page_load_t  load;  ///< Page load.
 	disk_buffer_write_t bufferWrite; ///< Buffer write.
 	disk_buffer_read_t bufferRead; ///< Buffer read.
@@ -204,9 +234,31 @@ typedef struct BattFsSuper
 	 * the entire disk in memory.
 	 */
 	pgcnt_t *page_array;
+
+	/**
+	 * File length table (optional).
+	 * If not NULL, must have space for BATTFS_MAX_FILES elements.
+	 * Element i is the number of pages used by file with inode i:
+	 * this keeps in RAM the position of every file in page_array,
+	 * so files are searched without reading the disk.
+	 * If NULL, files are searched with a binary search on page headers.
+	 */
+	pgoff_t *filelen_table;
 	pgcnt_t curr_page;  ///< Current page loaded in disk buffer.
 	bool cache_dirty;   ///< True if current cache is dirty (nneds to be flushed).
 
+	/**
+	 * Read-ahead buffer.
+	 * If not NULL, small reads are served from this buffer,
+	 * which is filled reading readahead_size bytes at once from the disk.
+	 * Set to NULL to disable read-ahead.
+	 */
+	uint8_t *readahead_buf;
+	pgaddr_t readahead_size; ///< Size of read-ahead buffer, in bytes.
+	pgcnt_t readahead_page;  ///< Page currently held in read-ahead buffer.
+	pgaddr_t readahead_addr; ///< Address inside readahead_page of the first byte in read-ahead buffer.
+	pgaddr_t readahead_len;  ///< Valid bytes in read-ahead buffer, 0 if buffer is invalid.
+
 	/**
 	 * Lowest address, in page array, for free pages.
 	 * Pages above this element are free for use.
@@ -217,6 +269,20 @@ typedef struct BattFsSuper
 	disk_size_t free_bytes;  ///< Free space on the disk.
 
 	List file_opened_list;       ///< List used to keep trace of open files.
+
+	bool in_trans;               ///< True if a transaction is in progress.
+	pgcnt_t trans_page;          ///< Page of the last commit record, PAGE_UNSET_SENTINEL if none.
+	pgcnt_t trans_freed;         ///< Pages freed by the current transaction.
+	pgcnt_t trans_count;         ///< Pages saved by the current transaction.
+
+	/**
+	 * Pages saved by the current transaction, with their header FCS.
+	 */
+	struct
+	{
+		pgcnt_t page;
+		fcs_t fcs;
+	} trans_pages[CONFIG_BATTFS_TRANS_PAGES];
 	/* TODO add other fields. */
 } BattFsSuper;
 
@@ -235,6 +301,7 @@ typedef int32_t file_size_t; ///< Type for file sizes.
 #define BATTFS_CREATE BV(0)  ///< Create file if does not exist
 #define BATTFS_RD     BV(1)  ///< Open file for reading
 #define BATTFS_WR     BV(2)  ///< Open file fir writing
+#define BATTFS_SYSTEM BV(3)  ///< Allow opening reserved inodes (internal use)
 /*/}*/
 
 
@@ -251,6 +318,7 @@ typedef int32_t file_size_t; ///< Type for file sizes.
 #define BATTFS_DISK_SPACEOVER_ERR  BV(7) ///< No more disk space available.
 #define BATTFS_DISK_FLUSHBUF_ERR   BV(8) ///< Error flushing (writing) the current page to disk.
 #define BATTFS_FILE_NOT_FOUND_ERR  BV(9) ///< File not found on disk.
+#define BATTFS_RESERVED_INODE_ERR  BV(10) ///< Inode reserved to the filesystem.
 /*/}*/
 
 /**
@@ -289,5 +357,7 @@ bool battfs_umount(struct BattFsSuper *disk);
 
 bool battfs_fileExists(BattFsSuper *disk, inode_t inode);
 bool battfs_fileopen(BattFsSuper *disk, BattFs *fd, inode_t inode, filemode_t mode);
+bool battfs_transBegin(struct BattFsSuper *disk);
+bool battfs_transCommit(struct BattFsSuper *disk);
 bool battfs_writeTestBlock(struct BattFsSuper *disk, pgcnt_t page, inode_t inode, seq_t seq, fill_t fill, pgoff_t pgoff);
 #endif /* FS_BATTFS_H */
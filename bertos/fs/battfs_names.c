@@ -0,0 +1,228 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \brief BattFS file names (implementation).
+ *
+ * \version $Id$
+ *
+ * \author Francesco Sacchi <batt@develer.com>
+ *
+ */
+
+#include "battfs_names.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN */
+
+#define LOG_LEVEL       LOG_LVL_INFO
+#define LOG_FORMAT      LOG_FMT_VERBOSE
+#include <cfg/log.h>
+
+#include <string.h> /* memset, strlen, strncpy */
+
+STATIC_ASSERT(sizeof(inode_t) == 1);
+
+/**
+ * Hook used by the hash table to get the key of a name.
+ */
+static const void *names_getKey(const void *data, uint8_t *key_length)
+{
+	const BattFsName *n = (const BattFsName *)data;
+
+	*key_length = strlen(n->name);
+	return n->name;
+}
+
+/**
+ * Insert name \a name for file \a inode in RAM cache.
+ * \return true if ok, false if cache is full.
+ */
+static bool names_insert(BattFsNames *names, const char *name, inode_t inode)
+{
+	if (names->count >= countof(names->names))
+	{
+		LOG_ERR("Names cache full\n");
+		return false;
+	}
+
+	BattFsName *n = &names->names[names->count];
+	strncpy(n->name, name, CONFIG_BATTFS_NAME_LEN);
+	n->name[CONFIG_BATTFS_NAME_LEN] = '\0';
+	n->inode = inode;
+
+	if (!ht_insert(&names->table, n))
+		return false;
+
+	names->count++;
+	return true;
+}
+
+/**
+ * Load the file name table of \a disk in \a names.
+ * \a disk must be already mounted.
+ * \return true if ok, false on errors.
+ */
+bool battfs_namesLoad(BattFsSuper *disk, BattFsNames *names)
+{
+	BattFs fd;
+	uint8_t rec[BATTFS_NAME_RECORD_LEN];
+	char name[CONFIG_BATTFS_NAME_LEN + 1];
+
+	names->disk = disk;
+	names->count = 0;
+	names->table.mem = names->nodes;
+	names->table.max_elts_log2 = UINT32_LOG2(countof(names->nodes));
+	names->table.flags.key_internal = false;
+	names->table.key_data.hook = names_getKey;
+	ht_init(&names->table);
+
+	/* No names yet */
+	if (!battfs_fileExists(disk, BATTFS_NAMES_INODE))
+		return true;
+
+	if (!battfs_fileopen(disk, &fd, BATTFS_NAMES_INODE, BATTFS_RD | BATTFS_SYSTEM))
+		return false;
+
+	while (kfile_read(&fd.fd, rec, sizeof(rec)) == sizeof(rec))
+	{
+		memcpy(name, &rec[sizeof(inode_t)], CONFIG_BATTFS_NAME_LEN);
+		name[CONFIG_BATTFS_NAME_LEN] = '\0';
+
+		if (!names_insert(names, name, rec[0]))
+		{
+			kfile_close(&fd.fd);
+			return false;
+		}
+	}
+
+	return kfile_error(&fd.fd) == 0 && kfile_close(&fd.fd) == 0;
+}
+
+/**
+ * Search file \a name.
+ * The search is done only in RAM.
+ * \return true if found, and inode is put in \a inode, false otherwise.
+ */
+bool battfs_lookup(BattFsNames *names, const char *name, inode_t *inode)
+{
+	const BattFsName *n = (const BattFsName *)ht_find(&names->table, name,
+		MIN(strlen(name), (size_t)CONFIG_BATTFS_NAME_LEN));
+
+	if (!n)
+		return false;
+
+	*inode = n->inode;
+	return true;
+}
+
+/**
+ * Find a free inode for a new file.
+ * \return true if found, false if all inodes are in use.
+ */
+static bool names_freeInode(BattFsNames *names, inode_t *inode)
+{
+	/* Inodes from BATTFS_TRANS_INODE up are reserved */
+	for (unsigned i = 0; i < BATTFS_TRANS_INODE; i++)
+	{
+		bool used = battfs_fileExists(names->disk, i);
+
+		for (size_t j = 0; !used && j < names->count; j++)
+			used = (names->names[j].inode == i);
+
+		if (!used)
+		{
+			*inode = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Add a name record for \a name to the name table on disk.
+ * \return true if ok, false on errors.
+ */
+static bool names_save(BattFsNames *names, const char *name, inode_t inode)
+{
+	BattFs fd;
+	uint8_t rec[BATTFS_NAME_RECORD_LEN];
+
+	memset(rec, 0, sizeof(rec));
+	rec[0] = inode;
+	memcpy(&rec[sizeof(inode_t)], name, MIN(strlen(name), (size_t)CONFIG_BATTFS_NAME_LEN));
+
+	if (!battfs_fileopen(names->disk, &fd, BATTFS_NAMES_INODE, BATTFS_CREATE | BATTFS_WR | BATTFS_SYSTEM))
+		return false;
+
+	kfile_seek(&fd.fd, 0, KSM_SEEK_END);
+	if (kfile_write(&fd.fd, rec, sizeof(rec)) != sizeof(rec))
+	{
+		kfile_close(&fd.fd);
+		return false;
+	}
+	return kfile_close(&fd.fd) == 0;
+}
+
+/**
+ * Open file \a name in \a mode.
+ * If the file does not exist and \a mode contains BATTFS_CREATE,
+ * a free inode is assigned to \a name and the file is created.
+ * Names longer than CONFIG_BATTFS_NAME_LEN are truncated.
+ * File context is stored in \a fd.
+ * \return true if ok, false otherwise.
+ */
+bool battfs_fileopenName(BattFsNames *names, BattFs *fd, const char *name, filemode_t mode)
+{
+	inode_t inode;
+
+	if (!battfs_lookup(names, name, &inode))
+	{
+		if (!(mode & BATTFS_CREATE))
+		{
+			LOG_INFO("file %s not found\n", name);
+			memset(fd, 0, sizeof(*fd));
+			fd->errors = BATTFS_FILE_NOT_FOUND_ERR;
+			return false;
+		}
+
+		if (names->count >= countof(names->names)
+		 || !names_freeInode(names, &inode)
+		 || !names_save(names, name, inode)
+		 || !names_insert(names, name, inode))
+		{
+			LOG_ERR("unable to create file %s\n", name);
+			return false;
+		}
+	}
+
+	return battfs_fileopen(names->disk, fd, inode, mode);
+}
@@ -0,0 +1,93 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ *
+ * -->
+ *
+ * \version $Id$
+ *
+ * \author Francesco Sacchi <batt@develer.com>
+ *
+ * \brief BattFS file names (interface).
+ *
+ * A simple namespace on top of BattFS inodes.
+ * File names are stored in a reserved file (inode BATTFS_NAMES_INODE),
+ * as an array of fixed length records: one byte for the inode followed
+ * by the name, padded with 0s up to CONFIG_BATTFS_NAME_LEN bytes.
+ * At mount the whole table is loaded in RAM and indexed with a hash
+ * table, so names are resolved without accessing the disk.
+ *
+ * Names can be added but not removed, since BattFS does not support
+ * file deletion.
+ */
+
+#ifndef FS_BATTFS_NAMES_H
+#define FS_BATTFS_NAMES_H
+
+#include "cfg/cfg_battfs.h"
+
+#include <fs/battfs.h>
+#include <struct/hashtable.h>
+
+/**
+ * Inode reserved to the file name table.
+ */
+#define BATTFS_NAMES_INODE (BATTFS_MAX_FILES - 1)
+
+/**
+ * Size of a file name record once saved on disk.
+ */
+#define BATTFS_NAME_RECORD_LEN (sizeof(inode_t) + CONFIG_BATTFS_NAME_LEN)
+
+/**
+ * A file name, as cached in RAM.
+ */
+typedef struct BattFsName
+{
+	char name[CONFIG_BATTFS_NAME_LEN + 1]; ///< Name, null terminated.
+	inode_t inode;                         ///< Inode of the file.
+} BattFsName;
+
+/**
+ * File name table of a disk.
+ */
+typedef struct BattFsNames
+{
+	BattFsSuper *disk;                          ///< Disk the names belong to.
+	struct HashTable table;                     ///< Index of names.
+	const void *nodes[CONFIG_BATTFS_NAMES * 2]; ///< Hash table buckets.
+	BattFsName names[CONFIG_BATTFS_NAMES];      ///< Names cache.
+	size_t count;                               ///< Number of names in cache.
+} BattFsNames;
+
+bool battfs_namesLoad(BattFsSuper *disk, BattFsNames *names);
+bool battfs_lookup(BattFsNames *names, const char *name, inode_t *inode);
+bool battfs_fileopenName(BattFsNames *names, BattFs *fd, const char *name, filemode_t mode);
+
+#endif /* FS_BATTFS_NAMES_H */
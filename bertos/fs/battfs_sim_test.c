@@ -0,0 +1,710 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief BattFS hosted simulator, benchmarks and power loss test.
+ *
+ * The disk is simulated in RAM. Every disk operation is counted and
+ * the time the real memory would spend on it is accounted, using
+ * timings similar to the DataFlash and Flash25 memories.
+ * The simulated disk can also lose power during any erase or save
+ * operation, leaving the page only partially written.
+ *
+ * Benchmark results are printed on stdout one per line, in
+ * a format easy to parse with scripts:
+ * \code
+ * BENCH scenario=<name> model=<name> key=value ...
+ * \endcode
+ * The disk image can be saved to a file for post-mortem analysis
+ * setting the BATTFS_SIM_IMAGE environment variable.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include <fs/battfs.h>
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if UNIT_TEST
+
+#define SIM_DISK_SIZE      65536UL ///< Simulated disk size, in bytes.
+#define SIM_MAX_PAGE_SIZE  264     ///< Greatest page size of simulated memories.
+#define SIM_MAX_PAGES      (SIM_DISK_SIZE / 256)
+
+#define RECORD_LEN  32      ///< Length of records written by benchmarks.
+#define LOG_SIZE    16384L  ///< Size of files written by benchmarks.
+
+/**
+ * Simulated memory timings.
+ * Values are typical timings taken from datasheets, with a 8MHz SPI bus.
+ */
+typedef struct SimTiming
+{
+	const char *name;
+	pgaddr_t page_size;
+	bool chip_buffer;   ///< True if the page buffer is inside the memory chip.
+	uint32_t cmd_us;    ///< Command overhead of every operation.
+	uint32_t byte_ns;   ///< Time to transfer one byte on the bus.
+	uint32_t load_us;   ///< Memory page to buffer transfer.
+	uint32_t save_us;   ///< Page program.
+	uint32_t erase_us;  ///< Page erase.
+} SimTiming;
+
+static const SimTiming sim_timings[] =
+{
+	/* AT45DB041 DataFlash, internal SRAM buffer */
+	{ "dataflash", 264, true,  5, 1000, 200, 3000, 15000 },
+	/* AT25F2048 serial flash, page buffer in RAM */
+	{ "flash25",   256, false, 5, 1000, 0,   2500, 60000 },
+};
+
+/**
+ * Disk operation statistics.
+ */
+typedef struct SimStats
+{
+	unsigned long read;
+	unsigned long multi_read;
+	unsigned long read_bytes;
+	unsigned long load;
+	unsigned long save;
+	unsigned long erase;
+	unsigned long buffer_ops;
+	uint64_t time_ns;
+} SimStats;
+
+static struct
+{
+	const SimTiming *timing;
+	SimStats stats;
+
+	/*
+	 * Number of erase/save operations before the power is lost,
+	 * -1 if power loss is disabled.
+	 */
+	long power_countdown;
+	jmp_buf power_lost;
+
+	uint8_t image[SIM_DISK_SIZE];
+	uint8_t buffer[SIM_MAX_PAGE_SIZE];
+	pgcnt_t page_array[SIM_MAX_PAGES];
+} sim;
+
+static void sim_account(size_t bytes, uint32_t op_us)
+{
+	sim.stats.time_ns += (uint64_t)(sim.timing->cmd_us + op_us) * 1000
+		+ (uint64_t)bytes * sim.timing->byte_ns;
+}
+
+/**
+ * Check if power has to be lost during current operation.
+ * \return the number of bytes to be written before losing power,
+ *         -1 if the power is still up.
+ */
+static int sim_powerLoss(struct BattFsSuper *d)
+{
+	if (sim.power_countdown < 0)
+		return -1;
+
+	if (sim.power_countdown-- == 0)
+		return (sim.stats.save * 31 + sim.stats.erase * 17) % d->page_size;
+
+	return -1;
+}
+
+static uint8_t *sim_page(struct BattFsSuper *d, pgcnt_t page)
+{
+	ASSERT(page < d->page_count);
+	return &sim.image[(size_t)page * d->page_size];
+}
+
+static bool sim_open(struct BattFsSuper *d)
+{
+	d->page_size = sim.timing->page_size;
+	d->page_count = SIM_DISK_SIZE / d->page_size;
+	d->page_array = sim.page_array;
+	return true;
+}
+
+static size_t sim_read(struct BattFsSuper *d, pgcnt_t page, pgaddr_t addr, void *buf, size_t size)
+{
+	ASSERT(addr + size <= d->page_size);
+	sim.stats.read++;
+	sim.stats.read_bytes += size;
+	sim_account(size, 0);
+
+	memcpy(buf, sim_page(d, page) + addr, size);
+	return size;
+}
+
+static size_t sim_readMulti(struct BattFsSuper *d, pgcnt_t page, pgaddr_t addr, void *_buf, size_t size)
+{
+	uint8_t *buf = (uint8_t *)_buf;
+	size_t bus_bytes = 0;
+	size_t total = 0;
+
+	sim.stats.multi_read++;
+	while (size)
+	{
+		size_t len = MIN(size, (size_t)(d->data_size - addr));
+
+		memcpy(buf, sim_page(d, page) + addr, len);
+		buf += len;
+		total += len;
+		size -= len;
+		/* Headers are clocked out too, and discarded */
+		bus_bytes += len + (size ? BATTFS_HEADER_LEN : 0);
+		addr = 0;
+		page++;
+	}
+	sim.stats.read_bytes += total;
+	sim_account(bus_bytes, 0);
+	return total;
+}
+
+static bool sim_load(struct BattFsSuper *d, pgcnt_t page)
+{
+	sim.stats.load++;
+	sim_account(sim.timing->chip_buffer ? 0 : d->page_size, sim.timing->load_us);
+
+	memcpy(sim.buffer, sim_page(d, page), d->page_size);
+	return true;
+}
+
+static size_t sim_bufferWrite(struct BattFsSuper *d, pgaddr_t addr, const void *buf, size_t size)
+{
+	ASSERT(addr + size <= d->page_size);
+	sim.stats.buffer_ops++;
+	if (sim.timing->chip_buffer)
+		sim_account(size, 0);
+
+	memcpy(&sim.buffer[addr], buf, size);
+	return size;
+}
+
+static size_t sim_bufferRead(struct BattFsSuper *d, pgaddr_t addr, void *buf, size_t size)
+{
+	ASSERT(addr + size <= d->page_size);
+	sim.stats.buffer_ops++;
+	if (sim.timing->chip_buffer)
+		sim_account(size, 0);
+
+	memcpy(buf, &sim.buffer[addr], size);
+	return size;
+}
+
+static bool sim_save(struct BattFsSuper *d, pgcnt_t page)
+{
+	int partial = sim_powerLoss(d);
+
+	if (partial >= 0)
+	{
+		memcpy(sim_page(d, page), sim.buffer, partial);
+		longjmp(sim.power_lost, 1);
+	}
+
+	sim.stats.save++;
+	sim_account(sim.timing->chip_buffer ? 0 : d->page_size, sim.timing->save_us);
+
+	memcpy(sim_page(d, page), sim.buffer, d->page_size);
+	return true;
+}
+
+static bool sim_erase(struct BattFsSuper *d, pgcnt_t page)
+{
+	int partial = sim_powerLoss(d);
+
+	if (partial >= 0)
+	{
+		memset(sim_page(d, page), 0xff, partial);
+		longjmp(sim.power_lost, 1);
+	}
+
+	sim.stats.erase++;
+	sim_account(0, sim.timing->erase_us);
+
+	memset(sim_page(d, page), 0xff, d->page_size);
+	return true;
+}
+
+static bool sim_close(UNUSED_ARG(struct BattFsSuper *, d))
+{
+	const char *name = getenv("BATTFS_SIM_IMAGE");
+
+	if (name)
+	{
+		FILE *fpt = fopen(name, "wb");
+		if (fpt)
+		{
+			fwrite(sim.image, 1, sizeof(sim.image), fpt);
+			fclose(fpt);
+		}
+	}
+	return true;
+}
+
+static void sim_init(BattFsSuper *disk, const SimTiming *timing)
+{
+	memset(disk, 0, sizeof(*disk));
+	disk->open = sim_open;
+	disk->read = sim_read;
+	disk->readMulti = sim_readMulti;
+	disk->load = sim_load;
+	disk->bufferWrite = sim_bufferWrite;
+	disk->bufferRead = sim_bufferRead;
+	disk->save = sim_save;
+	disk->erase = sim_erase;
+	disk->close = sim_close;
+
+	sim.timing = timing;
+	sim.power_countdown = -1;
+	memset(sim.image, 0xff, sizeof(sim.image));
+}
+
+static void sim_resetStats(void)
+{
+	memset(&sim.stats, 0, sizeof(sim.stats));
+}
+
+static void sim_report(const char *scenario, unsigned long bytes)
+{
+	unsigned long time_us = sim.stats.time_ns / 1000;
+
+	printf("BENCH scenario=%s model=%s bytes=%lu read=%lu multi_read=%lu read_bytes=%lu "
+		"load=%lu save=%lu erase=%lu buffer_ops=%lu time_us=%lu bytes_per_s=%lu\n",
+		scenario, sim.timing->name, bytes,
+		sim.stats.read, sim.stats.multi_read, sim.stats.read_bytes,
+		sim.stats.load, sim.stats.save, sim.stats.erase, sim.stats.buffer_ops,
+		time_us, time_us ? (unsigned long)((uint64_t)bytes * 1000000 / time_us) : 0);
+}
+
+/**
+ * Expected content of file \a inode at offset \a off.
+ */
+static uint8_t pattern(inode_t inode, kfile_off_t off)
+{
+	return (uint8_t)(off * 13 + (off >> 8) + inode * 71);
+}
+
+static void fillRecord(uint8_t *rec, inode_t inode, kfile_off_t off, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		rec[i] = pattern(inode, off + i);
+}
+
+/**
+ * Check that the first \a size bytes of file \a inode follow the pattern.
+ */
+static bool checkFile(BattFsSuper *disk, inode_t inode, kfile_off_t size)
+{
+	BattFs fd;
+	uint8_t buf[RECORD_LEN * 4];
+	bool ok;
+
+	if (!battfs_fileopen(disk, &fd, inode, 0))
+		return false;
+
+	ok = (fd.fd.size >= size);
+	for (kfile_off_t off = 0; ok && off < size; off += sizeof(buf))
+	{
+		size_t len = MIN((kfile_off_t)sizeof(buf), size - off);
+
+		ok = (kfile_read(&fd.fd, buf, len) == len);
+		for (size_t i = 0; ok && i < len; i++)
+			ok = (buf[i] == pattern(inode, off + i));
+	}
+	return (kfile_close(&fd.fd) == 0) && ok;
+}
+
+/**
+ * Append \a size bytes of records to file \a inode, flushing after each record.
+ */
+static bool appendLog(BattFsSuper *disk, inode_t inode, kfile_off_t size, volatile kfile_off_t *committed)
+{
+	BattFs fd;
+	uint8_t rec[RECORD_LEN];
+
+	if (!battfs_fileopen(disk, &fd, inode, BATTFS_CREATE))
+		return false;
+
+	for (kfile_off_t off = 0; off < size; off += RECORD_LEN)
+	{
+		fillRecord(rec, inode, off, RECORD_LEN);
+		if (kfile_write(&fd.fd, rec, RECORD_LEN) != RECORD_LEN
+		 || kfile_flush(&fd.fd) != 0)
+			return false;
+		if (committed)
+			*committed = off + RECORD_LEN;
+	}
+	return kfile_close(&fd.fd) == 0;
+}
+
+static void benchAppend(BattFsSuper *disk)
+{
+	ASSERT(battfs_mount(disk));
+	sim_resetStats();
+	ASSERT(appendLog(disk, 1, LOG_SIZE, NULL));
+	sim_report("append", LOG_SIZE);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(checkFile(disk, 1, LOG_SIZE));
+	ASSERT(battfs_umount(disk));
+}
+
+static void benchRewrite(BattFsSuper *disk)
+{
+	BattFs fd;
+	uint8_t rec[RECORD_LEN];
+	uint32_t rnd = 12345;
+	const int REWRITES = 256;
+
+	ASSERT(battfs_mount(disk));
+	ASSERT(checkFile(disk, 1, LOG_SIZE));
+	ASSERT(battfs_fileopen(disk, &fd, 1, 0));
+
+	sim_resetStats();
+	for (int i = 0; i < REWRITES; i++)
+	{
+		rnd = rnd * 1103515245 + 12345;
+		kfile_off_t off = ((rnd >> 8) % (LOG_SIZE / RECORD_LEN)) * RECORD_LEN;
+
+		fillRecord(rec, 1, off, RECORD_LEN);
+		ASSERT(kfile_seek(&fd.fd, off, KSM_SEEK_SET) == off);
+		ASSERT(kfile_write(&fd.fd, rec, RECORD_LEN) == RECORD_LEN);
+		ASSERT(kfile_flush(&fd.fd) == 0);
+	}
+	sim_report("rewrite", (unsigned long)REWRITES * RECORD_LEN);
+
+	ASSERT(kfile_close(&fd.fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(checkFile(disk, 1, LOG_SIZE));
+	ASSERT(battfs_umount(disk));
+}
+
+static void benchMount(BattFsSuper *disk)
+{
+	sim_resetStats();
+	ASSERT(battfs_mount(disk));
+	sim_report("mount", 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+}
+
+static void benchInterleave(BattFsSuper *disk)
+{
+	#define INTERLEAVE_FILES 4
+	BattFs fd[INTERLEAVE_FILES];
+	uint8_t rec[RECORD_LEN];
+	const kfile_off_t size = LOG_SIZE / INTERLEAVE_FILES;
+
+	memset(sim.image, 0xff, sizeof(sim.image));
+	ASSERT(battfs_mount(disk));
+	for (inode_t i = 0; i < INTERLEAVE_FILES; i++)
+		ASSERT(battfs_fileopen(disk, &fd[i], i + 2, BATTFS_CREATE));
+
+	sim_resetStats();
+	for (kfile_off_t off = 0; off < size; off += RECORD_LEN)
+	{
+		for (inode_t i = 0; i < INTERLEAVE_FILES; i++)
+		{
+			fillRecord(rec, i + 2, off, RECORD_LEN);
+			ASSERT(kfile_write(&fd[i].fd, rec, RECORD_LEN) == RECORD_LEN);
+			ASSERT(kfile_flush(&fd[i].fd) == 0);
+		}
+	}
+	sim_report("interleave", (unsigned long)size * INTERLEAVE_FILES);
+
+	for (inode_t i = 0; i < INTERLEAVE_FILES; i++)
+		ASSERT(kfile_close(&fd[i].fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	for (inode_t i = 0; i < INTERLEAVE_FILES; i++)
+		ASSERT(checkFile(disk, i + 2, size));
+	ASSERT(battfs_umount(disk));
+	#undef INTERLEAVE_FILES
+}
+
+static void benchRead(BattFsSuper *disk)
+{
+	BattFs fd;
+	static uint8_t buf[LOG_SIZE];
+
+	memset(sim.image, 0xff, sizeof(sim.image));
+	ASSERT(battfs_mount(disk));
+	ASSERT(appendLog(disk, 1, LOG_SIZE, NULL));
+	ASSERT(battfs_fileopen(disk, &fd, 1, 0));
+
+	sim_resetStats();
+	ASSERT(kfile_read(&fd.fd, buf, sizeof(buf)) == sizeof(buf));
+	sim_report("read", LOG_SIZE);
+
+	for (kfile_off_t off = 0; off < LOG_SIZE; off++)
+		ASSERT(buf[off] == pattern(1, off));
+
+	ASSERT(kfile_close(&fd.fd) == 0);
+	ASSERT(battfs_umount(disk));
+}
+
+/**
+ * Run the append scenario losing power at every erase/save operation,
+ * in turn. After each power loss the disk is mounted again and every
+ * record committed with a flush must be found intact.
+ */
+static void powerLoss(BattFsSuper *disk)
+{
+	const kfile_off_t size = 2048;
+	volatile long points = 0;
+	volatile long failures = 0;
+	volatile kfile_off_t committed;
+
+	/* Count the number of erase/save operations of the scenario */
+	memset(sim.image, 0xff, sizeof(sim.image));
+	ASSERT(battfs_mount(disk));
+	sim_resetStats();
+	ASSERT(appendLog(disk, 1, size, NULL));
+	ASSERT(battfs_umount(disk));
+	points = sim.stats.erase + sim.stats.save;
+
+	for (long point = 0; point < points; point++)
+	{
+		memset(sim.image, 0xff, sizeof(sim.image));
+		committed = 0;
+
+		if (setjmp(sim.power_lost) == 0)
+		{
+			ASSERT(battfs_mount(disk));
+			sim_resetStats();
+			sim.power_countdown = point;
+			appendLog(disk, 1, size, &committed);
+			/* Power loss must happen before the end of the scenario */
+			ASSERT(0);
+		}
+		sim.power_countdown = -1;
+
+		/* Reboot */
+		if (!battfs_mount(disk)
+		 || !battfs_fsck(disk)
+		 || (committed && !checkFile(disk, 1, committed)))
+		{
+			printf("Power loss at operation %ld: committed %ld bytes lost\n", point, (long)committed);
+			failures++;
+		}
+		battfs_umount(disk);
+	}
+
+	printf("BENCH scenario=powerloss model=%s points=%ld failures=%ld\n",
+		sim.timing->name, (long)points, (long)failures);
+	ASSERT(failures == 0);
+}
+
+/**
+ * Size of the files updated inside a transaction.
+ */
+#define TRANS_FILE_SIZE 600
+
+/**
+ * Write file \a inode with the pattern xored with \a gen.
+ */
+static bool writeGen(BattFsSuper *disk, inode_t inode, uint8_t gen)
+{
+	BattFs fd;
+	uint8_t rec[RECORD_LEN];
+
+	if (!battfs_fileopen(disk, &fd, inode, BATTFS_CREATE))
+		return false;
+
+	for (kfile_off_t off = 0; off < TRANS_FILE_SIZE; off += RECORD_LEN)
+	{
+		size_t len = MIN((kfile_off_t)RECORD_LEN, TRANS_FILE_SIZE - off);
+
+		fillRecord(rec, inode, off, len);
+		for (size_t i = 0; i < len; i++)
+			rec[i] ^= gen;
+		if (kfile_write(&fd.fd, rec, len) != len)
+			return false;
+	}
+	return kfile_close(&fd.fd) == 0;
+}
+
+/**
+ * Read the generation of file \a inode.
+ * \return the generation, -1 if the file is not consistent.
+ */
+static int readGen(BattFsSuper *disk, inode_t inode)
+{
+	BattFs fd;
+	uint8_t buf[TRANS_FILE_SIZE];
+	int gen = -1;
+
+	if (!battfs_fileopen(disk, &fd, inode, 0))
+		return -1;
+
+	if (fd.fd.size == TRANS_FILE_SIZE
+	 && kfile_read(&fd.fd, buf, sizeof(buf)) == sizeof(buf))
+	{
+		gen = buf[0] ^ pattern(inode, 0);
+		for (kfile_off_t off = 0; off < TRANS_FILE_SIZE; off++)
+			if ((buf[off] ^ pattern(inode, off)) != gen)
+				gen = -1;
+	}
+	kfile_close(&fd.fd);
+	return gen;
+}
+
+/**
+ * Update files 1 and 2 to generation \a gen in a transaction.
+ */
+static bool transUpdate(BattFsSuper *disk, uint8_t gen)
+{
+	return battfs_transBegin(disk)
+		&& writeGen(disk, 1, gen)
+		&& writeGen(disk, 2, gen)
+		&& battfs_transCommit(disk);
+}
+
+#define TRANS_GENS 3
+
+static bool transScenario(BattFsSuper *disk, volatile int *committed)
+{
+	if (!(writeGen(disk, 1, 0) && writeGen(disk, 2, 0)))
+		return false;
+	*committed = 0;
+
+	for (int gen = 1; gen <= TRANS_GENS; gen++)
+	{
+		if (!transUpdate(disk, gen))
+			return false;
+		*committed = gen;
+	}
+	return true;
+}
+
+/**
+ * Run a sequence of transactions updating two files, losing power at
+ * every erase/save operation in turn. After each power loss both files
+ * must be found either in the last committed generation or in the next one.
+ */
+static void transPowerLoss(BattFsSuper *disk)
+{
+	volatile long points = 0;
+	volatile long failures = 0;
+	volatile int committed;
+
+	memset(sim.image, 0xff, sizeof(sim.image));
+	ASSERT(battfs_mount(disk));
+	sim_resetStats();
+	ASSERT(transScenario(disk, &committed));
+	sim_report("transaction", (unsigned long)TRANS_FILE_SIZE * 2 * (TRANS_GENS + 1));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(readGen(disk, 1) == TRANS_GENS && readGen(disk, 2) == TRANS_GENS);
+	ASSERT(battfs_umount(disk));
+	points = sim.stats.erase + sim.stats.save;
+
+	for (long point = 0; point < points; point++)
+	{
+		memset(sim.image, 0xff, sizeof(sim.image));
+		committed = -1;
+
+		if (setjmp(sim.power_lost) == 0)
+		{
+			ASSERT(battfs_mount(disk));
+			sim.power_countdown = point;
+			transScenario(disk, &committed);
+			ASSERT(0);
+		}
+		sim.power_countdown = -1;
+
+		if (!battfs_mount(disk) || !battfs_fsck(disk))
+			failures++;
+		else if (committed >= 0)
+		{
+			int gen1 = readGen(disk, 1);
+			int gen2 = readGen(disk, 2);
+
+			if (gen1 != gen2 || (gen1 != committed && gen1 != committed + 1))
+			{
+				printf("Power loss at operation %ld: generation %d/%d, committed %d\n",
+					point, gen1, gen2, committed);
+				failures++;
+			}
+		}
+		battfs_umount(disk);
+	}
+
+	printf("BENCH scenario=transpowerloss model=%s points=%ld failures=%ld\n",
+		sim.timing->name, (long)points, (long)failures);
+	ASSERT(failures == 0);
+}
+
+int battfs_sim_testRun(void)
+{
+	BattFsSuper disk;
+
+	for (size_t i = 0; i < countof(sim_timings); i++)
+	{
+		sim_init(&disk, &sim_timings[i]);
+
+		benchAppend(&disk);
+		benchRewrite(&disk);
+		benchMount(&disk);
+		benchInterleave(&disk);
+		benchRead(&disk);
+		powerLoss(&disk);
+		transPowerLoss(&disk);
+	}
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int battfs_sim_testSetup(void)
+{
+	return 0;
+}
+
+int battfs_sim_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(battfs_sim)
+
+#include <fs/battfs.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif // UNIT_TEST
@@ -36,6 +36,7 @@
  */
 
 #include <fs/battfs.h>
+#include <fs/battfs_names.h>
 
 #include <cfg/debug.h>
 #include <cfg/test.h>
@@ -54,6 +55,8 @@ FILE *fp;
 const char test_filename[]="battfs_disk.bin";
 
 static uint8_t page_buffer[PAGE_SIZE];
+static uint8_t readahead_buffer[PAGE_SIZE / 4];
+static unsigned multi_reads;
 
 static bool disk_open(struct BattFsSuper *d)
 {
@@ -74,6 +77,29 @@ static size_t disk_page_read(struct BattFsSuper *d, pgcnt_t page, pgaddr_t addr,
 	return fread(buf, 1, size, fp);
 }
 
+static size_t disk_multi_read(struct BattFsSuper *d, pgcnt_t page, pgaddr_t addr, void *_buf, size_t size)
+{
+	//TRACEMSG("page:%d, addr:%d, size:%d", page, addr, size);
+	uint8_t *buf = (uint8_t *)_buf;
+	size_t total = 0;
+
+	multi_reads++;
+	while (size)
+	{
+		size_t len = MIN(size, (size_t)(d->data_size - addr));
+
+		fseek(fp, page * d->page_size + addr, SEEK_SET);
+		if (fread(buf, 1, len, fp) != len)
+			break;
+		total += len;
+		buf += len;
+		size -= len;
+		addr = 0;
+		page++;
+	}
+	return total;
+}
+
 static size_t disk_buffer_write(struct BattFsSuper *d, pgaddr_t addr, const void *buf, size_t size)
 {
 	//TRACEMSG("addr:%d, size:%d", addr, size);
@@ -1021,14 +1047,269 @@ static void multipleFilesRW(BattFsSuper *disk)
 	TRACEMSG("21: passed\n");
 }
 
+static void readMultiPage(BattFsSuper *disk)
+{
+	TRACEMSG("22: multi page read and read-ahead test\n");
+
+	FILE *fpt = fopen(test_filename, "w+");
+
+	for (int i = 0; i < FILE_SIZE; i++)
+		fputc(0xff, fpt);
+	fclose(fpt);
+
+	BattFs fd1;
+	inode_t INODE = 0;
+	unsigned int MODE = BATTFS_CREATE;
+	uint8_t buf[(PAGE_SIZE - BATTFS_HEADER_LEN) * 6];
+
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	ASSERT(battfs_mount(disk));
+	ASSERT(battfs_fileopen(disk, &fd1, INODE, MODE));
+	ASSERT(kfile_write(&fd1.fd, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(battfs_umount(disk));
+
+	disk->readahead_buf = readahead_buffer;
+	disk->readahead_size = sizeof(readahead_buffer);
+	ASSERT(battfs_mount(disk));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_fileopen(disk, &fd1, INODE, 0));
+
+	/* Whole file in one read: consecutive pages must be coalesced */
+	multi_reads = 0;
+	memset(buf, 0, sizeof(buf));
+	ASSERT(kfile_read(&fd1.fd, buf, sizeof(buf)) == sizeof(buf));
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		ASSERT(buf[i] == (i & 0xff));
+	ASSERT(multi_reads > 0);
+
+	/* Byte by byte, using the read-ahead buffer */
+	ASSERT(kfile_seek(&fd1.fd, 0, KSM_SEEK_SET) == 0);
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		ASSERT(kfile_getc(&fd1.fd) == (int)(i & 0xff));
+	ASSERT(kfile_getc(&fd1.fd) == EOF);
+
+	/* Read-ahead buffer must be invalidated by writes */
+	ASSERT(kfile_seek(&fd1.fd, 1, KSM_SEEK_SET) == 1);
+	ASSERT(kfile_getc(&fd1.fd) == 1);
+	ASSERT(kfile_seek(&fd1.fd, 2, KSM_SEEK_SET) == 2);
+	ASSERT(kfile_putc(0x55, &fd1.fd) == 0x55);
+	ASSERT(kfile_flush(&fd1.fd) == 0);
+	ASSERT(kfile_seek(&fd1.fd, 2, KSM_SEEK_SET) == 2);
+	ASSERT(kfile_getc(&fd1.fd) == 0x55);
+
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(kfile_error(&fd1.fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	disk->readahead_buf = NULL;
+	disk->readahead_size = 0;
+	TRACEMSG("22: passed\n");
+}
+
+static void fileNames(BattFsSuper *disk)
+{
+	TRACEMSG("23: file names and RAM inode index test\n");
+
+	FILE *fpt = fopen(test_filename, "w+");
+
+	for (int i = 0; i < FILE_SIZE; i++)
+		fputc(0xff, fpt);
+	fclose(fpt);
+
+	static pgoff_t filelen_table[BATTFS_MAX_FILES];
+	static BattFsNames names;
+	BattFs fd1;
+	inode_t inode;
+	uint8_t buf[PAGE_SIZE * 2];
+
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	disk->filelen_table = filelen_table;
+	ASSERT(battfs_mount(disk));
+	ASSERT(battfs_namesLoad(disk, &names));
+	ASSERT(!battfs_lookup(&names, "log", &inode));
+	ASSERT(!battfs_fileopenName(&names, &fd1, "log", 0));
+	ASSERT(fd1.errors == BATTFS_FILE_NOT_FOUND_ERR);
+
+	ASSERT(battfs_fileopenName(&names, &fd1, "log", BATTFS_CREATE));
+	ASSERT(fd1.inode == 0);
+	ASSERT(kfile_write(&fd1.fd, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(kfile_close(&fd1.fd) == 0);
+
+	ASSERT(battfs_fileopenName(&names, &fd1, "a_very_long_config_name", BATTFS_CREATE));
+	ASSERT(fd1.inode == 1);
+	ASSERT(kfile_close(&fd1.fd) == 0);
+
+	ASSERT(battfs_lookup(&names, "log", &inode));
+	ASSERT(inode == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	/* Names and file positions must be found again after mount */
+	ASSERT(battfs_mount(disk));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(filelen_table[0] == 3);
+	ASSERT(filelen_table[BATTFS_NAMES_INODE] == 1);
+	ASSERT(battfs_namesLoad(disk, &names));
+	ASSERT(battfs_lookup(&names, "log", &inode));
+	ASSERT(inode == 0);
+	ASSERT(battfs_lookup(&names, "a_very_long_config_name", &inode));
+	ASSERT(inode == 1);
+	ASSERT(!battfs_lookup(&names, "missing", &inode));
+
+	/* Reserved inodes can not be opened as ordinary files */
+	ASSERT(!battfs_fileopen(disk, &fd1, BATTFS_TRANS_INODE, BATTFS_CREATE));
+	ASSERT(fd1.errors == BATTFS_RESERVED_INODE_ERR);
+	ASSERT(!battfs_fileopen(disk, &fd1, BATTFS_NAMES_INODE, BATTFS_RD));
+	ASSERT(fd1.errors == BATTFS_RESERVED_INODE_ERR);
+
+	ASSERT(battfs_fileopenName(&names, &fd1, "log", 0));
+	ASSERT(fd1.fd.size == sizeof(buf));
+	ASSERT(fd1.start == &disk->page_array[0]);
+	memset(buf, 0, sizeof(buf));
+	ASSERT(kfile_read(&fd1.fd, buf, sizeof(buf)) == sizeof(buf));
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		ASSERT(buf[i] == (i & 0xff));
+	ASSERT(kfile_close(&fd1.fd) == 0);
+
+	ASSERT(battfs_fileopenName(&names, &fd1, "new", BATTFS_CREATE));
+	ASSERT(fd1.inode == 2);
+	ASSERT(fd1.start == &disk->page_array[filelen_table[0] + filelen_table[1]]);
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	disk->filelen_table = NULL;
+	TRACEMSG("23: passed\n");
+}
+
+static void transactions(BattFsSuper *disk)
+{
+	TRACEMSG("24: transactions test\n");
+
+	FILE *fpt = fopen(test_filename, "w+");
+
+	for (int i = 0; i < FILE_SIZE; i++)
+		fputc(0xff, fpt);
+	fclose(fpt);
+
+	BattFs fd1, fd2;
+	uint8_t buf[(PAGE_SIZE - BATTFS_HEADER_LEN) * 15];
+	uint8_t buf2[sizeof(buf)];
+
+	for (unsigned i = 0; i < sizeof(buf); i++)
+		buf[i] = i;
+
+	/* Two files written in one transaction each, the second fills the commit record */
+	ASSERT(battfs_mount(disk));
+	ASSERT(battfs_transBegin(disk));
+	ASSERT(battfs_fileopen(disk, &fd1, 0, BATTFS_CREATE));
+	ASSERT(kfile_write(&fd1.fd, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(battfs_transCommit(disk));
+	ASSERT(battfs_transBegin(disk));
+	ASSERT(battfs_fileopen(disk, &fd2, 1, BATTFS_CREATE));
+	ASSERT(kfile_write(&fd2.fd, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(kfile_close(&fd2.fd) == 0);
+	ASSERT(battfs_transCommit(disk));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	ASSERT(battfs_mount(disk));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_fileopen(disk, &fd1, 0, 0));
+	ASSERT(battfs_fileopen(disk, &fd2, 1, 0));
+	ASSERT(fd1.fd.size == sizeof(buf));
+	ASSERT(fd2.fd.size == sizeof(buf));
+	ASSERT(kfile_read(&fd1.fd, buf2, sizeof(buf2)) == sizeof(buf2));
+	ASSERT(memcmp(buf, buf2, sizeof(buf)) == 0);
+	ASSERT(kfile_read(&fd2.fd, buf2, sizeof(buf2)) == sizeof(buf2));
+	ASSERT(memcmp(buf, buf2, sizeof(buf)) == 0);
+
+	/* Transaction not committed: changes are lost at next mount */
+	ASSERT(battfs_transBegin(disk));
+	ASSERT(kfile_seek(&fd1.fd, 0, KSM_SEEK_SET) == 0);
+	ASSERT(kfile_seek(&fd2.fd, 0, KSM_SEEK_SET) == 0);
+	memset(buf2, 0xaa, sizeof(buf2));
+	ASSERT(kfile_write(&fd1.fd, buf2, PAGE_SIZE * 2) == PAGE_SIZE * 2);
+	ASSERT(kfile_write(&fd2.fd, buf2, PAGE_SIZE * 2) == PAGE_SIZE * 2);
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(kfile_close(&fd2.fd) == 0);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	ASSERT(battfs_mount(disk));
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_fileopen(disk, &fd1, 0, 0));
+	ASSERT(battfs_fileopen(disk, &fd2, 1, 0));
+	ASSERT(kfile_read(&fd1.fd, buf2, sizeof(buf2)) == sizeof(buf2));
+	ASSERT(memcmp(buf, buf2, sizeof(buf)) == 0);
+	ASSERT(kfile_read(&fd2.fd, buf2, sizeof(buf2)) == sizeof(buf2));
+	ASSERT(memcmp(buf, buf2, sizeof(buf)) == 0);
+	ASSERT(kfile_close(&fd1.fd) == 0);
+	ASSERT(kfile_close(&fd2.fd) == 0);
+	ASSERT(battfs_umount(disk));
+
+	/* Corrupted commit records are ignored */
+	static const uint8_t dup_entry[] = { 0, 0, 0, 0 };
+	static const uint8_t bad_entry[] = { 0xff, 0x7f };
+	pgcnt_t trans_page;
+
+	ASSERT(battfs_mount(disk));
+	trans_page = disk->trans_page;
+	ASSERT(trans_page != PAGE_UNSET_SENTINEL);
+	ASSERT(battfs_umount(disk));
+
+	/* Duplicate entry */
+	fpt = fopen(test_filename, "r+b");
+	fseek(fpt, trans_page * PAGE_SIZE + 2, SEEK_SET);
+	ASSERT(fread(buf2, 1, 4, fpt) == 4);
+	fseek(fpt, trans_page * PAGE_SIZE + 2 + 4, SEEK_SET);
+	fwrite(buf2, 1, 4, fpt);
+	fclose(fpt);
+	ASSERT(battfs_mount(disk));
+	ASSERT(disk->trans_page == PAGE_UNSET_SENTINEL);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	/* Entry out of the disk, and entries out of order */
+	fpt = fopen(test_filename, "r+b");
+	fseek(fpt, trans_page * PAGE_SIZE + 2, SEEK_SET);
+	fwrite(bad_entry, 1, sizeof(bad_entry), fpt);
+	fclose(fpt);
+	ASSERT(battfs_mount(disk));
+	ASSERT(disk->trans_page == PAGE_UNSET_SENTINEL);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	fpt = fopen(test_filename, "r+b");
+	fseek(fpt, trans_page * PAGE_SIZE + 2 + 4, SEEK_SET);
+	fwrite(dup_entry, 1, sizeof(dup_entry), fpt);
+	fseek(fpt, trans_page * PAGE_SIZE + 2, SEEK_SET);
+	fwrite(buf2, 1, 4, fpt);
+	fclose(fpt);
+	ASSERT(battfs_mount(disk));
+	ASSERT(disk->trans_page == PAGE_UNSET_SENTINEL);
+	ASSERT(battfs_fsck(disk));
+	ASSERT(battfs_umount(disk));
+
+	TRACEMSG("24: passed\n");
+}
 
 int battfs_testRun(void)
 {
 	BattFsSuper disk;
 
+	memset(&disk, 0, sizeof(disk));
 	disk.page_size = PAGE_SIZE;
 	disk.open = disk_open;
 	disk.read = disk_page_read;
+	disk.readMulti = disk_multi_read;
 	disk.load = disk_page_load;
 	disk.bufferWrite = disk_buffer_write;
 	disk.bufferRead = disk_buffer_read;
@@ -1055,6 +1336,9 @@ int battfs_testRun(void)
 	writeEOF(&disk);
 	endOfSpace(&disk);
 	multipleFilesRW(&disk);
+	readMultiPage(&disk);
+	fileNames(&disk);
+	transactions(&disk);
 
 	kprintf("All tests passed!\n");
 
@@ -1074,6 +1358,8 @@ int battfs_testTearDown(void)
 TEST_MAIN(battfs)
 
 #include <fs/battfs.c>
+#include <fs/battfs_names.c>
+#include <struct/hashtable.c>
 #include <kern/kfile.c>
 #include <drv/kdebug.c>
 #include <mware/formatwr.c>
@@ -86,8 +86,18 @@ int kfile_getc(struct KFile *fd)
 }
 
 #if CONFIG_PRINTF
+/**
+ * Write a run of formatted output to the KFile \a fd.
+ */
+static void kfile_putBlock(const char *buf, size_t len, void *fd)
+{
+	kfile_write((struct KFile *)fd, buf, len);
+}
+
 /**
  * Formatted write.
+ * Output is written in runs (literal text, converted values and
+ * padding), not one character at a time.
  */
 int kfile_printf(struct KFile *fd, const char *format, ...)
 {
@@ -95,7 +105,7 @@ int kfile_printf(struct KFile *fd, const char *format, ...)
 	int len;
 
 	va_start(ap, format);
-	len = _formatted_write(format, (void (*)(char, void *))kfile_putc, fd, ap);
+	len = _formatted_write_block(format, kfile_putBlock, fd, ap);
 	va_end(ap);
 
 	return len;
@@ -218,6 +228,48 @@ struct KFile * kfile_genericReopen(struct KFile *fd)
 	return fd;
 }
 
+/**
+ * Read \a fd in \a iovcnt buffers of \a iov, using kfile_read()
+ * on each buffer.
+ * Stops at the first short read.
+ * \return the total number of bytes read.
+ */
+size_t kfile_genericReadv(struct KFile *fd, const KFileIov *iov, int iovcnt)
+{
+	size_t total = 0;
+
+	for (int i = 0; i < iovcnt; i++)
+	{
+		size_t len = kfile_read(fd, iov[i].base, iov[i].len);
+
+		total += len;
+		if (len != iov[i].len)
+			break;
+	}
+	return total;
+}
+
+/**
+ * Write \a iovcnt buffers of \a iov in \a fd, using kfile_write()
+ * on each buffer.
+ * Stops at the first short write.
+ * \return the total number of bytes written.
+ */
+size_t kfile_genericWritev(struct KFile *fd, const KFileIov *iov, int iovcnt)
+{
+	size_t total = 0;
+
+	for (int i = 0; i < iovcnt; i++)
+	{
+		size_t len = kfile_write(fd, iov[i].base, iov[i].len);
+
+		total += len;
+		if (len != iov[i].len)
+			break;
+	}
+	return total;
+}
+
 /**
  * Close file \a fd.
  * This is a generic implementation that only return 0.
@@ -172,6 +172,40 @@ typedef int (*ErrorFunc_t) (struct KFile *fd);
  * Clear errors.
  */
 typedef void (*ClearErrFunc_t) (struct KFile *fd);
+
+/**
+ * Buffer descriptor for vectored I/O.
+ */
+typedef struct KFileIov
+{
+	void *base;  ///< Start of the buffer.
+	size_t len;  ///< Length of the buffer.
+} KFileIov;
+
+/**
+ * Read from file into \a iovcnt buffers, filling them in order.
+ * \return the number of bytes read.
+ */
+typedef size_t (*ReadvFunc_t) (struct KFile *fd, const KFileIov *iov, int iovcnt);
+
+/**
+ * Write to file \a iovcnt buffers, in order.
+ * \return the number of bytes written.
+ */
+typedef size_t (*WritevFunc_t) (struct KFile *fd, const KFileIov *iov, int iovcnt);
+
+/**
+ * Lend a buffer of the file to a producer, which can write data directly there.
+ * \a len is set with the size of the buffer.
+ * \return the buffer or NULL if no buffer is available at the moment.
+ */
+typedef void * (*BorrowFunc_t) (struct KFile *fd, size_t *len);
+
+/**
+ * Commit \a len bytes written in the buffer returned by a previous borrow.
+ * \return the number of bytes committed.
+ */
+typedef size_t (*CommitFunc_t) (struct KFile *fd, size_t len);
 /* \} */
 
 /**
@@ -191,6 +225,10 @@ typedef struct KFile
 	FlushFunc_t    flush;
 	ErrorFunc_t    error;
 	ClearErrFunc_t clearerr;
+	ReadvFunc_t    readv;    ///< Optional, NULL if not implemented.
+	WritevFunc_t   writev;   ///< Optional, NULL if not implemented.
+	BorrowFunc_t   borrow;   ///< Optional, NULL if not implemented.
+	CommitFunc_t   commit;   ///< Optional, NULL if not implemented.
 	DB(id_t _type); ///< Used to keep track, at runtime, of the class type.
 
 	/* NOTE: these must _NOT_ be size_t on 16bit CPUs! */
@@ -216,6 +254,8 @@ int kfile_printf(struct KFile *fd, const char *format, ...);
 int kfile_print(struct KFile *fd, const char *s);
 int kfile_gets(struct KFile *fd, char *buf, int size);
 int kfile_gets_echo(struct KFile *fd, char *buf, int size, bool echo);
+size_t kfile_genericReadv(struct KFile *fd, const KFileIov *iov, int iovcnt);
+size_t kfile_genericWritev(struct KFile *fd, const KFileIov *iov, int iovcnt);
 
 /**
  * Interface functions for KFile access.
@@ -269,6 +309,55 @@ INLINE void kfile_clearerr(struct KFile *fd)
 	ASSERT(fd->clearerr);
 	fd->clearerr(fd);
 }
+
+/**
+ * Vectored read, falls back to a kfile_read() per buffer if
+ * the file does not implement it.
+ */
+INLINE size_t kfile_readv(struct KFile *fd, const KFileIov *iov, int iovcnt)
+{
+	return fd->readv ? fd->readv(fd, iov, iovcnt) : kfile_genericReadv(fd, iov, iovcnt);
+}
+
+/**
+ * Vectored write, falls back to a kfile_write() per buffer if
+ * the file does not implement it.
+ */
+INLINE size_t kfile_writev(struct KFile *fd, const KFileIov *iov, int iovcnt)
+{
+	return fd->writev ? fd->writev(fd, iov, iovcnt) : kfile_genericWritev(fd, iov, iovcnt);
+}
+
+/**
+ * Borrow a buffer of \a fd to write data without intermediate copies.
+ * Once filled, the buffer must be passed back with kfile_commit(), before
+ * any other operation on \a fd.
+ * If the file does not lend buffers NULL is returned, and the producer
+ * has to use its own buffer and kfile_write():
+ * \code
+ * size_t len;
+ * uint8_t *buf = kfile_borrow(fd, &len);
+ *
+ * if (buf)
+ *     kfile_commit(fd, produce(buf, len));
+ * else
+ *     kfile_write(fd, local_buf, produce(local_buf, sizeof(local_buf)));
+ * \endcode
+ */
+INLINE void *kfile_borrow(struct KFile *fd, size_t *len)
+{
+	*len = 0;
+	return fd->borrow ? fd->borrow(fd, len) : NULL;
+}
+
+/**
+ * Commit \a len bytes written in the buffer lent by kfile_borrow().
+ */
+INLINE size_t kfile_commit(struct KFile *fd, size_t len)
+{
+	ASSERT(fd->commit);
+	return fd->commit(fd, len);
+}
 /* \} */
 
 /**
@@ -0,0 +1,144 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Asynchronous KFile operations.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "kfile_aio.h"
+
+#include "cfg/cfg_kern.h"
+#include <cfg/debug.h>
+
+#include <cpu/power.h> /* cpu_relax() */
+
+/*
+ * Sanity check for config parameters required by this module.
+ */
+#if !CONFIG_KERN || !CONFIG_KERN_SIGNALS
+	#error KFile async I/O requires CONFIG_KERN and CONFIG_KERN_SIGNALS
+#endif
+
+/**
+ * Serve request \a req on \a file.
+ */
+static void kfileaio_serve(KFile *file, KFileAioReq *req)
+{
+	req->error = 0;
+	req->result = 0;
+
+	if (req->pos != KFILEAIO_POS_CUR
+	 && kfile_seek(file, req->pos, KSM_SEEK_SET) != req->pos)
+	{
+		req->error = EOF;
+		return;
+	}
+
+	switch (req->op)
+	{
+	case KAIO_READ:
+		req->result = kfile_read(file, req->buf, req->size);
+		break;
+	case KAIO_WRITE:
+		req->result = kfile_write(file, req->buf, req->size);
+		break;
+	case KAIO_FLUSH:
+		req->error = file->flush ? kfile_flush(file) : 0;
+		return;
+	default:
+		ASSERT(0);
+		req->error = EOF;
+		return;
+	}
+
+	if (req->result != req->size)
+		req->error = EOF;
+}
+
+/**
+ * Process serving the requests of the KFileAio passed as user data.
+ */
+static void kfileaio_proc(void)
+{
+	KFileAio *aio = (KFileAio *)proc_currentUserData();
+	KFileAioReq *req;
+
+	for (;;)
+	{
+		/* Serve all pending requests before going to sleep */
+		while ((req = (KFileAioReq *)msg_get(&aio->port)))
+		{
+			kfileaio_serve(aio->file, req);
+			req->completed = true;
+			event_do(&req->done);
+		}
+		sig_wait(SIG_KFILEAIO);
+	}
+}
+
+/**
+ * Queue request \a req on \a aio.
+ * The request is served in background and its done event
+ * is triggered on completion.
+ */
+void kfileaio_submit(KFileAio *aio, KFileAioReq *req)
+{
+	req->completed = false;
+	msg_put(&aio->port, &req->msg);
+}
+
+/**
+ * Wait for the completion of \a req, yielding the CPU.
+ * Useful when the done event of the request does not signal the caller.
+ */
+void kfileaio_wait(KFileAioReq *req)
+{
+	while (!req->completed)
+		cpu_relax();
+}
+
+/**
+ * Init \a aio to serve requests on \a file.
+ * A new process, with stack \a stack long \a stacksize bytes, is created
+ * to serve the requests.
+ */
+void kfileaio_init(KFileAio *aio, KFile *file, cpu_stack_t *stack, size_t stacksize)
+{
+	aio->file = file;
+
+	/* The port event needs the process, which needs an initialized port */
+	msg_initPort(&aio->port, event_createNone());
+	aio->proc = proc_new(kfileaio_proc, (iptr_t)aio, stacksize, stack);
+	ASSERT(aio->proc);
+	aio->port.event = event_createSignal(aio->proc, SIG_KFILEAIO);
+}
@@ -0,0 +1,171 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Asynchronous KFile operations.
+ *
+ * A KFileAio serves the read, write and flush requests on a KFile
+ * with its own process. Requests are queued on a message port and
+ * executed in FIFO order; when a request is done its Event is triggered,
+ * so the submitter can be signalled or a callback can be called.
+ *
+ * The drivers of slow devices (DataFlash, Flash25, Serial...) wait
+ * for the hardware calling cpu_relax(), which yields the CPU: while
+ * a flash page is being programmed the submitting process can go on
+ * with its work.
+ *
+ * \code
+ * static cpu_stack_t aio_stack[CONFIG_KERN_MINSTACKSIZE / sizeof(cpu_stack_t)];
+ * static KFileAio aio;
+ * KFileAioReq req;
+ *
+ * kfileaio_init(&aio, &flash.fd, aio_stack, sizeof(aio_stack));
+ *
+ * kfileaio_write(&req, log_page, sizeof(log_page), event_createSignal(proc_current(), SIG_USER1));
+ * kfileaio_submit(&aio, &req);
+ * // ...prepare the next page while the first one is programmed...
+ * sig_wait(SIG_USER1);
+ * ASSERT(req.result == sizeof(log_page));
+ * \endcode
+ *
+ * \note A request, and its buffer, belong to the KFileAio from
+ *       submission to completion and must not be touched in the meantime.
+ *       The underlying KFile must be used only through the KFileAio.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef KERN_KFILE_AIO_H
+#define KERN_KFILE_AIO_H
+
+#include <kern/kfile.h>
+#include <kern/msg.h>
+#include <kern/signal.h>
+#include <mware/event.h>
+
+/**
+ * Signal used to wake up KFileAio processes when a request is queued.
+ */
+#define SIG_KFILEAIO SIG_USER0
+
+/**
+ * Use the current file position for a request.
+ */
+#define KFILEAIO_POS_CUR  ((kfile_off_t)-1)
+
+/**
+ * Asynchronous operations.
+ */
+typedef enum KFileAioOp
+{
+	KAIO_READ,
+	KAIO_WRITE,
+	KAIO_FLUSH,
+} KFileAioOp;
+
+/**
+ * Asynchronous request.
+ */
+typedef struct KFileAioReq
+{
+	Msg msg;               ///< Link in the request queue.
+	KFileAioOp op;         ///< Operation to do.
+	kfile_off_t pos;       ///< File position, KFILEAIO_POS_CUR to use the current one.
+	void *buf;             ///< Data buffer for reads and writes.
+	size_t size;           ///< Bytes to read or write.
+	Event done;            ///< Triggered on completion.
+
+	size_t result;         ///< Bytes read or written.
+	int error;             ///< 0 if ok, EOF on errors.
+	volatile bool completed; ///< True when the request has been served.
+} KFileAioReq;
+
+/**
+ * Asynchronous KFile context.
+ */
+typedef struct KFileAio
+{
+	KFile *file;           ///< File on which requests are done.
+	MsgPort port;          ///< Queue of pending requests.
+	struct Process *proc;  ///< Process serving the requests.
+} KFileAio;
+
+/**
+ * Prepare \a req to read \a size bytes in \a buf from the
+ * current position, triggering \a done on completion.
+ */
+INLINE void kfileaio_read(KFileAioReq *req, void *buf, size_t size, Event done)
+{
+	req->op = KAIO_READ;
+	req->pos = KFILEAIO_POS_CUR;
+	req->buf = buf;
+	req->size = size;
+	req->done = done;
+}
+
+/**
+ * Prepare \a req to write \a size bytes from \a buf at the
+ * current position, triggering \a done on completion.
+ */
+INLINE void kfileaio_write(KFileAioReq *req, const void *buf, size_t size, Event done)
+{
+	req->op = KAIO_WRITE;
+	req->pos = KFILEAIO_POS_CUR;
+	req->buf = (void *)buf;
+	req->size = size;
+	req->done = done;
+}
+
+/**
+ * Prepare \a req to flush the file, triggering \a done on completion.
+ */
+INLINE void kfileaio_flush(KFileAioReq *req, Event done)
+{
+	req->op = KAIO_FLUSH;
+	req->pos = KFILEAIO_POS_CUR;
+	req->buf = NULL;
+	req->size = 0;
+	req->done = done;
+}
+
+/**
+ * \return true if \a req has been served.
+ */
+INLINE bool kfileaio_completed(KFileAioReq *req)
+{
+	return req->completed;
+}
+
+void kfileaio_init(KFileAio *aio, KFile *file, cpu_stack_t *stack, size_t stacksize);
+void kfileaio_submit(KFileAio *aio, KFileAioReq *req);
+void kfileaio_wait(KFileAioReq *req);
+
+#endif /* KERN_KFILE_AIO_H */
@@ -0,0 +1,357 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Buffered KFile adapter.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "kfile_buf.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN, MAX */
+
+#include <string.h>
+
+/**
+ * True if the file under \a fb can be read ahead.
+ */
+#define SEEKABLE(fb) ((fb)->file->seek != NULL)
+
+/**
+ * Pass the content of the write buffer to the underlying file.
+ * On short writes the bytes not written are kept in the buffer.
+ * \return 0 if ok, EOF on errors.
+ */
+static int kfilebuf_writeBuffer(KFileBuf *fb)
+{
+	size_t len = fb->tx_len;
+	size_t done;
+
+	if (!len)
+		return 0;
+
+	done = kfile_write(fb->file, fb->tx_buf, len);
+	fb->tx_len = len - done;
+	if (done != len)
+	{
+		memmove(fb->tx_buf, fb->tx_buf + done, fb->tx_len);
+		return EOF;
+	}
+	return 0;
+}
+
+/**
+ * Discard data read ahead, moving the underlying file back
+ * to the current position.
+ */
+static void kfilebuf_dropReadAhead(KFileBuf *fb)
+{
+	if (fb->rx_len > fb->rx_pos)
+		kfile_seek(fb->file, -(kfile_off_t)(fb->rx_len - fb->rx_pos), KSM_SEEK_CUR);
+	fb->rx_pos = fb->rx_len = 0;
+}
+
+static size_t kfilebuf_write(struct KFile *fd, const void *_buf, size_t size)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+	const uint8_t *buf = (const uint8_t *)_buf;
+	size_t written = 0;
+
+	/* On streams, input and output are independent */
+	if (SEEKABLE(fb))
+		kfilebuf_dropReadAhead(fb);
+
+	while (size)
+	{
+		/* Big writes bypass the buffer */
+		if (!fb->tx_len && size >= fb->tx_size)
+		{
+			written += kfile_write(fb->file, buf, size);
+			break;
+		}
+
+		/* Still full after a failed write: retry before taking more data */
+		if (fb->tx_len == fb->tx_size && kfilebuf_writeBuffer(fb) == EOF)
+			break;
+
+		size_t len = MIN(size, fb->tx_size - fb->tx_len);
+		bool flush = false;
+
+		if (fb->mode == KFB_LINE)
+		{
+			const uint8_t *nl = (const uint8_t *)memchr(buf, '\n', len);
+			if (nl)
+			{
+				len = nl - buf + 1;
+				flush = true;
+			}
+		}
+
+		memcpy(fb->tx_buf + fb->tx_len, buf, len);
+		fb->tx_len += len;
+		buf += len;
+		size -= len;
+		written += len;
+
+		if ((flush || fb->tx_len == fb->tx_size)
+		 && kfilebuf_writeBuffer(fb) == EOF)
+			break;
+	}
+
+	fd->seek_pos += written;
+	if (SEEKABLE(fb))
+		fd->size = MAX(fd->size, fd->seek_pos);
+	return written;
+}
+
+/**
+ * Lend the free part of the write buffer.
+ */
+static void *kfilebuf_borrow(struct KFile *fd, size_t *len)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+
+	if (SEEKABLE(fb))
+		kfilebuf_dropReadAhead(fb);
+	if (fb->tx_len == fb->tx_size)
+		kfilebuf_writeBuffer(fb);
+
+	*len = fb->tx_size - fb->tx_len;
+	return fb->tx_buf + fb->tx_len;
+}
+
+/**
+ * Queue \a len bytes written in the buffer lent by kfilebuf_borrow(),
+ * flushing them as a normal write would do.
+ */
+static size_t kfilebuf_commit(struct KFile *fd, size_t len)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+	bool flush = (fb->mode == KFB_LINE && memchr(fb->tx_buf + fb->tx_len, '\n', len));
+
+	ASSERT(len <= fb->tx_size - fb->tx_len);
+	fb->tx_len += len;
+	fd->seek_pos += len;
+	if (SEEKABLE(fb))
+		fd->size = MAX(fd->size, fd->seek_pos);
+
+	if (flush || fb->tx_len == fb->tx_size)
+		kfilebuf_writeBuffer(fb);
+	return len;
+}
+
+static size_t kfilebuf_read(struct KFile *fd, void *_buf, size_t size)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+	uint8_t *buf = (uint8_t *)_buf;
+	size_t total = 0;
+
+	/* Pending output goes first (a prompt, or data to be read back) */
+	kfilebuf_writeBuffer(fb);
+
+	while (size)
+	{
+		size_t avail = fb->rx_len - fb->rx_pos;
+
+		if (avail)
+		{
+			size_t len = MIN(size, avail);
+
+			memcpy(buf, fb->rx_buf + fb->rx_pos, len);
+			fb->rx_pos += len;
+			buf += len;
+			size -= len;
+			total += len;
+		}
+		else if (!SEEKABLE(fb) || size >= fb->rx_size)
+		{
+			/* No read-ahead, or the buffer would not help */
+			total += kfile_read(fb->file, buf, size);
+			break;
+		}
+		else
+		{
+			fb->rx_pos = 0;
+			fb->rx_len = kfile_read(fb->file, fb->rx_buf, fb->rx_size);
+			if (!fb->rx_len)
+				break;
+		}
+	}
+
+	fd->seek_pos += total;
+	return total;
+}
+
+/**
+ * Return the next character of \a fb without consuming it.
+ * \return the character or EOF on errors.
+ */
+int kfilebuf_peek(KFileBuf *fb)
+{
+	if (fb->rx_pos == fb->rx_len)
+	{
+		kfilebuf_writeBuffer(fb);
+		fb->rx_pos = 0;
+		fb->rx_len = kfile_read(fb->file, fb->rx_buf, SEEKABLE(fb) ? fb->rx_size : 1);
+		if (!fb->rx_len)
+			return EOF;
+	}
+	return fb->rx_buf[fb->rx_pos];
+}
+
+/**
+ * Push back character \a c in \a fb, so that it will be the
+ * next character read.
+ * At least one character can always be pushed back after a read.
+ * \return \a c if ok, EOF if there is no room in read buffer.
+ */
+int kfilebuf_unget(int c, KFileBuf *fb)
+{
+	if (c == EOF)
+		return EOF;
+
+	if (fb->rx_pos)
+		fb->rx_pos--;
+	else if (fb->rx_len < fb->rx_size)
+	{
+		memmove(fb->rx_buf + 1, fb->rx_buf, fb->rx_len);
+		fb->rx_len++;
+	}
+	else
+		return EOF;
+
+	fb->rx_buf[fb->rx_pos] = (uint8_t)c;
+	fb->fd.seek_pos--;
+	return (int)((unsigned char)c);
+}
+
+static kfile_off_t kfilebuf_seek(struct KFile *fd, kfile_off_t offset, KSeekMode whence)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+	kfile_off_t pos;
+
+	if (kfilebuf_writeBuffer(fb) == EOF)
+		return EOF;
+	kfilebuf_dropReadAhead(fb);
+
+	pos = kfile_seek(fb->file, offset, whence);
+	if (pos != EOF)
+		fd->seek_pos = pos;
+	return pos;
+}
+
+static int kfilebuf_flush(struct KFile *fd)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+	int err = kfilebuf_writeBuffer(fb);
+
+	if (fb->file->flush && kfile_flush(fb->file) == EOF)
+		err = EOF;
+	return err;
+}
+
+static int kfilebuf_close(struct KFile *fd)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+	int err = kfilebuf_flush(fd);
+
+	fb->rx_pos = fb->rx_len = 0;
+	if (kfile_close(fb->file) == EOF)
+		err = EOF;
+	return err;
+}
+
+static struct KFile *kfilebuf_reopen(struct KFile *fd)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+
+	kfilebuf_writeBuffer(fb);
+	fb->rx_pos = fb->rx_len = 0;
+
+	fb->file = kfile_reopen(fb->file);
+	fd->seek_pos = fb->file->seek_pos;
+	fd->size = fb->file->size;
+	return fd;
+}
+
+static int kfilebuf_error(struct KFile *fd)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+
+	return fb->file->error ? kfile_error(fb->file) : 0;
+}
+
+static void kfilebuf_clearerr(struct KFile *fd)
+{
+	KFileBuf *fb = KFILEBUF_CAST(fd);
+
+	if (fb->file->clearerr)
+		kfile_clearerr(fb->file);
+}
+
+/**
+ * Init buffered KFile \a fb on top of \a file.
+ * \a rx_buf and \a tx_buf, long \a rx_size and \a tx_size bytes, are
+ * used as read and write buffers; write buffer is flushed following \a mode.
+ * The seek function is available only if \a file is seekable.
+ */
+void kfilebuf_init(KFileBuf *fb, KFile *file, uint8_t *rx_buf, size_t rx_size,
+	uint8_t *tx_buf, size_t tx_size, KFileBufMode mode)
+{
+	ASSERT(rx_buf && rx_size);
+	ASSERT(tx_buf && tx_size);
+
+	memset(fb, 0, sizeof(*fb));
+	DB(fb->fd._type = KFT_KFILEBUF);
+
+	fb->file = file;
+	fb->mode = mode;
+	fb->rx_buf = rx_buf;
+	fb->rx_size = rx_size;
+	fb->tx_buf = tx_buf;
+	fb->tx_size = tx_size;
+
+	fb->fd.seek_pos = file->seek_pos;
+	fb->fd.size = file->size;
+
+	fb->fd.read = kfilebuf_read;
+	fb->fd.write = kfilebuf_write;
+	fb->fd.seek = file->seek ? kfilebuf_seek : NULL;
+	fb->fd.flush = kfilebuf_flush;
+	fb->fd.close = kfilebuf_close;
+	fb->fd.reopen = kfilebuf_reopen;
+	fb->fd.error = kfilebuf_error;
+	fb->fd.clearerr = kfilebuf_clearerr;
+	fb->fd.borrow = kfilebuf_borrow;
+	fb->fd.commit = kfilebuf_commit;
+}
@@ -0,0 +1,115 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Buffered KFile adapter.
+ *
+ * A KFileBuf wraps any other KFile (a Serial port, a DataFlash, a BattFS file...)
+ * adding stdio-like read and write buffers.
+ * Small writes, like the ones done by kfile_putc() and kfile_printf(),
+ * are collected in the write buffer and passed to the underlying file
+ * with a single kfile_write() call, when:
+ * \li the buffer is full;
+ * \li a newline is written and the adapter is in KFB_LINE mode;
+ * \li kfile_flush() is called explicitly (this also flushes the underlying file).
+ *
+ * Reads are served from the read buffer, which is refilled with a single
+ * kfile_read() of the whole buffer size if the underlying file is
+ * seekable. Stream files (files without seek, like serial ports) are never
+ * read ahead, since a read could block waiting for data that will
+ * never come; on them the read buffer is only used by kfilebuf_peek()
+ * and kfilebuf_unget().
+ *
+ * Usage:
+ * \code
+ * static uint8_t rx_buf[32], tx_buf[64];
+ * KFileBuf out;
+ *
+ * kfilebuf_init(&out, &ser.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_LINE);
+ * kfile_printf(&out.fd, "temp: %d\n", temp);
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef KERN_KFILE_BUF_H
+#define KERN_KFILE_BUF_H
+
+#include <kern/kfile.h>
+
+/**
+ * Flush policies of the write buffer.
+ */
+typedef enum KFileBufMode
+{
+	KFB_FULL, ///< Flush when the buffer is full or on explicit kfile_flush().
+	KFB_LINE, ///< Also flush every time a newline is written.
+} KFileBufMode;
+
+/**
+ * Buffered KFile context structure.
+ */
+typedef struct KFileBuf
+{
+	KFile fd;             ///< KFile base class.
+	KFile *file;          ///< Underlying file.
+	KFileBufMode mode;    ///< Write buffer flush policy.
+
+	uint8_t *rx_buf;      ///< Read buffer.
+	size_t rx_size;       ///< Size of read buffer.
+	size_t rx_pos;        ///< Position of the next byte to read in rx_buf.
+	size_t rx_len;        ///< Number of valid bytes in rx_buf.
+
+	uint8_t *tx_buf;      ///< Write buffer.
+	size_t tx_size;       ///< Size of write buffer.
+	size_t tx_len;        ///< Number of bytes waiting in tx_buf.
+} KFileBuf;
+
+/**
+ * ID for buffered KFiles.
+ */
+#define KFT_KFILEBUF MAKE_ID('K', 'B', 'U', 'F')
+
+/**
+ * Convert + ASSERT from generic KFile to KFileBuf.
+ */
+INLINE KFileBuf * KFILEBUF_CAST(KFile *fd)
+{
+	ASSERT(fd->_type == KFT_KFILEBUF);
+	return (KFileBuf *)fd;
+}
+
+void kfilebuf_init(KFileBuf *fb, KFile *file, uint8_t *rx_buf, size_t rx_size,
+	uint8_t *tx_buf, size_t tx_size, KFileBufMode mode);
+int kfilebuf_peek(KFileBuf *fb);
+int kfilebuf_unget(int c, KFileBuf *fb);
+
+#endif /* KERN_KFILE_BUF_H */
@@ -0,0 +1,420 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Buffered KFile adapter test and benchmark.
+ *
+ * The adapter is tested on top of a RAM file (seekable) and of a
+ * simulated serial port (stream).
+ * The serial port accounts a fixed cost for every driver call (the
+ * virtual dispatch plus the txStart of the hardware) and a cost per byte
+ * moved in the FIFO; the benchmark compares kfile_printf() on the raw
+ * port with kfile_printf() through the adapter. Results are printed
+ * on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<raw|buffered> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "kfile_buf.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+
+#define SER_CALL_US   12  ///< Cost of a serial driver call (dispatch, locking, txStart).
+#define SER_BYTE_NS   400 ///< Cost of moving one byte in the serial FIFO.
+
+#define RAM_FILE_SIZE 1024
+
+/**
+ * Simulated serial port.
+ */
+static struct
+{
+	KFile fd;
+	char out[4096];
+	size_t out_len;
+	const char *in;
+	unsigned long writes;
+	unsigned long reads;
+	unsigned long bytes;
+	long room;            ///< Bytes accepted before failing, -1 for no limit.
+} ser;
+
+static size_t ser_write(UNUSED_ARG(struct KFile *, fd), const void *buf, size_t size)
+{
+	size_t len = MIN(size, sizeof(ser.out) - ser.out_len);
+
+	if (ser.room >= 0)
+	{
+		size = len = MIN(len, (size_t)ser.room);
+		ser.room -= len;
+	}
+
+	memcpy(ser.out + ser.out_len, buf, len);
+	ser.out_len += len;
+	ser.writes++;
+	ser.bytes += size;
+	return size;
+}
+
+static size_t ser_read(UNUSED_ARG(struct KFile *, fd), void *buf, size_t size)
+{
+	size_t len = MIN(size, strlen(ser.in));
+
+	memcpy(buf, ser.in, len);
+	ser.in += len;
+	ser.reads++;
+	return len;
+}
+
+static int ser_flush(UNUSED_ARG(struct KFile *, fd))
+{
+	return 0;
+}
+
+static void ser_init(const char *in)
+{
+	memset(&ser, 0, sizeof(ser));
+	ser.room = -1;
+	ser.in = in;
+	ser.fd.write = ser_write;
+	ser.fd.read = ser_read;
+	ser.fd.flush = ser_flush;
+	ser.fd.close = kfile_genericClose;
+}
+
+/**
+ * Simulated RAM file.
+ */
+static struct
+{
+	KFile fd;
+	uint8_t mem[RAM_FILE_SIZE];
+	unsigned long reads;
+	unsigned long writes;
+} ram;
+
+static size_t ram_write(struct KFile *fd, const void *buf, size_t size)
+{
+	size = MIN(size, (size_t)(RAM_FILE_SIZE - fd->seek_pos));
+	memcpy(ram.mem + fd->seek_pos, buf, size);
+	fd->seek_pos += size;
+	fd->size = MAX(fd->size, fd->seek_pos);
+	ram.writes++;
+	return size;
+}
+
+static size_t ram_read(struct KFile *fd, void *buf, size_t size)
+{
+	size = MIN(size, (size_t)(fd->size - fd->seek_pos));
+	memcpy(buf, ram.mem + fd->seek_pos, size);
+	fd->seek_pos += size;
+	ram.reads++;
+	return size;
+}
+
+static void ram_init(void)
+{
+	memset(&ram, 0, sizeof(ram));
+	ram.fd.write = ram_write;
+	ram.fd.read = ram_read;
+	ram.fd.seek = kfile_genericSeek;
+	ram.fd.close = kfile_genericClose;
+}
+
+static uint8_t rx_buf[16];
+static uint8_t tx_buf[32];
+
+static void lineMode(void)
+{
+	KFileBuf fb;
+
+	ser_init("");
+	kfilebuf_init(&fb, &ser.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_LINE);
+
+	ASSERT(kfile_print(&fb.fd, "hello") == 0);
+	ASSERT(ser.writes == 0);
+	ASSERT(kfile_printf(&fb.fd, " %d\nworld", 42) == 9);
+	ASSERT(ser.writes == 1);
+	ASSERT(ser.out_len == 9 && memcmp(ser.out, "hello 42\n", 9) == 0);
+	ASSERT(kfile_flush(&fb.fd) == 0);
+	ASSERT(ser.writes == 2);
+	ASSERT(ser.out_len == 14 && memcmp(ser.out + 9, "world", 5) == 0);
+}
+
+static void fullMode(void)
+{
+	KFileBuf fb;
+	char big[100];
+
+	ser_init("");
+	kfilebuf_init(&fb, &ser.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_FULL);
+
+	/* Newlines do not flush, a full buffer does */
+	for (int i = 0; i < 31; i++)
+		ASSERT(kfile_putc('\n', &fb.fd) == '\n');
+	ASSERT(ser.writes == 0);
+	ASSERT(kfile_putc('x', &fb.fd) == 'x');
+	ASSERT(ser.writes == 1 && ser.out_len == 32);
+
+	/* Big writes go straight to the file */
+	memset(big, 'b', sizeof(big));
+	ASSERT(kfile_write(&fb.fd, big, sizeof(big)) == sizeof(big));
+	ASSERT(ser.writes == 2 && ser.out_len == 132);
+	ASSERT(kfile_close(&fb.fd) == 0);
+}
+
+/**
+ * Data that the file does not accept stays in the buffer, and is not
+ * counted as written if it does not fit there.
+ */
+static void shortWrite(void)
+{
+	KFileBuf fb;
+	char big[100];
+
+	ser_init("");
+	kfilebuf_init(&fb, &ser.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_LINE);
+
+	/* Partial write on newline: the tail is kept */
+	ser.room = 10;
+	ASSERT(kfile_write(&fb.fd, "0123456789abcdef\n", 17) == 17);
+	ASSERT(ser.out_len == 10 && fb.tx_len == 7);
+
+	/* Failing file: only what fits in the buffer is taken */
+	memset(big, 'x', sizeof(big));
+	ASSERT(kfile_write(&fb.fd, big, 40) == sizeof(tx_buf) - 7);
+	ASSERT(kfile_write(&fb.fd, big, 40) == 0);
+	ASSERT(kfile_flush(&fb.fd) == EOF);
+	ASSERT(ser.out_len == 10);
+
+	/* The file recovers: nothing has been lost */
+	ser.room = -1;
+	ASSERT(kfile_flush(&fb.fd) == 0);
+	ASSERT(ser.out_len == 17 + sizeof(tx_buf) - 7);
+	ASSERT(memcmp(ser.out, "0123456789abcdef\nxxx", 20) == 0);
+
+	/* Big writes report the bytes accepted by the file */
+	ser.room = 50;
+	ASSERT(kfile_write(&fb.fd, big, sizeof(big)) == 50);
+	ser.room = -1;
+	ASSERT(kfile_close(&fb.fd) == 0);
+}
+
+static void streamRead(void)
+{
+	KFileBuf fb;
+	char buf[8];
+
+	ser_init("abc def");
+	kfilebuf_init(&fb, &ser.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_LINE);
+
+	/* Pending output is flushed before reading */
+	ASSERT(kfile_print(&fb.fd, "> ") == 0);
+	ASSERT(kfilebuf_peek(&fb) == 'a');
+	ASSERT(ser.out_len == 2);
+
+	/* Streams are never read ahead */
+	ASSERT(strcmp(ser.in, "bc def") == 0);
+	ASSERT(kfile_getc(&fb.fd) == 'a');
+	ASSERT(kfile_getc(&fb.fd) == 'b');
+	ASSERT(kfilebuf_unget('b', &fb) == 'b');
+	ASSERT(kfilebuf_unget('a', &fb) == 'a');
+	ASSERT(kfile_read(&fb.fd, buf, 4) == 4);
+	ASSERT(memcmp(buf, "abc ", 4) == 0);
+	ASSERT(kfile_read(&fb.fd, buf, sizeof(buf)) == 3);
+	ASSERT(kfile_getc(&fb.fd) == EOF);
+}
+
+static void seekableFile(void)
+{
+	KFileBuf fb;
+	uint8_t buf[RAM_FILE_SIZE / 2];
+
+	ram_init();
+	kfilebuf_init(&fb, &ram.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_FULL);
+
+	for (int i = 0; i < 200; i++)
+		ASSERT(kfile_putc(i, &fb.fd) == i);
+	ASSERT(fb.fd.seek_pos == 200 && fb.fd.size == 200);
+	ASSERT(ram.writes == 6);
+
+	/* Reads are done in blocks of the buffer size */
+	ASSERT(kfile_seek(&fb.fd, 10, KSM_SEEK_SET) == 10);
+	ASSERT(ram.fd.size == 200);
+	ram.reads = 0;
+	for (int i = 10; i < 42; i++)
+		ASSERT(kfile_getc(&fb.fd) == i);
+	ASSERT(ram.reads == 2);
+
+	/* A write after a read-ahead goes to the right position */
+	ASSERT(kfile_getc(&fb.fd) == 42);
+	ASSERT(kfile_putc(0xaa, &fb.fd) == 0xaa);
+	ASSERT(fb.fd.seek_pos == 44);
+	ASSERT(kfile_getc(&fb.fd) == 44);
+	ASSERT(ram.mem[43] == 0xaa);
+
+	ASSERT(kfile_seek(&fb.fd, -2, KSM_SEEK_CUR) == 43);
+	ASSERT(kfile_getc(&fb.fd) == 0xaa);
+	ASSERT(kfilebuf_unget(0xaa, &fb) == 0xaa);
+	ASSERT(fb.fd.seek_pos == 43);
+
+	/* Append at the end and read back everything */
+	ASSERT(kfile_seek(&fb.fd, 0, KSM_SEEK_END) == 200);
+	ASSERT(kfile_print(&fb.fd, "end") == 0);
+	ASSERT(fb.fd.size == 203);
+	ASSERT(kfile_seek(&fb.fd, 0, KSM_SEEK_SET) == 0);
+	ASSERT(kfile_read(&fb.fd, buf, sizeof(buf)) == 203);
+	ASSERT(memcmp(buf + 200, "end", 3) == 0);
+	for (int i = 0; i < 200; i++)
+		ASSERT(buf[i] == (i == 43 ? 0xaa : i));
+}
+
+static void vectoredIo(void)
+{
+	KFileBuf fb;
+	char hdr[] = "HDR:", payload[] = "payload", crc[] = "\n";
+	char r1[4], r2[7];
+	KFileIov wv[] = { { hdr, 4 }, { payload, 7 }, { crc, 1 } };
+	KFileIov rv[] = { { r1, sizeof(r1) }, { r2, sizeof(r2) } };
+	size_t len;
+	char *buf;
+
+	/* RAM file has no vectored I/O nor buffers to lend */
+	ram_init();
+	ASSERT(kfile_borrow(&ram.fd, &len) == NULL && len == 0);
+	ASSERT(kfile_writev(&ram.fd, wv, countof(wv)) == 12);
+	ASSERT(ram.writes == 3);
+	ASSERT(kfile_seek(&ram.fd, 0, KSM_SEEK_SET) == 0);
+	ASSERT(kfile_readv(&ram.fd, rv, countof(rv)) == 11);
+	ASSERT(memcmp(r1, "HDR:", 4) == 0 && memcmp(r2, "payload", 7) == 0);
+
+	/* Buffered file: gathered in one driver call */
+	ser_init("");
+	kfilebuf_init(&fb, &ser.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_LINE);
+	ASSERT(kfile_writev(&fb.fd, wv, countof(wv)) == 12);
+	ASSERT(ser.writes == 1 && memcmp(ser.out, "HDR:payload\n", 12) == 0);
+
+	/* Produce data straight in the write buffer */
+	buf = kfile_borrow(&fb.fd, &len);
+	ASSERT(buf && len == sizeof(tx_buf));
+	memcpy(buf, "zero", 4);
+	ASSERT(kfile_commit(&fb.fd, 4) == 4);
+	ASSERT(ser.writes == 1);
+	buf = kfile_borrow(&fb.fd, &len);
+	ASSERT(buf && len == sizeof(tx_buf) - 4);
+	memcpy(buf, "copy\n", 5);
+	ASSERT(kfile_commit(&fb.fd, 5) == 5);
+	ASSERT(ser.writes == 2 && memcmp(ser.out + 12, "zerocopy\n", 9) == 0);
+}
+
+#define BENCH_LINES 100
+
+static void printLines(KFile *fd)
+{
+	for (int i = 0; i < BENCH_LINES; i++)
+		kfile_printf(fd, "sensor %d: %d mV, status %s\n", i, i * 37, i & 1 ? "ok" : "warn");
+	kfile_flush(fd);
+}
+
+static void benchReport(const char *path)
+{
+	unsigned long time_us = ser.writes * SER_CALL_US + ser.bytes * SER_BYTE_NS / 1000;
+
+	printf("BENCH scenario=printf path=%s lines=%d bytes=%lu calls=%lu time_us=%lu bytes_per_s=%lu\n",
+		path, BENCH_LINES, ser.bytes, ser.writes, time_us,
+		time_us ? (unsigned long)((uint64_t)ser.bytes * 1000000 / time_us) : 0);
+}
+
+static void benchPrintf(void)
+{
+	KFileBuf fb;
+	static char raw_out[sizeof(ser.out)];
+	size_t raw_len;
+
+	ser_init("");
+	printLines(&ser.fd);
+	benchReport("raw");
+	raw_len = ser.out_len;
+	memcpy(raw_out, ser.out, raw_len);
+
+	ser_init("");
+	kfilebuf_init(&fb, &ser.fd, rx_buf, sizeof(rx_buf), tx_buf, sizeof(tx_buf), KFB_LINE);
+	printLines(&fb.fd);
+	benchReport("buffered");
+
+	/* Same output, with one driver call per line */
+	ASSERT(ser.out_len == raw_len && memcmp(ser.out, raw_out, raw_len) == 0);
+	ASSERT(ser.writes <= BENCH_LINES * 2);
+}
+
+int kfile_buf_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int kfile_buf_testRun(void)
+{
+	lineMode();
+	fullMode();
+	shortWrite();
+	streamRead();
+	seekableFile();
+	vectoredIo();
+	benchPrintf();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int kfile_buf_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kfile_buf);
+
+#include <kern/kfile_buf.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif // UNIT_TEST
@@ -0,0 +1,414 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Block cache KFile adapter.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "kfile_cache.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN, MAX */
+
+#include <string.h>
+
+/**
+ * Write block \a blk to the file, if dirty.
+ * \return 0 if ok, EOF on errors.
+ */
+static int kfilecache_writeBack(KFileCache *kc, KFileCacheBlock *blk)
+{
+	if (!blk->dirty)
+		return 0;
+
+	kc->stats.writebacks++;
+	if (kfile_seek(kc->file, blk->addr, KSM_SEEK_SET) != blk->addr
+	 || kfile_write(kc->file, blk->data, blk->len) != blk->len)
+		return EOF;
+
+	/* Still dirty on errors, so that the write is retried later */
+	blk->dirty = false;
+	return 0;
+}
+
+/**
+ * Move \a blk at the head of the LRU list.
+ */
+INLINE void kfilecache_touch(KFileCache *kc, KFileCacheBlock *blk)
+{
+	REMOVE(&blk->link);
+	ADDHEAD(&kc->lru, &blk->link);
+}
+
+/**
+ * Empty the least recently used block, to be reused.
+ * \return the block, moved at the head of the LRU list, or NULL if
+ *         it could not be written back; in that case the block stays
+ *         cached and dirty.
+ */
+static KFileCacheBlock *kfilecache_evict(KFileCache *kc)
+{
+	KFileCacheBlock *blk = (KFileCacheBlock *)LIST_TAIL(&kc->lru);
+
+	if (kfilecache_writeBack(kc, blk) == EOF)
+		return NULL;
+
+	blk->addr = KFC_INVALID;
+	blk->len = 0;
+	kfilecache_touch(kc, blk);
+	return blk;
+}
+
+static KFileCacheBlock *kfilecache_find(KFileCache *kc, kfile_off_t addr)
+{
+	KFileCacheBlock *blk;
+
+	FOREACH_NODE(blk, &kc->lru)
+		if (blk->addr == addr)
+			return blk;
+	return NULL;
+}
+
+/**
+ * \return the bytes of the block at \a addr present in the file.
+ */
+static size_t kfilecache_fileLen(KFileCache *kc, kfile_off_t addr)
+{
+	kfile_off_t size = kc->file->size;
+
+	return addr < size ? (size_t)MIN((kfile_off_t)kc->block_size, size - addr) : 0;
+}
+
+/**
+ * Get the block at \a addr, loading it from the file if \a load is true.
+ * \return the block, moved at the head of the LRU list, or NULL on errors.
+ */
+static KFileCacheBlock *kfilecache_get(KFileCache *kc, kfile_off_t addr, bool load)
+{
+	KFileCacheBlock *blk = kfilecache_find(kc, addr);
+	KFileCacheBlock *ahead = NULL;
+	kfile_off_t next = addr + kc->block_size;
+	KFileIov iov[2];
+	int iovcnt = 1;
+
+	if (blk)
+	{
+		kc->stats.hits++;
+		kfilecache_touch(kc, blk);
+		return blk;
+	}
+
+	kc->stats.misses++;
+	if (!(blk = kfilecache_evict(kc)))
+		return NULL;
+	if (!load)
+	{
+		blk->addr = addr;
+		return blk;
+	}
+
+	iov[0].base = blk->data;
+	iov[0].len = kfilecache_fileLen(kc, addr);
+
+	/* Sequential misses: load the next block with the same read */
+	if ((kc->mode & KFC_READAHEAD)
+	 && kc->last_miss != KFC_INVALID && kc->last_miss + (kfile_off_t)kc->block_size == addr
+	 && iov[0].len == kc->block_size && kfilecache_fileLen(kc, next)
+	 && LIST_TAIL(&kc->lru) != &blk->link && !kfilecache_find(kc, next))
+	{
+		if ((ahead = kfilecache_evict(kc)))
+		{
+			iov[1].base = ahead->data;
+			iov[1].len = kfilecache_fileLen(kc, next);
+			iovcnt = 2;
+		}
+		kfilecache_touch(kc, blk);
+	}
+
+	if (iov[0].len)
+	{
+		size_t len;
+
+		if (kfile_seek(kc->file, addr, KSM_SEEK_SET) != addr)
+			return NULL;
+
+		len = kfile_readv(kc->file, iov, iovcnt);
+		if (len < iov[0].len)
+			return NULL;
+		if (ahead && len == iov[0].len + iov[1].len)
+		{
+			ahead->addr = next;
+			ahead->len = iov[1].len;
+			kc->stats.readaheads++;
+		}
+		else
+			ahead = NULL;
+	}
+
+	blk->addr = addr;
+	blk->len = iov[0].len;
+	kc->last_miss = ahead ? next : addr;
+	return blk;
+}
+
+/**
+ * Copy \a len bytes of \a buf at offset \a off of \a blk.
+ */
+static void kfilecache_copyIn(KFileCacheBlock *blk, size_t off, const uint8_t *buf, size_t len)
+{
+	/* Writes beyond the end of file leave a hole of zeros */
+	if (blk->len < off)
+		memset(blk->data + blk->len, 0, off - blk->len);
+
+	memcpy(blk->data + off, buf, len);
+	blk->len = MAX(blk->len, off + len);
+}
+
+static size_t kfilecache_read(struct KFile *fd, void *_buf, size_t size)
+{
+	KFileCache *kc = KFILECACHE_CAST(fd);
+	uint8_t *buf = (uint8_t *)_buf;
+	size_t total = 0;
+
+	if (fd->seek_pos >= fd->size)
+		return 0;
+	size = MIN(size, (size_t)(fd->size - fd->seek_pos));
+
+	while (size)
+	{
+		size_t off = fd->seek_pos % kc->block_size;
+		KFileCacheBlock *blk = kfilecache_get(kc, fd->seek_pos - off, true);
+		size_t len;
+
+		if (!blk || blk->len <= off)
+			break;
+
+		len = MIN(size, blk->len - off);
+		memcpy(buf, blk->data + off, len);
+		buf += len;
+		size -= len;
+		total += len;
+		fd->seek_pos += len;
+	}
+	return total;
+}
+
+/**
+ * Write \a size bytes of \a buf to the file, updating the cached blocks.
+ */
+static size_t kfilecache_writeThrough(KFileCache *kc, const uint8_t *buf, size_t size)
+{
+	kfile_off_t pos = kc->fd.seek_pos;
+	KFileCacheBlock *blk;
+	size_t written;
+
+	if (kfile_seek(kc->file, pos, KSM_SEEK_SET) != pos)
+		return 0;
+	written = kfile_write(kc->file, buf, size);
+
+	FOREACH_NODE(blk, &kc->lru)
+	{
+		kfile_off_t start, end;
+
+		if (blk->addr == KFC_INVALID)
+			continue;
+
+		start = MAX(blk->addr, pos);
+		end = MIN(blk->addr + (kfile_off_t)kc->block_size, pos + (kfile_off_t)written);
+		if (start < end)
+			kfilecache_copyIn(blk, start - blk->addr, buf + (start - pos), end - start);
+	}
+	return written;
+}
+
+static size_t kfilecache_write(struct KFile *fd, const void *_buf, size_t size)
+{
+	KFileCache *kc = KFILECACHE_CAST(fd);
+	const uint8_t *buf = (const uint8_t *)_buf;
+	size_t written = 0;
+
+	if (kc->mode & KFC_WRITETHROUGH)
+		written = kfilecache_writeThrough(kc, buf, size);
+	else
+	{
+		kfile_off_t pos = fd->seek_pos;
+
+		while (size)
+		{
+			size_t off = pos % kc->block_size;
+			size_t len = MIN(size, kc->block_size - off);
+			/* Whole blocks are not loaded */
+			KFileCacheBlock *blk = kfilecache_get(kc, pos - off, len != kc->block_size);
+
+			if (!blk)
+				break;
+
+			kfilecache_copyIn(blk, off, buf + written, len);
+			blk->dirty = true;
+			size -= len;
+			written += len;
+			pos += len;
+		}
+	}
+
+	fd->seek_pos += written;
+	fd->size = MAX(fd->size, fd->seek_pos);
+	return written;
+}
+
+/**
+ * Write all dirty blocks to the file.
+ * \return 0 if ok, EOF on errors.
+ */
+static int kfilecache_writeAll(KFileCache *kc)
+{
+	KFileCacheBlock *blk;
+	int err = 0;
+
+	FOREACH_NODE(blk, &kc->lru)
+		if (kfilecache_writeBack(kc, blk) == EOF)
+			err = EOF;
+	return err;
+}
+
+static int kfilecache_flush(struct KFile *fd)
+{
+	KFileCache *kc = KFILECACHE_CAST(fd);
+	int err = kfilecache_writeAll(kc);
+
+	if (kc->file->flush && kfile_flush(kc->file) == EOF)
+		err = EOF;
+	return err;
+}
+
+/**
+ * Drop all the cached blocks, writing the dirty ones to the file.
+ * Call it when the file has been modified without passing through \a kc.
+ * \return 0 if ok, EOF on errors.
+ */
+int kfilecache_invalidate(KFileCache *kc)
+{
+	KFileCacheBlock *blk;
+	int err = kfilecache_writeAll(kc);
+
+	/* Blocks that could not be written back are kept */
+	FOREACH_NODE(blk, &kc->lru)
+		if (!blk->dirty)
+		{
+			blk->addr = KFC_INVALID;
+			blk->len = 0;
+		}
+	kc->last_miss = KFC_INVALID;
+	return err;
+}
+
+static int kfilecache_close(struct KFile *fd)
+{
+	KFileCache *kc = KFILECACHE_CAST(fd);
+	int err = kfilecache_flush(fd);
+
+	if (kfile_close(kc->file) == EOF)
+		err = EOF;
+	return err;
+}
+
+static struct KFile *kfilecache_reopen(struct KFile *fd)
+{
+	KFileCache *kc = KFILECACHE_CAST(fd);
+
+	kfilecache_invalidate(kc);
+
+	kc->file = kfile_reopen(kc->file);
+	fd->seek_pos = kc->file->seek_pos;
+	fd->size = kc->file->size;
+	return fd;
+}
+
+static int kfilecache_error(struct KFile *fd)
+{
+	KFileCache *kc = KFILECACHE_CAST(fd);
+
+	return kc->file->error ? kfile_error(kc->file) : 0;
+}
+
+static void kfilecache_clearerr(struct KFile *fd)
+{
+	KFileCache *kc = KFILECACHE_CAST(fd);
+
+	if (kc->file->clearerr)
+		kfile_clearerr(kc->file);
+}
+
+/**
+ * Init block cache \a kc on top of seekable \a file.
+ * \a num_blocks blocks long \a block_size bytes are cached, using the
+ * descriptors in \a blocks and the \a num_blocks * \a block_size bytes
+ * of \a data. \a mode selects the write and read-ahead policies (KFC_*).
+ */
+void kfilecache_init(KFileCache *kc, KFile *file, KFileCacheBlock *blocks, uint8_t *data,
+	size_t num_blocks, size_t block_size, int mode)
+{
+	ASSERT(file->seek);
+	ASSERT(blocks && data);
+	ASSERT(num_blocks && block_size);
+
+	memset(kc, 0, sizeof(*kc));
+	DB(kc->fd._type = KFT_KFILECACHE);
+
+	kc->file = file;
+	kc->mode = mode;
+	kc->block_size = block_size;
+	kc->last_miss = KFC_INVALID;
+
+	LIST_INIT(&kc->lru);
+	for (size_t i = 0; i < num_blocks; i++)
+	{
+		blocks[i].addr = KFC_INVALID;
+		blocks[i].len = 0;
+		blocks[i].dirty = false;
+		blocks[i].data = data + i * block_size;
+		ADDTAIL(&kc->lru, &blocks[i].link);
+	}
+
+	kc->fd.seek_pos = file->seek_pos;
+	kc->fd.size = file->size;
+
+	kc->fd.read = kfilecache_read;
+	kc->fd.write = kfilecache_write;
+	kc->fd.seek = kfile_genericSeek;
+	kc->fd.flush = kfilecache_flush;
+	kc->fd.close = kfilecache_close;
+	kc->fd.reopen = kfilecache_reopen;
+	kc->fd.error = kfilecache_error;
+	kc->fd.clearerr = kfilecache_clearerr;
+}
@@ -0,0 +1,146 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Block cache KFile adapter.
+ *
+ * A KFileCache keeps the most recently used blocks of another seekable
+ * KFile (a DataFlash, a Flash25, an EEPROM...) in RAM. Reads and writes
+ * are served from the cached blocks; on a miss the least recently used
+ * block is reused, writing it back first if it is dirty.
+ *
+ * Modes:
+ * \li KFC_WRITEBACK: writes only modify the cached block, which is
+ *     written to the file when evicted or on kfile_flush();
+ * \li KFC_WRITETHROUGH: writes go to the file at once, and update the
+ *     cached block if present;
+ * \li KFC_READAHEAD (can be or'ed to the previous ones): when a miss
+ *     follows a miss on the previous block, the next block is loaded too,
+ *     with the same vectored read.
+ *
+ * Hits, misses, read-aheads and write-backs are counted in \a stats.
+ *
+ * Usage:
+ * \code
+ * #define CACHE_BLOCKS 4
+ * static KFileCacheBlock blocks[CACHE_BLOCKS];
+ * static uint8_t cache_data[CACHE_BLOCKS * DATAFLASH_PAGE];
+ * KFileCache cache;
+ *
+ * kfilecache_init(&cache, &flash.fd, blocks, cache_data, CACHE_BLOCKS, DATAFLASH_PAGE,
+ *     KFC_WRITEBACK | KFC_READAHEAD);
+ * kfile_read(&cache.fd, &hdr, sizeof(hdr));
+ * \endcode
+ *
+ * \note Data is kept in the cache until kfile_flush(), kfile_close()
+ *       or kfile_reopen() in write-back mode.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef KERN_KFILE_CACHE_H
+#define KERN_KFILE_CACHE_H
+
+#include <cfg/macros.h> /* BV() */
+
+#include <kern/kfile.h>
+#include <struct/list.h>
+
+/**
+ * Cache modes.
+ * \{
+ */
+#define KFC_WRITEBACK     0      ///< Write dirty blocks on eviction or flush.
+#define KFC_WRITETHROUGH  BV(0)  ///< Write to the file at once.
+#define KFC_READAHEAD     BV(1)  ///< Load the next block on sequential misses.
+/* \} */
+
+/**
+ * Address of an empty block.
+ */
+#define KFC_INVALID  ((kfile_off_t)-1)
+
+/**
+ * A cached block.
+ */
+typedef struct KFileCacheBlock
+{
+	Node link;           ///< Link in the LRU list.
+	kfile_off_t addr;    ///< Offset of the block in the file, KFC_INVALID if empty.
+	size_t len;          ///< Valid bytes, short for the last block of the file.
+	bool dirty;          ///< True if modified and not written to the file.
+	uint8_t *data;       ///< Block data.
+} KFileCacheBlock;
+
+/**
+ * Cache statistics.
+ */
+typedef struct KFileCacheStats
+{
+	uint32_t hits;       ///< Blocks found in the cache.
+	uint32_t misses;     ///< Blocks loaded from the file.
+	uint32_t readaheads; ///< Blocks loaded in advance.
+	uint32_t writebacks; ///< Dirty blocks written to the file.
+} KFileCacheStats;
+
+/**
+ * Block cache KFile context structure.
+ */
+typedef struct KFileCache
+{
+	KFile fd;             ///< KFile base class.
+	KFile *file;          ///< Underlying file.
+	int mode;             ///< Cache mode (KFC_*).
+	size_t block_size;    ///< Size of a block.
+	List lru;             ///< Cached blocks, most recently used first.
+	kfile_off_t last_miss; ///< Address of the last block missed.
+	KFileCacheStats stats; ///< Statistics.
+} KFileCache;
+
+/**
+ * ID for block cache KFiles.
+ */
+#define KFT_KFILECACHE MAKE_ID('K', 'C', 'A', 'C')
+
+/**
+ * Convert + ASSERT from generic KFile to KFileCache.
+ */
+INLINE KFileCache * KFILECACHE_CAST(KFile *fd)
+{
+	ASSERT(fd->_type == KFT_KFILECACHE);
+	return (KFileCache *)fd;
+}
+
+void kfilecache_init(KFileCache *kc, KFile *file, KFileCacheBlock *blocks, uint8_t *data,
+	size_t num_blocks, size_t block_size, int mode);
+int kfilecache_invalidate(KFileCache *kc);
+
+#endif /* KERN_KFILE_CACHE_H */
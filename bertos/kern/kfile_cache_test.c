@@ -0,0 +1,449 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Block cache KFile adapter test and benchmark.
+ *
+ * The cache is tested on top of a simulated storage device, that
+ * accounts a fixed cost for every command (address setup for reads,
+ * page program for writes) plus a cost per byte moved on the bus, and
+ * reads contiguous vectors with a single command.
+ * The benchmark runs a small filesystem-like workload (header reads,
+ * appended log records, random record lookups) directly on the device
+ * and through the cache. Results are printed on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<name> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "kfile_cache.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+
+#define DEV_SIZE      8192
+#define READ_CMD_US   100   ///< Read command and address setup.
+#define WRITE_CMD_US  3000  ///< Page program.
+#define BYTE_US       1     ///< One byte on the bus.
+
+#define BLOCK_SIZE    64
+#define NUM_BLOCKS    4
+
+/**
+ * Simulated storage device.
+ */
+static struct
+{
+	KFile fd;
+	uint8_t mem[DEV_SIZE];
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long now;
+	bool fail;            ///< Simulate a write error.
+} dev;
+
+static size_t dev_write(struct KFile *fd, const void *buf, size_t size)
+{
+	if (dev.fail)
+		return 0;
+
+	size = MIN(size, (size_t)(DEV_SIZE - fd->seek_pos));
+	memcpy(dev.mem + fd->seek_pos, buf, size);
+	fd->seek_pos += size;
+	dev.writes++;
+	dev.now += WRITE_CMD_US + size * BYTE_US;
+	return size;
+}
+
+static size_t dev_readv(struct KFile *fd, const KFileIov *iov, int iovcnt)
+{
+	size_t total = 0;
+
+	for (int i = 0; i < iovcnt; i++)
+	{
+		size_t size = MIN(iov[i].len, (size_t)(DEV_SIZE - fd->seek_pos));
+
+		memcpy(iov[i].base, dev.mem + fd->seek_pos, size);
+		fd->seek_pos += size;
+		total += size;
+	}
+	dev.reads++;
+	dev.now += READ_CMD_US + total * BYTE_US;
+	return total;
+}
+
+static size_t dev_read(struct KFile *fd, void *buf, size_t size)
+{
+	KFileIov iov = { buf, size };
+
+	return dev_readv(fd, &iov, 1);
+}
+
+static int dev_flush(UNUSED_ARG(struct KFile *, fd))
+{
+	return 0;
+}
+
+static void dev_init(void)
+{
+	memset(&dev, 0, sizeof(dev));
+	for (size_t i = 0; i < DEV_SIZE; i++)
+		dev.mem[i] = (uint8_t)(i * 11 + 5);
+	dev.fd.size = DEV_SIZE;
+	dev.fd.write = dev_write;
+	dev.fd.read = dev_read;
+	dev.fd.readv = dev_readv;
+	dev.fd.seek = kfile_genericSeek;
+	dev.fd.flush = dev_flush;
+	dev.fd.close = kfile_genericClose;
+}
+
+static KFileCacheBlock blocks[NUM_BLOCKS];
+static uint8_t cache_data[NUM_BLOCKS * BLOCK_SIZE];
+static uint8_t ref[DEV_SIZE];
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return rnd_state >> 8;
+}
+
+static void readAt(KFile *fd, kfile_off_t pos, void *buf, size_t len)
+{
+	ASSERT(kfile_seek(fd, pos, KSM_SEEK_SET) == pos);
+	ASSERT(kfile_read(fd, buf, len) == len);
+}
+
+static void writeAt(KFile *fd, kfile_off_t pos, const void *buf, size_t len)
+{
+	ASSERT(kfile_seek(fd, pos, KSM_SEEK_SET) == pos);
+	ASSERT(kfile_write(fd, buf, len) == len);
+}
+
+/**
+ * Random reads and writes, checked against a reference copy.
+ */
+static void randomOps(int mode)
+{
+	KFileCache kc;
+	uint8_t buf[200];
+
+	kprintf("Random operations, mode %d\n", mode);
+	dev_init();
+	memcpy(ref, dev.mem, sizeof(ref));
+	kfilecache_init(&kc, &dev.fd, blocks, cache_data, NUM_BLOCKS, BLOCK_SIZE, mode);
+	ASSERT(kc.fd.size == DEV_SIZE);
+
+	for (int i = 0; i < 2000; i++)
+	{
+		size_t len = rnd() % sizeof(buf) + 1;
+		kfile_off_t pos = rnd() % (DEV_SIZE - len);
+
+		if (rnd() % 2)
+		{
+			for (size_t j = 0; j < len; j++)
+				buf[j] = (uint8_t)rnd();
+			writeAt(&kc.fd, pos, buf, len);
+			memcpy(ref + pos, buf, len);
+		}
+		else
+		{
+			readAt(&kc.fd, pos, buf, len);
+			ASSERT(memcmp(buf, ref + pos, len) == 0);
+		}
+	}
+
+	/* Reads at the end of file are short */
+	ASSERT(kfile_seek(&kc.fd, DEV_SIZE - 10, KSM_SEEK_SET) == DEV_SIZE - 10);
+	ASSERT(kfile_read(&kc.fd, buf, sizeof(buf)) == 10);
+	ASSERT(kfile_read(&kc.fd, buf, sizeof(buf)) == 0);
+
+	ASSERT(kfile_flush(&kc.fd) == 0);
+	ASSERT(memcmp(dev.mem, ref, sizeof(ref)) == 0);
+	ASSERT(kc.stats.hits && kc.stats.misses);
+	ASSERT(kfile_close(&kc.fd) == 0);
+}
+
+static void lru(void)
+{
+	KFileCache kc;
+	uint8_t c;
+
+	kprintf("LRU\n");
+	dev_init();
+	kfilecache_init(&kc, &dev.fd, blocks, cache_data, NUM_BLOCKS, BLOCK_SIZE, KFC_WRITEBACK);
+
+	for (int i = 0; i < NUM_BLOCKS; i++)
+		readAt(&kc.fd, i * BLOCK_SIZE, &c, 1);
+	ASSERT(kc.stats.misses == NUM_BLOCKS && kc.stats.hits == 0);
+
+	/* Block 0 is used again, block 1 is the oldest */
+	readAt(&kc.fd, 10, &c, 1);
+	ASSERT(kc.stats.hits == 1);
+	readAt(&kc.fd, NUM_BLOCKS * BLOCK_SIZE, &c, 1);
+	ASSERT(kc.stats.misses == NUM_BLOCKS + 1);
+	readAt(&kc.fd, 20, &c, 1);
+	ASSERT(kc.stats.hits == 2);
+	readAt(&kc.fd, BLOCK_SIZE, &c, 1);
+	ASSERT(kc.stats.misses == NUM_BLOCKS + 2);
+	ASSERT(kc.stats.readaheads == 0);
+	ASSERT(dev.reads == NUM_BLOCKS + 2);
+	ASSERT(kfile_close(&kc.fd) == 0);
+}
+
+static void writePolicies(void)
+{
+	KFileCache kc;
+	uint8_t buf[BLOCK_SIZE];
+
+	kprintf("Write policies\n");
+	memset(buf, 0x5A, sizeof(buf));
+
+	/* Write-back: whole blocks are neither loaded nor written until flush */
+	dev_init();
+	kfilecache_init(&kc, &dev.fd, blocks, cache_data, NUM_BLOCKS, BLOCK_SIZE, KFC_WRITEBACK);
+	for (int i = 0; i < 10; i++)
+		writeAt(&kc.fd, BLOCK_SIZE, buf, sizeof(buf));
+	writeAt(&kc.fd, 3, buf, 5);
+	ASSERT(dev.writes == 0);
+	ASSERT(dev.reads == 1);
+	ASSERT(kfile_flush(&kc.fd) == 0);
+	ASSERT(dev.writes == 2 && kc.stats.writebacks == 2);
+	ASSERT(memcmp(dev.mem + BLOCK_SIZE, buf, sizeof(buf)) == 0);
+	ASSERT(memcmp(dev.mem + 3, buf, 5) == 0);
+
+	/* Evicted dirty blocks are written back */
+	for (int i = 0; i < NUM_BLOCKS + 1; i++)
+		writeAt(&kc.fd, i * BLOCK_SIZE, buf, sizeof(buf));
+	ASSERT(dev.writes == 3);
+	ASSERT(kfile_close(&kc.fd) == 0);
+	ASSERT(dev.writes == 2 + NUM_BLOCKS + 1);
+
+	/* Write-through: the file is always up to date, cached copies too */
+	dev_init();
+	kfilecache_init(&kc, &dev.fd, blocks, cache_data, NUM_BLOCKS, BLOCK_SIZE, KFC_WRITETHROUGH);
+	readAt(&kc.fd, 0, buf, 10);
+	memset(buf, 0xA5, sizeof(buf));
+	writeAt(&kc.fd, 5, buf, 3);
+	ASSERT(dev.writes == 1);
+	ASSERT(memcmp(dev.mem + 5, buf, 3) == 0);
+	readAt(&kc.fd, 0, buf, 10);
+	ASSERT(buf[4] == (uint8_t)(4 * 11 + 5) && buf[5] == 0xA5 && buf[7] == 0xA5 && buf[8] == (uint8_t)(8 * 11 + 5));
+	ASSERT(dev.reads == 1);
+	ASSERT(kfile_close(&kc.fd) == 0);
+	ASSERT(kc.stats.writebacks == 0);
+}
+
+/**
+ * Dirty blocks that can not be written back stay in the cache, and are
+ * written when the device works again.
+ */
+static void writeErrors(void)
+{
+	KFileCache kc;
+	uint8_t buf[BLOCK_SIZE];
+
+	kprintf("Write errors\n");
+	dev_init();
+	memcpy(ref, dev.mem, sizeof(ref));
+	kfilecache_init(&kc, &dev.fd, blocks, cache_data, NUM_BLOCKS, BLOCK_SIZE, KFC_WRITEBACK);
+
+	memset(buf, 0x3C, sizeof(buf));
+	writeAt(&kc.fd, 5, buf, 10);
+	memcpy(ref + 5, buf, 10);
+
+	/* Failed flush */
+	dev.fail = true;
+	ASSERT(kfile_flush(&kc.fd) == EOF);
+	ASSERT(kfile_flush(&kc.fd) == EOF);
+
+	/* Fill the cache: the dirty block can not be evicted */
+	for (int i = 1; i < NUM_BLOCKS; i++)
+	{
+		memset(buf, i, sizeof(buf));
+		writeAt(&kc.fd, i * BLOCK_SIZE, buf, sizeof(buf));
+		memcpy(ref + i * BLOCK_SIZE, buf, sizeof(buf));
+	}
+	ASSERT(kfile_seek(&kc.fd, NUM_BLOCKS * BLOCK_SIZE, KSM_SEEK_SET) == NUM_BLOCKS * BLOCK_SIZE);
+	ASSERT(kfile_write(&kc.fd, buf, sizeof(buf)) == 0);
+	ASSERT(kfilecache_invalidate(&kc) == EOF);
+	ASSERT(memcmp(dev.mem, ref, sizeof(ref)) != 0);
+
+	/* The device recovers: nothing has been lost */
+	dev.fail = false;
+	ASSERT(kfile_flush(&kc.fd) == 0);
+	ASSERT(memcmp(dev.mem, ref, sizeof(ref)) == 0);
+	readAt(&kc.fd, 0, buf, sizeof(buf));
+	ASSERT(memcmp(buf, ref, sizeof(buf)) == 0);
+	ASSERT(kfile_close(&kc.fd) == 0);
+}
+
+static void readAhead(void)
+{
+	KFileCache kc;
+	uint8_t buf[BLOCK_SIZE / 2];
+
+	kprintf("Read-ahead\n");
+	dev_init();
+	kfilecache_init(&kc, &dev.fd, blocks, cache_data, NUM_BLOCKS, BLOCK_SIZE, KFC_WRITEBACK | KFC_READAHEAD);
+
+	ASSERT(kfile_seek(&kc.fd, 0, KSM_SEEK_SET) == 0);
+	for (int i = 0; i < 16; i++)
+	{
+		ASSERT(kfile_read(&kc.fd, buf, sizeof(buf)) == sizeof(buf));
+		ASSERT(memcmp(buf, dev.mem + i * sizeof(buf), sizeof(buf)) == 0);
+	}
+
+	/* Blocks 0 and 1 are missed, then every other block is read ahead */
+	ASSERT(kc.stats.misses == 5);
+	ASSERT(kc.stats.readaheads == 4);
+	ASSERT(dev.reads == 5);
+
+	/* Non sequential misses do not read ahead */
+	readAt(&kc.fd, 40 * BLOCK_SIZE, buf, 1);
+	readAt(&kc.fd, 20 * BLOCK_SIZE, buf, 1);
+	ASSERT(kc.stats.readaheads == 4);
+	ASSERT(kfile_close(&kc.fd) == 0);
+}
+
+/*
+ * Filesystem-like workload: a header at offset 0 read before every
+ * operation, 24 byte records appended to a log, and lookups of
+ * recent records.
+ */
+#define LOG_START  256
+#define RECORD     24
+#define RECORDS    200
+
+static void workload(KFile *fd)
+{
+	uint8_t hdr[16], rec[RECORD];
+
+	for (int i = 0; i < RECORDS; i++)
+	{
+		readAt(fd, 0, hdr, sizeof(hdr));
+
+		memset(rec, i, sizeof(rec));
+		writeAt(fd, LOG_START + i * RECORD, rec, sizeof(rec));
+
+		if (i % 4 == 3)
+		{
+			int j = i - rnd() % 4;
+
+			readAt(fd, 0, hdr, sizeof(hdr));
+			readAt(fd, LOG_START + j * RECORD, rec, sizeof(rec));
+			ASSERT(rec[0] == (uint8_t)j);
+		}
+	}
+	ASSERT(kfile_flush(fd) == 0);
+}
+
+static void bench(const char *path, int mode)
+{
+	KFileCache kc;
+	KFile *fd = &dev.fd;
+
+	dev_init();
+	if (mode >= 0)
+	{
+		kfilecache_init(&kc, &dev.fd, blocks, cache_data, NUM_BLOCKS, BLOCK_SIZE, mode);
+		fd = &kc.fd;
+	}
+
+	rnd_state = 1;
+	workload(fd);
+	for (int i = 0; i < RECORDS; i++)
+		ASSERT(dev.mem[LOG_START + i * RECORD] == (uint8_t)i);
+
+	if (mode >= 0)
+	{
+		uint32_t total = kc.stats.hits + kc.stats.misses;
+
+		printf("BENCH scenario=fs_log path=%s blocks=%d block_size=%d dev_reads=%lu dev_writes=%lu time_us=%lu hits=%lu misses=%lu readaheads=%lu writebacks=%lu hit_pct=%lu\n",
+			path, NUM_BLOCKS, BLOCK_SIZE, dev.reads, dev.writes, dev.now,
+			(unsigned long)kc.stats.hits, (unsigned long)kc.stats.misses,
+			(unsigned long)kc.stats.readaheads, (unsigned long)kc.stats.writebacks,
+			(unsigned long)(kc.stats.hits * 100 / total));
+	}
+	else
+		printf("BENCH scenario=fs_log path=%s dev_reads=%lu dev_writes=%lu time_us=%lu\n",
+			path, dev.reads, dev.writes, dev.now);
+}
+
+int kfile_cache_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int kfile_cache_testRun(void)
+{
+	randomOps(KFC_WRITEBACK);
+	randomOps(KFC_WRITEBACK | KFC_READAHEAD);
+	randomOps(KFC_WRITETHROUGH);
+	randomOps(KFC_WRITETHROUGH | KFC_READAHEAD);
+	lru();
+	writePolicies();
+	writeErrors();
+	readAhead();
+
+	bench("raw", -1);
+	bench("writethrough", KFC_WRITETHROUGH);
+	bench("writeback", KFC_WRITEBACK);
+	bench("writeback_readahead", KFC_WRITEBACK | KFC_READAHEAD);
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int kfile_cache_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kfile_cache);
+
+#include <kern/kfile_cache.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif /* UNIT_TEST */
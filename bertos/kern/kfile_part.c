@@ -0,0 +1,208 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Partition KFile adapter.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "kfile_part.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN */
+
+#include <string.h>
+
+#if CONFIG_KERN && CONFIG_KERN_SEMAPHORES
+	#define PART_LOCK(part)    do { if ((part)->sem) sem_obtain((part)->sem); } while (0)
+	#define PART_UNLOCK(part)  do { if ((part)->sem) sem_release((part)->sem); } while (0)
+#else
+	#define PART_LOCK(part)    do { ASSERT(!(part)->sem); } while (0)
+	#define PART_UNLOCK(part)  do {} while (0)
+#endif
+
+/**
+ * Bytes of a \a size bytes transfer at \a pos that fit in \a part.
+ */
+INLINE size_t kfilepart_clip(KFilePart *part, size_t size, kfile_off_t pos)
+{
+	if (pos < 0 || pos >= part->fd.size)
+		return 0;
+	return MIN(size, (size_t)(part->fd.size - pos));
+}
+
+/**
+ * Read \a size bytes at position \a pos of \a part in \a buf.
+ * The seek position of \a part is not changed.
+ * \return the number of bytes read.
+ */
+size_t kfilepart_pread(KFilePart *part, void *buf, size_t size, kfile_off_t pos)
+{
+	kfile_off_t addr = part->start + pos;
+
+	if (!(size = kfilepart_clip(part, size, pos)))
+		return 0;
+
+	PART_LOCK(part);
+	if (kfile_seek(part->file, addr, KSM_SEEK_SET) == addr)
+		size = kfile_read(part->file, buf, size);
+	else
+		size = 0;
+	PART_UNLOCK(part);
+	return size;
+}
+
+/**
+ * Write \a size bytes of \a buf at position \a pos of \a part.
+ * The seek position of \a part is not changed.
+ * \return the number of bytes written.
+ */
+size_t kfilepart_pwrite(KFilePart *part, const void *buf, size_t size, kfile_off_t pos)
+{
+	kfile_off_t addr = part->start + pos;
+
+	if (!(size = kfilepart_clip(part, size, pos)))
+		return 0;
+
+	PART_LOCK(part);
+	if (kfile_seek(part->file, addr, KSM_SEEK_SET) == addr)
+		size = kfile_write(part->file, buf, size);
+	else
+		size = 0;
+	PART_UNLOCK(part);
+	return size;
+}
+
+static size_t kfilepart_read(struct KFile *fd, void *buf, size_t size)
+{
+	size_t len = kfilepart_pread(KFILEPART_CAST(fd), buf, size, fd->seek_pos);
+
+	fd->seek_pos += len;
+	return len;
+}
+
+static size_t kfilepart_write(struct KFile *fd, const void *buf, size_t size)
+{
+	size_t len = kfilepart_pwrite(KFILEPART_CAST(fd), buf, size, fd->seek_pos);
+
+	fd->seek_pos += len;
+	return len;
+}
+
+/*
+ * The device is held for the whole vector, so that a record made of
+ * many buffers is read or written atomically.
+ */
+static size_t kfilepart_readv(struct KFile *fd, const KFileIov *iov, int iovcnt)
+{
+	KFilePart *part = KFILEPART_CAST(fd);
+	size_t total;
+
+	PART_LOCK(part);
+	total = kfile_genericReadv(fd, iov, iovcnt);
+	PART_UNLOCK(part);
+	return total;
+}
+
+static size_t kfilepart_writev(struct KFile *fd, const KFileIov *iov, int iovcnt)
+{
+	KFilePart *part = KFILEPART_CAST(fd);
+	size_t total;
+
+	PART_LOCK(part);
+	total = kfile_genericWritev(fd, iov, iovcnt);
+	PART_UNLOCK(part);
+	return total;
+}
+
+static int kfilepart_flush(struct KFile *fd)
+{
+	KFilePart *part = KFILEPART_CAST(fd);
+	int err = 0;
+
+	if (part->file->flush)
+	{
+		PART_LOCK(part);
+		err = kfile_flush(part->file);
+		PART_UNLOCK(part);
+	}
+	return err;
+}
+
+static int kfilepart_error(struct KFile *fd)
+{
+	KFilePart *part = KFILEPART_CAST(fd);
+
+	return part->file->error ? kfile_error(part->file) : 0;
+}
+
+static void kfilepart_clearerr(struct KFile *fd)
+{
+	KFilePart *part = KFILEPART_CAST(fd);
+
+	if (part->file->clearerr)
+		kfile_clearerr(part->file);
+}
+
+/**
+ * Init partition \a part, \a len bytes of \a file from offset \a start.
+ * Accesses to \a file are serialized with \a sem, that must be shared by
+ * all the partitions of \a file; use NULL if the partitions are all used
+ * by the same process.
+ * Closing a partition flushes the device but does not close it.
+ */
+void kfilepart_init(KFilePart *part, KFile *file, struct Semaphore *sem,
+	kfile_off_t start, kfile_off_t len)
+{
+	ASSERT(file->seek);
+	ASSERT(start >= 0 && len >= 0);
+	ASSERT(start + len <= file->size);
+
+	memset(part, 0, sizeof(*part));
+	DB(part->fd._type = KFT_KFILEPART);
+
+	part->file = file;
+	part->sem = sem;
+	part->start = start;
+	part->fd.size = len;
+
+	part->fd.read = kfilepart_read;
+	part->fd.write = kfilepart_write;
+	part->fd.seek = kfile_genericSeek;
+	part->fd.flush = kfilepart_flush;
+	part->fd.close = kfilepart_flush;
+	part->fd.reopen = kfile_genericReopen;
+	part->fd.error = kfilepart_error;
+	part->fd.clearerr = kfilepart_clearerr;
+	part->fd.readv = kfilepart_readv;
+	part->fd.writev = kfilepart_writev;
+}
@@ -0,0 +1,109 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Partition KFile adapter.
+ *
+ * A KFilePart is a window of \a len bytes, starting at offset \a start,
+ * of a seekable KFile (a DataFlash, a Flash25...). Each partition has its
+ * own seek position, and many partitions can share the same device: each
+ * access to the device (seek plus read or write) is done holding the
+ * Semaphore of the device, so processes using different partitions
+ * need no other locking.
+ *
+ * kfilepart_pread() and kfilepart_pwrite() read and write at a given
+ * position, without moving the seek position of the partition, so a
+ * single partition can also be shared by processes doing positional I/O.
+ *
+ * \code
+ * static Semaphore flash_sem;
+ * KFilePart log, cfg;
+ *
+ * sem_init(&flash_sem);
+ * kfilepart_init(&cfg, &flash.fd, &flash_sem, 0, CFG_SIZE);
+ * kfilepart_init(&log, &flash.fd, &flash_sem, CFG_SIZE, LOG_SIZE);
+ *
+ * // Log writer process
+ * kfile_write(&log.fd, &rec, sizeof(rec));
+ *
+ * // Config reader process
+ * kfilepart_pread(&cfg, &baudrate, sizeof(baudrate), CFG_BAUDRATE);
+ * \endcode
+ *
+ * \note Semaphores are recursive, so partitions can be nested.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef KERN_KFILE_PART_H
+#define KERN_KFILE_PART_H
+
+#include "cfg/cfg_kern.h"
+
+#include <kern/kfile.h>
+
+#if CONFIG_KERN && CONFIG_KERN_SEMAPHORES
+	#include <kern/sem.h>
+#endif
+
+struct Semaphore;
+
+/**
+ * Partition KFile context structure.
+ */
+typedef struct KFilePart
+{
+	KFile fd;               ///< KFile base class.
+	KFile *file;            ///< Underlying device.
+	struct Semaphore *sem;  ///< Lock of the device, NULL if not shared among processes.
+	kfile_off_t start;      ///< Start of the partition in the device.
+} KFilePart;
+
+/**
+ * ID for partition KFiles.
+ */
+#define KFT_KFILEPART MAKE_ID('K', 'P', 'R', 'T')
+
+/**
+ * Convert + ASSERT from generic KFile to KFilePart.
+ */
+INLINE KFilePart * KFILEPART_CAST(KFile *fd)
+{
+	ASSERT(fd->_type == KFT_KFILEPART);
+	return (KFilePart *)fd;
+}
+
+void kfilepart_init(KFilePart *part, KFile *file, struct Semaphore *sem,
+	kfile_off_t start, kfile_off_t len);
+size_t kfilepart_pread(KFilePart *part, void *buf, size_t size, kfile_off_t pos);
+size_t kfilepart_pwrite(KFilePart *part, const void *buf, size_t size, kfile_off_t pos);
+
+#endif /* KERN_KFILE_PART_H */
@@ -0,0 +1,273 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Partition KFile adapter test.
+ *
+ * Partitions are tested on a RAM device. The semaphore functions are
+ * replaced by stubs that check the device is only accessed while held,
+ * and let a simulated second process try to take the device in the
+ * middle of every access.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "kfile_part.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <string.h>
+
+#if UNIT_TEST
+
+#define DEV_SIZE  1024
+
+/**
+ * Simulated device.
+ */
+static struct
+{
+	KFile fd;
+	uint8_t mem[DEV_SIZE];
+	unsigned long accesses;
+	unsigned long contended;   ///< Lock attempts of the other process, all failed.
+	bool closed;
+} dev;
+
+static Semaphore sem;
+
+/*
+ * Semaphore stubs, the running process is the only one able to take it.
+ */
+void sem_init(struct Semaphore *s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+void sem_obtain(struct Semaphore *s)
+{
+	s->nest_count++;
+}
+
+void sem_release(struct Semaphore *s)
+{
+	ASSERT(s->nest_count > 0);
+	s->nest_count--;
+}
+
+bool sem_attempt(struct Semaphore *s)
+{
+	return s->nest_count == 0;
+}
+
+/**
+ * Another process tries to use the device.
+ */
+static void dev_access(void)
+{
+	ASSERT(sem.nest_count > 0);
+	ASSERT(!sem_attempt(&sem));
+	dev.contended++;
+	dev.accesses++;
+}
+
+static size_t dev_write(struct KFile *fd, const void *buf, size_t size)
+{
+	dev_access();
+	size = MIN(size, (size_t)(DEV_SIZE - fd->seek_pos));
+	memcpy(dev.mem + fd->seek_pos, buf, size);
+	fd->seek_pos += size;
+	return size;
+}
+
+static size_t dev_read(struct KFile *fd, void *buf, size_t size)
+{
+	dev_access();
+	size = MIN(size, (size_t)(DEV_SIZE - fd->seek_pos));
+	memcpy(buf, dev.mem + fd->seek_pos, size);
+	fd->seek_pos += size;
+	return size;
+}
+
+static kfile_off_t dev_seek(struct KFile *fd, kfile_off_t offset, KSeekMode whence)
+{
+	ASSERT(sem.nest_count > 0);
+	return kfile_genericSeek(fd, offset, whence);
+}
+
+static int dev_flush(UNUSED_ARG(struct KFile *, fd))
+{
+	dev_access();
+	return 0;
+}
+
+static int dev_close(UNUSED_ARG(struct KFile *, fd))
+{
+	dev.closed = true;
+	return 0;
+}
+
+static void dev_init(void)
+{
+	memset(&dev, 0, sizeof(dev));
+	for (size_t i = 0; i < DEV_SIZE; i++)
+		dev.mem[i] = (uint8_t)(i * 3 + 7);
+	dev.fd.size = DEV_SIZE;
+	dev.fd.write = dev_write;
+	dev.fd.read = dev_read;
+	dev.fd.seek = dev_seek;
+	dev.fd.flush = dev_flush;
+	dev.fd.close = dev_close;
+}
+
+static void window(void)
+{
+	KFilePart cfg, log;
+	uint8_t buf[64];
+
+	kprintf("Window\n");
+	dev_init();
+	sem_init(&sem);
+	kfilepart_init(&cfg, &dev.fd, &sem, 0, 100);
+	kfilepart_init(&log, &dev.fd, &sem, 100, 400);
+	ASSERT(cfg.fd.size == 100 && log.fd.size == 400);
+
+	/* Reads are relative to the start of the partition */
+	ASSERT(kfile_read(&log.fd, buf, 10) == 10);
+	ASSERT(memcmp(buf, dev.mem + 100, 10) == 0);
+	ASSERT(log.fd.seek_pos == 10);
+
+	/* Writes can not go out of the window */
+	memset(buf, 0xEE, sizeof(buf));
+	ASSERT(kfile_seek(&cfg.fd, 90, KSM_SEEK_SET) == 90);
+	ASSERT(kfile_write(&cfg.fd, buf, 20) == 10);
+	ASSERT(dev.mem[99] == 0xEE && dev.mem[100] == (uint8_t)(100 * 3 + 7));
+	ASSERT(kfile_write(&cfg.fd, buf, 20) == 0);
+	ASSERT(kfile_read(&cfg.fd, buf, 20) == 0);
+
+	/* Each partition has its own position */
+	ASSERT(kfile_seek(&cfg.fd, 0, KSM_SEEK_SET) == 0);
+	for (int i = 0; i < 10; i++)
+	{
+		uint8_t rec[8], c;
+
+		memset(rec, i, sizeof(rec));
+		ASSERT(kfile_write(&log.fd, rec, sizeof(rec)) == sizeof(rec));
+		ASSERT(kfile_read(&cfg.fd, &c, 1) == 1);
+		ASSERT(c == dev.mem[i]);
+	}
+	ASSERT(log.fd.seek_pos == 10 + 80 && cfg.fd.seek_pos == 10);
+	ASSERT(dev.mem[100 + 10] == 0 && dev.mem[100 + 89] == 9);
+
+	ASSERT(sem.nest_count == 0);
+	ASSERT(kfile_close(&log.fd) == 0);
+	ASSERT(!dev.closed);
+}
+
+static void positional(void)
+{
+	KFilePart log;
+	uint8_t buf[16];
+
+	kprintf("Positional I/O\n");
+	dev_init();
+	kfilepart_init(&log, &dev.fd, &sem, 512, 512);
+
+	ASSERT(kfile_seek(&log.fd, 33, KSM_SEEK_SET) == 33);
+	memset(buf, 0x42, sizeof(buf));
+	ASSERT(kfilepart_pwrite(&log, buf, sizeof(buf), 100) == sizeof(buf));
+	ASSERT(dev.mem[612] == 0x42 && dev.mem[627] == 0x42);
+	ASSERT(kfilepart_pread(&log, buf, sizeof(buf), 0) == sizeof(buf));
+	ASSERT(memcmp(buf, dev.mem + 512, sizeof(buf)) == 0);
+	ASSERT(log.fd.seek_pos == 33);
+
+	ASSERT(kfilepart_pread(&log, buf, sizeof(buf), 510) == 2);
+	ASSERT(kfilepart_pread(&log, buf, sizeof(buf), 512) == 0);
+	ASSERT(kfilepart_pwrite(&log, buf, sizeof(buf), -1) == 0);
+	ASSERT(sem.nest_count == 0);
+}
+
+static void vectors(void)
+{
+	KFilePart log, inner;
+	uint8_t hdr[4] = { 1, 2, 3, 4 }, payload[12], back[16];
+	KFileIov iov[] = { { hdr, sizeof(hdr) }, { payload, sizeof(payload) } };
+
+	kprintf("Vectors and nesting\n");
+	dev_init();
+	kfilepart_init(&log, &dev.fd, &sem, 256, 256);
+	memset(payload, 0x77, sizeof(payload));
+
+	/* The device is held for the whole record */
+	ASSERT(kfile_writev(&log.fd, iov, countof(iov)) == sizeof(hdr) + sizeof(payload));
+	ASSERT(memcmp(dev.mem + 256, hdr, sizeof(hdr)) == 0);
+	ASSERT(memcmp(dev.mem + 260, payload, sizeof(payload)) == 0);
+
+	/* A partition of a partition, on the same lock */
+	kfilepart_init(&inner, &log.fd, &sem, 8, 16);
+	ASSERT(kfile_read(&inner.fd, back, sizeof(back)) == 16);
+	ASSERT(memcmp(back, dev.mem + 264, sizeof(back)) == 0);
+	ASSERT(kfile_flush(&inner.fd) == 0);
+	ASSERT(sem.nest_count == 0);
+	ASSERT(dev.contended == dev.accesses);
+}
+
+int kfile_part_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int kfile_part_testRun(void)
+{
+	window();
+	positional();
+	vectors();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int kfile_part_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(kfile_part);
+
+#include <kern/kfile_part.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif /* UNIT_TEST */
@@ -0,0 +1,205 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief XTEA encrypting KFile filter.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "kfile_xtea.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN, MAX */
+
+#include <string.h>
+
+/**
+ * Size of the buffer used to encrypt writes.
+ */
+#define KFILEXTEA_CHUNK  64
+
+/**
+ * True if the file under \a kx can seek.
+ */
+#define SEEKABLE(kx) ((kx)->file->seek != NULL)
+
+/**
+ * Keystream for a transfer at the current position: on seekable files
+ * reads and writes share the same one, moved to the file position
+ * after a seek; on streams \a stream_ctr is used.
+ */
+static XteaCtr *kfilextea_stream(KFileXtea *kx, XteaCtr *stream_ctr)
+{
+	if (!SEEKABLE(kx))
+		return stream_ctr;
+
+	if (kx->pos != kx->fd.seek_pos)
+		xtea_ctrSeek(&kx->tx, kx->fd.seek_pos);
+	return &kx->tx;
+}
+
+static size_t kfilextea_read(struct KFile *fd, void *buf, size_t size)
+{
+	KFileXtea *kx = KFILEXTEA_CAST(fd);
+	XteaCtr *ctr = kfilextea_stream(kx, &kx->rx);
+	size_t len = kfile_read(kx->file, buf, size);
+
+	xtea_ctrCrypt(ctr, buf, buf, len);
+	fd->seek_pos += len;
+	kx->pos = fd->seek_pos;
+	return len;
+}
+
+static size_t kfilextea_write(struct KFile *fd, const void *_buf, size_t size)
+{
+	KFileXtea *kx = KFILEXTEA_CAST(fd);
+	XteaCtr *ctr = kfilextea_stream(kx, &kx->tx);
+	const uint8_t *buf = (const uint8_t *)_buf;
+	uint8_t chunk[KFILEXTEA_CHUNK];
+	size_t written = 0;
+	bool sync = true;
+
+	while (size)
+	{
+		size_t n = MIN(size, sizeof(chunk));
+		size_t len;
+
+		xtea_ctrCrypt(ctr, chunk, buf, n);
+		len = kfile_write(kx->file, chunk, n);
+		buf += len;
+		size -= len;
+		written += len;
+
+		/* The keystream went past the data actually written */
+		if (len != n)
+		{
+			sync = false;
+			break;
+		}
+	}
+
+	fd->seek_pos += written;
+	if (SEEKABLE(kx))
+		fd->size = MAX(fd->size, fd->seek_pos);
+	kx->pos = sync ? fd->seek_pos : -1;
+	return written;
+}
+
+static kfile_off_t kfilextea_seek(struct KFile *fd, kfile_off_t offset, KSeekMode whence)
+{
+	KFileXtea *kx = KFILEXTEA_CAST(fd);
+	kfile_off_t pos = kfile_seek(kx->file, offset, whence);
+
+	if (pos != EOF)
+		fd->seek_pos = pos;
+	return pos;
+}
+
+static int kfilextea_flush(struct KFile *fd)
+{
+	KFileXtea *kx = KFILEXTEA_CAST(fd);
+
+	return kx->file->flush ? kfile_flush(kx->file) : 0;
+}
+
+static int kfilextea_close(struct KFile *fd)
+{
+	KFileXtea *kx = KFILEXTEA_CAST(fd);
+
+	return kfile_close(kx->file);
+}
+
+static struct KFile *kfilextea_reopen(struct KFile *fd)
+{
+	KFileXtea *kx = KFILEXTEA_CAST(fd);
+
+	kx->file = kfile_reopen(kx->file);
+	fd->seek_pos = kx->file->seek_pos;
+	fd->size = kx->file->size;
+
+	/* Streams start again from the beginning */
+	xtea_ctrSeek(&kx->tx, 0);
+	xtea_ctrSeek(&kx->rx, 0);
+	kx->pos = 0;
+	return fd;
+}
+
+static int kfilextea_error(struct KFile *fd)
+{
+	KFileXtea *kx = KFILEXTEA_CAST(fd);
+
+	return kx->file->error ? kfile_error(kx->file) : 0;
+}
+
+static void kfilextea_clearerr(struct KFile *fd)
+{
+	KFileXtea *kx = KFILEXTEA_CAST(fd);
+
+	if (kx->file->clearerr)
+		kfile_clearerr(kx->file);
+}
+
+/**
+ * Init XTEA filter \a kx on top of \a file, with \a key.
+ * \a iv, 8 bytes, is the CTR mode IV of the file, or of the data
+ * written on streams; \a rx_iv is the IV of the data read from
+ * streams, different from \a iv, and must be NULL on seekable files.
+ */
+void kfilextea_init(KFileXtea *kx, KFile *file, const XteaKey *key,
+	const void *iv, const void *rx_iv)
+{
+	ASSERT(key && iv);
+	/* The two directions of a stream must not share the keystream */
+	ASSERT(rx_iv || file->seek);
+	ASSERT(!rx_iv || !file->seek);
+	ASSERT(!rx_iv || memcmp(iv, rx_iv, XTEA_BLOCK_LEN));
+
+	memset(kx, 0, sizeof(*kx));
+	DB(kx->fd._type = KFT_KFILEXTEA);
+
+	kx->file = file;
+	xtea_ctrInit(&kx->tx, key, iv, 0);
+	xtea_ctrInit(&kx->rx, key, file->seek ? iv : rx_iv, 0);
+	kx->pos = 0;
+
+	kx->fd.seek_pos = file->seek_pos;
+	kx->fd.size = file->size;
+
+	kx->fd.read = kfilextea_read;
+	kx->fd.write = kfilextea_write;
+	kx->fd.seek = file->seek ? kfilextea_seek : NULL;
+	kx->fd.flush = kfilextea_flush;
+	kx->fd.close = kfilextea_close;
+	kx->fd.reopen = kfilextea_reopen;
+	kx->fd.error = kfilextea_error;
+	kx->fd.clearerr = kfilextea_clearerr;
+}
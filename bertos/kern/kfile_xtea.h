@@ -0,0 +1,94 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief XTEA encrypting KFile filter.
+ *
+ * A KFileXtea wraps any other KFile, encrypting data written to it and
+ * decrypting data read from it with XTEA in CTR mode. The ciphertext has
+ * the same length and positions of the plaintext, so the filter can sit
+ * on a BattFS file, a DataFlash partition or a serial port.
+ *
+ * On seekable files the keystream follows the file position: data can
+ * be read and rewritten anywhere, but rewriting a position with new data
+ * under the same key and IV reuses the keystream, so a file should get a
+ * new IV when it is rewritten.
+ * On streams (files without seek) reads and writes are independent
+ * sequences, each with its own IV: the two ends of a link must swap them.
+ *
+ * \code
+ * static XteaKey key;
+ * KFileXtea link;
+ *
+ * xtea_setKey(&key, key_bytes);
+ * kfilextea_init(&link, &ser.fd, &key, tx_iv, rx_iv);
+ * kfile_printf(&link.fd, "temp: %d\n", temp);
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef KERN_KFILE_XTEA_H
+#define KERN_KFILE_XTEA_H
+
+#include <kern/kfile.h>
+#include <algo/xtea.h>
+
+/**
+ * XTEA filter KFile context structure.
+ */
+typedef struct KFileXtea
+{
+	KFile fd;             ///< KFile base class.
+	KFile *file;          ///< Underlying file.
+	XteaCtr tx;           ///< Keystream of writes, and of reads on seekable files.
+	XteaCtr rx;           ///< Keystream of reads on streams.
+	kfile_off_t pos;      ///< Position of \a tx on seekable files, -1 if unknown.
+} KFileXtea;
+
+/**
+ * ID for XTEA filter KFiles.
+ */
+#define KFT_KFILEXTEA MAKE_ID('K', 'X', 'T', 'E')
+
+/**
+ * Convert + ASSERT from generic KFile to KFileXtea.
+ */
+INLINE KFileXtea * KFILEXTEA_CAST(KFile *fd)
+{
+	ASSERT(fd->_type == KFT_KFILEXTEA);
+	return (KFileXtea *)fd;
+}
+
+void kfilextea_init(KFileXtea *kx, KFile *file, const XteaKey *key,
+	const void *iv, const void *rx_iv);
+
+#endif /* KERN_KFILE_XTEA_H */
@@ -0,0 +1,715 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ *
+ * \brief Deferred log.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "dlog.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN, IS_POW2 */
+
+#include <cpu/attr.h> /* CPU_HARVARD, CPU_BYTE_ORDER */
+#include <cpu/irq.h>
+#include <cpu/pgm.h>
+
+#include <stdarg.h>
+#include <string.h>
+
+/**
+ * Any argument of a record.
+ */
+typedef union DLogArg
+{
+	int i;
+	long l;
+	void *p;
+	double d;
+} DLogArg;
+
+/**
+ * Max size of a record: the log site address, the timestamp and the arguments.
+ */
+#define DLOG_REC_MAX  (sizeof(DLogSite *) + sizeof(dlog_time_t) + CONFIG_DLOG_MAX_ARGS * sizeof(DLogArg))
+
+/**
+ * Max length of a single conversion specification passed to the formatter.
+ */
+#define DLOG_SPEC_MAX  24
+
+/**
+ * Size of the arguments, indexed by DLOG_OP_*.
+ */
+static const uint8_t dlog_argSize[] =
+{
+	0, sizeof(int), sizeof(long), sizeof(void *), sizeof(double),
+	sizeof(const char *), sizeof(const char *)
+};
+
+/**
+ * Current binary dump epoch: sites sent in a previous epoch
+ * are sent again by dlog_dump().
+ */
+static uint8_t dlog_epoch = 1;
+
+/**
+ * Last site ID assigned.
+ */
+static uint16_t dlog_lastId;
+
+#if CONFIG_DLOG_DEFAULT_SIZE
+	STATIC_ASSERT(IS_POW2(CONFIG_DLOG_DEFAULT_SIZE));
+
+	static uint8_t dlog_defaultBuf[CONFIG_DLOG_DEFAULT_SIZE];
+	DLog dlog_default = { dlog_defaultBuf, sizeof(dlog_defaultBuf), 0, 0, 0, NULL, 0 };
+#endif
+
+/**
+ * \return the argument type for conversion \a conv, with a long
+ *         modifier if \a l is true, or DLOG_OP_END if not supported.
+ */
+static uint8_t dlog_convOp(char conv, bool l)
+{
+	switch (conv)
+	{
+	case 'c':
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		return l ? DLOG_OP_LONG : DLOG_OP_INT;
+	case 's':
+		return DLOG_OP_STR;
+	case 'S':
+		return DLOG_OP_PSTR;
+	case 'p':
+		return DLOG_OP_PTR;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'g':
+	case 'G':
+		return DLOG_OP_DOUBLE;
+	default:
+		return DLOG_OP_END;
+	}
+}
+
+/**
+ * \return true if \a c is a length modifier for long arguments.
+ */
+INLINE bool dlog_isLong(char c)
+{
+	return c == 'l' || c == 'L' || c == 'z';
+}
+
+/**
+ * Compile the format string of \a site in its argument list.
+ */
+static void dlog_compile(DLogSite *site)
+{
+	const char *fmt = site->fmt;
+	unsigned n = 0;
+	size_t size = sizeof(DLogSite *);
+
+	#define ADD_OP(op) \
+		do { \
+			ASSERT(n < CONFIG_DLOG_MAX_ARGS); \
+			if (n < CONFIG_DLOG_MAX_ARGS) \
+			{ \
+				site->ops[n++] = (op); \
+				size += dlog_argSize[op]; \
+			} \
+		} while (0)
+
+	while ((fmt = strchr(fmt, '%')))
+	{
+		bool l;
+		uint8_t op;
+
+		if (*++fmt == '%')
+		{
+			fmt++;
+			continue;
+		}
+
+		fmt += strspn(fmt, "-+ #0");
+		if (*fmt == '*')
+		{
+			ADD_OP(DLOG_OP_INT);
+			fmt++;
+		}
+		else
+			fmt += strspn(fmt, "0123456789");
+
+		if (*fmt == '.')
+		{
+			if (*++fmt == '*')
+			{
+				ADD_OP(DLOG_OP_INT);
+				fmt++;
+			}
+			else
+				fmt += strspn(fmt, "0123456789");
+		}
+
+		l = dlog_isLong(*fmt);
+		if (l || *fmt == 'h')
+			fmt++;
+
+		/* %n and unknown conversions are not supported */
+		op = dlog_convOp(*fmt, l);
+		ASSERT(op != DLOG_OP_END);
+		if (op == DLOG_OP_END)
+			break;
+		ADD_OP(op);
+		fmt++;
+	}
+	#undef ADD_OP
+
+	site->ops[n] = DLOG_OP_END;
+	site->size = size;
+	site->compiled = true;
+}
+
+/**
+ * Copy \a len bytes from \a buf to the ring of \a log.
+ * Interrupts must be disabled and there must be room for the data.
+ */
+static void dlog_put(DLog *log, const uint8_t *buf, size_t len)
+{
+	size_t pos = log->head & (log->size - 1);
+	size_t first = MIN(len, log->size - pos);
+
+	memcpy(log->buf + pos, buf, first);
+	memcpy(log->buf, buf + first, len - first);
+	log->head += len;
+}
+
+/**
+ * Copy \a len bytes from the ring of \a log to \a buf.
+ * Interrupts must be disabled and there must be enough data.
+ */
+static void dlog_get(DLog *log, uint8_t *buf, size_t len)
+{
+	size_t pos = log->tail & (log->size - 1);
+	size_t first = MIN(len, log->size - pos);
+
+	memcpy(buf, log->buf + pos, first);
+	memcpy(buf + first, log->buf, len - first);
+	log->tail += len;
+}
+
+/**
+ * Queue a record for \a site in \a log, with the arguments
+ * following \a site. Use it through the DLOG() macro.
+ * If there is no room in the ring the record is dropped and
+ * counted as lost.
+ */
+void dlog_write(DLog *log, DLogSite *site, ...)
+{
+	uint8_t rec[DLOG_REC_MAX];
+	uint8_t *p = rec + sizeof(site);
+	const uint8_t *op;
+	cpu_flags_t flags;
+	size_t size;
+	va_list ap;
+
+	if (UNLIKELY(!site->compiled))
+		dlog_compile(site);
+
+	#define PACK(type) \
+		do { \
+			type __v = va_arg(ap, type); \
+			memcpy(p, &__v, sizeof(__v)); \
+			p += sizeof(__v); \
+		} while (0)
+
+	memcpy(rec, &site, sizeof(site));
+	if (log->clock)
+		p += sizeof(dlog_time_t);
+
+	va_start(ap, site);
+	for (op = site->ops; *op != DLOG_OP_END; op++)
+	{
+		switch (*op)
+		{
+		case DLOG_OP_INT:
+			PACK(int);
+			break;
+		case DLOG_OP_LONG:
+			PACK(long);
+			break;
+		case DLOG_OP_PTR:
+		case DLOG_OP_STR:
+		case DLOG_OP_PSTR:
+			PACK(void *);
+			break;
+		case DLOG_OP_DOUBLE:
+			PACK(double);
+			break;
+		}
+	}
+	va_end(ap);
+	#undef PACK
+
+	size = p - rec;
+	IRQ_SAVE_DISABLE(flags);
+	if (log->size - (log->head - log->tail) >= size)
+	{
+		/* Timestamps are taken here to keep them sorted */
+		if (log->clock)
+		{
+			dlog_time_t now = log->clock();
+			memcpy(rec + sizeof(site), &now, sizeof(now));
+		}
+		dlog_put(log, rec, size);
+	}
+	else
+		log->lost++;
+	IRQ_RESTORE(flags);
+}
+
+/**
+ * Write the decimal representation of \a val in \a buf.
+ * \return the number of characters written.
+ */
+static size_t dlog_itoa(char *buf, int val)
+{
+	char tmp[sizeof(int) * 3];
+	unsigned u = val < 0 ? -(unsigned)val : (unsigned)val;
+	size_t len = 0, n = 0;
+
+	if (val < 0)
+		buf[len++] = '-';
+	do
+	{
+		tmp[n++] = '0' + u % 10;
+		u /= 10;
+	}
+	while (u);
+
+	while (n)
+		buf[len++] = tmp[--n];
+	return len;
+}
+
+/**
+ * Write \a val in a conversion spec at \a s, preceded by a '.' if
+ * \a dot is true, only if it fits in \a room characters.
+ * \return the number of characters written.
+ */
+static size_t dlog_specInt(char *s, size_t room, bool dot, int val)
+{
+	char num[sizeof(int) * 3 + 1];
+	size_t len = dlog_itoa(num, val);
+
+	if (len + dot > room)
+		return 0;
+	if (dot)
+		*s++ = '.';
+	memcpy(s, num, len);
+	return len + dot;
+}
+
+/**
+ * Format the arguments in \a arg following \a fmt on \a fd.
+ * The format string is split in literal runs, written as they are,
+ * and single conversions, each formatted with kfile_printf().
+ * '*' widths and precisions are replaced by their value.
+ * Parts of a conversion that do not fit in DLOG_SPEC_MAX are dropped.
+ */
+static void dlog_format(struct KFile *fd, const char *fmt, const uint8_t *arg)
+{
+	char spec[DLOG_SPEC_MAX];
+
+	#define UNPACK(type, v) \
+		do { \
+			memcpy(&(v), arg, sizeof(type)); \
+			arg += sizeof(type); \
+		} while (0)
+
+	/* Room left in spec, keeping the modifier, the conversion and the NUL */
+	#define SPEC_ROOM() \
+		((spec + sizeof(spec) - s > 3) ? (size_t)(spec + sizeof(spec) - s - 3) : 0)
+
+	#define SPEC_SPAN(chars) \
+		do { \
+			size_t __n = strspn(fmt, chars); \
+			size_t __len = MIN(__n, SPEC_ROOM()); \
+			memcpy(s, fmt, __len); \
+			s += __len; \
+			fmt += __n; \
+		} while (0)
+
+	while (*fmt)
+	{
+		const char *pct = strchr(fmt, '%');
+		char *s = spec;
+		bool l;
+		int star;
+
+		if (!pct)
+		{
+			kfile_write(fd, fmt, strlen(fmt));
+			break;
+		}
+
+		/* "%%" ends a literal run with a '%' */
+		if (pct[1] == '%')
+		{
+			kfile_write(fd, fmt, pct - fmt + 1);
+			fmt = pct + 2;
+			continue;
+		}
+		if (pct != fmt)
+			kfile_write(fd, fmt, pct - fmt);
+		fmt = pct + 1;
+
+		*s++ = '%';
+		SPEC_SPAN("-+ #0");
+		if (*fmt == '*')
+		{
+			UNPACK(int, star);
+			s += dlog_specInt(s, SPEC_ROOM(), false, star);
+			fmt++;
+		}
+		else
+			SPEC_SPAN("0123456789");
+
+		if (*fmt == '.')
+		{
+			if (*++fmt == '*')
+			{
+				UNPACK(int, star);
+				/* A negative precision is taken as omitted */
+				if (star >= 0)
+					s += dlog_specInt(s, SPEC_ROOM(), true, star);
+				fmt++;
+			}
+			else if (SPEC_ROOM())
+			{
+				*s++ = '.';
+				SPEC_SPAN("0123456789");
+			}
+			else
+				fmt += strspn(fmt, "0123456789");
+		}
+
+		l = dlog_isLong(*fmt);
+		if (l || *fmt == 'h')
+			*s++ = *fmt++;
+		*s++ = *fmt;
+		*s = '\0';
+
+		switch (dlog_convOp(*fmt++, l))
+		{
+		case DLOG_OP_INT:
+		{
+			int v;
+			UNPACK(int, v);
+			kfile_printf(fd, spec, v);
+			break;
+		}
+		case DLOG_OP_LONG:
+		{
+			long v;
+			UNPACK(long, v);
+			kfile_printf(fd, spec, v);
+			break;
+		}
+		case DLOG_OP_PTR:
+		case DLOG_OP_STR:
+		case DLOG_OP_PSTR:
+		{
+			void *v;
+			UNPACK(void *, v);
+			kfile_printf(fd, spec, v);
+			break;
+		}
+		case DLOG_OP_DOUBLE:
+		{
+			double v;
+			UNPACK(double, v);
+			kfile_printf(fd, spec, v);
+			break;
+		}
+		default:
+			/* Not compiled either, see dlog_compile() */
+			return;
+		}
+	}
+	#undef SPEC_SPAN
+	#undef SPEC_ROOM
+	#undef UNPACK
+}
+
+/**
+ * Take the lost records counter of \a log.
+ */
+static size_t dlog_takeLost(DLog *log)
+{
+	cpu_flags_t flags;
+	size_t lost;
+
+	IRQ_SAVE_DISABLE(flags);
+	lost = log->lost;
+	log->lost = 0;
+	IRQ_RESTORE(flags);
+	return lost;
+}
+
+/**
+ * Take the oldest record of \a log, copying its timestamp and
+ * arguments in \a rec.
+ * \return the site of the record, or NULL if the ring is empty.
+ */
+static DLogSite *dlog_next(DLog *log, uint8_t *rec)
+{
+	DLogSite *site = NULL;
+	cpu_flags_t flags;
+
+	IRQ_SAVE_DISABLE(flags);
+	if (log->head != log->tail)
+	{
+		dlog_get(log, rec, sizeof(site));
+		memcpy(&site, rec, sizeof(site));
+		dlog_get(log, rec, site->size - sizeof(site)
+			+ (log->clock ? sizeof(dlog_time_t) : 0));
+	}
+	IRQ_RESTORE(flags);
+	return site;
+}
+
+/**
+ * Format all the messages queued in \a log on \a fd.
+ * If some messages have been lost, a note with their number
+ * is written before the others.
+ * \return the number of messages written.
+ */
+size_t dlog_drain(DLog *log, struct KFile *fd)
+{
+	uint8_t rec[DLOG_REC_MAX];
+	DLogSite *site;
+	size_t lost = dlog_takeLost(log), count = 0;
+
+	if (lost)
+		kfile_printf(fd, "[dlog: %lu messages lost]\n", (unsigned long)lost);
+
+	while ((site = dlog_next(log, rec)))
+	{
+		/* Timestamps are for binary dumps only */
+		dlog_format(fd, site->fmt, rec + (log->clock ? sizeof(dlog_time_t) : 0));
+		count++;
+	}
+	return count;
+}
+
+/**
+ * Send \a site in a binary dump on \a fd.
+ */
+static void dlog_dumpSite(DLogSite *site, struct KFile *fd)
+{
+	uint8_t frame[4 + CONFIG_DLOG_MAX_ARGS];
+	uint8_t n = strlen((const char *)site->ops);
+
+	if (!site->id)
+		site->id = ++dlog_lastId;
+	site->epoch = dlog_epoch;
+
+	frame[0] = DLOG_FRAME_SITE;
+	memcpy(frame + 1, &site->id, sizeof(site->id));
+	frame[3] = n;
+	memcpy(frame + 4, site->ops, n);
+	kfile_write(fd, frame, 4 + n);
+	kfile_write(fd, site->fmt, strlen(site->fmt) + 1);
+}
+
+/**
+ * Write the string \a s in program memory on \a fd, with its NUL.
+ */
+static void dlog_dumpPgmStr(const char *s, struct KFile *fd)
+{
+#if CPU_HARVARD
+	char buf[16];
+	size_t len = 0;
+	char c;
+
+	do
+	{
+		c = pgm_read_char(s++);
+		buf[len++] = c;
+		if (len == sizeof(buf) || !c)
+		{
+			kfile_write(fd, buf, len);
+			len = 0;
+		}
+	}
+	while (c);
+#else
+	kfile_write(fd, s, strlen(s) + 1);
+#endif
+}
+
+/**
+ * Start a binary dump of \a log on \a fd, writing the stream header.
+ * Log sites will be sent again before their first record, so a decoder
+ * can start from any header.
+ * \return 0 if ok, EOF on errors.
+ */
+int dlog_dumpStart(DLog *log, struct KFile *fd)
+{
+	uint8_t hdr[16];
+	uint32_t hz = log->clock_hz;
+
+	hdr[0] = DLOG_FRAME_HEADER;
+	memcpy(hdr + 1, "DLOG", 4);
+	hdr[5] = DLOG_VERSION;
+	hdr[6] = (CPU_BYTE_ORDER == CPU_BIG_ENDIAN) ? DLOG_HDR_BIG_ENDIAN : 0;
+	hdr[7] = sizeof(int);
+	hdr[8] = sizeof(long);
+	hdr[9] = sizeof(void *);
+	hdr[10] = sizeof(double);
+	hdr[11] = log->clock ? sizeof(dlog_time_t) : 0;
+	STATIC_ASSERT(sizeof(hdr) == 12 + sizeof(hz));
+	memcpy(hdr + 12, &hz, sizeof(hz));
+
+	/* Epoch 0 is for sites never sent */
+	if (!++dlog_epoch)
+		dlog_epoch = 1;
+
+	return kfile_write(fd, hdr, sizeof(hdr)) == sizeof(hdr) ? 0 : EOF;
+}
+
+/**
+ * Write all the records queued in \a log on \a fd in binary form,
+ * to be decoded by the host tool dlog_decode.
+ * dlog_dumpStart() must have been called on \a fd before.
+ * \return the number of records written.
+ */
+size_t dlog_dump(DLog *log, struct KFile *fd)
+{
+	uint8_t rec[DLOG_REC_MAX];
+	uint8_t frame[1 + sizeof(uint16_t) + DLOG_REC_MAX];
+	DLogSite *site;
+	size_t lost = dlog_takeLost(log), count = 0;
+
+	if (lost)
+	{
+		uint32_t l = lost;
+
+		frame[0] = DLOG_FRAME_LOST;
+		memcpy(frame + 1, &l, sizeof(l));
+		kfile_write(fd, frame, 1 + sizeof(l));
+	}
+
+	while ((site = dlog_next(log, rec)))
+	{
+		const uint8_t *arg = rec, *op;
+		uint8_t *f = frame;
+
+		if (site->epoch != dlog_epoch)
+			dlog_dumpSite(site, fd);
+
+		*f++ = DLOG_FRAME_RECORD;
+		memcpy(f, &site->id, sizeof(site->id));
+		f += sizeof(site->id);
+		if (log->clock)
+		{
+			memcpy(f, arg, sizeof(dlog_time_t));
+			f += sizeof(dlog_time_t);
+			arg += sizeof(dlog_time_t);
+		}
+
+		/* Strings are sent in place of their address */
+		for (op = site->ops; *op != DLOG_OP_END; op++)
+		{
+			if (*op == DLOG_OP_STR || *op == DLOG_OP_PSTR)
+			{
+				const char *s;
+
+				memcpy(&s, arg, sizeof(s));
+				kfile_write(fd, frame, f - frame);
+				f = frame;
+				if (*op == DLOG_OP_STR)
+					kfile_write(fd, s, strlen(s) + 1);
+				else
+					dlog_dumpPgmStr(s, fd);
+			}
+			else
+			{
+				memcpy(f, arg, dlog_argSize[*op]);
+				f += dlog_argSize[*op];
+			}
+			arg += dlog_argSize[*op];
+		}
+		if (f != frame)
+			kfile_write(fd, frame, f - frame);
+		count++;
+	}
+	return count;
+}
+
+/**
+ * Set the clock used for the timestamps of the records of \a log
+ * to \a clock, running at \a hz. \a clock is called with interrupts
+ * disabled; NULL disables timestamps.
+ * Must be called when the ring is empty.
+ */
+void dlog_setClock(DLog *log, dlog_clock_t clock, uint32_t hz)
+{
+	ASSERT(log->head == log->tail);
+
+	log->clock = clock;
+	log->clock_hz = hz;
+}
+
+/**
+ * Init deferred log \a log, using the \a size bytes of \a buf
+ * as record ring. \a size must be a power of 2.
+ */
+void dlog_init(DLog *log, uint8_t *buf, size_t size)
+{
+	ASSERT(buf);
+	ASSERT(size && IS_POW2(size));
+
+	log->buf = buf;
+	log->size = size;
+	log->head = log->tail = log->lost = 0;
+	log->clock = NULL;
+	log->clock_hz = 0;
+}
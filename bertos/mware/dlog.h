@@ -0,0 +1,209 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ *
+ * \brief Deferred log.
+ *
+ * Formatting a message with kprintf() or kfile_printf() parses the
+ * format string and converts every argument, character by character,
+ * in the caller context: in a tight control loop a LOG_INFO() line may
+ * cost more than the work it describes.
+ *
+ * A deferred log queues instead a compact binary record for each
+ * message: the address of its log site and the raw arguments.
+ * The log site is a static structure created by the DLOG() macro, which
+ * holds the format string and its compiled form: the list of the
+ * argument types, parsed only the first time the site is hit.
+ * Logging a message then costs a walk on the argument list and a
+ * copy in a RAM ring; formatting is done later by dlog_drain(), usually
+ * called by a low priority process, which writes the messages to any KFile.
+ *
+ * \code
+ * static uint8_t ctrl_log_buf[256];
+ * static DLog ctrl_log;
+ *
+ * dlog_init(&ctrl_log, ctrl_log_buf, sizeof(ctrl_log_buf));
+ *
+ * // In the control loop
+ * DLOG(&ctrl_log, "pid: err %d out %ld\n", err, out);
+ *
+ * // In a low priority process
+ * for (;;)
+ * {
+ *     dlog_drain(&ctrl_log, &ser.fd);
+ *     timer_delay(100);
+ * }
+ * \endcode
+ *
+ * Records can also be dumped in binary form with dlog_dump(), without
+ * any formatting: the stream carries the format strings and argument
+ * types of the log sites, sent the first time each site is dumped,
+ * followed by the records, which refer to them by a small ID.
+ * If a clock is set with dlog_setClock(), each record gets a timestamp
+ * too. The host tool dlog_decode (see mware/dlog_decode.c) turns the
+ * stream back into text:
+ * \code
+ * static dlog_time_t ctrl_clock(void)
+ * {
+ *     return timer_clock_unlocked() * TIMER_HW_CNT + timer_hw_hpread();
+ * }
+ *
+ * dlog_setClock(&ctrl_log, ctrl_clock, TIMER_HW_HPTICKS_PER_SEC);
+ *
+ * // In a low priority process
+ * dlog_dumpStart(&ctrl_log, &ser.fd);
+ * for (;;)
+ * {
+ *     dlog_dump(&ctrl_log, &ser.fd);
+ *     timer_delay(100);
+ * }
+ * \endcode
+ * and on the host:
+ * \code
+ * $ gcc -o dlog_decode bertos/mware/dlog_decode.c
+ * $ dlog_decode < /dev/ttyUSB0
+ * [   12.004113] pid: err -3 out 1200
+ * \endcode
+ *
+ * Modules can send their LOG_ERR(), LOG_WARN() and LOG_INFO() messages
+ * to the default deferred log dlog_default defining LOG_DEFERRED to 1
+ * before including cfg/log.h.
+ *
+ * \note Only the argument values are saved: a "%s" argument must point to
+ *       a string that does not change until the message has been drained,
+ *       like a string literal or __func__.
+ *       Float arguments need a formatter with float support in dlog_drain().
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef MWARE_DLOG_H
+#define MWARE_DLOG_H
+
+#include "cfg/cfg_dlog.h"
+#include <cfg/compiler.h>
+#include <cfg/macros.h> /* BV() */
+
+#include <kern/kfile.h>
+
+/**
+ * \name Argument types of compiled format strings.
+ * \{
+ */
+#define DLOG_OP_END     0 ///< End of the argument list.
+#define DLOG_OP_INT     1 ///< int, also for promoted char and short.
+#define DLOG_OP_LONG    2 ///< long.
+#define DLOG_OP_PTR     3 ///< Pointer, for %p.
+#define DLOG_OP_DOUBLE  4 ///< double, also for promoted float.
+#define DLOG_OP_STR     5 ///< String pointer, for %s.
+#define DLOG_OP_PSTR    6 ///< Program memory string pointer, for %S.
+/* \} */
+
+/**
+ * \name Frames of the binary stream written by dlog_dumpStart() and dlog_dump().
+ *
+ * All fields are in the byte order and sizes of the target, described
+ * by the header frame:
+ * \li header: 'H', "DLOG", version, flags (DLOG_HDR_*), sizeof(int),
+ *     sizeof(long), sizeof(void *), sizeof(double), timestamp size
+ *     (0 without clock), clock frequency (uint32_t);
+ * \li site: 'S', ID (uint16_t), number of arguments, argument types
+ *     (DLOG_OP_*), format string with its NUL;
+ * \li record: 'R', site ID (uint16_t), timestamp (dlog_time_t, if any),
+ *     arguments; strings are sent with their NUL instead of their address;
+ * \li lost records: 'L', number of records dropped (uint32_t).
+ * \{
+ */
+#define DLOG_FRAME_HEADER  'H'
+#define DLOG_FRAME_SITE    'S'
+#define DLOG_FRAME_RECORD  'R'
+#define DLOG_FRAME_LOST    'L'
+#define DLOG_VERSION       1
+#define DLOG_HDR_BIG_ENDIAN  BV(0) ///< Target is big endian.
+/* \} */
+
+/// Timestamp of a record.
+typedef uint32_t dlog_time_t;
+
+/// Clock for record timestamps.
+typedef dlog_time_t (*dlog_clock_t)(void);
+
+/**
+ * Log site, a static structure for each DLOG() call.
+ */
+typedef struct DLogSite
+{
+	const char *fmt;                            ///< Format string.
+	uint8_t ops[CONFIG_DLOG_MAX_ARGS + 1];      ///< Argument types, DLOG_OP_END terminated.
+	uint8_t size;                               ///< Size of a record of this site.
+	volatile bool compiled;                     ///< True when ops and size are valid.
+	uint16_t id;                                ///< ID in binary dumps, 0 if not assigned yet.
+	uint8_t epoch;                              ///< Dump epoch in which the site has been sent.
+} DLogSite;
+
+/**
+ * Deferred log context.
+ */
+typedef struct DLog
+{
+	uint8_t *buf;                ///< Record ring.
+	size_t size;                 ///< Size of the ring, a power of 2.
+	volatile size_t head;        ///< Free running write index.
+	volatile size_t tail;        ///< Free running read index.
+	volatile size_t lost;        ///< Records dropped because the ring was full.
+	dlog_clock_t clock;          ///< Timestamp clock, NULL for no timestamps.
+	uint32_t clock_hz;           ///< Clock frequency.
+} DLog;
+
+/**
+ * Queue a message with format \a fmt in deferred log \a log.
+ * Can be called from interrupts.
+ */
+#define DLOG(log, fmt, ...) \
+	do { \
+		static DLogSite __dlog_site = { fmt, { DLOG_OP_END }, 0, false, 0, 0 }; \
+		dlog_write((log), &__dlog_site, ## __VA_ARGS__); \
+	} while (0)
+
+#if CONFIG_DLOG_DEFAULT_SIZE
+	/// Deferred log of LOG_* macros in modules with LOG_DEFERRED set.
+	extern DLog dlog_default;
+#endif
+
+void dlog_init(DLog *log, uint8_t *buf, size_t size);
+void dlog_write(DLog *log, DLogSite *site, ...);
+size_t dlog_drain(DLog *log, struct KFile *fd);
+void dlog_setClock(DLog *log, dlog_clock_t clock, uint32_t hz);
+int dlog_dumpStart(DLog *log, struct KFile *fd);
+size_t dlog_dump(DLog *log, struct KFile *fd);
+
+#endif /* MWARE_DLOG_H */
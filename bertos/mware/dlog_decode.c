@@ -0,0 +1,528 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ *
+ * \brief Host decoder for binary deferred log dumps.
+ *
+ * Reads the stream written by dlog_dumpStart() and dlog_dump()
+ * (see mware/dlog.h for the frame format) and prints the messages,
+ * formatted with the format strings carried by the stream.
+ * When the stream has timestamps, each line is prefixed with the
+ * time in seconds.
+ *
+ * Decoding starts at the first stream header; arguments are
+ * converted from the sizes and byte order of the target.
+ *
+ * This is a host tool, not part of the target build:
+ * \code
+ * $ gcc -o dlog_decode bertos/mware/dlog_decode.c
+ * $ dlog_decode [dump file]
+ * \endcode
+ *
+ * notest: avr
+ * notest: arm
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Stream constants, the same as mware/dlog.h.
+ */
+enum
+{
+	DEC_OP_END, DEC_OP_INT, DEC_OP_LONG, DEC_OP_PTR,
+	DEC_OP_DOUBLE, DEC_OP_STR, DEC_OP_PSTR, DEC_OP_CNT
+};
+
+#define DEC_VERSION      1
+#define DEC_BIG_ENDIAN   0x01
+#define DEC_MAX_SITES    65536
+#define DEC_MAX_ARGS     32
+#define DEC_MAX_STR      256
+#define DEC_MAX_MSG      4096
+
+typedef struct DecSite
+{
+	char *fmt;
+	uint8_t nops;
+	uint8_t ops[DEC_MAX_ARGS];
+} DecSite;
+
+typedef struct DecArg
+{
+	uint64_t u;
+	double d;
+	char s[DEC_MAX_STR];
+} DecArg;
+
+typedef struct Decoder
+{
+	FILE *in;
+	FILE *out;
+	bool big_endian;
+	unsigned size[DEC_OP_CNT];
+	unsigned ts_size;
+	uint32_t hz;
+	bool bol;
+	DecSite **sites;
+} Decoder;
+
+static bool dec_read(Decoder *d, void *buf, size_t len)
+{
+	return fread(buf, 1, len, d->in) == len;
+}
+
+/*
+ * Read an unsigned integer \a len bytes long in target byte order.
+ */
+static bool dec_readUint(Decoder *d, unsigned len, uint64_t *val)
+{
+	uint8_t buf[8];
+	unsigned i;
+
+	if (len > sizeof(buf) || !dec_read(d, buf, len))
+		return false;
+
+	*val = 0;
+	for (i = 0; i < len; i++)
+		*val |= (uint64_t)buf[d->big_endian ? len - 1 - i : i] << (8 * i);
+	return true;
+}
+
+/*
+ * Read a NUL terminated string, truncating it to \a size - 1 chars.
+ */
+static bool dec_readStr(Decoder *d, char *buf, size_t size)
+{
+	size_t len = 0;
+	int c;
+
+	while ((c = fgetc(d->in)) != EOF && c)
+		if (len < size - 1)
+			buf[len++] = c;
+	buf[len] = '\0';
+	return c != EOF;
+}
+
+/// True if \a size is a valid size for an integer type.
+#define DEC_SIZE_OK(size)  ((size) >= 1 && (size) <= 8)
+
+static bool dec_header(Decoder *d)
+{
+	uint8_t hdr[10];
+	uint64_t hz;
+
+	if (!dec_read(d, hdr, sizeof(hdr)) || memcmp(hdr, "DLOG", 4) || hdr[4] != DEC_VERSION)
+		return false;
+
+	d->big_endian = hdr[5] & DEC_BIG_ENDIAN;
+	d->size[DEC_OP_END] = 0;
+	d->size[DEC_OP_INT] = hdr[6];
+	d->size[DEC_OP_LONG] = hdr[7];
+	d->size[DEC_OP_PTR] = d->size[DEC_OP_STR] = d->size[DEC_OP_PSTR] = hdr[8];
+	d->size[DEC_OP_DOUBLE] = hdr[9];
+	if (!dec_readUint(d, 1, &hz))
+		return false;
+	d->ts_size = hz;
+	if (!dec_readUint(d, 4, &hz))
+		return false;
+	d->hz = hz;
+
+	/* Sites are sent again after each header */
+	for (unsigned i = 0; i < DEC_MAX_SITES; i++)
+	{
+		if (d->sites[i])
+		{
+			free(d->sites[i]->fmt);
+			free(d->sites[i]);
+			d->sites[i] = NULL;
+		}
+	}
+	/* Sizes are used as shift counts, reject the ones no target has */
+	return DEC_SIZE_OK(d->size[DEC_OP_INT]) && DEC_SIZE_OK(d->size[DEC_OP_LONG])
+		&& DEC_SIZE_OK(d->size[DEC_OP_PTR])
+		&& (d->size[DEC_OP_DOUBLE] == 4 || d->size[DEC_OP_DOUBLE] == 8);
+}
+
+static bool dec_site(Decoder *d)
+{
+	uint64_t id, n;
+	char fmt[DEC_MAX_MSG];
+	DecSite *site;
+
+	if (!dec_readUint(d, 2, &id) || !dec_readUint(d, 1, &n) || n > DEC_MAX_ARGS)
+		return false;
+
+	site = calloc(1, sizeof(*site));
+	site->nops = n;
+	if (!dec_read(d, site->ops, n) || !dec_readStr(d, fmt, sizeof(fmt)))
+	{
+		free(site);
+		return false;
+	}
+	site->fmt = strdup(fmt);
+
+	if (d->sites[id])
+	{
+		free(d->sites[id]->fmt);
+		free(d->sites[id]);
+	}
+	d->sites[id] = site;
+	return true;
+}
+
+/*
+ * Print a message, prefixed by \a ts if the stream has timestamps
+ * and the message starts a new line.
+ */
+static void dec_print(Decoder *d, const char *msg, uint64_t ts)
+{
+	size_t len = strlen(msg);
+
+	if (d->bol && d->ts_size)
+	{
+		if (d->hz)
+			fprintf(d->out, "[%5lu.%06lu] ", (unsigned long)(ts / d->hz),
+				(unsigned long)((ts % d->hz) * 1000000 / d->hz));
+		else
+			fprintf(d->out, "[%10lu] ", (unsigned long)ts);
+	}
+	fputs(msg, d->out);
+	if (len)
+		d->bol = (msg[len - 1] == '\n');
+}
+
+/*
+ * Sign extend \a v, \a bits long.
+ */
+static int64_t dec_signed(uint64_t v, unsigned bits)
+{
+	return (int64_t)(v << (64 - bits)) >> (64 - bits);
+}
+
+#define MSG_PRINTF(...) \
+	do { \
+		int __n = snprintf(m, msg + sizeof(msg) - m, __VA_ARGS__); \
+		if (__n > 0) \
+			m += (__n < msg + sizeof(msg) - m) ? __n : msg + sizeof(msg) - 1 - m; \
+	} while (0)
+
+/*
+ * Append to the conversion spec \a spec, \a size bytes long, at \a *s.
+ * \return false if it does not fit.
+ */
+static bool dec_specAdd(char *spec, size_t size, char **s, const char *fmt, ...)
+{
+	size_t room = spec + size - *s;
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(*s, room, fmt, ap);
+	va_end(ap);
+	if (n < 0 || (size_t)n >= room)
+		return false;
+	*s += n;
+	return true;
+}
+
+/*
+ * Format the arguments \a arg of a record following \a fmt,
+ * like dlog_format() does on the target.
+ */
+static void dec_format(Decoder *d, const DecSite *site, const DecArg *arg, uint64_t ts)
+{
+	char msg[DEC_MAX_MSG], spec[32];
+	char *m = msg;
+	const char *fmt = site->fmt;
+	unsigned a = 0;
+
+	*m = '\0';
+	while (*fmt)
+	{
+		const char *pct = strchr(fmt, '%');
+		char *s = spec;
+		unsigned bits;
+		char conv, mod = 0;
+
+		if (!pct)
+		{
+			MSG_PRINTF("%s", fmt);
+			break;
+		}
+		if (pct[1] == '%')
+		{
+			MSG_PRINTF("%.*s", (int)(pct - fmt + 1), fmt);
+			fmt = pct + 2;
+			continue;
+		}
+		MSG_PRINTF("%.*s", (int)(pct - fmt), fmt);
+		fmt = pct + 1;
+
+		*s++ = '%';
+		while (*fmt && strchr("-+ #0", *fmt) && s < spec + 8)
+			*s++ = *fmt++;
+		if (*fmt == '*')
+		{
+			if (a >= site->nops
+			 || !dec_specAdd(spec, sizeof(spec), &s, "%d",
+					(int)dec_signed(arg[a++].u, 8 * d->size[DEC_OP_INT])))
+				goto done;
+			fmt++;
+		}
+		while (*fmt >= '0' && *fmt <= '9' && s < spec + 16)
+			*s++ = *fmt++;
+		if (*fmt == '.')
+		{
+			if (*++fmt == '*')
+			{
+				int prec;
+
+				if (a >= site->nops)
+					goto done;
+				prec = (int)dec_signed(arg[a++].u, 8 * d->size[DEC_OP_INT]);
+				if (prec >= 0 && !dec_specAdd(spec, sizeof(spec), &s, ".%d", prec))
+					goto done;
+				fmt++;
+			}
+			else
+			{
+				*s++ = '.';
+				while (*fmt >= '0' && *fmt <= '9' && s < spec + 24)
+					*s++ = *fmt++;
+			}
+		}
+		if (*fmt == 'l' || *fmt == 'L' || *fmt == 'z' || *fmt == 'h')
+			mod = *fmt++;
+		/* Only the conversions the target emits, see dlog_convOp() */
+		if (!*fmt || !strchr("diouxXcsSpeEfgG", *fmt))
+			goto done;
+		conv = *fmt++;
+		/* Room for the longest conversion, "lld" or "llx" */
+		if (a >= site->nops || spec + sizeof(spec) - s < 4)
+			break;
+
+		bits = (mod == 'h') ? 16 : 8 * d->size[site->ops[a]];
+		switch (conv)
+		{
+		case 'd':
+		case 'i':
+		{
+			strcpy(s, "lld");
+			MSG_PRINTF(spec, (long long)dec_signed(arg[a++].u, bits));
+			break;
+		}
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'p':
+		{
+			uint64_t v = arg[a++].u;
+
+			if (bits < 64)
+				v &= ((uint64_t)1 << bits) - 1;
+			s[0] = s[1] = 'l';
+			s[2] = (conv == 'p') ? 'X' : conv;
+			s[3] = '\0';
+			MSG_PRINTF(spec, (unsigned long long)v);
+			break;
+		}
+		case 'c':
+			strcpy(s, "c");
+			MSG_PRINTF(spec, (int)(unsigned char)arg[a++].u);
+			break;
+		case 's':
+		case 'S':
+			strcpy(s, "s");
+			MSG_PRINTF(spec, arg[a++].s);
+			break;
+		default:
+			s[0] = conv;
+			s[1] = '\0';
+			MSG_PRINTF(spec, arg[a++].d);
+			break;
+		}
+	}
+done:
+	dec_print(d, msg, ts);
+}
+
+static bool dec_record(Decoder *d)
+{
+	static DecArg arg[DEC_MAX_ARGS];
+	uint64_t id, ts = 0;
+	DecSite *site;
+	unsigned i;
+
+	if (!dec_readUint(d, 2, &id))
+		return false;
+	site = d->sites[id];
+	if (!site)
+	{
+		fprintf(stderr, "dlog_decode: record of unknown site %u\n", (unsigned)id);
+		return false;
+	}
+	if (d->ts_size && !dec_readUint(d, d->ts_size, &ts))
+		return false;
+
+	for (i = 0; i < site->nops; i++)
+	{
+		uint8_t op = site->ops[i];
+
+		if (op == DEC_OP_STR || op == DEC_OP_PSTR)
+		{
+			if (!dec_readStr(d, arg[i].s, sizeof(arg[i].s)))
+				return false;
+		}
+		else if (op < DEC_OP_CNT && op != DEC_OP_END)
+		{
+			if (!dec_readUint(d, d->size[op], &arg[i].u))
+				return false;
+			if (op == DEC_OP_DOUBLE)
+			{
+				if (d->size[op] == sizeof(float))
+				{
+					uint32_t u32 = arg[i].u;
+					float f;
+
+					memcpy(&f, &u32, sizeof(f));
+					arg[i].d = f;
+				}
+				else
+					memcpy(&arg[i].d, &arg[i].u, sizeof(arg[i].d));
+			}
+		}
+		else
+			return false;
+	}
+
+	dec_format(d, site, arg, ts);
+	return true;
+}
+
+/**
+ * Decode the stream read from \a in, printing the messages on \a out.
+ * \return 0 if the stream ends with a complete frame, -1 otherwise.
+ */
+int dlog_decode(FILE *in, FILE *out)
+{
+	Decoder d;
+	uint64_t lost;
+	int c, err = -1;
+	bool started = false;
+
+	memset(&d, 0, sizeof(d));
+	d.in = in;
+	d.out = out;
+	d.bol = true;
+	d.sites = calloc(DEC_MAX_SITES, sizeof(*d.sites));
+
+	while ((c = fgetc(in)) != EOF)
+	{
+		bool ok = false;
+
+		/* Skip everything up to the first header */
+		if (!started && c != 'H')
+			continue;
+
+		switch (c)
+		{
+		case 'H':
+			/* Not a header: look for the next one */
+			started = dec_header(&d);
+			continue;
+		case 'S':
+			ok = dec_site(&d);
+			break;
+		case 'R':
+			ok = dec_record(&d);
+			break;
+		case 'L':
+			ok = dec_readUint(&d, 4, &lost);
+			if (ok)
+			{
+				fprintf(out, "%s[dlog: %lu messages lost]\n", d.bol ? "" : "\n", (unsigned long)lost);
+				d.bol = true;
+			}
+			break;
+		}
+		if (!ok)
+			goto out;
+	}
+	err = 0;
+
+out:
+	for (unsigned i = 0; i < DEC_MAX_SITES; i++)
+	{
+		if (d.sites[i])
+		{
+			free(d.sites[i]->fmt);
+			free(d.sites[i]);
+		}
+	}
+	free(d.sites);
+	return err;
+}
+
+#if !UNIT_TEST
+int main(int argc, char *argv[])
+{
+	FILE *in = stdin;
+	int err;
+
+	if (argc > 2)
+	{
+		fprintf(stderr, "usage: %s [dump file]\n", argv[0]);
+		return 2;
+	}
+	if (argc == 2 && !(in = fopen(argv[1], "rb")))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	err = dlog_decode(in, stdout);
+	if (err)
+		fprintf(stderr, "%s: truncated or corrupted stream\n", argv[0]);
+	if (in != stdin)
+		fclose(in);
+	return err ? 1 : 0;
+}
+#endif /* !UNIT_TEST */
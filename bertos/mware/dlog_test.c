@@ -0,0 +1,485 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ *
+ * \brief Deferred log test.
+ *
+ * Messages queued in a deferred log and drained on a KFile must
+ * be equal to the ones written directly by kfile_printf().
+ * Binary dumps are checked decoding them with the host decoder.
+ *
+ * The benchmark compares the cost of a log line in a control loop
+ * formatted at once with kfile_printf() and queued with DLOG();
+ * the cost of the deferred formatting and of the binary dump of the
+ * same records is reported too.
+ * Results are printed on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<sync|deferred|drain|dump> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#define LOG_LEVEL     LOG_LVL_INFO
+#define LOG_FORMAT    LOG_FMT_TERSE
+#define LOG_DEFERRED  1
+
+#include "dlog.h"
+
+#include <cfg/debug.h>
+#include <cfg/log.h>
+#include <cfg/test.h>
+
+#include <cpu/irq.h>
+#include <cpu/pgm.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if UNIT_TEST
+#define BENCH_LINES  20000
+
+/**
+ * Output file, collecting all the data written.
+ */
+static struct
+{
+	KFile fd;
+	char buf[8192];
+	size_t len;
+	unsigned long writes;
+} out;
+
+static size_t out_write(UNUSED_ARG(struct KFile *, fd), const void *buf, size_t size)
+{
+	size_t len = MIN(size, sizeof(out.buf) - 1 - out.len);
+
+	if (!len)
+		return size;
+	memcpy(out.buf + out.len, buf, len);
+	out.len += len;
+	out.buf[out.len] = '\0';
+	out.writes++;
+	return size;
+}
+
+static void out_init(void)
+{
+	memset(&out, 0, sizeof(out));
+	out.fd.write = out_write;
+	out.fd.close = kfile_genericClose;
+}
+
+static uint8_t log_buf[128];
+static DLog dlog;
+
+static char expect[sizeof(out.buf)];
+
+#define CHECK_OUT(str) \
+	do { \
+		if (strcmp(out.buf, (str)) != 0) \
+		{ \
+			kprintf("expected [%s] got [%s]\n", (str), out.buf); \
+			ASSERT(0); \
+		} \
+	} while (0)
+
+/*
+ * Log the same message with kfile_printf() and DLOG(),
+ * saving the first output in expect and the second in out.
+ */
+#define LOG_BOTH(fmt, ...) \
+	do { \
+		out_init(); \
+		kfile_printf(&out.fd, fmt, ## __VA_ARGS__); \
+		strcpy(expect, out.buf); \
+		out_init(); \
+		DLOG(&dlog, fmt, ## __VA_ARGS__); \
+		ASSERT(dlog_drain(&dlog, &out.fd) == 1); \
+		CHECK_OUT(expect); \
+	} while (0)
+
+static void formats(void)
+{
+	static const char name[] = "motor";
+	char c = 'x';
+	short sh = -300;
+	float fl = 1.5;
+
+	dlog_init(&dlog, log_buf, sizeof(log_buf));
+
+	LOG_BOTH("plain text\n");
+	LOG_BOTH("%d %i %u %x %X %c\n", -42, 42, 42U, 0xbeef, 0xbeef, c);
+	LOG_BOTH("%ld %lu %lx %hd\n", -1234567L, 4000000000UL, 0xdeadbeefUL, sh);
+	LOG_BOTH("[%8d|%-8d|%08d|%+d|% d]\n", 123, 123, -123, 5, 5);
+	LOG_BOTH("%s: %10s|%-10s|%.3s\n", name, name, name, name);
+	LOG_BOTH("100%% %s %%d%%\n", "sure");
+	LOG_BOTH("%*d|%-*d|%*.*s|\n", 6, 42, 6, 42, 8, 3, name);
+	LOG_BOTH("%.*d|%*d|%.*s|\n", 4, 42, -6, 42, -1, name);
+
+	/* Conversions too long for the spec buffer are cut, not overflowed */
+	out_init();
+	DLOG(&dlog, "%*.3d|%-+ #0-+ #0-+ #0*.00000000000000000001d|\n", -6, 42, INT_MIN, 42);
+	ASSERT(dlog_drain(&dlog, &out.fd) == 1);
+	CHECK_OUT("042   |+42|\n");
+
+	LOG_BOTH("%p\n", (void *)&dlog);
+	LOG_BOTH("%f %.2f %8.3f %e\n", 3.25, fl, -1.0625, 12345.0);
+	LOG_BOTH("%d%d%d%d%d%d%d%d", 1, 2, 3, 4, 5, 6, 7, 8);
+
+	/* Messages are drained in order */
+	out_init();
+	DLOG(&dlog, "a=%d ", 1);
+	DLOG(&dlog, "b=%ld ", 2L);
+	DLOG(&dlog, "c=%s\n", "3");
+	ASSERT(dlog_drain(&dlog, &out.fd) == 3);
+	CHECK_OUT("a=1 b=2 c=3\n");
+	ASSERT(dlog_drain(&dlog, &out.fd) == 0);
+}
+
+static void wrapAndOverflow(void)
+{
+	int i, lost;
+
+	/* Records wrap around the end of the ring */
+	dlog_init(&dlog, log_buf, sizeof(log_buf));
+	for (i = 0; i < 100; i++)
+	{
+		out_init();
+		DLOG(&dlog, "%d:%ld:%d", i, (long)i * 100000L, -i);
+		DLOG(&dlog, ":%s", "w");
+		ASSERT(dlog_drain(&dlog, &out.fd) == 2);
+		sprintf(expect, "%d:%ld:%d:w", i, (long)i * 100000L, -i);
+		CHECK_OUT(expect);
+	}
+
+	/* Records that do not fit are dropped and counted */
+	out_init();
+	for (i = 0; i < 100; i++)
+		DLOG(&dlog, "%d,", i);
+	lost = 100 - sizeof(log_buf) / (sizeof(DLogSite *) + sizeof(int));
+	ASSERT(dlog.lost == (size_t)lost);
+	ASSERT(dlog_drain(&dlog, &out.fd) == (size_t)(100 - lost));
+	sprintf(expect, "[dlog: %d messages lost]\n0,1,2,", lost);
+	ASSERT(strncmp(out.buf, expect, strlen(expect)) == 0);
+	ASSERT(dlog.lost == 0);
+}
+
+static void logMacros(void)
+{
+	out_init();
+	LOG_INFO("speed %d rpm\n", 1500);
+	LOG_WARN("overload %ld\n", 70000L);
+	LOG_ERR("%s stalled\n", "motor");
+	ASSERT(dlog_drain(&dlog_default, &out.fd) == 3);
+	CHECK_OUT("INFO: speed 1500 rpm\nWARN: overload 70000\nERR: motor stalled\n");
+}
+
+/* Host decoder, see mware/dlog_decode.c */
+int dlog_decode(FILE *in, FILE *out);
+
+static dlog_time_t fake_now;
+
+/* A clock running at 1MHz, 1.5ms later at each call */
+static dlog_time_t fake_clock(void)
+{
+	return fake_now += 1500;
+}
+
+/*
+ * Decode the binary dump in out with the host decoder.
+ */
+static void decode(char **text)
+{
+	FILE *in, *txt;
+	size_t len;
+
+	in = fmemopen(out.buf, out.len, "rb");
+	txt = open_memstream(text, &len);
+	ASSERT(in && txt);
+	ASSERT(dlog_decode(in, txt) == 0);
+	fclose(in);
+	fclose(txt);
+}
+
+static unsigned countStr(const char *str)
+{
+	unsigned n = 0;
+	size_t len = strlen(str);
+
+	for (size_t i = 0; i + len <= out.len; i++)
+		if (!memcmp(out.buf + i, str, len))
+			n++;
+	return n;
+}
+
+static void binaryDump(void)
+{
+	static const pgm_char pump[] = "pump";
+	char *text;
+	int i;
+
+	dlog_init(&dlog, log_buf, sizeof(log_buf));
+	dlog_setClock(&dlog, fake_clock, 1000000);
+	fake_now = 0;
+
+	out_init();
+	/* The decoder skips garbage before the first header */
+	kfile_write(&out.fd, "\0xyz", 4);
+	ASSERT(dlog_dumpStart(&dlog, &out.fd) == 0);
+	DLOG(&dlog, "%s: speed %d rpm, load %ld%%\n", "motor", -1500, 70000L);
+	DLOG(&dlog, "%S %c %x %hd ", pump, 'z', 0xbeef, (short)-2);
+	DLOG(&dlog, "%*d|%.2f|%p\n", -6, 42, 2.5, (void *)0x1234);
+	ASSERT(dlog_dump(&dlog, &out.fd) == 3);
+
+	/* Sites already sent are referred by ID */
+	for (i = 0; i < 3; i++)
+		DLOG(&dlog, "tick %d\n", i);
+	ASSERT(dlog_dump(&dlog, &out.fd) == 3);
+	ASSERT(countStr("tick %d") == 1);
+
+	/* Lost records */
+	for (i = 0; i < 10; i++)
+		DLOG(&dlog, "fill %d\n", i);
+	ASSERT(dlog_dump(&dlog, &out.fd) == 8);
+
+	/* Sites are sent again after a new header */
+	ASSERT(dlog_dumpStart(&dlog, &out.fd) == 0);
+	DLOG(&dlog, "%s: speed %d rpm, load %ld%%\n", "motor", 0, 0L);
+	ASSERT(dlog_dump(&dlog, &out.fd) == 1);
+	ASSERT(countStr("load %ld") == 2);
+
+	decode(&text);
+	if (strcmp(text,
+		"[    0.001500] motor: speed -1500 rpm, load 70000%\n"
+		"[    0.003000] pump z beef -2 42    |2.50|1234\n"
+		"[    0.006000] tick 0\n"
+		"[    0.007500] tick 1\n"
+		"[    0.009000] tick 2\n"
+		"[dlog: 2 messages lost]\n"
+		"[    0.010500] fill 0\n"
+		"[    0.012000] fill 1\n"
+		"[    0.013500] fill 2\n"
+		"[    0.015000] fill 3\n"
+		"[    0.016500] fill 4\n"
+		"[    0.018000] fill 5\n"
+		"[    0.019500] fill 6\n"
+		"[    0.021000] fill 7\n"
+		"[    0.022500] motor: speed 0 rpm, load 0%\n") != 0)
+	{
+		kprintf("decoded:\n%s", text);
+		ASSERT(0);
+	}
+	free(text);
+
+	/* Text drain skips the timestamps */
+	out_init();
+	DLOG(&dlog, "%s %d\n", "timed", 7);
+	ASSERT(dlog_drain(&dlog, &out.fd) == 1);
+	CHECK_OUT("timed 7\n");
+}
+
+/*
+ * Add a site frame for \a fmt with \a nops int arguments to out,
+ * followed by a record with \a nargs arguments taken from \a args.
+ */
+static void dumpHostile(uint16_t id, const char *fmt, uint8_t nops, const int *args, int nargs)
+{
+	uint8_t frame[4 + CONFIG_DLOG_MAX_ARGS];
+
+	frame[0] = DLOG_FRAME_SITE;
+	memcpy(frame + 1, &id, sizeof(id));
+	frame[3] = nops;
+	memset(frame + 4, DLOG_OP_INT, nops);
+	kfile_write(&out.fd, frame, 4 + nops);
+	kfile_write(&out.fd, fmt, strlen(fmt) + 1);
+
+	frame[0] = DLOG_FRAME_RECORD;
+	memcpy(frame + 1, &id, sizeof(id));
+	kfile_write(&out.fd, frame, 1 + sizeof(id));
+	kfile_write(&out.fd, args, nargs * sizeof(int));
+}
+
+static void decodeHostile(void)
+{
+	static const int args[] = { INT_MIN, INT_MAX, 5 };
+	char *text;
+	size_t hdr;
+
+	dlog_init(&dlog, log_buf, sizeof(log_buf));
+	out_init();
+	ASSERT(dlog_dumpStart(&dlog, &out.fd) == 0);
+
+	/* Conversion spec longer than the decoder buffer */
+	dumpHostile(1, "a%-+ #0-+*.*db\n", 3, args, 3);
+	/* Star widths and precisions without arguments */
+	dumpHostile(2, "c%*.*dd\n", 1, args + 2, 1);
+	dumpHostile(3, "e%*df\n", 0, NULL, 0);
+	/* Conversions the target never emits, and a '%' ending the format */
+	dumpHostile(4, "g%nh\n", 1, args + 2, 1);
+	dumpHostile(5, "i%", 1, args + 2, 1);
+
+	/* Integer sizes no target has: frames are skipped up to the next header */
+	hdr = out.len;
+	ASSERT(dlog_dumpStart(&dlog, &out.fd) == 0);
+	out.buf[hdr + 7] = 0;
+	dumpHostile(6, "j%dk\n", 1, args + 2, 1);
+	ASSERT(dlog_dumpStart(&dlog, &out.fd) == 0);
+	dumpHostile(7, "l%d\n", 1, args + 2, 1);
+
+	decode(&text);
+	if (strcmp(text, "acegil5\n") != 0)
+	{
+		kprintf("decoded:\n%s", text);
+		ASSERT(0);
+	}
+	free(text);
+}
+
+static void benchLog(void)
+{
+	static uint8_t bench_buf[4096];
+	unsigned long start, sync_ns, deferred_ns = 0, drain_ns = 0, dump_ns = 0, irq_ns;
+	unsigned long text_bytes = 0, dump_bytes = 0;
+	size_t drained = 0;
+	int i;
+
+	/* Formatting in the control loop */
+	start = bench_nsec();
+	for (i = 0; i < BENCH_LINES; i++)
+	{
+		out.len = 0;
+		kfile_printf(&out.fd, "pid: sp %d pv %d err %d out %ld\n", 1000, i, 1000 - i, (long)i * 37);
+	}
+	sync_ns = bench_nsec() - start;
+
+	/* Records queued in the control loop, formatted later */
+	dlog_init(&dlog, bench_buf, sizeof(bench_buf));
+	for (i = 0; i < BENCH_LINES; i += 100)
+	{
+		int j;
+
+		start = bench_nsec();
+		for (j = i; j < i + 100; j++)
+			DLOG(&dlog, "pid: sp %d pv %d err %d out %ld\n", 1000, j, 1000 - j, (long)j * 37);
+		deferred_ns += bench_nsec() - start;
+
+		out.len = 0;
+		start = bench_nsec();
+		drained += dlog_drain(&dlog, &out.fd);
+		drain_ns += bench_nsec() - start;
+		text_bytes += out.len;
+	}
+	ASSERT(drained == BENCH_LINES);
+	ASSERT(dlog.lost == 0);
+
+	/* The same records, timestamped and dumped in binary form */
+	dlog_setClock(&dlog, fake_clock, 1000000);
+	drained = 0;
+	for (i = 0; i < BENCH_LINES; i += 100)
+	{
+		int j;
+
+		for (j = i; j < i + 100; j++)
+			DLOG(&dlog, "pid: sp %d pv %d err %d out %ld\n", 1000, j, 1000 - j, (long)j * 37);
+
+		out.len = 0;
+		start = bench_nsec();
+		if (!i)
+			dlog_dumpStart(&dlog, &out.fd);
+		drained += dlog_dump(&dlog, &out.fd);
+		dump_ns += bench_nsec() - start;
+		dump_bytes += out.len;
+	}
+	ASSERT(drained == BENCH_LINES);
+
+	/*
+	 * On the emulator disabling interrupts is a sigprocmask() syscall,
+	 * while on targets it costs a couple of instructions: report its
+	 * cost apart.
+	 */
+	start = bench_nsec();
+	for (i = 0; i < BENCH_LINES; i++)
+	{
+		cpu_flags_t flags;
+
+		IRQ_SAVE_DISABLE(flags);
+		IRQ_RESTORE(flags);
+	}
+	irq_ns = bench_nsec() - start;
+
+	printf("BENCH scenario=control_log path=sync lines=%d time_us=%lu ns_per_line=%lu\n",
+		BENCH_LINES, sync_ns / 1000, sync_ns / BENCH_LINES);
+	printf("BENCH scenario=control_log path=deferred lines=%d time_us=%lu ns_per_line=%lu irq_ns_per_line=%lu\n",
+		BENCH_LINES, deferred_ns / 1000, deferred_ns / BENCH_LINES, irq_ns / BENCH_LINES);
+	printf("BENCH scenario=control_log path=drain lines=%d time_us=%lu ns_per_line=%lu bytes_per_line=%lu\n",
+		BENCH_LINES, drain_ns / 1000, drain_ns / BENCH_LINES, text_bytes / BENCH_LINES);
+	printf("BENCH scenario=control_log path=dump lines=%d time_us=%lu ns_per_line=%lu bytes_per_line=%lu\n",
+		BENCH_LINES, dump_ns / 1000, dump_ns / BENCH_LINES, dump_bytes / BENCH_LINES);
+}
+
+int dlog_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int dlog_testRun(void)
+{
+	formats();
+	wrapAndOverflow();
+	logMacros();
+	binaryDump();
+	decodeHostile();
+	benchLog();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int dlog_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(dlog);
+
+#include <mware/dlog.c>
+#include <mware/dlog_decode.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif // UNIT_TEST
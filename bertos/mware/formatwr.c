@@ -81,9 +81,11 @@
 
 #include "cfg/cfg_formatwr.h"  /* CONFIG_ macros */
 #include <cfg/debug.h>         /* ASSERT */
+#include <cfg/macros.h>        /* MIN */
 
 #include <cpu/pgm.h>
 #include <mware/hex.h>
+#include <mware/ultoa.h>
 
 #ifndef CONFIG_PRINTF_N_FORMATTER
 	/** Disable the arcane %n formatter. */
@@ -315,18 +317,73 @@ CLEAN_UP:
 
 #endif /* CONFIG_PRINTF > PRINTF_NOFLOAT */
 
+#if CONFIG_PRINTF > PRINTF_REDUCED
+
+/** Source of padding runs. */
+static const char pad_spaces[] = "                ";
+
+#if CONFIG_PRINTF_COUNT_CHARS
+	#define COUNT_CHARS(n)  (nr_of_chars += (n))
+#else
+	#define COUNT_CHARS(n)  do {} while (0)
+#endif
+
+/** Emit the \a len characters of \a s as a single run. */
+#define PUT_RUN(s, len) \
+	do { \
+		put_block((s), (len), secret_pointer); \
+		COUNT_CHARS(len); \
+	} while (0)
+
+#if CPU_HARVARD
+/**
+ * Emit \a len characters of string \a s in program memory, copying them
+ * in RAM a chunk at a time.
+ */
+static void put_pgm_run(const char * PROGMEM s, int len,
+		void put_block(const char *, size_t, void *), void *secret_pointer)
+{
+	char chunk[16];
+
+	while (len > 0)
+	{
+		int n = MIN(len, (int)sizeof(chunk));
+
+		for (int i = 0; i < n; i++)
+			chunk[i] = pgm_read_char(s++);
+		put_block(chunk, n, secret_pointer);
+		len -= n;
+	}
+}
+#endif /* CPU_HARVARD */
+
+/**
+ * Emit \a n padding spaces, in runs.
+ */
+static void put_pad(int n, void put_block(const char *, size_t, void *), void *secret_pointer)
+{
+	while (n > 0)
+	{
+		int len = MIN(n, (int)sizeof(pad_spaces) - 1);
+
+		put_block(pad_spaces, len, secret_pointer);
+		n -= len;
+	}
+}
+
 /**
  * This routine forms the core and entry of the formatter.
  *
  * The conversion performed conforms to the ANSI specification for "printf".
+ * Output is passed to \a put_block in runs of characters: spans of the
+ * format string without conversions, converted values and padding.
  */
 int
-PGM_FUNC(_formatted_write)(const char * PGM_ATTR format,
-		void put_one_char(char, void *),
+PGM_FUNC(_formatted_write_block)(const char * PGM_ATTR format,
+		void put_block(const char *, size_t, void *),
 		void *secret_pointer,
 		va_list ap)
 {
-#if CONFIG_PRINTF > PRINTF_REDUCED
 	MEM_ATTRIBUTE static char bad_conversion[] = "???";
 	MEM_ATTRIBUTE static char null_pointer[] = "<NULL>";
 
@@ -379,26 +436,30 @@ PGM_FUNC(_formatted_write)(const char * PGM_ATTR format,
 #endif
 	for (;;)    /* Until full format string read */
 	{
-		while ((format_flag = PGM_READ_CHAR(format++)) != '%')    /* Until '%' or '\0' */
+		/* Emit the span up to '%' or '\0' as a single run */
+		ptr = (char *)format;
+		while ((format_flag = PGM_READ_CHAR(format)) && format_flag != '%')
+			format++;
+		if (format != ptr)
 		{
-			if (!format_flag)
-#if CONFIG_PRINTF_RETURN_COUNT
-				return (nr_of_chars);
+#ifdef _PROGMEM
+			put_pgm_run(ptr, format - ptr, put_block, secret_pointer);
+			COUNT_CHARS(format - ptr);
 #else
-				return 0;
-#endif
-			put_one_char(format_flag, secret_pointer);
-#if CONFIG_PRINTF_COUNT_CHARS
-			nr_of_chars++;
+			PUT_RUN(ptr, format - ptr);
 #endif
 		}
-		if (PGM_READ_CHAR(format) == '%')    /* %% prints as % */
+
+		if (!format_flag)
+#if CONFIG_PRINTF_RETURN_COUNT
+			return (nr_of_chars);
+#else
+			return 0;
+#endif
+		if (PGM_READ_CHAR(++format) == '%')    /* %% prints as % */
 		{
 			format++;
-			put_one_char('%', secret_pointer);
-#if CONFIG_PRINTF_COUNT_CHARS
-			nr_of_chars++;
-#endif
+			PUT_RUN("%", 1);
 			continue;
 		}
 
@@ -635,15 +696,11 @@ INTEGRAL_CONVERSION:
 					switch (flags.div_factor)
 					{
 					case DIV_DEC:
-						do
-							*--buf_pointer = hex[ulong % 10];
-						while (ulong /= 10);
+						buf_pointer = ultoa10(ulong, buf_pointer);
 						break;
 
 					case DIV_HEX:
-						do
-							*--buf_pointer = hex[ulong % 16];
-						while (ulong /= 16);
+						buf_pointer = ultohex(ulong, buf_pointer, hex);
 						break;
 #if CONFIG_PRINTF_OCTAL_FORMATTER
 					case DIV_OCT:
@@ -741,7 +798,7 @@ FLOATING_CONVERSION:
 		}
 
 		/*
-		 * This part emittes the formatted string to "put_one_char".
+		 * This part emittes the formatted string to "put_block".
 		 */
 
 		/* If field_width == 0 then nothing should be written. */
@@ -757,61 +814,89 @@ FLOATING_CONVERSION:
 		}
 
 		/* emit any leading pad characters */
-		if (!flags.left_adjust)
-			while (--n >= 0)
-			{
-				put_one_char(' ', secret_pointer);
-#if CONFIG_PRINTF_COUNT_CHARS
-				nr_of_chars++;
-#endif
-			}
+		if (!flags.left_adjust && n > 0)
+		{
+			put_pad(n, put_block, secret_pointer);
+			COUNT_CHARS(n);
+		}
 
 		/* emit flag characters (if any) */
 		if (flags.plus_space_flag)
-		{
-			put_one_char(flags.plus_space_flag == PSF_PLUS ? '+' : '-', secret_pointer);
-#if CONFIG_PRINTF_COUNT_CHARS
-			nr_of_chars++;
-#endif
-		}
+			PUT_RUN(flags.plus_space_flag == PSF_PLUS ? "+" : "-", 1);
 
-#if CPU_HARVARD
-		if (flags.progmem)
+		if (precision > 0)
 		{
-			while (--precision >= 0)
+#if CPU_HARVARD
+			if (flags.progmem)
 			{
-				put_one_char(pgm_read_char(buf_pointer++), secret_pointer);
-#if CONFIG_PRINTF_COUNT_CHARS
-				nr_of_chars++;
-#endif
+				put_pgm_run(buf_pointer, precision, put_block, secret_pointer);
+				COUNT_CHARS(precision);
 			}
-		}
-		else
+			else
 #endif /* CPU_HARVARD */
-		{
-			/* emit the string itself */
-			while (--precision >= 0)
-			{
-				put_one_char(*buf_pointer++, secret_pointer);
-#if CONFIG_PRINTF_COUNT_CHARS
-				nr_of_chars++;
-#endif
-			}
+				/* emit the string itself */
+				PUT_RUN(buf_pointer, precision);
 		}
 
 		/* emit trailing space characters */
-		if (flags.left_adjust)
-			while (--n >= 0)
-			{
-				put_one_char(' ', secret_pointer);
-#if CONFIG_PRINTF_COUNT_CHARS
-				nr_of_chars++;
-#endif
-			}
+		if (flags.left_adjust && n > 0)
+		{
+			put_pad(n, put_block, secret_pointer);
+			COUNT_CHARS(n);
+		}
 	}
+}
+
+/**
+ * Output function of _formatted_write() and its user data.
+ */
+struct CharSink
+{
+	void (*put_one_char)(char, void *);
+	void *user_data;
+};
+
+/**
+ * Adapter passing runs one character at a time to a CharSink.
+ */
+static void put_char_run(const char *s, size_t len, void *_sink)
+{
+	struct CharSink *sink = (struct CharSink *)_sink;
+
+	while (len--)
+		sink->put_one_char(*s++, sink->user_data);
+}
+
+/**
+ * Formatter with a per character output function.
+ * \see _formatted_write_block()
+ */
+int
+PGM_FUNC(_formatted_write)(const char * PGM_ATTR format,
+		void put_one_char(char, void *),
+		void *secret_pointer,
+		va_list ap)
+{
+	struct CharSink sink = { put_one_char, secret_pointer };
+
+	return PGM_FUNC(_formatted_write_block)(format, put_char_run, &sink, ap);
+}
 
 #else /* PRINTF_REDUCED starts here */
 
+/**
+ * This routine forms the core and entry of the formatter.
+ *
+ * The reduced formatter is optimized for size, and emits one character
+ * at a time.
+ */
+int
+PGM_FUNC(_formatted_write)(const char * PGM_ATTR format,
+		void put_one_char(char, void *),
+		void *secret_pointer,
+		va_list ap)
+{
+
 #if CONFIG_PRINTF > PRINTF_NOMODIFIERS
 	bool l_modifier, h_modifier;
 	unsigned long u_val, div_val;
@@ -953,7 +1038,41 @@ CONVERSION_LOOP:
 
 		} /* end switch(format_flag...) */
 	}
-#endif /* CONFIG_PRINTF > PRINTF_REDUCED */
 }
 
+/**
+ * Output function of _formatted_write_block() and its user data.
+ */
+struct BlockSink
+{
+	void (*put_block)(const char *, size_t, void *);
+	void *user_data;
+};
+
+/**
+ * Adapter passing each character as a run to a BlockSink.
+ */
+static void put_block_char(char c, void *_sink)
+{
+	struct BlockSink *sink = (struct BlockSink *)_sink;
+
+	sink->put_block(&c, 1, sink->user_data);
+}
+
+/**
+ * Formatter with an output function receiving runs of characters.
+ * The reduced formatter passes runs of a single character.
+ */
+int
+PGM_FUNC(_formatted_write_block)(const char * PGM_ATTR format,
+		void put_block(const char *, size_t, void *),
+		void *secret_pointer,
+		va_list ap)
+{
+	struct BlockSink sink = { put_block, secret_pointer };
+
+	return PGM_FUNC(_formatted_write)(format, put_block_char, &sink, ap);
+}
+#endif /* CONFIG_PRINTF > PRINTF_REDUCED */
+
 #endif /* CONFIG_PRINTF */
@@ -60,6 +60,8 @@
 	#define CONFIG_PRINTF_RETURN_COUNT 1
 #endif
 
+#include <stddef.h>      /* size_t */
+
 int
 _formatted_write(
 	const char *format,
@@ -67,6 +69,18 @@ _formatted_write(
 	void *user_data,
 	va_list ap);
 
+/*
+ * Same as _formatted_write(), but \a put_block_func receives runs of
+ * \a len characters at a time: literal spans of the format, converted
+ * values and padding. A run is not NUL terminated.
+ */
+int
+_formatted_write_block(
+	const char *format,
+	void put_block_func(const char *buf, size_t len, void *user_data),
+	void *user_data,
+	va_list ap);
+
 #if CPU_HARVARD
 	#include <cpu/pgm.h>
 	int _formatted_write_P(
@@ -74,6 +88,11 @@ _formatted_write(
 		void put_char_func(char c, void *user_data),
 		void *user_data,
 		va_list ap);
+	int _formatted_write_block_P(
+		const char * PROGMEM format,
+		void put_block_func(const char *buf, size_t len, void *user_data),
+		void *user_data,
+		va_list ap);
 #endif /* CPU_HARVARD */
 
 int sprintf_testSetup(void);
@@ -45,6 +45,12 @@
  * argument is determined by format strings present in the
  * CmdTemplate table.
  *
+ * Commands are stored in an open addressing table indexed by the hash
+ * of their name, computed once at registration. Text lines look the
+ * command up hashing the name word; binary frames carry the hash
+ * itself, so they reach the command without any text processing.
+ * A command whose hash is already taken is only reachable by name.
+ *
  * \version $Id: parser.c 1636 2008-08-13 10:42:23Z bernie $
  *
  * \author Bernie Innocenti <bernie@codewiz.org>
@@ -59,8 +65,10 @@
 
 #include "cfg/cfg_parser.h"
 
-#include <drv/ser.h>
-#include <struct/hashtable.h>
+#include <algo/rotating_hash.h>
+
+#include <cfg/debug.h>
+#include <cfg/macros.h> // MIN()
 
 #include <stdlib.h> // atol(), NULL
 #include <string.h> // strchr(), strcmp()
@@ -70,13 +78,22 @@
 #define ARG_SEP_S " "
 #define ARG_SEP_C ' '
 
-#define MAX_COMMANDS_NUMBER  128  // 64
+STATIC_ASSERT(!(CONFIG_PARSER_MAX_COMMANDS & (CONFIG_PARSER_MAX_COMMANDS - 1)));
+
+/// Table slot where the search for command \a hash starts.
+#define CMD_SLOT(hash)  ((hash) & (CONFIG_PARSER_MAX_COMMANDS - 1))
+
+/// Commands that can be executed, indexed by CMD_SLOT() of their name hash.
+static const struct CmdTemplate *commands[CONFIG_PARSER_MAX_COMMANDS];
 
-/// Hashtable hook to extract the key from a command
-static const void* get_key_from_command(const void* cmd, uint8_t* length);
+/// Name hash of the command in the same slot of \c commands.
+static cmd_hash_t command_hashes[CONFIG_PARSER_MAX_COMMANDS];
 
-/// Hashtable that handles the commands that can be executed
-DECLARE_HASHTABLE_STATIC(commands, MAX_COMMANDS_NUMBER, get_key_from_command);
+/// Registered commands, sorted by name for completion.
+static const struct CmdTemplate *sorted_commands[CONFIG_PARSER_MAX_COMMANDS];
+
+/// Number of registered commands.
+static size_t num_commands;
 
 
 /**
@@ -165,6 +182,22 @@ static bool parseArgs(const char *fmt, const char *input, parms argv[])
 }
 
 
+/**
+ * Find the slot holding the command with name hash \a hash, or the free
+ * slot where it should be inserted.
+ * The table is never full, so the search always ends.
+ */
+static size_t find_slot(cmd_hash_t hash)
+{
+	size_t i = CMD_SLOT(hash);
+
+	while (commands[i] && command_hashes[i] != hash)
+		i = CMD_SLOT(i + 1);
+
+	return i;
+}
+
+
 #ifdef UNUSED_CODE
 /**
  * \brief Command result formatting and printing.
@@ -241,30 +274,84 @@ static int printResult(struct Serial *ser, const char *fmt, parms result[])
 }
 #endif /* UNUSED_CODE */
 
-/// Hook provided by the parser for matching of command names (TAB completion) for readline
-const char* parser_rl_match(UNUSED_ARG(void *,dummy), const char *word, int word_len)
+/**
+ * Binary search in sorted_commands of the first command whose name,
+ * truncated to \a len characters, is not lower than \a word
+ * (greater than \a word if \a after is true).
+ */
+static size_t find_sorted(const char *word, int len, bool after)
 {
-	HashIterator cur;
-	HashIterator end = ht_iter_end(&commands);
-	const char *found = NULL;
+	size_t lo = 0, hi = num_commands;
 
-	for (cur = ht_iter_begin(&commands);
-	     !ht_iter_cmp(cur, end);
-	     cur = ht_iter_next(cur))
+	while (lo < hi)
 	{
-		const struct CmdTemplate* cmdp = (const struct CmdTemplate*)ht_iter_get(cur);
-		if (strncmp(cmdp->name, word, word_len) == 0)
-		{
-			// If there was another matching word, it means that we have a multiple
-			//  match: then return NULL.
-			if (found)
-				return NULL;
+		size_t mid = (lo + hi) / 2;
+		int cmp = strncmp(sorted_commands[mid]->name, word, len);
 
-			found = cmdp->name;
-		}
+		if (cmp < 0 || (after && cmp == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	return found;
+	return lo;
+}
+
+/**
+ * Find the command named \a name, \a len characters long.
+ */
+static const struct CmdTemplate *find_cmd(const char *name, size_t len)
+{
+	const struct CmdTemplate *cmdp = commands[find_slot(parser_cmd_hash(name, len))];
+	size_t pos;
+
+	if (!cmdp)
+		return NULL;
+	if (!strncmp(cmdp->name, name, len) && !cmdp->name[len])
+		return cmdp;
+
+	/* Another name has the same hash: \a name could be a text only command */
+	pos = find_sorted(name, len, false);
+	if (pos < num_commands && !strncmp(sorted_commands[pos]->name, name, len)
+			&& !sorted_commands[pos]->name[len])
+		return sorted_commands[pos];
+
+	return NULL;
+}
+
+int parser_rl_complete(UNUSED_ARG(void *,dummy), const char *word, int word_len,
+	const char **match, int *match_len)
+{
+	size_t first = find_sorted(word, word_len, false);
+	size_t last = find_sorted(word, word_len, true);
+	const char *a, *b;
+	int len = word_len;
+
+	if (first == last)
+		return 0;
+
+	// Matches are contiguous: their common prefix is the one of the first and last
+	a = sorted_commands[first]->name;
+	b = sorted_commands[last - 1]->name;
+	while (a[len] && a[len] == b[len])
+		++len;
+
+	*match = a;
+	*match_len = len;
+	return last - first;
+}
+
+/// Hook provided by the parser for matching of command names (TAB completion) for readline
+const char* parser_rl_match(void *dummy, const char *word, int word_len)
+{
+	const char *match;
+	int len;
+
+	// Multiple matches are ambiguous
+	if (parser_rl_complete(dummy, word, word_len, &match, &len) != 1)
+		return NULL;
+
+	return match;
 }
 
 bool parser_get_cmd_id(const char* line, unsigned long* ID)
@@ -295,7 +382,7 @@ const struct CmdTemplate* parser_get_cmd_template(const char *input)
 	if (!get_word(&begin, &end))
 		return NULL;
 
-	return (const struct CmdTemplate*)ht_find(&commands, begin, end-begin);
+	return find_cmd(begin, end - begin);
 }
 
 static const char *skip_to_params(const char *input, const struct CmdTemplate *cmdp)
@@ -327,13 +414,6 @@ bool parser_get_cmd_arguments(const char* input, const struct CmdTemplate* cmdp,
 	return true;
 }
 
-static const void* get_key_from_command(const void* cmd, uint8_t* length)
-{
-	const struct CmdTemplate* c = cmd;
-	*length = strlen(c->name);
-	return c->name;
-}
-
 bool parser_process_line(const char* input)
 {
 	const struct CmdTemplate *cmdp;
@@ -352,9 +432,184 @@ bool parser_process_line(const char* input)
 	return true;
 }
 
-void parser_register_cmd(const struct CmdTemplate* cmd)
+bool parser_register_cmd(const struct CmdTemplate* cmd)
+{
+	cmd_hash_t hash = parser_cmd_hash(cmd->name, strlen(cmd->name));
+	size_t slot = find_slot(hash);
+	bool binary = !commands[slot];
+
+	ASSERT2(binary || strcmp(commands[slot]->name, cmd->name), "Command already registered");
+	if (num_commands >= CONFIG_PARSER_MAX_COMMANDS - 1)
+	{
+		ASSERT2(0, "Too many commands");
+		return false;
+	}
+
+	// Names sharing the hash of a registered command are only available as text
+	if (binary)
+	{
+		commands[slot] = cmd;
+		command_hashes[slot] = hash;
+	}
+
+	// Keep sorted_commands sorted, inserting cmd after all the lower names
+	size_t pos = find_sorted(cmd->name, strlen(cmd->name) + 1, true);
+	memmove(&sorted_commands[pos + 1], &sorted_commands[pos],
+		(num_commands - pos) * sizeof(sorted_commands[0]));
+	sorted_commands[pos] = cmd;
+	num_commands++;
+	return binary;
+}
+
+cmd_hash_t parser_cmd_hash(const char *name, size_t len)
+{
+	rotating_t hash;
+
+	rotating_init(&hash);
+	rotating_update(name, len, &hash);
+	return hash;
+}
+
+const struct CmdTemplate* parser_get_cmd_by_hash(cmd_hash_t hash)
+{
+	return commands[find_slot(hash)];
+}
+
+/**
+ * Unpack the arguments in \a buf, \a len bytes long, following the format
+ * \a fmt and store them in \a argv.
+ *
+ * \return False if the packed arguments do not match the format.
+ */
+static bool unpackArgs(const char *fmt, const uint8_t *buf, size_t len, parms argv[])
+{
+	const uint8_t *end = buf + len;
+
+	for (; *fmt; ++fmt)
+	{
+		switch (*fmt)
+		{
+			case 'd':
+				if (end - buf < 4)
+					return false;
+				(*argv++).l = (long)(int32_t)((uint32_t)buf[0]
+					| ((uint32_t)buf[1] << 8)
+					| ((uint32_t)buf[2] << 16)
+					| ((uint32_t)buf[3] << 24));
+				buf += 4;
+				break;
+
+			case 's':
+			{
+				const uint8_t *nul = (const uint8_t *)memchr(buf, '\0', end - buf);
+				if (!nul)
+					return false;
+				(*argv++).s = (const char *)buf;
+				buf = nul + 1;
+				break;
+			}
+
+			default:
+				ASSERT2(0, "Unknown format for argument");
+				return false;
+		}
+	}
+
+	return buf == end;
+}
+
+/**
+ * Pack the results in \a argv following the format \a fmt in \a buf,
+ * \a size bytes long.
+ *
+ * \return Number of bytes used, or -1 if results do not fit.
+ */
+static int packResults(const char *fmt, const parms argv[], uint8_t *buf, size_t size)
+{
+	uint8_t *p = buf;
+	uint8_t *end = buf + size;
+
+	for (; *fmt; ++fmt, ++argv)
+	{
+		switch (*fmt)
+		{
+			case 'd':
+			{
+				uint32_t v = (uint32_t)argv->l;
+
+				if (end - p < 4)
+					return -1;
+				p[0] = (uint8_t)v;
+				p[1] = (uint8_t)(v >> 8);
+				p[2] = (uint8_t)(v >> 16);
+				p[3] = (uint8_t)(v >> 24);
+				p += 4;
+				break;
+			}
+
+			case 's':
+			{
+				size_t len = strlen(argv->s) + 1;
+
+				if ((size_t)(end - p) < len)
+					return -1;
+				memcpy(p, argv->s, len);
+				p += len;
+				break;
+			}
+
+			default:
+				ASSERT2(0, "Unknown format for result");
+				return -1;
+		}
+	}
+
+	return p - buf;
+}
+
+size_t parser_frame_status(uint8_t seq, ParserFrameStatus status, uint8_t *reply)
 {
-	ht_insert(&commands, cmd);
+	reply[0] = PARSER_FRAME_SYNC;
+	reply[1] = 0;
+	reply[2] = seq;
+	reply[3] = (uint8_t)status;
+	return PARSER_REPLY_HDR;
+}
+
+size_t parser_process_frame(const uint8_t *frame, size_t len, uint8_t *reply, size_t reply_size)
+{
+	const struct CmdTemplate *cmdp;
+	parms args[PARSER_MAX_ARGS];
+	uint8_t seq;
+	int res_len;
+
+	ASSERT(reply_size >= PARSER_REPLY_HDR);
+
+	if (len < PARSER_FRAME_HDR || frame[0] != PARSER_FRAME_SYNC
+	 || len != (size_t)frame[1] + PARSER_FRAME_HDR)
+		return 0;
+
+	seq = frame[2];
+	cmdp = parser_get_cmd_by_hash((cmd_hash_t)(frame[3] | (frame[4] << 8)));
+	if (!cmdp)
+		return parser_frame_status(seq, PFS_INVALID_CMD, reply);
+
+	/* Same layout of text commands: args[0] is the command name */
+	args[0].s = cmdp->name;
+	if (!unpackArgs(cmdp->arg_fmt, frame + PARSER_FRAME_HDR, frame[1], args + 1))
+		return parser_frame_status(seq, PFS_INVALID_ARGS, reply);
+
+	if (!parser_execute_cmd(cmdp, args))
+		return parser_frame_status(seq, PFS_CMD_ERROR, reply);
+
+	res_len = packResults(cmdp->result_fmt, args + 1 + strlen(cmdp->arg_fmt),
+		reply + PARSER_REPLY_HDR, MIN(reply_size - PARSER_REPLY_HDR, (size_t)255));
+	if (res_len < 0)
+		return parser_frame_status(seq, PFS_REPLY_OVERFLOW, reply);
+
+	parser_frame_status(seq, PFS_OK, reply);
+	reply[1] = (uint8_t)res_len;
+	return PARSER_REPLY_HDR + res_len;
 }
 
 #if CONFIG_INTERNAL_COMMANDS
@@ -365,11 +620,9 @@ static ResultCode cmd_help(void)
 
 	// FIXME: There is no way at the moment to access the serial port. Dump
 	//  this through JTAG for now
-	for (HashIterator iter = ht_iter_begin(&commands);
-		!ht_iter_cmp(iter, ht_iter_end(&commands));
-		iter = ht_iter_next(iter))
+	for (size_t i = 0; i < num_commands; ++i)
 	{
-		struct CmdTemplate* cmd = (struct CmdTemplate*)ht_iter_get(iter);
+		const struct CmdTemplate* cmd = sorted_commands[i];
 		kprintf("%-20s", cmd->name);
 		for (unsigned j = 0; cmd->arg_fmt[j]; ++j)
 			kprintf("%c ", 'a' + j);
@@ -388,8 +641,9 @@ DECLARE_CMD_HUNK(help, (NIL), (NIL));
 
 void parser_init(void)
 {
-	// Initialize the hashtable used to store the command description
-	ht_init(&commands);
+	// Clear the table used to store the command description
+	memset(commands, 0, sizeof(commands));
+	num_commands = 0;
 
 #if CONFIG_INTERNAL_COMMANDS
 	parser_register_cmd(&CMD_HUNK_TEMPLATE(help));
@@ -45,9 +45,52 @@
 
 #include <cpu/types.h>
 
+#include <stddef.h> /* size_t */
+
 /** Max number of arguments and results for each command */
 #define PARSER_MAX_ARGS       8
 
+/**
+ * \name Binary command frames.
+ *
+ * Machine clients can skip the text protocol and send commands
+ * as binary frames:
+ *
+ * \code
+ * request: | SYNC | len | seq | hash_lo | hash_hi | args (len bytes)    |
+ * reply:   | SYNC | len | seq | status            | results (len bytes) |
+ * \endcode
+ *
+ * \a seq is echoed back in the reply, \a hash is the name hash returned
+ * by parser_cmd_hash(), \a status is one of the PFS_* codes.
+ * Arguments and results are packed following the format strings
+ * of the command: 'd' values are 32 bit little endian integers,
+ * 's' values are NUL terminated strings.
+ * Results are only sent when status is PFS_OK.
+ * \{
+ */
+#define PARSER_FRAME_SYNC     0xA5 ///< First byte of every frame.
+#define PARSER_FRAME_HDR      5    ///< Size of request header.
+#define PARSER_REPLY_HDR      4    ///< Size of reply header.
+#define PARSER_FRAME_MAX      (PARSER_FRAME_HDR + 255) ///< Max size of a request.
+/* \} */
+
+/**
+ * Status codes of binary replies.
+ * Error codes match the ones of the text protocol.
+ */
+typedef enum
+{
+	PFS_OK            = 0,  ///< Command executed, results follow.
+	PFS_INVALID_CMD   = -1, ///< Unknown command hash.
+	PFS_INVALID_ARGS  = -2, ///< Arguments do not match the command format.
+	PFS_CMD_ERROR     = -3, ///< The command returned an error.
+	PFS_REPLY_OVERFLOW = -4, ///< Results do not fit in the reply buffer.
+} ParserFrameStatus;
+
+/** Hash of a command name, used in binary frames */
+typedef uint16_t cmd_hash_t;
+
 /**
  * Error generated by the commands through the return code.
  */
@@ -98,8 +141,11 @@ void parser_init(void);
  *
  * \param cmd Command template describing the command
  *
+ * \return True if the command is also available to binary frames, false
+ *         if its name hash is already used by another command: in this
+ *         case the command can only be run by name, from the text protocol.
  */
-void parser_register_cmd(const struct CmdTemplate* cmd);
+bool parser_register_cmd(const struct CmdTemplate* cmd);
 
 
 /**
@@ -112,6 +158,23 @@ void parser_register_cmd(const struct CmdTemplate* cmd);
 const char* parser_rl_match(void* dummy, const char* word, int word_len);
 
 
+/**
+ * Completion hook for readline: find the commands whose name starts
+ * with \a word, \a word_len characters long, with a binary search
+ * on the commands sorted by name.
+ *
+ * \param match Will contain the name of the first matching command.
+ * \param match_len Will contain the length of the prefix shared by
+ * all the matching names.
+ *
+ * \return Number of matching commands.
+ *
+ * \note See rl_sethook_complete() in mware/readline.h.
+ */
+int parser_rl_complete(void* dummy, const char* word, int word_len,
+	const char** match, int* match_len);
+
+
 /**
  * \brief Command input handler.
  *
@@ -181,5 +244,45 @@ bool parser_get_cmd_arguments(const char* line, const struct CmdTemplate* templ,
 bool parser_get_cmd_id(const char* line, unsigned long* ID);
 
 
+/**
+ * Compute the hash of the command named \a name, \a len characters long.
+ *
+ * The hash is the 16 bit rotating hash of the name (algo/rotating_hash.h),
+ * so host software can compute it on its own from the command names.
+ * Not to be confused with the sequence number read by parser_get_cmd_id().
+ */
+cmd_hash_t parser_cmd_hash(const char *name, size_t len);
+
+
+/**
+ * Find the template of the command with name hash \a hash.
+ *
+ * \return The command template, or NULL if no command has that hash.
+ */
+const struct CmdTemplate* parser_get_cmd_by_hash(cmd_hash_t hash);
+
+
+/**
+ * \brief Binary frame handler.
+ *
+ * Decode the request in \a frame, \a len bytes long, execute the command
+ * and build the whole reply in \a reply, \a reply_size bytes long
+ * (at least PARSER_REPLY_HDR), so that it can be sent with a single write.
+ * String arguments point inside \a frame.
+ *
+ * \return Length of the reply, 0 if \a frame is not a well formed frame.
+ */
+size_t parser_process_frame(const uint8_t *frame, size_t len, uint8_t *reply, size_t reply_size);
+
+
+/**
+ * Build in \a reply the header of a reply with \a status and no results,
+ * for the request with sequence number \a seq.
+ *
+ * \return Length of the reply.
+ */
+size_t parser_frame_status(uint8_t seq, ParserFrameStatus status, uint8_t *reply);
+
+
 #endif /* MWARE_PARSER_H */
 
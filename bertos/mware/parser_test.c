@@ -0,0 +1,370 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Command parser test.
+ *
+ * Commands are looked up both from text lines and from binary frames,
+ * checking that they share the same IDs and templates and that malformed
+ * frames are refused.
+ *
+ * The benchmark serves the same commands as text lines, replying with
+ * kfile_printf() like app/triface/protocol.c does, and as binary frames,
+ * replying with a single write. Results are printed on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<text|frame> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "parser.h"
+
+#include <algo/rotating_hash.h>
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+#include <cfg/test.h>
+
+#include <kern/kfile.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+#define BENCH_ROUNDS  200000
+
+static ResultCode cmd_add(parms *args)
+{
+	args[3].l = args[1].l + args[2].l;
+	return RC_OK;
+}
+
+static ResultCode cmd_echo(parms *args)
+{
+	args[2].s = args[1].s;
+	return RC_OK;
+}
+
+static ResultCode cmd_ver(parms *args)
+{
+	args[1].l = 2;
+	args[2].l = -1;
+	args[3].l = 1723;
+	return RC_OK;
+}
+
+static ResultCode cmd_fail(UNUSED_ARG(parms *, args))
+{
+	return RC_ERROR;
+}
+
+static const struct CmdTemplate cmds[] =
+{
+	{ "add",  "dd", "d",   cmd_add,  0 },
+	{ "echo", "s",  "s",   cmd_echo, 0 },
+	{ "ver",  "",   "ddd", cmd_ver,  0 },
+	{ "fail", "",   "",    cmd_fail, 0 },
+};
+
+/* Memory KFile collecting the replies */
+static struct
+{
+	KFile fd;
+	uint8_t buf[512];
+	size_t len;
+	unsigned long writes;
+} out;
+
+static size_t out_write(UNUSED_ARG(struct KFile *, fd), const void *buf, size_t size)
+{
+	/* Keep the last reply only */
+	if (out.len + size > sizeof(out.buf))
+		out.len = 0;
+	memcpy(out.buf + out.len, buf, size);
+	out.len += size;
+	out.writes++;
+	return size;
+}
+
+static void out_init(void)
+{
+	memset(&out, 0, sizeof(out));
+	out.fd.write = out_write;
+	out.fd.close = kfile_genericClose;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static int32_t get32(const uint8_t *p)
+{
+	return (int32_t)(p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+/* Build a request frame for command \a name, with \a args_len bytes of packed \a args */
+static size_t makeFrame(uint8_t *frame, uint8_t seq, const char *name, const void *args, size_t args_len)
+{
+	cmd_hash_t hash = parser_cmd_hash(name, strlen(name));
+
+	frame[0] = PARSER_FRAME_SYNC;
+	frame[1] = (uint8_t)args_len;
+	frame[2] = seq;
+	frame[3] = (uint8_t)hash;
+	frame[4] = (uint8_t)(hash >> 8);
+	if (args_len)
+		memcpy(frame + PARSER_FRAME_HDR, args, args_len);
+	return PARSER_FRAME_HDR + args_len;
+}
+
+static void lookup(void)
+{
+	for (size_t i = 0; i < countof(cmds); i++)
+	{
+		char line[32];
+		rotating_t rot;
+		cmd_hash_t hash = parser_cmd_hash(cmds[i].name, strlen(cmds[i].name));
+
+		/* Hashes are the documented rotating hash of the name */
+		rotating_init(&rot);
+		rotating_update(cmds[i].name, strlen(cmds[i].name), &rot);
+		ASSERT(hash == rot);
+
+		ASSERT(parser_get_cmd_by_hash(hash) == &cmds[i]);
+		snprintf(line, sizeof(line), "7 %s 1 2", cmds[i].name);
+		ASSERT(parser_get_cmd_template(line) == &cmds[i]);
+	}
+
+	ASSERT(!parser_get_cmd_template("7 ad 1 2"));
+	ASSERT(!parser_get_cmd_template("7 addd 1 2"));
+	ASSERT(!parser_get_cmd_by_hash(parser_cmd_hash("sub", 3)));
+
+	ASSERT(parser_rl_match(NULL, "ec", 2) == cmds[1].name);
+	ASSERT(parser_rl_match(NULL, "f", 1) == cmds[3].name);
+	ASSERT(!parser_rl_match(NULL, "x", 1));
+}
+
+static void textCommands(void)
+{
+	parms args[PARSER_MAX_ARGS];
+	const struct CmdTemplate *templ = parser_get_cmd_template("3 add 1234 -56");
+
+	ASSERT(templ == &cmds[0]);
+	ASSERT(parser_get_cmd_arguments("3 add 1234 -56", templ, args));
+	ASSERT(parser_execute_cmd(templ, args));
+	ASSERT(args[3].l == 1178);
+
+	ASSERT(!parser_get_cmd_arguments("3 add 1234", templ, args));
+	ASSERT(parser_process_line("3 ver"));
+	ASSERT(!parser_process_line("3 fail"));
+}
+
+static void frames(void)
+{
+	uint8_t frame[PARSER_FRAME_MAX], reply[64], args[16];
+	size_t len;
+
+	/* Integer arguments and results */
+	put32(args, 1234);
+	put32(args + 4, (uint32_t)-56);
+	len = makeFrame(frame, 42, "add", args, 8);
+	ASSERT(parser_process_frame(frame, len, reply, sizeof(reply)) == PARSER_REPLY_HDR + 4);
+	ASSERT(reply[0] == PARSER_FRAME_SYNC && reply[1] == 4 && reply[2] == 42);
+	ASSERT(reply[3] == PFS_OK && get32(reply + 4) == 1178);
+
+	len = makeFrame(frame, 43, "ver", NULL, 0);
+	ASSERT(parser_process_frame(frame, len, reply, sizeof(reply)) == PARSER_REPLY_HDR + 12);
+	ASSERT(get32(reply + 4) == 2 && get32(reply + 8) == -1 && get32(reply + 12) == 1723);
+
+	/* Strings */
+	len = makeFrame(frame, 44, "echo", "hello", 6);
+	ASSERT(parser_process_frame(frame, len, reply, sizeof(reply)) == PARSER_REPLY_HDR + 6);
+	ASSERT(reply[1] == 6 && !memcmp(reply + 4, "hello", 6));
+
+	/* Errors */
+	len = makeFrame(frame, 45, "sub", args, 8);
+	ASSERT(parser_process_frame(frame, len, reply, sizeof(reply)) == PARSER_REPLY_HDR);
+	ASSERT(reply[1] == 0 && reply[2] == 45 && (int8_t)reply[3] == PFS_INVALID_CMD);
+
+	len = makeFrame(frame, 46, "add", args, 7);
+	ASSERT(parser_process_frame(frame, len, reply, sizeof(reply)) == PARSER_REPLY_HDR);
+	ASSERT((int8_t)reply[3] == PFS_INVALID_ARGS);
+
+	len = makeFrame(frame, 46, "add", args, 9);
+	ASSERT(parser_process_frame(frame, len, reply, sizeof(reply)) == PARSER_REPLY_HDR);
+	ASSERT((int8_t)reply[3] == PFS_INVALID_ARGS);
+
+	len = makeFrame(frame, 47, "echo", "hello", 5);
+	ASSERT(parser_process_frame(frame, len, reply, sizeof(reply)) == PARSER_REPLY_HDR);
+	ASSERT((int8_t)reply[3] == PFS_INVALID_ARGS);
+
+	len = makeFrame(frame, 48, "fail", NULL, 0);
+	ASSERT(parser_process_frame(frame, len, reply, sizeof(reply)) == PARSER_REPLY_HDR);
+	ASSERT((int8_t)reply[3] == PFS_CMD_ERROR);
+
+	len = makeFrame(frame, 49, "ver", NULL, 0);
+	ASSERT(parser_process_frame(frame, len, reply, PARSER_REPLY_HDR + 11) == PARSER_REPLY_HDR);
+	ASSERT((int8_t)reply[3] == PFS_REPLY_OVERFLOW);
+
+	/* Malformed frames get no reply */
+	len = makeFrame(frame, 50, "add", args, 8);
+	ASSERT(!parser_process_frame(frame, len - 1, reply, sizeof(reply)));
+	ASSERT(!parser_process_frame(frame, PARSER_FRAME_HDR - 1, reply, sizeof(reply)));
+	frame[0] = 'x';
+	ASSERT(!parser_process_frame(frame, len, reply, sizeof(reply)));
+}
+
+/*
+ * Text reply, as done by protocol_reply() in app/triface/protocol.c.
+ */
+static void textReply(KFile *fd, const struct CmdTemplate *t, const parms *args)
+{
+	size_t offset = strlen(t->arg_fmt) + 1;
+	size_t nres = strlen(t->result_fmt);
+
+	for (size_t i = 0; i < nres; ++i)
+	{
+		if (t->result_fmt[i] == 'd')
+			kfile_printf(fd, " %ld", args[offset + i].l);
+		else
+			kfile_printf(fd, " %s", args[offset + i].s);
+	}
+	kfile_printf(fd, "\r\n");
+}
+
+static void bench(void)
+{
+	static const char * const lines[] = { "12 add 1234 -56", "13 ver", "14 echo hello" };
+	uint8_t frames[countof(lines)][32], reply[64], args[8];
+	size_t frame_len[countof(lines)];
+	unsigned long start, t, rx_bytes, tx_bytes, sum;
+	int path, i;
+
+	put32(args, 1234);
+	put32(args + 4, (uint32_t)-56);
+	frame_len[0] = makeFrame(frames[0], 12, "add", args, 8);
+	frame_len[1] = makeFrame(frames[1], 13, "ver", NULL, 0);
+	frame_len[2] = makeFrame(frames[2], 14, "echo", "hello", 6);
+
+	for (path = 0; path < 2; path++)
+	{
+		out_init();
+		rx_bytes = tx_bytes = sum = 0;
+		start = bench_nsec();
+		for (i = 0; i < BENCH_ROUNDS; i++)
+		{
+			size_t n = i % countof(lines);
+			size_t before = out.len;
+
+			if (path)
+			{
+				size_t len = parser_process_frame(frames[n], frame_len[n], reply, sizeof(reply));
+
+				kfile_write(&out.fd, reply, len);
+				rx_bytes += frame_len[n];
+			}
+			else
+			{
+				parms a[PARSER_MAX_ARGS];
+				const struct CmdTemplate *templ = parser_get_cmd_template(lines[n]);
+
+				if (templ && parser_get_cmd_arguments(lines[n], templ, a)
+				 && parser_execute_cmd(templ, a))
+					textReply(&out.fd, templ, a);
+				rx_bytes += strlen(lines[n]) + 2;
+			}
+			tx_bytes += out.len > before ? out.len - before : out.len;
+			sum += out.buf[out.len - 1];
+		}
+		t = bench_nsec() - start;
+		printf("BENCH scenario=dispatch path=%s commands=%d rx_bytes=%lu tx_bytes=%lu writes=%lu time_us=%lu ns_per_cmd=%lu sum=%lu\n",
+			path ? "frame" : "text", BENCH_ROUNDS, rx_bytes, tx_bytes, out.writes,
+			t / 1000, t / BENCH_ROUNDS, sum);
+	}
+}
+
+static void collisions(void)
+{
+	/* "aet" has the same name hash of "add" */
+	static const struct CmdTemplate aet = { "aet", "dd", "d", cmd_add, 0 };
+	cmd_hash_t hash = parser_cmd_hash("add", 3);
+
+	ASSERT(parser_cmd_hash("aet", 3) == hash);
+	ASSERT(!parser_register_cmd(&aet));
+
+	/* Only available as text, the frame hash still runs "add" */
+	ASSERT(parser_get_cmd_template("7 aet 1 2") == &aet);
+	ASSERT(parser_get_cmd_template("7 add 1 2") == &cmds[0]);
+	ASSERT(parser_get_cmd_by_hash(hash) == &cmds[0]);
+	ASSERT(!parser_get_cmd_template("7 ae 1 2"));
+	ASSERT(parser_rl_match(NULL, "ae", 2) == aet.name);
+}
+
+int parser_testSetup(void)
+{
+	kdbg_init();
+	parser_init();
+	for (size_t i = 0; i < countof(cmds); i++)
+		parser_register_cmd(&cmds[i]);
+	return 0;
+}
+
+int parser_testRun(void)
+{
+	lookup();
+	collisions();
+	textCommands();
+	frames();
+	bench();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int parser_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(parser);
+
+#include <mware/parser.c>
+#include <kern/kfile.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif // UNIT_TEST
@@ -35,33 +35,23 @@
  *
  * Rationale for basic implementation choices:
  *
- * \li The history is implemented storing consecutive ASCIIZ strings within an array of memory. When
- * the history is full, the first (oldest) line is cancelled and the whole buffer is memmoved to
- * overwrite it and make room. while this is is obviously not the fastest algorithm (which would
- * require the use of a circular buffer) it is surely good enough for this module, which does not
- * aim at fast performances (line editing does not require to be blazingly fast).
+ * \li The history is a ring of line descriptors (start and length) over a ring of text.
+ * Adding a line evicts the oldest ones until there is room both for the descriptor and for the
+ * text: each eviction is O(1), nothing is ever moved and lines can wrap around the end of the
+ * text buffer.
  *
- * \li The first character in the history is always \c \\0, and it is used as a guard. By 'wasting' it
- * in this way, the code actually gets much simpler in that we remove many checks when moving 
- * backward (\c i>0 and similar).
+ * \li The line being edited lives in its own buffer, always kept null-terminated: it is
+ * returned to the caller as is, and lines recalled from the history are copied in it, so
+ * that they can be edited without changing the history.
  *
- * \li While editing, the current index points to the position of the buffer which contains the
- * last character typed in (exactly like a stack pointer). This also allows to simplify calculations
- * and to make easier using the last byte of history.
+ * \li Terminal output is sent as deltas: when the line changes only the characters from the
+ * first difference on are written, the cursor is moved with backspaces (or by writing again
+ * the characters it passes over, which is cheaper than an escape sequence) and the tail of a
+ * longer line is cleared with spaces or with an erase sequence, whichever is shorter.
  *
- * \li While editing, the current line is always kept null-terminated. This is important because
- * if the user press ENTER, we must have room to add a \c \\0 to terminate the line. If the line
- * is as long as the whole history buffer, there would not be space for it. By always keeping the
- * \c \\0 at the end, we properly ensure this without making index checks harder.
- *
- * \li When removing a line from the history (see \c pop_history()), instead of updating all the
- * indices we have around, we move backward the pointer to the history we use. This way, we don't
- * have to update anything. This means that we keep two pointers to the history: \c real_history
- * always points to the physical start, while \c history is the adjusted pointer (that is
- * dereference to read/write to it).
- *
- * \todo Use up/down to move through history  The history line will be copied to the current line,
- * making sure there is room for it.
+ * \li Output is collected in a small buffer, written just before waiting for the next key:
+ * every key costs a single call of the write hook. On slow links this keeps the terminal
+ * responsive, since the number of characters is the only cost that matters.
  *
  * \version $Id: readline.c 1313 2008-05-21 08:47:05Z asterix $
  *
@@ -73,14 +63,7 @@
 
 #include <cfg/compiler.h>
 #include <cfg/debug.h>
-
-#include <stdio.h>
-
-/// Enable compilation of the unit test code
-#define DEBUG_UNIT_TEST       0
-
-/// Enable dump of the history after each line
-#define DEBUG_DUMP_HISTORY    0
+#include <cfg/macros.h> // MIN()
 
 
 /** Special keys (escape sequences converted to a single code) */
@@ -135,35 +118,78 @@ enum RL_KEYS {
 	KEY_F10, KEY_F11, KEY_F12,
 };
 
+STATIC_ASSERT(RL_LINE_SIZE <= 256);
+STATIC_ASSERT(HISTORY_SIZE <= 65536);
+STATIC_ASSERT(HISTORY_LINES <= 255);
+
+/// ANSI sequence erasing from the cursor to the end of the line.
+#define ERASE_EOL  "\x1b[K"
+
 /** Check if \a c is a separator between words.
  *  \note Parameter \a c is evaluated multiple times
  */
 #define IS_WORD_SEPARATOR(c) ((c) == ' ' || (c) == '\0')
 
-/// Write the string \a txt to the IO output (without any kind of termination)
-INLINE void rl_puts(const struct RLContext* ctx, const char* txt)
+/// Send the buffered output through the hooks.
+static void rl_flush(struct RLContext* ctx)
 {
-	if (!ctx->put)
+	if (!ctx->out_len)
 		return;
 
-	while (*txt)
-		ctx->put(*txt++, ctx->put_param);
+	if (ctx->write)
+		ctx->write(ctx->out, ctx->out_len, ctx->write_param);
+	else if (ctx->put)
+		for (size_t i = 0; i < ctx->out_len; ++i)
+			ctx->put(ctx->out[i], ctx->put_param);
+
+	ctx->out_len = 0;
 }
 
 /// Write character \a ch to the IO output.
-INLINE void rl_putc(const struct RLContext* ctx, char ch)
+INLINE void rl_putc(struct RLContext* ctx, char ch)
 {
-	if (ctx->put)
-		ctx->put(ch, ctx->put_param);
+	if (ctx->out_len == sizeof(ctx->out))
+		rl_flush(ctx);
+	ctx->out[ctx->out_len++] = ch;
+}
+
+/// Write \a len characters of \a txt to the IO output.
+static void rl_write(struct RLContext* ctx, const char* txt, size_t len)
+{
+	while (len--)
+		rl_putc(ctx, *txt++);
+}
+
+/// Write the string \a txt to the IO output (without any kind of termination)
+INLINE void rl_puts(struct RLContext* ctx, const char* txt)
+{
+	rl_write(ctx, txt, strlen(txt));
+}
+
+/// Write character \a ch \a n times.
+static void rl_repeat(struct RLContext* ctx, char ch, size_t n)
+{
+	while (n--)
+		rl_putc(ctx, ch);
+}
+
+/// Read a character from the IO, without any conversion.
+INLINE int rl_getc_raw(struct RLContext* ctx)
+{
+	return ctx->get(ctx->get_param);
 }
 
 /** Read a character from the IO into \a ch. This function also takes
  *  care of converting the ANSI escape sequences into one of the codes
  *  defined in \c RL_KEYS.
+ *  Pending output is sent before waiting for the character.
  */
-static bool rl_getc(const struct RLContext* ctx, int* ch)
+static bool rl_getc(struct RLContext* ctx, int* ch)
 {
-	int c = ctx->get(ctx->get_param);
+	int c;
+
+	rl_flush(ctx);
+	c = rl_getc_raw(ctx);
 
 	if (c == EOF)
 	{
@@ -177,26 +203,20 @@ static bool rl_getc(const struct RLContext* ctx, int* ch)
 	{
 		// Unknown ESC sequence. Ignore it and read
 		//  return next character.
-		if (ctx->get(ctx->get_param) != 0x5B)
+		if (rl_getc_raw(ctx) != 0x5B)
 			return rl_getc(ctx, ch);
 
 		/* To be added:
-			* Home:        0x1b 0x5B 0x31 0x7E
 			* F6:          0x1b 0x5B 0x31 0x37 0x7E
 			* F7:          0x1b 0x5B 0x31 0x38 0x7E
 			* F8:          0x1b 0x5B 0x31 0x39 0x7E
-			* Ins:         0x1b 0x5B 0x32 0x7E
 			* F9:          0x1b 0x5B 0x32 0x30 0x7E
 			* F10:         0x1b 0x5B 0x32 0x31 0x7E
 			* F11:         0x1b 0x5B 0x32 0x33 0x7E
 			* F12:         0x1b 0x5B 0x32 0x34 0x7E
-			* Del:         0x1b 0x5B 0x33 0x7E
-			* End:         0x1b 0x5B 0x34 0x7E
-			* PgUp:        0x1b 0x5B 0x35 0x7E
-			* PgDn:        0x1b 0x5B 0x36 0x7E
 		*/
 
-		c = ctx->get(ctx->get_param);
+		c = rl_getc_raw(ctx);
 		switch (c)
 		{
 		case 0x41: c = KEY_UP_ARROW; break;
@@ -204,8 +224,24 @@ static bool rl_getc(const struct RLContext* ctx, int* ch)
 		case 0x43: c = KEY_RIGHT_ARROW; break;
 		case 0x44: c = KEY_LEFT_ARROW; break;
 		case 0x50: c = KEY_PAUSE; break;
+		case 0x48: c = KEY_HOME; break;
+		case 0x46: c = KEY_END; break;
+		case 0x31: case 0x32: case 0x33:
+		case 0x34: case 0x35: case 0x36:
+			if (rl_getc_raw(ctx) != 0x7E)
+				return rl_getc(ctx, ch);
+			switch (c)
+			{
+			case 0x31: c = KEY_HOME; break;
+			case 0x32: c = KEY_INS; break;
+			case 0x33: c = KEY_DEL; break;
+			case 0x34: c = KEY_END; break;
+			case 0x35: c = KEY_PGUP; break;
+			default:   c = KEY_PGDN; break;
+			}
+			break;
 		case 0x5B:
-			c = ctx->get(ctx->get_param);
+			c = rl_getc_raw(ctx);
 			switch (c)
 			{
 			case 0x41: c = KEY_F1; break;
@@ -229,277 +265,323 @@ INLINE void beep(struct RLContext* ctx)
 	rl_putc(ctx, '\a');
 }
 
-static bool pop_history(struct RLContext* ctx, int total_len)
+/// Return the descriptor of history line \a n, 0 being the newest.
+INLINE struct RLHistLine* history_line(struct RLContext* ctx, int n)
 {
-	// Compute the length of the first command (including terminator).
-	int len = strlen(ctx->real_history+1)+1;
+	return &ctx->history[(ctx->history_first + ctx->history_count - 1 - n) % HISTORY_LINES];
+}
 
-	// (the first byte of the history should always be 0)
-	ASSERT(ctx->real_history[0] == '\0');
+/// Remove the oldest line from the history.
+static void pop_history(struct RLContext* ctx)
+{
+	ASSERT(ctx->history_count);
 
-	// If it is the only one in the history, do nothing
-	if (len == total_len)
-		return false;
+	ctx->history_used -= ctx->history[ctx->history_first].len;
+	ctx->history_first = (ctx->history_first + 1) % HISTORY_LINES;
+	ctx->history_count--;
+}
 
-	// Overwrite the first command with the second one
-	memmove(ctx->real_history, ctx->real_history+len, HISTORY_SIZE-len);
+/// Add \a len characters of \a line to the history, evicting old lines if needed.
+static void push_history(struct RLContext* ctx, const char* line, size_t len)
+{
+	struct RLHistLine* h;
+	size_t start, first;
 
-	// Move back the ctx->buffer pointer so that all the indices are still valid
-	ctx->history -= len;
+	while (ctx->history_count == HISTORY_LINES || ctx->history_used + len > HISTORY_SIZE)
+		pop_history(ctx);
 
-	return true;
+	if (ctx->history_count)
+	{
+		h = history_line(ctx, 0);
+		start = (h->start + h->len) % HISTORY_SIZE;
+	}
+	else
+		start = 0;
+
+	ctx->history_count++;
+	h = history_line(ctx, 0);
+	h->start = start;
+	h->len = len;
+	ctx->history_used += len;
+
+	// Copy the text, wrapping around the end of the buffer
+	first = MIN(len, HISTORY_SIZE - start);
+	memcpy(ctx->history_buf + start, line, first);
+	memcpy(ctx->history_buf, line + first, len - first);
 }
 
-/// Check if index \a i points to the begin of the history.
-INLINE bool is_history_begin(struct RLContext* ctx, int i)
-{ return ctx->history + i == ctx->real_history; }
+/// Copy history line \a n in \a buf, returning its length.
+static size_t get_history(struct RLContext* ctx, int n, char* buf)
+{
+	const struct RLHistLine* h = history_line(ctx, n);
+	size_t first = MIN((size_t)h->len, (size_t)(HISTORY_SIZE - h->start));
 
-/// Check if index \a i points to the (exclusive) end of history
-INLINE bool is_history_end(struct RLContext* ctx, int i)
-{ return ctx->history + i == ctx->real_history + HISTORY_SIZE; }
+	memcpy(buf, ctx->history_buf + h->start, first);
+	memcpy(buf + first, ctx->history_buf, h->len - first);
+	buf[h->len] = '\0';
+	return h->len;
+}
 
-/// Check if index \a i points to the (exclusive) end of history, or somewhere past the end.
-INLINE bool is_history_past_end(struct RLContext* ctx, int i)
-{ return ctx->history + i >= ctx->real_history + HISTORY_SIZE; }
+/// Move the terminal cursor to position \a pos of the line.
+static void move_cursor(struct RLContext* ctx, size_t pos)
+{
+	if (pos < ctx->cursor)
+		rl_repeat(ctx, '\b', ctx->cursor - pos);
+	else
+		rl_write(ctx, ctx->line + ctx->cursor, pos - ctx->cursor);
 
-/** Insert \a num_chars characters from \a ch into the history buffer at the
- *  position indicated by \a curpos. If needed, remove old history to make room.
- *  Returns true if everything was successful, false if there was no room to
- *  add the characters.
- *  \note \a num_chars can be 0, in which case we just make sure the line is
- *  correctly zero-terminated (ASCIIZ format).
+	ctx->cursor = pos;
+}
+
+/**
+ * Write the line from position \a from, which must be the cursor
+ * position, to the end, clearing \a old_len - line_len characters
+ * left by a longer line, and move back the cursor to \a pos.
  */
-static bool insert_chars(struct RLContext* ctx, size_t *curpos, const char* ch, int num_chars)
+static void redraw_tail(struct RLContext* ctx, size_t from, size_t old_len, size_t pos)
 {
-	ASSERT(!is_history_past_end(ctx, *curpos));
+	size_t end = ctx->line_len;
+
+	ASSERT(ctx->cursor == from);
+	rl_write(ctx, ctx->line + from, end - from);
 
-	while (is_history_past_end(ctx, *curpos+num_chars+1))
+	if (old_len > end)
 	{
-		if (!pop_history(ctx, *curpos))
-			return false;
-	}
+		size_t n = old_len - end;
 
-	while (num_chars--)
-		ctx->history[++(*curpos)] = *ch++;
+		// Spaces and backspaces, or the erase sequence
+		if (2 * n <= sizeof(ERASE_EOL) - 1)
+		{
+			rl_repeat(ctx, ' ', n);
+			rl_repeat(ctx, '\b', n);
+		}
+		else
+			rl_puts(ctx, ERASE_EOL);
+	}
 
-	ASSERT(!is_history_past_end(ctx, *curpos + 1));
-	ctx->history[*curpos+1] = '\0';
-	return true;
+	ctx->cursor = end;
+	move_cursor(ctx, pos);
 }
 
-/// Insert a single character \a ch into the buffer (with the same semantic of \c insert_chars())
-static bool insert_char(struct RLContext* ctx, size_t *curpos, char ch)
+/// Replace the line with the \a len characters of \a txt, sending only the differences.
+static void replace_line(struct RLContext* ctx, const char* txt, size_t len)
 {
-	return insert_chars(ctx, curpos, &ch, 1);
+	size_t old_len = ctx->line_len;
+	size_t same = 0;
+
+	while (same < len && same < old_len && ctx->line[same] == txt[same])
+		++same;
+
+	move_cursor(ctx, MIN(same, ctx->cursor));
+	memcpy(ctx->line + same, txt + same, len - same);
+	ctx->line[len] = '\0';
+	ctx->line_len = len;
+	move_cursor(ctx, MIN(same, len));
+	redraw_tail(ctx, ctx->cursor, old_len, len);
 }
 
-#if DEBUG_DUMP_HISTORY
-/// Dump the internal history of a context (used only for debug purposes)
-static void dump_history(struct RLContext* ctx)
+/// Recall the history line \a n (-1 for an empty line).
+static void recall_history(struct RLContext* ctx, int n)
 {
-	int k;
-	char buf[8];
-	ASSERT(ctx->real_history[0] == '\0');
-	rl_puts(ctx, "History dump:");
-	rl_puts(ctx, "\r\n");
-	for (k = 1;
-	     ctx->real_history + k != ctx->history + ctx->history_pos + 1;
-	     k += strlen(&ctx->real_history[k]) + 1)
+	char buf[RL_LINE_SIZE];
+	size_t len = 0;
+
+	if (n >= (int)ctx->history_count)
 	{
-		rl_puts(ctx, &ctx->real_history[k]);
-		rl_puts(ctx, "\r\n");
+		beep(ctx);
+		return;
 	}
 
-	sprintf(buf, "%d\r\n", ctx->history_pos + (ctx->history - ctx->real_history));
-	rl_puts(ctx, buf);
+	if (n >= 0)
+		len = get_history(ctx, n, buf);
+	ctx->history_cur = n;
+	replace_line(ctx, buf, len);
 }
-#endif /* DEBUG_DUMP_HISTORY */
 
-/// Complete the current word. Return false if no unambiguous completion was found
-static bool complete_word(struct RLContext *ctx, size_t *curpos)
+/// Insert \a len characters of \a txt at the cursor. Return false if there is no room.
+static bool insert_chars(struct RLContext* ctx, const char* txt, size_t len)
 {
-	const char* completed_word;
-	size_t wstart;
+	size_t pos = ctx->cursor;
 
-	// If the current character is a separator,
-	//  there is nothing to complete
-	wstart = *curpos;
-	if (IS_WORD_SEPARATOR(ctx->history[wstart]))
-	{
-		beep(ctx);
+	if (ctx->line_len + len >= RL_LINE_SIZE)
 		return false;
-	}
+
+	memmove(ctx->line + pos + len, ctx->line + pos, ctx->line_len - pos + 1);
+	memcpy(ctx->line + pos, txt, len);
+	ctx->line_len += len;
+	redraw_tail(ctx, pos, ctx->line_len, pos + len);
+	return true;
+}
+
+/// Delete the character at position \a pos, moving the cursor there.
+static void delete_char(struct RLContext* ctx, size_t pos)
+{
+	move_cursor(ctx, pos);
+	memmove(ctx->line + pos, ctx->line + pos + 1, ctx->line_len - pos);
+	ctx->line_len--;
+	redraw_tail(ctx, pos, ctx->line_len + 1, pos);
+}
+
+/// Complete the word before the cursor. Return false if no completion was found
+static bool complete_word(struct RLContext *ctx)
+{
+	const char* match;
+	int match_len, count;
+	size_t wstart = ctx->cursor;
 
 	// Find the separator before the current word
-	do
+	while (wstart && !IS_WORD_SEPARATOR(ctx->line[wstart - 1]))
 		--wstart;
-	while (!IS_WORD_SEPARATOR(ctx->history[wstart]));
 
-	// Complete the word through the hook
-	completed_word = ctx->match(ctx->match_param, ctx->history + wstart + 1, *curpos - wstart);
-	if (!completed_word)
+	// If the cursor is not at the end of a word, there is nothing to complete
+	if (wstart == ctx->cursor || !IS_WORD_SEPARATOR(ctx->line[ctx->cursor]))
+	{
+		beep(ctx);
 		return false;
+	}
 
-	// Move back the terminal cursor to the separator
-	while (*curpos != wstart)
+	// Complete the word through the hook
+	if (ctx->complete)
+		count = ctx->complete(ctx->complete_param, ctx->line + wstart,
+			ctx->cursor - wstart, &match, &match_len);
+	else
 	{
-		rl_putc(ctx, '\b');
-		--*curpos;
+		match = ctx->match(ctx->match_param, ctx->line + wstart, ctx->cursor - wstart);
+		count = match ? 1 : 0;
+		match_len = match ? (int)strlen(match) : 0;
 	}
 
-	// Insert the completed command
-	insert_chars(ctx, curpos, completed_word, strlen(completed_word));
-	rl_puts(ctx, completed_word);
-	insert_char(ctx, curpos, ' ');
-	rl_putc(ctx, ' ');
+	if (!count || (count > 1 && (size_t)match_len == ctx->cursor - wstart))
+	{
+		beep(ctx);
+		return false;
+	}
+
+	// Insert the missing characters, and a separator if the match is unique
+	if (!insert_chars(ctx, match + ctx->cursor - wstart, match_len - (ctx->cursor - wstart)))
+	{
+		beep(ctx);
+		return false;
+	}
+	if (count == 1 && ctx->line[ctx->cursor] != ' ')
+		insert_chars(ctx, " ", 1);
 
 	return true;
 }
 
 void rl_refresh(struct RLContext* ctx)
 {
+	size_t pos = ctx->cursor;
+
 	rl_puts(ctx, "\r\n");
 	if (ctx->prompt)
 		rl_puts(ctx, ctx->prompt);
-	rl_puts(ctx, ctx->history + ctx->history_pos + 1);
+	ctx->cursor = 0;
+	redraw_tail(ctx, 0, 0, pos);
+	rl_flush(ctx);
 }
 
 const char* rl_readline(struct RLContext* ctx)
 {
-	size_t i = ctx->history_pos;
-
-	if (ctx->prompt)
-		rl_puts(ctx, ctx->prompt);
+	/* A line left incomplete by an IO error is kept, and is still on screen */
+	if (!ctx->editing)
+	{
+		ctx->line[0] = '\0';
+		ctx->line_len = ctx->cursor = 0;
+		ctx->history_cur = -1;
+		ctx->editing = true;
 
-	insert_chars(ctx, &i, NULL, 0);
+		if (ctx->prompt)
+			rl_puts(ctx, ctx->prompt);
+	}
 
 	while (1)
 	{
 		char ch;
 		int c;
 
-		ASSERT(ctx->history - ctx->real_history + ctx->line_pos < HISTORY_SIZE);
-
 		if (!rl_getc(ctx, &c))
 			return NULL;
 
-		// Just ignore special keys for now
-		if (c > SPECIAL_KEYS)
-			continue;
-
-		if (c == '\t')
+		switch (c)
 		{
+		case '\t':
 			// Ask the match hook if available
-			if (!ctx->match)
-				return false;
+			if (!ctx->complete && !ctx->match)
+				return NULL;
 
-			complete_word(ctx, &ctx->line_pos);
+			complete_word(ctx);
 			continue;
-		}
-
-		if (c == '\r' || c == '\n')
-		{
-			if (ctx->prompt)
-				rl_puts(ctx, ctx->prompt);
 
-			// Terminate line
-			insert_chars(ctx, &ctx->line_pos, NULL, 0);
-			rl_puts(ctx, "\r\n");
+		case '\r':
+		case '\n':
 			break;
-		}
 
 		// Backspace cancels a character, or it is ignored if at
 		//  the start of the line
-		if (c == '\b')
-		{
-			if (ctx->history[ctx->line_pos] != '\0')
-			{
-				--ctx->line_pos;
-				rl_puts(ctx, "\b \b");
-			}
+		case '\b':
+		case 0x7F:
+			if (ctx->cursor)
+				delete_char(ctx, ctx->cursor - 1);
 			continue;
-		}
 
-		// Add a character to the buffer, if possible
-		ch = (char)c;
-		ASSERT2(ch == c, "a special key was not properly handled");
-		if (insert_chars(ctx, &ctx->line_pos, &ch, 1))
-		{
-			rl_putc(ctx, ch);
-		}
-		else
-		{
-			beep(ctx);
-		}
-	}
-
-	ctx->history_pos = ctx->line_pos + 1;
-	while (ctx->history[ctx->line_pos] != '\0')
-		--ctx->line_pos;
-
-	// Do not store empty lines in the history
-	if (ctx->line_pos == ctx->history_pos - 1)
-		ctx->history_pos -= 1;
-
-#if DEBUG_DUMP_HISTORY
-	dump_history(ctx);
-#endif
-
-	// Since the current pointer now points to the separator, we need
-	//  to return the first character
-	return &ctx->history[ctx->line_pos + 1];
-}
+		case KEY_DEL:
+			if (ctx->cursor < ctx->line_len)
+				delete_char(ctx, ctx->cursor);
+			continue;
 
+		case KEY_LEFT_ARROW:
+			if (ctx->cursor)
+				move_cursor(ctx, ctx->cursor - 1);
+			continue;
 
-#if DEBUG_UNIT_TEST
+		case KEY_RIGHT_ARROW:
+			if (ctx->cursor < ctx->line_len)
+				move_cursor(ctx, ctx->cursor + 1);
+			continue;
 
-/** Perform the unit test for the readline library */
-void rl_test(void);
+		case KEY_HOME:
+			move_cursor(ctx, 0);
+			continue;
 
-#if HISTORY_SIZE != 32
-	#error This test needs HISTORY_SIZE to be set at 32
-#endif
+		case KEY_END:
+			move_cursor(ctx, ctx->line_len);
+			continue;
 
-static struct RLContext test_ctx;
+		case KEY_UP_ARROW:
+			recall_history(ctx, ctx->history_cur + 1);
+			continue;
 
-static char* test_getc_ptr;
-static int test_getc(void* data)
-{
-	return *test_getc_ptr++;
-}
+		case KEY_DOWN_ARROW:
+			if (ctx->history_cur >= 0)
+				recall_history(ctx, ctx->history_cur - 1);
+			continue;
 
-/** Perform a readline test. The function pipes the characters from \a input_buffer
- *  through the I/O to \c rl_readline(). After the whole string is sent, \c do_test()
- *  checks if the current history within the context match \a expected_history.
- */
-static bool do_test(char* input_buffer, char* expected_history)
-{
-	rl_init_ctx(&test_ctx);
-	rl_sethook_get(&test_ctx, test_getc, NULL);
+		default:
+			// Just ignore other special keys for now
+			if (c > SPECIAL_KEYS)
+				continue;
 
-	test_getc_ptr = input_buffer;
-	while (*test_getc_ptr)
-		rl_readline(&test_ctx);
+			// Add a character to the buffer, if possible
+			ch = (char)c;
+			ASSERT2(ch == c, "a special key was not properly handled");
+			if (!insert_chars(ctx, &ch, 1))
+				beep(ctx);
+			continue;
+		}
 
-	if (memcmp(test_ctx.real_history, expected_history, HISTORY_SIZE) != 0)
-	{
-		ASSERT2(0, "history compare failed");
-		return false;
+		// End of line
+		break;
 	}
 
-	return true;
-}
-
-void rl_test(void)
-{
-	char* test1_in = "a\nb\nc\nd\ne\nf\ng\nh\ni\nj\nk\nl\nm\nn\no\np\nq\nr\ns\nt\nu\nv\nw\nx\ny\nz\n";
-	char test1_hist[HISTORY_SIZE] = "\0l\0m\0n\0o\0p\0q\0r\0s\0t\0u\0v\0w\0x\0y\0z";
+	move_cursor(ctx, ctx->line_len);
+	rl_puts(ctx, "\r\n");
+	rl_flush(ctx);
+	ctx->editing = false;
 
-	if (!do_test(test1_in, test1_hist))
-		return;
+	// Do not store empty lines in the history
+	if (ctx->line_len)
+		push_history(ctx, ctx->line, ctx->line_len);
 
-	kprintf("rl_test successful\n");
+	return ctx->line;
 }
-
-#endif /* DEBUG_UNIT_TEST */
-
@@ -39,6 +39,9 @@
  * \li Abstracted from I/O. The user must provide hooks for getc and putc functions.
  * \li Basic support for ANSI escape sequences for input of special codes.
  * \li Support for command name completion (through a hook).
+ * \li Terminal output is kept to the minimum: edits and history recalls only
+ *     send the characters that changed, and the output of each key is
+ *     collected and sent with a single call of the write hook.
  *
  * \version $Id: readline.h 1210 2008-03-21 00:05:04Z asterix $
  *
@@ -53,13 +56,26 @@
 
 #include <string.h>
 
-#define HISTORY_SIZE       1024
+#define HISTORY_SIZE       1024 ///< Bytes of history text.
+#define HISTORY_LINES      32   ///< Max number of lines in the history.
+#define RL_LINE_SIZE       80   ///< Max length of a line, terminator included.
+#define RL_OUT_SIZE        32   ///< Size of the output buffer.
 
 typedef int (*getc_hook)(void* user_data);
 typedef void (*putc_hook)(char ch, void* user_data);
+typedef void (*write_hook)(const char* buf, size_t len, void* user_data);
 typedef const char* (*match_hook)(void* user_data, const char* word, int word_len);
+typedef int (*complete_hook)(void* user_data, const char* word, int word_len,
+	const char** match, int* match_len);
 typedef void (*clear_hook)(void* user_data);
 
+/// Line of the history: position and length of its text in \c history_buf.
+struct RLHistLine
+{
+	uint16_t start;
+	uint8_t len;
+};
+
 struct RLContext
 {
 	getc_hook get;
@@ -68,31 +84,48 @@ struct RLContext
 	putc_hook put;
 	void* put_param;
 
+	write_hook write;
+	void* write_param;
+
 	match_hook match;
 	void* match_param;
 
+	complete_hook complete;
+	void* complete_param;
+
 	clear_hook clear;
 	void* clear_param;
 
 	const char* prompt;
 
-	char real_history[HISTORY_SIZE];
-	char* history;
-	size_t history_pos;
-	size_t line_pos;
+	char history_buf[HISTORY_SIZE];            ///< Ring with the text of the lines.
+	struct RLHistLine history[HISTORY_LINES];  ///< Ring of lines, oldest first.
+	uint8_t history_first;                     ///< Oldest line in \c history.
+	uint8_t history_count;                     ///< Lines in \c history.
+	size_t history_used;                       ///< Bytes used in \c history_buf.
+	int history_cur;                           ///< Recalled line, 0 is the newest, -1 if none.
+
+	char line[RL_LINE_SIZE];                   ///< Line being edited, NUL terminated.
+	size_t line_len;                           ///< Length of \c line.
+	size_t cursor;                             ///< Cursor position in \c line.
+	bool editing;                              ///< True if \c line has not been returned yet.
+
+	char out[RL_OUT_SIZE];                     ///< Output waiting to be written.
+	size_t out_len;                            ///< Bytes in \c out.
 };
 
 INLINE void rl_init_ctx(struct RLContext *ctx)
 {
 	memset(ctx, 0, sizeof(*ctx));
-	ctx->history = ctx->real_history;
+	ctx->history_cur = -1;
 }
 
 INLINE void rl_clear_history(struct RLContext *ctx)
 {
-	memset(ctx->real_history, 0, sizeof(ctx->real_history));
-	ctx->history_pos = 0;
-	ctx->history = ctx->real_history;
+	ctx->history_first = 0;
+	ctx->history_count = 0;
+	ctx->history_used = 0;
+	ctx->history_cur = -1;
 }
 
 INLINE void rl_sethook_get(struct RLContext* ctx, getc_hook get, void* get_param)
@@ -101,9 +134,26 @@ INLINE void rl_sethook_get(struct RLContext* ctx, getc_hook get, void* get_param
 INLINE void rl_sethook_put(struct RLContext* ctx, putc_hook put, void* put_param)
 { ctx->put = put; ctx->put_param = put_param; }
 
+/**
+ * Set a hook writing a whole buffer: if present it is used
+ * instead of the put hook.
+ */
+INLINE void rl_sethook_write(struct RLContext* ctx, write_hook write, void* write_param)
+{ ctx->write = write; ctx->write_param = write_param; }
+
 INLINE void rl_sethook_match(struct RLContext* ctx, match_hook match, void* match_param)
 { ctx->match = match; ctx->match_param = match_param; }
 
+/**
+ * Set a completion hook: it returns the number of words starting with
+ * \a word, sets \a match to the first one and \a match_len to the length
+ * of the prefix shared by all of them.
+ * If present it is used instead of the match hook, allowing completion
+ * of the common prefix of ambiguous words.
+ */
+INLINE void rl_sethook_complete(struct RLContext* ctx, complete_hook complete, void* complete_param)
+{ ctx->complete = complete; ctx->complete_param = complete_param; }
+
 INLINE void rl_sethook_clear(struct RLContext* ctx, clear_hook clear, void* clear_param)
 { ctx->clear = clear; ctx->clear_param = clear_param; }
 
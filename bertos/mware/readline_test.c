@@ -0,0 +1,451 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ * \brief Readline test.
+ *
+ * Keys are fed to rl_readline() through the get hook, and its output is
+ * applied to a minimal terminal emulator: every time a key is read the
+ * emulated screen line must show the prompt and the edited line, with the
+ * cursor in the right place. Random key sequences check the delta redraw,
+ * long lines check the history ring when it wraps and evicts lines.
+ *
+ * The benchmark recalls and edits history lines, comparing the output
+ * with the one of a full redraw of the line. The time spent on a 9600
+ * baud line is printed on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<redraw|delta> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "readline.h"
+#include "parser.h"
+
+#include <cfg/debug.h>
+#include <cfg/macros.h>
+#include <cfg/test.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+
+#define PROMPT  "> "
+
+/* Keys as sent by the terminal */
+#define UP     "\x1b[A"
+#define DOWN   "\x1b[B"
+#define RIGHT  "\x1b[C"
+#define LEFT   "\x1b[D"
+#define HOME   "\x1b[1~"
+#define END    "\x1b[4~"
+#define DEL    "\x1b[3~"
+
+static struct RLContext ctx;
+
+/* From readline.c, to look at the history */
+static size_t get_history(struct RLContext* ctx, int n, char* buf);
+
+/* Input */
+static const char *input;
+
+/* Emulated terminal line */
+static char screen[256];
+static size_t col;
+static bool check_screen;
+
+/* Output statistics */
+static unsigned long out_bytes, out_writes;
+
+static void term_putc(char c)
+{
+	static int esc;
+
+	/* Only the erase to end of line sequence is sent */
+	if (esc || c == 0x1b)
+	{
+		ASSERT(c == "\x1b[K"[esc]);
+		if (++esc == 3)
+		{
+			memset(screen + col, 0, sizeof(screen) - col);
+			esc = 0;
+		}
+	}
+	else if (c == '\r' || c == '\n')
+	{
+		memset(screen, 0, sizeof(screen));
+		col = 0;
+	}
+	else if (c == '\b')
+	{
+		ASSERT(col);
+		col--;
+	}
+	else if (c != '\a')
+	{
+		ASSERT(col < sizeof(screen) - 1);
+		screen[col++] = c;
+	}
+}
+
+static void test_write(const char *buf, size_t len, UNUSED_ARG(void *, data))
+{
+	out_bytes += len;
+	out_writes++;
+
+	while (len--)
+		term_putc(*buf++);
+}
+
+/* Trailing spaces look like empty cells */
+static void trim(char *str)
+{
+	size_t len = strlen(str);
+
+	while (len && str[len - 1] == ' ')
+		str[--len] = '\0';
+}
+
+static void checkScreen(void)
+{
+	char expect[sizeof(screen)], shown[sizeof(screen)];
+
+	snprintf(expect, sizeof(expect), PROMPT "%s", ctx.line);
+	strcpy(shown, screen);
+	trim(expect);
+	trim(shown);
+	if (strcmp(shown, expect) || col != strlen(PROMPT) + ctx.cursor)
+	{
+		kprintf("screen [%s] col %d, expected [%s] col %d\n",
+			screen, (int)col, expect, (int)(strlen(PROMPT) + ctx.cursor));
+		ASSERT(0);
+	}
+}
+
+static int test_getc(UNUSED_ARG(void *, data))
+{
+	/* All the output of the previous key has been written */
+	if (check_screen)
+		checkScreen();
+
+	return *input ? (unsigned char)*input++ : EOF;
+}
+
+static void init(void)
+{
+	rl_init_ctx(&ctx);
+	rl_setprompt(&ctx, PROMPT);
+	rl_sethook_get(&ctx, test_getc, NULL);
+	rl_sethook_write(&ctx, test_write, NULL);
+	rl_sethook_complete(&ctx, parser_rl_complete, NULL);
+	memset(screen, 0, sizeof(screen));
+	col = 0;
+	check_screen = true;
+}
+
+/* Read a line typing \a keys */
+static const char *type(const char *keys)
+{
+	input = keys;
+	return rl_readline(&ctx);
+}
+
+#define EXPECT_LINE(keys, str) \
+	do { \
+		const char *got = type(keys); \
+		if (!got || strcmp(got, (str))) \
+		{ \
+			kprintf("expected [%s] got [%s]\n", (str), got ? got : "(null)"); \
+			ASSERT(0); \
+		} \
+	} while (0)
+
+static void editing(void)
+{
+	init();
+	EXPECT_LINE("hello\r", "hello");
+	EXPECT_LINE("hello" LEFT LEFT "X\r", "helXlo");
+	EXPECT_LINE("hello" LEFT LEFT "\b\r", "helo");
+	EXPECT_LINE("hello" HOME DEL RIGHT "\x7f" END "!\r", "llo!");
+	EXPECT_LINE(LEFT "\b" DEL RIGHT "ab\r", "ab");
+
+	/* A line interrupted by EOF is kept */
+	ASSERT(!type("par"));
+	EXPECT_LINE("tial\r", "partial");
+
+	/* Lines are limited to RL_LINE_SIZE - 1 characters */
+	char keys[RL_LINE_SIZE + 8];
+	memset(keys, 'x', RL_LINE_SIZE + 5);
+	strcpy(keys + RL_LINE_SIZE + 5, "\r");
+	ASSERT(strlen(type(keys)) == RL_LINE_SIZE - 1);
+}
+
+static void history(void)
+{
+	char keys[RL_LINE_SIZE + 8], line[RL_LINE_SIZE];
+
+	init();
+	EXPECT_LINE("first\r", "first");
+	EXPECT_LINE("second\r", "second");
+	EXPECT_LINE("\r", "");
+	EXPECT_LINE(UP "\r", "second");
+	EXPECT_LINE(UP UP UP UP "\r", "first");
+	EXPECT_LINE(UP UP UP UP UP DOWN "\r", "second");
+	EXPECT_LINE(UP UP DOWN DOWN "new\r", "new");
+
+	/* Recalled lines can be edited without changing the history */
+	EXPECT_LINE(UP UP "\b\b\b!\r", "sec!");
+	EXPECT_LINE(UP UP UP "\r", "second");
+
+	/* Max number of lines */
+	init();
+	for (int i = 0; i < HISTORY_LINES + 10; i++)
+	{
+		snprintf(keys, sizeof(keys), "%d\r", i);
+		type(keys);
+	}
+	ASSERT(ctx.history_count == HISTORY_LINES);
+	EXPECT_LINE(UP "\r", "41");
+	ASSERT(ctx.history_count == HISTORY_LINES);
+	EXPECT_LINE(UP UP UP "\r", "40");
+
+	/* Long lines, wrapping around the end of the text buffer */
+	init();
+	for (int i = 0; i < 100; i++)
+	{
+		int len = 20 + (i * 37) % (RL_LINE_SIZE - 21);
+
+		memset(keys, 'a' + i % 26, len);
+		snprintf(keys, sizeof(keys), "%d", i);
+		keys[strlen(keys)] = '-';
+		keys[len] = '\r';
+		keys[len + 1] = '\0';
+		type(keys);
+		ASSERT(ctx.history_used <= HISTORY_SIZE);
+	}
+
+	/* All the lines in history are intact */
+	int count = ctx.history_count;
+	for (int n = 0; n < count; n++)
+	{
+		char got[RL_LINE_SIZE];
+		int i = 99 - n;
+		int len = 20 + (i * 37) % (RL_LINE_SIZE - 21);
+
+		memset(line, 'a' + i % 26, len);
+		snprintf(line, sizeof(line), "%d", i);
+		line[strlen(line)] = '-';
+		line[len] = '\0';
+
+		ASSERT(get_history(&ctx, n, got) == (size_t)len);
+		ASSERT(!strcmp(got, line));
+
+		/* The oldest one is recalled too */
+		if (n == count - 1)
+		{
+			char recall[HISTORY_LINES * 3 + 2] = "";
+
+			for (int k = 0; k <= n + 1; k++)
+				strcat(recall, UP);
+			strcat(recall, "\r");
+			EXPECT_LINE(recall, line);
+		}
+	}
+}
+
+/* Random keys: the screen must always match the line */
+static void randomKeys(void)
+{
+	static const char * const keys[] =
+	{
+		"a", "b", "cd", "\b", "\x7f", UP, DOWN, LEFT, RIGHT, HOME, END, DEL, "\t", " ",
+	};
+	static char seq[4096];
+	unsigned long r = 1;
+
+	init();
+	type("pi\r");
+	type("verbose on\r");
+	type("reset\r");
+
+	for (int round = 0; round < 200; round++)
+	{
+		seq[0] = '\0';
+		for (int k = 0; k < 100; k++)
+		{
+			r = r * 1103515245UL + 12345;
+			strcat(seq, keys[(r >> 16) % countof(keys)]);
+		}
+		strcat(seq, "\r");
+		type(seq);
+	}
+}
+
+static ResultCode cmd_nop(UNUSED_ARG(parms *, args))
+{
+	return RC_OK;
+}
+
+static const struct CmdTemplate cmds[] =
+{
+	{ "ping",    "", "", cmd_nop, 0 },
+	{ "pingall", "", "", cmd_nop, 0 },
+	{ "reset",   "", "", cmd_nop, 0 },
+	{ "ver",     "", "", cmd_nop, 0 },
+	{ "verbose", "", "", cmd_nop, 0 },
+	{ "beep",    "", "", cmd_nop, 0 },
+};
+
+static void completion(void)
+{
+	const char *match;
+	int len;
+
+	ASSERT(parser_rl_complete(NULL, "p", 1, &match, &len) == 2);
+	ASSERT(!strcmp(match, "ping") && len == 4);
+	ASSERT(parser_rl_complete(NULL, "ve", 2, &match, &len) == 2);
+	ASSERT(!strcmp(match, "ver") && len == 3);
+	ASSERT(parser_rl_complete(NULL, "b", 1, &match, &len) == 1);
+	ASSERT(!strcmp(match, "beep") && len == 4);
+	ASSERT(parser_rl_complete(NULL, "", 0, &match, &len) == (int)countof(cmds));
+	ASSERT(parser_rl_complete(NULL, "x", 1, &match, &len) == 0);
+	ASSERT(parser_rl_complete(NULL, "pingallx", 8, &match, &len) == 0);
+	ASSERT(parser_rl_match(NULL, "re", 2) == cmds[2].name);
+	ASSERT(!parser_rl_match(NULL, "ping", 4));
+
+	init();
+	EXPECT_LINE("re\t\r", "reset ");
+	EXPECT_LINE("p\t\r", "ping");
+	EXPECT_LINE("p\tal\t\r", "pingall ");
+	EXPECT_LINE("verb\t1\r", "verbose 1");
+	EXPECT_LINE("x\t\r", "x");
+	EXPECT_LINE("be\t\t\r", "beep ");
+}
+
+/*
+ * Output of a full redraw of the line, as done by rl_refresh() and
+ * by terminals without cursor addressing: prompt, line, clear the
+ * tail of the previous line, move the cursor back.
+ */
+static size_t redrawBytes(size_t old_len, size_t len, size_t cursor)
+{
+	return 1 + strlen(PROMPT) + len + (old_len > len ? 3 : 0) + (len - cursor);
+}
+
+static void bench(void)
+{
+	/* Typical service session: recall and edit previous commands */
+	static const char * const session[] =
+	{
+		"dout 255\r", "din\r", "ain\r", "sleep 1000\r", "dout 0\r",
+		UP UP UP UP UP "\b\b\b15\r",
+		UP UP UP "\r",
+		UP UP UP UP UP UP UP HOME DEL DEL DEL DEL "beep" END "\b\b5\r",
+		UP DOWN UP DOWN UP UP "\r",
+		UP "\b" "128\r",
+	};
+	unsigned long keys = 0, redraw = 0;
+
+	init();
+	out_bytes = out_writes = 0;
+	for (size_t i = 0; i < countof(session); i++)
+	{
+		const char *p = session[i];
+
+		while (*p)
+		{
+			size_t old_len = ctx.line_len;
+			size_t len = p[0] != 0x1b ? 1 : (p[2] >= '1' && p[2] <= '6') ? 4 : 3;
+			char key[8];
+
+			memcpy(key, p, len);
+			key[len] = '\0';
+			p += len;
+			keys++;
+
+			/* Feed one key, stopping at EOF to look at the line after it */
+			if (*key == '\r')
+			{
+				ASSERT(type(key));
+				redraw += 2 + strlen(PROMPT);
+			}
+			else
+			{
+				ASSERT(!type(key));
+				redraw += redrawBytes(old_len, ctx.line_len, ctx.cursor);
+			}
+		}
+	}
+
+	/* A full redraw used to be sent one character at a time */
+	printf("BENCH scenario=session path=redraw keys=%lu out_bytes=%lu writes=%lu ms_at_9600=%lu\n",
+		keys, redraw, redraw, redraw * 1000 / 960);
+	printf("BENCH scenario=session path=delta keys=%lu out_bytes=%lu writes=%lu ms_at_9600=%lu\n",
+		keys, out_bytes, out_writes, out_bytes * 1000 / 960);
+}
+
+int readline_testSetup(void)
+{
+	kdbg_init();
+	parser_init();
+	for (size_t i = 0; i < countof(cmds); i++)
+		parser_register_cmd(&cmds[i]);
+	return 0;
+}
+
+int readline_testRun(void)
+{
+	editing();
+	history();
+	completion();
+	randomKeys();
+	bench();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int readline_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(readline);
+
+#include <mware/readline.c>
+#include <mware/parser.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+#include <mware/hex.c>
+
+#endif // UNIT_TEST
@@ -40,21 +40,21 @@
 #include <cpu/pgm.h>
 #include <cfg/compiler.h>
 
+#include <cfg/macros.h> /* MIN() */
+
 #include <stdio.h>
+#include <string.h> /* memcpy() */
 
 
-static void __str_put_char(char c, void *ptr)
+static void __str_put_block(const char *buf, size_t len, void *ptr)
 {
-	/*
-	 * This Does not work on Code Warrior. Hmm...
-	 *	*(*((char **)ptr))++ = c;
-	 */
+	char **str = (char **)ptr;
 
-	**((char **)ptr) = c;
-	(*((char **)ptr))++;
+	memcpy(*str, buf, len);
+	*str += len;
 }
 
-static void __null_put_char(UNUSED_ARG(char, c), UNUSED_ARG(void *, ptr))
+static void __null_put_block(UNUSED_ARG(const char *, buf), UNUSED_ARG(size_t, len), UNUSED_ARG(void *, ptr))
 {
 	/* nop */
 }
@@ -66,13 +66,13 @@ int PGM_FUNC(vsprintf)(char *str, const char * PGM_ATTR fmt, va_list ap)
 
 	if (str)
 	{
-		result = PGM_FUNC(_formatted_write)(fmt, __str_put_char, &str, ap);
+		result = PGM_FUNC(_formatted_write_block)(fmt, __str_put_block, &str, ap);
 
 		/* Terminate string */
 		*str = '\0';
 	}
 	else
-		result = PGM_FUNC(_formatted_write)(fmt, __null_put_char, 0, ap);
+		result = PGM_FUNC(_formatted_write_block)(fmt, __null_put_block, 0, ap);
 
 
 	return result;
@@ -92,7 +92,7 @@ int PGM_FUNC(sprintf)(char *str, const char * fmt, ...)
 }
 
 /**
- * State information for __sn_put_char()
+ * State information for __sn_put_block()
  */
 struct __sn_state
 {
@@ -103,15 +103,14 @@ struct __sn_state
 /**
  * formatted_write() callback used [v]snprintf().
  */
-static void __sn_put_char(char c, void *ptr)
+static void __sn_put_block(const char *buf, size_t len, void *ptr)
 {
 	struct __sn_state *state = (struct __sn_state *)ptr;
 
-	if (state->len)
-	{
-		--state->len;
-		*state->str++ = c;
-	}
+	len = MIN(len, state->len);
+	memcpy(state->str, buf, len);
+	state->str += len;
+	state->len -= len;
 }
 
 
@@ -128,13 +127,13 @@ int PGM_FUNC(vsnprintf)(char *str, size_t size, const char * PGM_ATTR fmt, va_li
 			state.str = str;
 			state.len = size;
 
-			result = PGM_FUNC(_formatted_write)(fmt, __sn_put_char, &state, ap);
+			result = PGM_FUNC(_formatted_write_block)(fmt, __sn_put_block, &state, ap);
 
 			/* Terminate string. */
 			*state.str = '\0';
 		}
 		else
-			result = PGM_FUNC(_formatted_write)(fmt, __null_put_char, 0, ap);
+			result = PGM_FUNC(_formatted_write_block)(fmt, __null_put_block, 0, ap);
 	}
 
 	return result;
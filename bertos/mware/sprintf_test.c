@@ -40,6 +40,7 @@
 #include <cfg/compiler.h>
 #include <cfg/test.h>
 #include <cfg/debug.h>
+#include <cfg/macros.h> /* MIN() */
 
 #include <cpu/pgm.h>
 
@@ -48,6 +49,82 @@
 #include <string.h> /* strcmp() */
 
 
+#if UNIT_TEST
+/*
+ * Formatted logging benchmark: the same messages are formatted with
+ * a per character output function (how every sink worked before
+ * _formatted_write_block()) and with a block output function.
+ * Results are printed on stdout as:
+ * BENCH scenario=<name> path=<char|block> key=value ...
+ */
+struct BenchSink
+{
+	char *str;
+	size_t len;
+	unsigned long calls;
+};
+
+static void bench_putChar(char c, void *ptr)
+{
+	struct BenchSink *sink = (struct BenchSink *)ptr;
+
+	sink->calls++;
+	if (sink->len)
+	{
+		sink->len--;
+		*sink->str++ = c;
+	}
+}
+
+static void bench_putBlock(const char *buf, size_t len, void *ptr)
+{
+	struct BenchSink *sink = (struct BenchSink *)ptr;
+
+	sink->calls++;
+	len = MIN(len, sink->len);
+	memcpy(sink->str, buf, len);
+	sink->str += len;
+	sink->len -= len;
+}
+
+static int bench_printf(struct BenchSink *sink, bool block, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	if (block)
+		len = _formatted_write_block(fmt, bench_putBlock, sink, ap);
+	else
+		len = _formatted_write(fmt, bench_putChar, sink, ap);
+	va_end(ap);
+	return len;
+}
+
+static void bench(bool block)
+{
+	enum { ROUNDS = 20000 };
+	char buf[256];
+	struct BenchSink sink = { buf, 0, 0 };
+	unsigned long bytes = 0, start = bench_nsec(), elapsed;
+
+	for (int i = 0; i < ROUNDS; i++)
+	{
+		sink.str = buf;
+		sink.len = sizeof(buf) - 1;
+		bytes += bench_printf(&sink, block, "%s", "Hello, world!\n");
+		bytes += bench_printf(&sink, block, "%8d|%-8d|%08d|%ld|%lu|%hd\n", 123, -123, -123, -12345678L, 4294967295UL, -12345);
+		bytes += bench_printf(&sink, block, "%8.2f|%-8.2f|%8.0f\n", -123.456, -123.456, -123.456);
+		bytes += bench_printf(&sink, block, "[%5lu] %s: temperature %d.%d C, status 0x%04x\n", (unsigned long)i, "sensor", 21, i % 10, i & 0xFFFF);
+	}
+	elapsed = (bench_nsec() - start) / 1000;
+
+	printf("BENCH scenario=log_format path=%s msgs=%d bytes=%lu sink_calls=%lu time_us=%lu ns_per_msg=%lu\n",
+		block ? "block" : "char", ROUNDS * 4, bytes, sink.calls, elapsed,
+		elapsed * 1000 / (ROUNDS * 4));
+}
+#endif /* UNIT_TEST */
+
 int sprintf_testSetup(void)
 {
 	kdbg_init();
@@ -102,6 +179,20 @@ int sprintf_testRun(void)
 		return 4;
 	sprintf(NULL, test_string); /* must not crash */
 
+	/* Truncation and padding longer than a run */
+	if (snprintf(buf, 6, "%s", test_string) != (int)strlen(test_string) || strcmp(buf, "Hello") != 0)
+		return 5;
+	snprintf(buf, sizeof buf, "%40d|%-20s|", 7, "x");
+	if (strcmp(buf, "                                       7|x                   |") != 0)
+		return 6;
+	if (snprintf(buf, sizeof buf, "100%% %s %%d", "sure") != 12 || strcmp(buf, "100% sure %d") != 0)
+		return 7;
+
+#if UNIT_TEST
+	bench(false);
+	bench(true);
+#endif
+
 	return 0;
 }
 
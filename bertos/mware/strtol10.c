@@ -30,7 +30,7 @@
  *
  * -->
  *
- * \brief Poor man's hex arrays (implementation).
+ * \brief Poor man's strtol() (implementation).
  *
  * \version $Id: strtol10.c 1532 2008-08-04 07:21:26Z bernie $
  * \author Bernie Innocenti <bernie@codewiz.org>
@@ -38,6 +38,22 @@
 
 #include "strtol10.h"
 
+#include <limits.h> /* ULONG_MAX, LONG_MAX */
+
+/**
+ * Multipliers for chunks of 1, 2, 3 and 4 digits.
+ */
+static const uint16_t strtoul10_mul[] = { 10, 100, 1000, 10000 };
+
+/**
+ * Largest values that can be multiplied by 10, 100, 1000 and 10000
+ * without overflowing an unsigned long.
+ */
+static const unsigned long strtoul10_max[] =
+{
+	ULONG_MAX / 10, ULONG_MAX / 100, ULONG_MAX / 1000, ULONG_MAX / 10000
+};
+
 /**
  * Convert a formatted base-10 ASCII number to unsigned long binary representation.
  *
@@ -45,42 +61,76 @@
  * that makes it better suited for protocol parsers.  It's also
  * much simpler and smaller than a full featured strtoul().
  *
+ * Digits are parsed in chunks of 4 with 16 bit arithmetic, and
+ * added to the result with a single multiplication for each chunk,
+ * so overflow is checked once every 4 digits.
+ *
  * \param first  Pointer to first byte of input range (STL-style).
  * \param last   Pointer to end of input range (STL-style).
  *               Pass NULL to parse up to the first \\0.
  * \param val    Pointer to converted value.
  *
- * \return true for success, false for failure.
+ * \return true for success, false for failure (bad digits or overflow).
  *
  * \see strtol10()
  */
 bool strtoul10(const char *first, const char *last, unsigned long *val)
 {
+	unsigned long v = 0;
+
 	// Check for no input
 	if (*first == '\0')
 		return false;
 
-	*val = 0;
-	for(/*nop*/; first != last && *first != '\0'; ++first)
+	while (first != last && *first != '\0')
 	{
-		if ((*first < '0') || (*first > '9'))
-			return false;
+		uint16_t chunk = 0;
+		unsigned long mul;
+		uint8_t n = 0;
+
+		do
+		{
+			uint8_t digit = *first - '0';
 
-		*val = (*val * 10L) + (*first - '0');
+			if (digit > 9)
+			{
+				*val = v;
+				return false;
+			}
+			chunk = chunk * 10 + digit;
+			++first;
+		}
+		while (++n < 4 && first != last && *first != '\0');
+
+		if (v > strtoul10_max[n - 1])
+			goto overflow;
+		mul = v * strtoul10_mul[n - 1];
+		v = mul + chunk;
+		if (v < mul)
+			goto overflow;
 	}
 
+	*val = v;
 	return true;
+
+overflow:
+	*val = ULONG_MAX;
+	return false;
 }
 
 
 /**
  * Convert a formatted base-10 ASCII number to signed long binary representation.
  *
+ * \return true for success, false for failure (bad digits or overflow).
+ *
  * \see strtoul10()
  */
 bool strtol10(const char *first, const char *last, long *val)
 {
 	bool negative = false;
+	unsigned long u = 0;
+	bool result;
 
 	if (*first == '+')
 		++first; /* skip unary plus sign */
@@ -90,11 +140,14 @@ bool strtol10(const char *first, const char *last, long *val)
 		++first;
 	}
 
-	bool result = strtoul10(first, last, (unsigned long *)val);
+	result = strtoul10(first, last, &u);
 
-	if (negative)
-		*val = - *val;
+	if (u > (unsigned long)LONG_MAX + negative)
+	{
+		u = (unsigned long)LONG_MAX + negative;
+		result = false;
+	}
+	*val = negative ? -(long)(u - 1) - 1 : (long)u;
 
 	return result;
 }
-
@@ -0,0 +1,141 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ *
+ * \brief Fast integer to ASCII conversion kernels.
+ *
+ * Converting a number with repeated divisions by 10 costs a
+ * library call for each digit on CPUs without a hardware divider
+ * (AVR, i196, DSP56K). ultoa10() divides only once every 4 digits;
+ * the 4 digit chunks are split with multiplications by fixed point
+ * reciprocals, exact in their range:
+ * \li x / 100 == (x * 5243) >> 19 for x < 10000;
+ * \li x / 10  == (x * 205) >> 11  for x < 1029.
+ *
+ * Digits are written backwards, ending just before a given pointer,
+ * which is how printf-like formatters fill their buffers:
+ * \code
+ * char buf[ULTOA10_LEN];
+ * char *s = ultoa10(val, buf + sizeof(buf));
+ * kfile_write(fd, s, buf + sizeof(buf) - s);
+ * \endcode
+ *
+ * ultohex() takes its digits from the tables of mware/hex.h.
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#ifndef MWARE_ULTOA_H
+#define MWARE_ULTOA_H
+
+#include <cfg/compiler.h>
+
+/**
+ * Max number of digits of an unsigned long, in base 10.
+ */
+#define ULTOA10_LEN  (sizeof(unsigned long) * 5 / 2 + 1)
+
+/**
+ * Max number of digits of an unsigned long, in base 16.
+ */
+#define ULTOHEX_LEN  (sizeof(unsigned long) * 2)
+
+/**
+ * Write the two digits of \a val (< 100) before \a end.
+ */
+INLINE char *ultoa10_2(uint8_t val, char *end)
+{
+	uint8_t tens = ((uint16_t)val * 205) >> 11;
+
+	*--end = '0' + (val - tens * 10);
+	*--end = '0' + tens;
+	return end;
+}
+
+/**
+ * Write the four digits of \a val (< 10000), leading zeros
+ * included, before \a end.
+ */
+INLINE char *ultoa10_4(uint16_t val, char *end)
+{
+	uint8_t hi = ((uint32_t)val * 5243) >> 19;
+
+	end = ultoa10_2(val - hi * 100, end);
+	return ultoa10_2(hi, end);
+}
+
+/**
+ * Write the decimal digits of \a val before \a end.
+ * \return a pointer to the first digit.
+ */
+INLINE char *ultoa10(unsigned long val, char *end)
+{
+	uint16_t v;
+
+	/* A single division every 4 digits */
+	while (val >= 10000)
+	{
+		unsigned long q = val / 10000;
+
+		end = ultoa10_4(val - q * 10000, end);
+		val = q;
+	}
+
+	/* Last chunk, without leading zeros */
+	v = val;
+	if (v >= 100)
+	{
+		uint8_t hi = ((uint32_t)v * 5243) >> 19;
+
+		end = ultoa10_2(v - hi * 100, end);
+		v = hi;
+	}
+	if (v >= 10)
+		return ultoa10_2(v, end);
+	*--end = '0' + v;
+	return end;
+}
+
+/**
+ * Write the hexadecimal digits of \a val before \a end, using
+ * the digits in \a tab (hex_tab or HEX_tab).
+ * \return a pointer to the first digit.
+ */
+INLINE char *ultohex(unsigned long val, char *end, const char *tab)
+{
+	do
+		*--end = tab[val & 0xF];
+	while (val >>= 4);
+	return end;
+}
+
+#endif /* MWARE_ULTOA_H */
@@ -0,0 +1,313 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * Copyright 2008 Develer S.r.l. (http://www.develer.com/)
+ * -->
+ *
+ *
+ * \brief Integer conversion kernels test.
+ *
+ * ultoa10(), ultohex(), strtoul10() and strtol10() are checked against
+ * the C library: the 4 and 2 digit kernels and their reciprocals
+ * exhaustively, full conversions on all the values below 2^20, around
+ * every power of 2 and 10 and on pseudo random values.
+ *
+ * The benchmark compares the new kernels with the digit by digit
+ * conversions they replace; on the host divisions are cheap, so the
+ * number of divisions and of multiplications on longs, the real cost
+ * on small CPUs, is reported too. Results are printed on stdout as:
+ * \code
+ * BENCH scenario=<name> path=<digit|chunk> key=value ...
+ * \endcode
+ *
+ * \version $Id$
+ * \author Francesco Sacchi <batt@develer.com>
+ */
+
+#include "ultoa.h"
+#include "strtol10.h"
+#include "hex.h"
+
+#include <cfg/debug.h>
+#include <cfg/test.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#if UNIT_TEST
+#define BENCH_VALUES  1000000
+
+static unsigned long rand_state = 1;
+
+/* Pseudo random values, with any number of digits */
+static unsigned long rnd(void)
+{
+	unsigned long r;
+
+	rand_state = rand_state * 1103515245UL + 12345;
+	r = rand_state ^ (rand_state << 31 << 1 >> 17);
+	return r >> ((rand_state >> 16) % (sizeof(r) * 8));
+}
+
+static void checkValue(unsigned long val)
+{
+	char buf[ULTOA10_LEN + 1], ref[32], *s, *end = buf + ULTOA10_LEN;
+	unsigned long parsed;
+	long sparsed;
+
+	*end = '\0';
+	s = ultoa10(val, end);
+	snprintf(ref, sizeof(ref), "%lu", val);
+	if (strcmp(s, ref))
+	{
+		kprintf("ultoa10(%lu): %s\n", val, s);
+		ASSERT(0);
+	}
+	ASSERT(strtoul10(s, NULL, &parsed) && parsed == val);
+	ASSERT(strtoul10(s, end, &parsed) && parsed == val);
+
+	if (val <= LONG_MAX)
+	{
+		ASSERT(strtol10(s, NULL, &sparsed) && sparsed == (long)val);
+		*--s = '-';
+		ASSERT(strtol10(s, NULL, &sparsed) && sparsed == -(long)val);
+		*s = '+';
+		ASSERT(strtol10(s, NULL, &sparsed) && sparsed == (long)val);
+	}
+
+	s = ultohex(val, end, hex_tab);
+	snprintf(ref, sizeof(ref), "%lx", val);
+	ASSERT(!strcmp(s, ref));
+	s = ultohex(val, end, HEX_tab);
+	snprintf(ref, sizeof(ref), "%lX", val);
+	ASSERT(!strcmp(s, ref));
+}
+
+static void kernels(void)
+{
+	char buf[4], ref[8];
+	unsigned x;
+
+	for (x = 0; x < 1029; x++)
+		ASSERT(((x * 205) >> 11) == x / 10);
+	for (x = 0; x < 10000; x++)
+		ASSERT(((x * 5243UL) >> 19) == x / 100);
+
+	for (x = 0; x < 100; x++)
+	{
+		ASSERT(ultoa10_2(x, buf + 2) == buf);
+		snprintf(ref, sizeof(ref), "%02u", x);
+		ASSERT(!memcmp(buf, ref, 2));
+	}
+	for (x = 0; x < 10000; x++)
+	{
+		ASSERT(ultoa10_4(x, buf + 4) == buf);
+		snprintf(ref, sizeof(ref), "%04u", x);
+		ASSERT(!memcmp(buf, ref, 4));
+	}
+}
+
+static void conversions(void)
+{
+	unsigned long val, p;
+	int i, d;
+
+	for (val = 0; val < (1UL << 20); val++)
+		checkValue(val);
+
+	/* Around powers of 10 and 2, up to the largest unsigned long */
+	for (p = 10; ; p *= 10)
+	{
+		for (d = -1000; d <= 1000; d++)
+			checkValue(p + d);
+		if (p > ULONG_MAX / 10)
+			break;
+	}
+	for (i = 20; i < (int)sizeof(val) * 8; i++)
+		for (d = -1000; d <= 1000; d++)
+			checkValue((1UL << i) + d);
+	for (val = ULONG_MAX - 10000; val != 0; val++)
+		checkValue(val);
+
+	for (i = 0; i < BENCH_VALUES; i++)
+		checkValue(rnd());
+}
+
+static void parseErrors(void)
+{
+	char buf[64];
+	unsigned long u;
+	long l;
+
+	ASSERT(!strtoul10("", NULL, &u));
+	ASSERT(!strtoul10("12a4", NULL, &u));
+	ASSERT(!strtoul10("-1", NULL, &u));
+	ASSERT(!strtol10("-", NULL, &l));
+	ASSERT(!strtol10("", NULL, &l));
+
+	/* Parse ranges */
+	ASSERT(strtoul10("123456789", "123456789" + 0, &u) == true);
+	ASSERT(strtoul10("1234567x", NULL, &u) == false);
+	{
+		static const char str[] = "1234567x";
+		ASSERT(strtoul10(str, str + 7, &u) && u == 1234567);
+		ASSERT(strtoul10(str, str + 1, &u) && u == 1);
+	}
+	ASSERT(strtoul10("0000000000000000000000000042", NULL, &u) && u == 42);
+
+	/* Overflow */
+	snprintf(buf, sizeof(buf), "%lu", ULONG_MAX);
+	ASSERT(strtoul10(buf, NULL, &u) && u == ULONG_MAX);
+	buf[strlen(buf) - 1]++;
+	ASSERT(!strtoul10(buf, NULL, &u));
+	snprintf(buf, sizeof(buf), "%lu0", ULONG_MAX / 10 + 1);
+	ASSERT(!strtoul10(buf, NULL, &u));
+	ASSERT(!strtoul10("100000000000000000000000000", NULL, &u));
+
+	snprintf(buf, sizeof(buf), "%ld", LONG_MAX);
+	ASSERT(strtol10(buf, NULL, &l) && l == LONG_MAX);
+	snprintf(buf, sizeof(buf), "%ld", LONG_MIN);
+	ASSERT(strtol10(buf, NULL, &l) && l == LONG_MIN);
+	snprintf(buf, sizeof(buf), "%lu", (unsigned long)LONG_MAX + 1);
+	ASSERT(!strtol10(buf, NULL, &l));
+	snprintf(buf, sizeof(buf), "-%lu", (unsigned long)LONG_MAX + 2);
+	ASSERT(!strtol10(buf, NULL, &l));
+}
+
+/*
+ * Digit by digit conversions, as done before.
+ */
+static char *ref_ultoa10(unsigned long val, char *end)
+{
+	do
+		*--end = '0' + val % 10;
+	while (val /= 10);
+	return end;
+}
+
+static bool ref_strtoul10(const char *first, const char *last, unsigned long *val)
+{
+	if (*first == '\0')
+		return false;
+
+	*val = 0;
+	for (; first != last && *first != '\0'; ++first)
+	{
+		if ((*first < '0') || (*first > '9'))
+			return false;
+		*val = (*val * 10L) + (*first - '0');
+	}
+	return true;
+}
+
+static void bench(void)
+{
+	static unsigned long values[BENCH_VALUES];
+	static char strings[BENCH_VALUES][ULTOA10_LEN + 1];
+	char buf[ULTOA10_LEN], *end = buf + sizeof(buf);
+	unsigned long start, t, sum, digits = 0, divs_digit = 0, divs_chunk = 0, chunks = 0;
+	int i, path;
+
+	rand_state = 42;
+	for (i = 0; i < BENCH_VALUES; i++)
+	{
+		char *s = ultoa10(values[i] = rnd(), end);
+		size_t len = end - s;
+
+		memcpy(strings[i], s, len);
+		strings[i][len] = '\0';
+		digits += len;
+		divs_digit += len;
+		divs_chunk += (len - 1) / 4;
+		chunks += (len + 3) / 4;
+	}
+
+	for (path = 0; path < 2; path++)
+	{
+		sum = 0;
+		start = bench_nsec();
+		for (i = 0; i < BENCH_VALUES; i++)
+			sum += *(path ? ultoa10(values[i], end) : ref_ultoa10(values[i], end));
+		t = bench_nsec() - start;
+		printf("BENCH scenario=utoa path=%s values=%d digits=%lu divisions=%lu time_us=%lu ns_per_value=%lu sum=%lu\n",
+			path ? "chunk" : "digit", BENCH_VALUES, digits, path ? divs_chunk : divs_digit,
+			t / 1000, t / BENCH_VALUES, sum);
+	}
+
+	for (path = 0; path < 2; path++)
+	{
+		unsigned long u;
+
+		sum = 0;
+		start = bench_nsec();
+		for (i = 0; i < BENCH_VALUES; i++)
+		{
+			if (path)
+				strtoul10(strings[i], NULL, &u);
+			else
+				ref_strtoul10(strings[i], NULL, &u);
+			sum += u;
+		}
+		t = bench_nsec() - start;
+		printf("BENCH scenario=atou path=%s values=%d digits=%lu long_multiplies=%lu time_us=%lu ns_per_value=%lu sum=%lu\n",
+			path ? "chunk" : "digit", BENCH_VALUES, digits, path ? chunks : digits,
+			t / 1000, t / BENCH_VALUES, sum);
+	}
+}
+
+int ultoa_testSetup(void)
+{
+	kdbg_init();
+	return 0;
+}
+
+int ultoa_testRun(void)
+{
+	kernels();
+	conversions();
+	parseErrors();
+	bench();
+
+	kprintf("All tests passed!\n");
+	return 0;
+}
+
+int ultoa_testTearDown(void)
+{
+	return 0;
+}
+
+TEST_MAIN(ultoa);
+
+#include <mware/strtol10.c>
+#include <mware/hex.c>
+#include <drv/kdebug.c>
+#include <mware/formatwr.c>
+
+#endif // UNIT_TEST
@@ -199,6 +199,40 @@ INLINE void fifo_flush(FIFOBuffer *fb)
 	fb->head = fb->tail;
 }
 
+/**
+ * \return the number of free locations that can be written
+ *         contiguously starting from \c tail, without wrapping around.
+ *
+ * \note The value can only grow if a concurrent context pops
+ *       characters in the meantime.
+ */
+INLINE size_t fifo_contigFree(const FIFOBuffer *fb)
+{
+	unsigned char *head = fb->head;
+
+	if (fb->tail >= head)
+		/* The last location must stay free if head is at the beginning */
+		return fb->end - fb->tail + (head != fb->begin);
+	else
+		return head - fb->tail - 1;
+}
+
+/**
+ * Push \a len characters, already written in place starting from \c tail.
+ * This allows a producer to fill the fifo without copying data.
+ *
+ * \note \a len must not exceed fifo_contigFree().
+ */
+INLINE void fifo_pushInPlace(FIFOBuffer *fb, size_t len)
+{
+	unsigned char *tail = fb->tail + len;
+
+	if (UNLIKELY(tail > fb->end))
+		/* wrap tail around */
+		tail = fb->begin;
+	fb->tail = tail;
+}
+
 
 #if CPU_REG_BITS >= CPU_BITS_PER_PTR
 
@@ -210,6 +244,8 @@ INLINE void fifo_flush(FIFOBuffer *fb)
 	#define fifo_push_locked(fb, c) fifo_push((fb), (c))
 	#define fifo_pop_locked(fb)     fifo_pop((fb))
 	#define fifo_flush_locked(fb)   fifo_flush((fb))
+	#define fifo_contigFree_locked(fb)       fifo_contigFree((fb))
+	#define fifo_pushInPlace_locked(fb, len) fifo_pushInPlace((fb), (len))
 
 #else /* CPU_REG_BITS < CPU_BITS_PER_PTR */
 
@@ -263,6 +299,24 @@ INLINE void fifo_flush(FIFOBuffer *fb)
 		ATOMIC(fifo_flush(fb));
 	}
 
+	/**
+	 * Thread safe version of fifo_contigFree().
+	 */
+	INLINE size_t fifo_contigFree_locked(const FIFOBuffer *fb)
+	{
+		size_t len;
+		ATOMIC(len = fifo_contigFree(fb));
+		return len;
+	}
+
+	/**
+	 * Thread safe version of fifo_pushInPlace().
+	 */
+	INLINE void fifo_pushInPlace_locked(FIFOBuffer *fb, size_t len)
+	{
+		ATOMIC(fifo_pushInPlace(fb, len));
+	}
+
 #endif /* CPU_REG_BITS < BITS_PER_PTR */
 
 